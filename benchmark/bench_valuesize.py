@@ -16,6 +16,8 @@ from pysciqlop_cache import Cache as SciqlopCache
 from diskcache import Cache as DiskCache
 
 VALUE_SIZES = [64, 200, 1024, 4096, 8192, 16384, 65536, 262144, 1048576]
+READ_STRATEGY_SIZES = [16384 * 2**i for i in range(9)]  # 16 KiB .. 4 MiB
+READ_STRATEGIES = {"pread": 2**63, "mmap": 0}  # pread cutoff forcing each one
 BATCH_SIZES = [1, 10, 50, 100, 500]
 BATCH_VALUE_SIZES = [200, 16384, 65536]
 
@@ -86,6 +88,30 @@ def bench_batch_ops(writer):
             print(f"  batch: value_size={sz:>10,}  batch_n={batch_n:>4} done", file=sys.stderr)
 
 
+def bench_read_strategy(writer):
+    """First read of file-backed values with pread vs mmap, to locate the
+    crossover that the default pread cutoff is set from."""
+    for sz in READ_STRATEGY_SIZES:
+        value = os.urandom(sz)
+        n_keys = max(20, 500 // max(1, sz // 65536))
+
+        for strategy, cutoff in READ_STRATEGIES.items():
+            with TemporaryDirectory() as tmp:
+                cache = SciqlopCache(tmp)
+                cache.set_pread_cutoff(cutoff)
+                keys = [f"k{i}" for i in range(n_keys)]
+                for k in keys:
+                    cache.set(k, value)
+
+                # Each key is read once, so no read is served by the mmap
+                # handle cache.
+                it = iter(keys)
+                t = measure(lambda: cache.get(next(it)), n_keys)
+                writer.writerow([f"sciqlop-{strategy}", "first_get", sz, 1, f"{t:.2f}"])
+
+        print(f"  read strategy: value_size={sz:>10,} bytes done", file=sys.stderr)
+
+
 def main():
     writer = csv.writer(sys.stdout)
     writer.writerow(["backend", "operation", "value_size", "batch_size", "latency_us"])
@@ -99,6 +125,10 @@ def main():
     bench_batch_ops(writer)
     sys.stdout.flush()
 
+    print("Running read strategy sweep...", file=sys.stderr)
+    bench_read_strategy(writer)
+    sys.stdout.flush()
+
     print("Done.", file=sys.stderr)
 
 
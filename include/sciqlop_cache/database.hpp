@@ -356,7 +356,7 @@ private:
     void _ensure_parent_directory(const std::filesystem::path& db_path)
     {
         auto parent_path = db_path.parent_path();
-        if (!std::filesystem::exists(parent_path))
+        if (!parent_path.empty() && !std::filesystem::exists(parent_path))
         {
             std::filesystem::create_directories(parent_path);
         }
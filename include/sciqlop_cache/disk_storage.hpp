@@ -1,206 +1,2140 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cerrno>
+#include <cstdlib>
 #include <cpp_utils/io/memory_mapped_file.hpp>
+#include <cstdint>
+#include <deque>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
-#include <list>
 #include <mutex>
 #include <optional>
 #include <random>
+#include <shared_mutex>
+#include <span>
+#include <string_view>
 #include <sqlite3.h>
 #include <string>
+#include <system_error>
+#include <thread>
 #include <unordered_map>
 #include <uuid.h>
+#include <vector>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/statvfs.h>
+#include <unistd.h>
+#endif
+#include "sciqlop_cache/utils/batch_io.hpp"
 #include "sciqlop_cache/utils/concepts.hpp"
 #include "sciqlop_cache/utils/buffer.hpp"
 
+// How far a value file is pushed towards stable storage before the entry
+// holding it is committed.
+enum class Durability : uint8_t
+{
+    // Left in the page cache for the kernel to write back: the fastest, but
+    // a power loss can leave a committed entry with a missing or torn file.
+    none,
+    // Each file is written under a temporary name, fdatasync'ed, renamed into
+    // place and its directory synced, and commits sync the WAL: an entry is
+    // durable once set() returns, and a value file is never seen half-written.
+    sync,
+    // Files are written as with `none` and flushed in waves by the store's
+    // background thread (ahead of each checkpoint, at least once per
+    // housekeeping tick, or as soon as a batch is pending) together with the
+    // WAL, so many writes share one round of fdatasyncs; sync() forces a
+    // wave. Entries written before the last wave survive a crash. Those
+    // written since may be lost, or come back torn: with
+    // synchronous=NORMAL, writeback can put the WAL frames committing a row
+    // on disk before its value file's data. Pair this mode with checksum
+    // verification (VerifyPolicy) so a torn value reads as a miss.
+    group
+};
+
+// Fan-out of the value file tree: `depth` levels of `width` directories,
+// all created when the storage opens. Wide and shallow suits filesystems
+// with hashed directory indexes (ext4, XFS, btrfs, APFS, NTFS); a deeper
+// tree keeps each directory small where lookups scan entries (FAT, some
+// network filesystems). Clamped to 1 to 3 levels of 1 to 4096 directories
+// and 65536 directories in all: files never land in the store's root, next
+// to the database and the trash.
+struct StorageLayout
+{
+    std::size_t depth = 1;
+    std::size_t width = 256;
+
+    bool operator==(const StorageLayout&) const = default;
+};
+
+// Values of at least `threshold` bytes (0, the default: none) are split
+// into files of `chunk_size` bytes, kept together in one <name>.chunks
+// directory and written by up to `workers` threads at once: writes into
+// separate files proceed in parallel, where writes into one file serialize
+// on its inode lock. Reads map the chunks side by side into one contiguous
+// view, and range reads only touch the chunks they cover. chunk_size is
+// rounded up to whole pages. POSIX only: elsewhere values stay whole.
+struct ChunkPolicy
+{
+    std::size_t threshold = 0;
+    std::size_t chunk_size = 64 * 1024 * 1024;
+    std::size_t workers = 4;
+
+    bool operator==(const ChunkPolicy&) const = default;
+};
+
+struct MmapCacheStats
+{
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t entries;
+    uint64_t mapped_bytes;
+    uint64_t capacity_bytes;
+};
+
+// Cache of mapped value files, so hot values skip open/mmap/munmap/close.
+// Entries are keyed by a 64-bit ID hashed from the value file name (unique
+// across the tree, see DiskStorage::_next_rel_path) and spread over independent shards, each with
+// its own lock. Replacement is CLOCK: a hit only sets a reference bit under
+// the shard's shared lock, so concurrent readers of the same shard do not
+// serialize on list splices the way an LRU would. Each shard holds at most
+// capacity_bytes / shard_count mapped bytes (and max_entries / shard_count
+// mappings, to stay clear of the kernel's map count limit); a file larger
+// than a shard's budget is simply not cached.
+class MmapHandleCache
+{
+public:
+    static constexpr std::size_t shard_count = 16;
+    static constexpr std::size_t default_capacity_bytes = 512 * 1024 * 1024;
+    static constexpr std::size_t max_entries = 16384;
+
+    explicit MmapHandleCache(std::size_t capacity_bytes = default_capacity_bytes)
+            : _capacity_bytes(capacity_bytes)
+            , _shard_budget(capacity_bytes / shard_count)
+    {
+    }
+
+    using name_view = std::basic_string_view<std::filesystem::path::value_type>;
+
+    [[nodiscard]] static inline name_view file_name(name_view path) noexcept
+    {
+        auto pos = path.size();
+        while (pos > 0 && path[pos - 1] != '/' && path[pos - 1] != '\\')
+            --pos;
+        return path.substr(pos);
+    }
+
+    [[nodiscard]] static inline uint64_t compact_id(name_view path) noexcept
+    {
+        return std::hash<name_view> {}(file_name(path));
+    }
+
+    std::shared_ptr<MemoryMappedFile> get(uint64_t id, name_view name)
+    {
+        auto& shard = _shard(id);
+        {
+            std::shared_lock lk { shard.mtx };
+            if (auto it = shard.index.find(id); it != shard.index.end())
+            {
+                auto& slot = shard.slots[it->second];
+                if (slot.name == name)
+                {
+                    slot.referenced.store(true, std::memory_order_relaxed);
+                    shard.hits.fetch_add(1, std::memory_order_relaxed);
+                    return slot.mmf;
+                }
+            }
+        }
+        shard.misses.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+
+    void put(uint64_t id, name_view name, std::shared_ptr<MemoryMappedFile> mmf)
+    {
+        const auto bytes = mmf->size();
+        const auto budget = _shard_budget.load(std::memory_order_relaxed);
+        if (bytes > budget)
+            return;
+        auto& shard = _shard(id);
+        std::unique_lock lk { shard.mtx };
+        _erase_locked(shard, id);
+        while (shard.live > 0
+               && (shard.bytes + bytes > budget || shard.live >= max_entries / shard_count))
+            _evict_one_locked(shard);
+        std::size_t pos;
+        if (!shard.free.empty())
+        {
+            pos = shard.free.back();
+            shard.free.pop_back();
+        }
+        else
+        {
+            pos = shard.slots.size();
+            shard.slots.emplace_back();
+        }
+        auto& slot = shard.slots[pos];
+        slot.id = id;
+        slot.name.assign(name);
+        slot.mmf = std::move(mmf);
+        slot.bytes = bytes;
+        slot.referenced.store(false, std::memory_order_relaxed);
+        shard.index.emplace(id, pos);
+        shard.bytes += bytes;
+        ++shard.live;
+    }
+
+    void erase(uint64_t id)
+    {
+        auto& shard = _shard(id);
+        std::unique_lock lk { shard.mtx };
+        _erase_locked(shard, id);
+    }
+
+    void clear()
+    {
+        for (auto& shard : _shards)
+        {
+            std::unique_lock lk { shard.mtx };
+            shard.slots.clear();
+            shard.index.clear();
+            shard.free.clear();
+            shard.hand = 0;
+            shard.bytes = 0;
+            shard.live = 0;
+        }
+    }
+
+    [[nodiscard]] MmapCacheStats stats() const
+    {
+        MmapCacheStats st { 0, 0, 0, 0, _capacity_bytes.load(std::memory_order_relaxed) };
+        for (auto& shard : _shards)
+        {
+            st.hits += shard.hits.load(std::memory_order_relaxed);
+            st.misses += shard.misses.load(std::memory_order_relaxed);
+            std::shared_lock lk { shard.mtx };
+            st.entries += shard.live;
+            st.mapped_bytes += shard.bytes;
+        }
+        return st;
+    }
+
+    [[nodiscard]] std::size_t capacity() const
+    {
+        return _capacity_bytes.load(std::memory_order_relaxed);
+    }
+
+    // Shrinking unmaps the least recently used entries of each shard down
+    // to its new budget.
+    void set_capacity(std::size_t capacity_bytes)
+    {
+        _capacity_bytes.store(capacity_bytes, std::memory_order_relaxed);
+        _shard_budget.store(capacity_bytes / shard_count, std::memory_order_relaxed);
+        for (auto& shard : _shards)
+        {
+            std::unique_lock lk { shard.mtx };
+            while (shard.live > 0 && shard.bytes > capacity_bytes / shard_count)
+                _evict_one_locked(shard);
+        }
+    }
+
+    void reset_stats()
+    {
+        for (auto& shard : _shards)
+        {
+            shard.hits.store(0, std::memory_order_relaxed);
+            shard.misses.store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    struct Slot
+    {
+        uint64_t id = 0;
+        std::filesystem::path::string_type name;
+        std::shared_ptr<MemoryMappedFile> mmf;
+        std::size_t bytes = 0;
+        std::atomic<bool> referenced { false };
+    };
+
+    struct alignas(64) Shard
+    {
+        mutable std::shared_mutex mtx;
+        // A deque never relocates its elements, so slots (and their atomic
+        // reference bits) stay put as the ring grows.
+        std::deque<Slot> slots;
+        std::unordered_map<uint64_t, std::size_t> index;
+        std::vector<std::size_t> free;
+        std::size_t hand = 0;
+        std::size_t bytes = 0;
+        std::size_t live = 0;
+        std::atomic<uint64_t> hits { 0 };
+        std::atomic<uint64_t> misses { 0 };
+    };
+
+    std::atomic<std::size_t> _capacity_bytes;
+    std::atomic<std::size_t> _shard_budget;
+    std::array<Shard, shard_count> _shards;
+
+    Shard& _shard(uint64_t id) { return _shards[(id ^ (id >> 32)) % shard_count]; }
+
+    static void _release_locked(Shard& shard, std::size_t pos)
+    {
+        auto& slot = shard.slots[pos];
+        shard.bytes -= slot.bytes;
+        --shard.live;
+        slot.mmf.reset();
+        slot.name.clear();
+        slot.bytes = 0;
+        shard.free.push_back(pos);
+    }
+
+    static void _erase_locked(Shard& shard, uint64_t id)
+    {
+        if (auto it = shard.index.find(id); it != shard.index.end())
+        {
+            _release_locked(shard, it->second);
+            shard.index.erase(it);
+        }
+    }
+
+    // Advance the hand, giving referenced slots a second chance, until an
+    // unreferenced live slot is found and dropped. Terminates within two
+    // sweeps since every pass over a slot clears its bit.
+    static void _evict_one_locked(Shard& shard)
+    {
+        for (;;)
+        {
+            if (shard.hand >= shard.slots.size())
+                shard.hand = 0;
+            auto& slot = shard.slots[shard.hand++];
+            if (!slot.mmf)
+                continue;
+            if (slot.referenced.exchange(false, std::memory_order_relaxed))
+                continue;
+            shard.index.erase(slot.id);
+            _release_locked(shard, shard.hand - 1);
+            return;
+        }
+    }
+};
+
 class DiskStorage
 {
     std::random_device rd;
     std::mt19937 gen;
     uuids::uuid_random_generator uuid_generator;
     std::filesystem::path _path;
+    // Optional second root, typically on a larger and slower volume, for
+    // values that went cold (see _Store::set_tier_policy). Their rows store
+    // cold_dirname/<path under that root>, so either root can move on its
+    // own. Empty without a cold tier. Set up front: reads resolve paths
+    // against it without locking.
+    std::filesystem::path _cold_path;
+
+    // Value file names are a random 64-bit tag, drawn per instance (and
+    // again in a forked child), and a counter: unique among all the
+    // processes sharing the tree, without a UUID per write. The counter also
+    // picks the directory: runs of _dir_run consecutive files share one, for
+    // locality, and successive runs go round the fan-out. _create_layout()
+    // makes every directory up front, so a write does no stat or mkdir; only
+    // when its directory has vanished (a clear(), maybe by another process)
+    // does it recreate it and retry.
+    static constexpr uint64_t _dir_run = 64;
+    std::atomic<std::size_t> _fanout_depth { StorageLayout {}.depth };
+    std::atomic<std::size_t> _fanout_width { StorageLayout {}.width };
+    uint64_t _name_tag = 0;
+    std::string _name_prefix;
+    std::atomic<uint64_t> _name_counter { 0 };
 
-    // LRU mmap handle cache: path_string → shared_ptr<MemoryMappedFile>.
-    // The user-facing path (set/get/del) calls into DiskStorage under the
-    // store's _mtx, but the background checkpoint thread also calls
-    // remove() lock-free during eviction (see _Store::_bg_evict). So this
-    // cache needs its own mutex.
-    mutable std::mutex _cache_mutex;
-    std::size_t _mmap_cache_capacity;
-    std::list<std::string> _lru_order;
-    std::unordered_map<std::string,
-        std::pair<std::shared_ptr<MemoryMappedFile>,
-                  std::list<std::string>::iterator>> _mmap_cache;
+    // Mapped value files (see MmapHandleCache). The user-facing path
+    // (set/get/del) calls into DiskStorage under the store's _mtx, but the
+    // background checkpoint thread also calls defer_remove() lock-free after
+    // eviction (see _Store::_bg_delete), so the cache locks on its own.
+    MmapHandleCache _mmap_cache;
 
-    void _evict_lru_locked()
+    // Files smaller than the cutoff are read with a single pread() into a
+    // pooled block instead of being mapped: up to a couple hundred KiB the
+    // mmap/munmap pair and the page faults cost more than the copy (see
+    // BM_LoadStrategy in tests/bench_perf). Larger files are mapped, with a
+    // WILLNEED hint, and kept in _mmap_cache.
+    std::atomic<std::size_t> _pread_cutoff { default_pread_cutoff };
+    std::shared_ptr<ReadBufferPool> _read_pool = ReadBufferPool::create();
+
+    // Chunked values (see ChunkPolicy).
+    std::atomic<std::size_t> _chunk_threshold { ChunkPolicy {}.threshold };
+    std::atomic<std::size_t> _chunk_size { ChunkPolicy {}.chunk_size };
+    std::atomic<std::size_t> _chunk_workers { ChunkPolicy {}.workers };
+
+    // Batched file I/O for load_many(), store_many() and drain_removals().
+    // io_uring is opt-in (set_io_uring_enabled): it pays off when batches
+    // reach the device, but on page-cache-hot files one plain syscall per
+    // operation is slightly faster (see BM_LoadMany). The drain runs on the
+    // store's background thread, so it gets its own ring rather than
+    // queueing behind user batches. Created on first use.
+    std::atomic<bool> _use_io_uring { false };
+    std::mutex _io_mutex;
+    std::unique_ptr<BatchIo> _io;
+    std::mutex _drain_io_mutex;
+    std::unique_ptr<BatchIo> _drain_io;
+
+    // Durability mode (see Durability). In group mode the files written
+    // since the last sync_pending(), and the directories whose entries
+    // changed for them, wait here for the next wave. Waves run under
+    // _drain_io_mutex (they share the background thread's ring), which also
+    // makes sync_pending() a barrier: it returns once every file queued
+    // before the call is on the device, even if another thread's wave
+    // picked it up. Each tier has its own list (hot first, then cold) since
+    // a wave flushes each tier's filesystem on its own.
+    struct _Unsynced
     {
-        if (_lru_order.empty()) return;
-        _mmap_cache.erase(_lru_order.back());
-        _lru_order.pop_back();
-    }
+        std::vector<std::string> files;
+        std::vector<std::string> dirs;
+    };
+    std::atomic<Durability> _durability { Durability::none };
+    mutable std::mutex _unsynced_mutex;
+    std::array<_Unsynced, 2> _unsynced;
 
-    void _cache_evict_locked(const std::string& key)
+    // Deferred deletion queue. Files whose rows are already gone are renamed
+    // into <root>/.trash (a cheap metadata op, safe to do right after the
+    // commit) and unlinked later, in bounded batches, by drain_removals() —
+    // which the store's background thread calls without holding its lock.
+    // The trash directory makes the queue survive a crash: whatever is left
+    // in it is re-queued the next time the storage is opened.
+    mutable std::mutex _trash_mutex;
+    std::condition_variable _trash_cv;
+    std::deque<std::filesystem::path> _trash_queue;
+    std::size_t _draining = 0; // items popped but not yet fully processed
+
+    // On-disk bytes (rounded up to whole filesystem blocks) of the files this
+    // storage created minus those it unlinked since the owner last took the
+    // delta. The store folds it into a persisted total (see _Store::volume),
+    // so nobody has to walk the tree to know how much space values take.
+    std::size_t _block_size = 4096;
+    std::atomic<int64_t> _bytes_delta { 0 };
+
+    // Intent log. Each value file is announced, with the key it is written
+    // for, in a per-process journal (<prefix><pid>-<uuid>) BEFORE it is
+    // written; the journal is truncated once the owner's transaction settles
+    // (commit_intents/abort_intents), so it only ever lists writes whose
+    // commit is pending. The owner holds an flock on it for its lifetime: a
+    // journal nobody can lock belongs to a live process, one that can be
+    // locked to a dead one, and recover_intents() replays just its entries
+    // instead of walking the tree for orphans. Disabled until the owner sets
+    // a prefix, and on Windows.
+    std::mutex _intent_mutex;
+    std::filesystem::path _intent_prefix;
+    std::filesystem::path _intent_log;
+    int _intent_fd = -1;
+    std::vector<std::filesystem::path> _in_flight;
+
+    bool _open_intent_log_locked()
     {
-        auto it = _mmap_cache.find(key);
-        if (it != _mmap_cache.end())
+#if !defined(_WIN32)
+        if (_intent_fd >= 0)
+            return true;
+        if (_intent_prefix.empty())
+            return false;
+        auto name = _intent_prefix.string() + std::to_string(::getpid()) + "-"
+            + generate_random_filename();
+        // Locked under a temporary name first so recovery never sees (and
+        // reaps) a live journal in the window between open() and flock().
+        auto tmp = name + ".tmp";
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return false;
+        if (::flock(fd, LOCK_EX | LOCK_NB) != 0 || ::rename(tmp.c_str(), name.c_str()) != 0)
         {
-            _lru_order.erase(it->second.second);
-            _mmap_cache.erase(it);
+            ::close(fd);
+            ::unlink(tmp.c_str());
+            return false;
         }
+        _intent_fd = fd;
+        _intent_log = name;
+        return true;
+#else
+        return false;
+#endif
     }
 
-    std::shared_ptr<MemoryMappedFile> _cache_get_locked(const std::string& key)
+    void _log_intent(const std::filesystem::path& rel_path, std::string_view owner)
     {
-        auto it = _mmap_cache.find(key);
-        if (it == _mmap_cache.end()) return nullptr;
-        // Move to front (most recently used)
-        _lru_order.splice(_lru_order.begin(), _lru_order, it->second.second);
-        return it->second.first;
+        std::lock_guard lk { _intent_mutex };
+        if (!_open_intent_log_locked())
+            return;
+#if !defined(_WIN32)
+        auto record = rel_path.string() + '\t' + std::to_string(owner.size()) + '\t'
+            + std::string(owner) + '\n';
+        if (::write(_intent_fd, record.data(), record.size())
+            == static_cast<ssize_t>(record.size()))
+            _in_flight.push_back(rel_path);
+#endif
     }
 
-    void _cache_put_locked(const std::string& key, std::shared_ptr<MemoryMappedFile> mmf)
+    void _truncate_intent_log_locked()
     {
-        if (_mmap_cache_capacity == 0) return;
-        _cache_evict_locked(key); // remove old entry if exists
-        while (_mmap_cache.size() >= _mmap_cache_capacity)
-            _evict_lru_locked();
-        _lru_order.push_front(key);
-        _mmap_cache[key] = { std::move(mmf), _lru_order.begin() };
+#if !defined(_WIN32)
+        if (_intent_fd >= 0)
+            (void)::ftruncate(_intent_fd, 0);
+#endif
     }
 
-    [[nodiscard]] inline bool _write(const std::filesystem::path& file_path,
-                                    const Bytes auto & value)
+    static std::size_t _detect_block_size([[maybe_unused]] const std::filesystem::path& path)
     {
-        try
+#if !defined(_WIN32)
+        struct statvfs st;
+        if (statvfs(path.string().c_str(), &st) == 0 && st.f_frsize > 0)
+            return static_cast<std::size_t>(st.f_frsize);
+#endif
+        return 4096;
+    }
+
+    BatchIo& _batch_io(std::unique_ptr<BatchIo>& io)
+    {
+        if (!io)
+            io = std::make_unique<BatchIo>(_use_io_uring.load(std::memory_order_relaxed));
+        return *io;
+    }
+
+    // Unlink plain files in one batch, accounting for the bytes released.
+    void _unlink_batch(const std::vector<std::filesystem::path>& files)
+    {
+        if (files.empty())
+            return;
+#if !defined(_WIN32)
+        std::vector<std::string> paths;
+        std::vector<std::size_t> footprints;
+        std::vector<IoOp> ops;
+        paths.reserve(files.size());
+        footprints.reserve(files.size());
+        ops.reserve(files.size());
+        for (const auto& f : files)
         {
-            std::filesystem::path parent_dir = file_path.parent_path();
-            if (!std::filesystem::exists(parent_dir))
-            {
-                std::filesystem::create_directories(parent_dir);
-            }
-            std::ofstream ofs(file_path, std::ios::binary);
-            if (!ofs)
-                return false;
-            ofs.write(value.data(), value.size());
-            return ofs.good();
+            std::error_code ec;
+            auto sz = std::filesystem::file_size(f, ec);
+            footprints.push_back(ec ? 0 : footprint(sz));
+            paths.push_back(f.string());
         }
-        catch (const std::exception& e)
+        for (const auto& p : paths)
+            ops.push_back(IoOp::unlink(p.c_str()));
         {
-            throw std::runtime_error(
-                std::string("Failed to write file: ") + e.what());
+            std::lock_guard lk { _drain_io_mutex };
+            _batch_io(_drain_io).run(ops);
         }
+        int64_t released = 0;
+        for (std::size_t i = 0; i < ops.size(); ++i)
+            if (ops[i].result == 0)
+                released += static_cast<int64_t>(footprints[i]);
+        _bytes_delta.fetch_sub(released, std::memory_order_relaxed);
+#else
+        for (const auto& f : files)
+            _unlink_accounted(f);
+#endif
     }
 
-public:
-    DiskStorage(const std::filesystem::path& path, std::size_t mmap_cache_capacity = 128)
-            : gen(rd()), uuid_generator { gen }, _path(path)
-            , _mmap_cache_capacity(mmap_cache_capacity)
+    // Unlink a file or a whole tree, accounting for the bytes released.
+    // Returns the number of entries removed.
+    std::size_t _unlink_accounted(const std::filesystem::path& item)
     {
-        if (!std::filesystem::exists(path))
+        std::error_code ec;
+        if (!std::filesystem::is_directory(item, ec))
         {
-            std::filesystem::create_directories(path);
+            auto sz = std::filesystem::file_size(item, ec);
+            auto fp = ec ? 0 : footprint(sz);
+            if (!std::filesystem::remove(item, ec))
+                return 0;
+            _bytes_delta.fetch_sub(static_cast<int64_t>(fp), std::memory_order_relaxed);
+            return 1;
         }
+        std::size_t released = 0;
+        for (auto it = std::filesystem::recursive_directory_iterator(item, ec);
+             !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+        {
+            std::error_code fec;
+            if (it->is_regular_file(fec))
+                released += footprint(it->file_size(fec));
+        }
+        auto n = std::filesystem::remove_all(item, ec);
+        _bytes_delta.fetch_sub(static_cast<int64_t>(released), std::memory_order_relaxed);
+        return static_cast<std::size_t>(n);
     }
 
-    DiskStorage()
-            : gen(rd()), uuid_generator { gen }, _path(".")
-            , _mmap_cache_capacity(128)
+    // defer_remove_all() for the cold root: everything but its trash goes
+    // into one purge directory there. Returns it, or an empty path.
+    std::filesystem::path _defer_remove_cold()
     {
-        if (!std::filesystem::exists(_path))
+        std::error_code ec;
+        if (_cold_path.empty() || !std::filesystem::is_directory(_cold_path, ec))
+            return {};
+        std::vector<std::filesystem::path> entries;
+        for (auto it = std::filesystem::directory_iterator(_cold_path, ec);
+             !ec && it != std::filesystem::directory_iterator(); it.increment(ec))
+            if (it->path().filename() != trash_dirname)
+                entries.push_back(it->path());
+        if (entries.empty())
+            return {};
+        auto target = cold_trash_path() / ("purge-" + generate_random_filename());
+        std::filesystem::create_directories(target, ec);
+        for (const auto& entry : entries)
         {
-            std::filesystem::create_directories(_path);
+            ec.clear();
+            std::filesystem::rename(entry, target / entry.filename(), ec);
+            if (ec)
+                _unlink_accounted(entry);
         }
+        return target;
     }
 
-    [[nodiscard]] inline std::filesystem::path path() const { return _path; }
+    void _done_draining(std::size_t n)
+    {
+        if (n == 0)
+            return;
+        {
+            std::lock_guard lk { _trash_mutex };
+            _draining -= n;
+        }
+        _trash_cv.notify_all();
+    }
 
-    // Paths are stored in the DB relative to the cache root so the whole
-    // cache directory can be moved/copied and still resolve. Resolve a stored
-    // path back to an absolute one against the current root. Absolute inputs
-    // (legacy DBs written before this change, or the root itself) pass through
-    // unchanged.
-    [[nodiscard]] inline std::filesystem::path abs_path(const std::filesystem::path& stored) const
+    void _requeue_trash(const std::filesystem::path& trash)
     {
-        return stored.is_absolute() ? stored : _path / stored;
+        std::error_code ec;
+        if (!std::filesystem::is_directory(trash, ec))
+            return;
+        std::lock_guard lk { _trash_mutex };
+        for (auto it = std::filesystem::directory_iterator(trash, ec);
+             !ec && it != std::filesystem::directory_iterator(); it.increment(ec))
+            _trash_queue.push_back(it->path());
     }
 
-    [[nodiscard]] inline std::string generate_random_filename()
+    // `size` bytes of a file from `offset` on, into a pooled block.
+    std::shared_ptr<PooledMemoryView> _read_whole(const std::filesystem::path& file_path,
+                                                  std::size_t size, std::size_t offset = 0)
     {
-        return uuids::to_string(uuid_generator());
+        auto view = _read_pool->acquire(size);
+        std::size_t done = 0;
+#if !defined(_WIN32)
+        int fd = ::open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return nullptr;
+        while (done < size)
+        {
+            auto n = ::pread(fd, view->mutable_data() + done, size - done,
+                             static_cast<off_t>(offset + done));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            done += static_cast<std::size_t>(n);
+        }
+        ::close(fd);
+#else
+        std::ifstream ifs(file_path, std::ios::binary);
+        if (!ifs || !ifs.seekg(static_cast<std::streamoff>(offset)))
+            return nullptr;
+        ifs.read(view->mutable_data(), static_cast<std::streamsize>(size));
+        done = static_cast<std::size_t>(ifs.gcount());
+#endif
+        // Truncated under our feet: hand back what was there.
+        view->shrink(done);
+        return view;
     }
 
-    inline bool remove(const std::filesystem::path& stored , bool recursive = false)
+    // The chunk files of a chunked value, in order: their names are
+    // zero-padded indexes, so shorter names come first, then by name.
+    static std::vector<std::filesystem::path> _chunk_files(const std::filesystem::path& dir)
     {
-        auto file_path = abs_path(stored);
+        std::vector<std::filesystem::path> files;
+        std::error_code ec;
+        for (auto it = std::filesystem::directory_iterator(dir, ec);
+             !ec && it != std::filesystem::directory_iterator(); it.increment(ec))
+            files.push_back(it->path());
+        std::sort(files.begin(), files.end(),
+                  [](const std::filesystem::path& a, const std::filesystem::path& b)
+                  {
+                      const auto& x = a.native();
+                      const auto& y = b.native();
+                      return x.size() != y.size() ? x.size() < y.size() : x < y;
+                  });
+        return files;
+    }
+
+    static std::optional<Buffer> _load_chunked(const std::filesystem::path& dir)
+    {
+        auto chunks = _chunk_files(dir);
+        if (chunks.empty())
+            return std::nullopt;
+#if !defined(_WIN32)
+        return Buffer(std::static_pointer_cast<IMemoryView>(
+            std::make_shared<ChunkedMappedFile>(chunks)));
+#else
+        std::vector<char> value;
+        for (const auto& chunk : chunks)
+        {
+            std::ifstream ifs(chunk, std::ios::binary);
+            if (!ifs)
+                return std::nullopt;
+            value.insert(value.end(), std::istreambuf_iterator<char>(ifs),
+                         std::istreambuf_iterator<char>());
+        }
+        return Buffer(std::move(value));
+#endif
+    }
+
+#if !defined(_WIN32)
+    // Bytes [offset, offset + size) of a chunked value, touching only the
+    // chunks they cover. Every chunk but the last is as large as the first
+    // (the page-aligned chunk size the value was written with), so the
+    // covered chunks are named from the range instead of listed, and a
+    // range within one chunk is read like a plain file's.
+    std::optional<Buffer> _load_chunked_range(const std::filesystem::path& dir, std::size_t offset,
+                                              std::size_t size)
+    {
+        auto chunk_path = [&dir](std::size_t i)
+        {
+            char name[24];
+            std::snprintf(name, sizeof name, "%06zu", i);
+            return dir / name;
+        };
+        std::error_code ec;
+        const auto chunk = std::filesystem::file_size(chunk_path(0), ec);
+        if (ec)
+            return std::nullopt;
+        if (chunk == 0)
+            return Buffer(std::vector<char> {});
+        const auto first = offset / chunk;
+        const auto last = size == 0 ? first : first + (offset % chunk + size - 1) / chunk;
+        std::vector<std::filesystem::path> files;
+        std::size_t covered = 0;
+        for (auto i = first; i <= last; ++i)
         {
-            std::lock_guard lk { _cache_mutex };
-            _cache_evict_locked(file_path.string());
+            auto path = chunk_path(i);
+            auto bytes = std::filesystem::file_size(path, ec);
+            if (ec)
+                break; // Past the last chunk.
+            files.push_back(std::move(path));
+            covered += bytes;
+            if (bytes < chunk)
+                break;
         }
-        try
+        offset -= first * chunk;
+        if (files.empty() || offset >= covered)
+            return Buffer(std::vector<char> {});
+        size = std::min(size, covered - offset);
+        if (files.size() == 1 && size < _pread_cutoff.load(std::memory_order_relaxed))
         {
-            if (std::filesystem::exists(file_path))
+            if (auto view = _read_whole(files.front(), size, offset))
+                return Buffer(std::static_pointer_cast<IMemoryView>(view));
+            return std::nullopt;
+        }
+        auto range = Buffer(std::static_pointer_cast<IMemoryView>(
+                                std::make_shared<ChunkedMappedFile>(files)))
+                         .slice(offset, size);
+        _advise_willneed(range);
+        return range;
+    }
+#endif
+
+    // Start reading in the pages under a range of a mapped value.
+    static void _advise_willneed([[maybe_unused]] const Buffer& range)
+    {
+#if !defined(_WIN32)
+        if (range.size() == 0)
+            return;
+        const auto page = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+        auto begin = reinterpret_cast<uintptr_t>(range.data()) / page * page;
+        auto end = reinterpret_cast<uintptr_t>(range.data()) + range.size();
+        (void)::posix_madvise(reinterpret_cast<void*>(begin), end - begin, POSIX_MADV_WILLNEED);
+#endif
+    }
+
+    static std::string _hex(uint64_t value, int digits)
+    {
+        char buf[17];
+        auto n = std::snprintf(buf, sizeof buf, "%0*llx", digits,
+                               static_cast<unsigned long long>(value));
+        return std::string(buf, static_cast<std::size_t>(n));
+    }
+
+    // Hex digits naming the directories of one level.
+    static int _hex_digits(std::size_t width)
+    {
+        int digits = 1;
+        for (std::size_t w = 16; w < width; w *= 16)
+            ++digits;
+        return digits;
+    }
+
+    void _seed_names()
+    {
+        _name_tag = (static_cast<uint64_t>(rd()) << 32) ^ rd();
+        _name_prefix = _hex(_name_tag, 16) + '-';
+        _name_counter.store(0, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] std::filesystem::path _next_rel_path()
+    {
+        auto n = _name_counter.fetch_add(1, std::memory_order_relaxed);
+        auto depth = _fanout_depth.load(std::memory_order_relaxed);
+        auto width = _fanout_width.load(std::memory_order_relaxed);
+        auto digits = _hex_digits(width);
+        std::filesystem::path rel;
+        auto slot = _name_tag + n / _dir_run;
+        for (std::size_t level = 0; level < depth; ++level, slot /= width)
+            rel /= _hex(slot % width, digits);
+        return rel / (_name_prefix + _hex(n, 1));
+    }
+
+    // Name of the (empty) directory recording that a layout was created.
+    static constexpr std::string_view _layout_marker = ".layout-";
+
+    // Create every fan-out directory of the current layout, once per tree.
+    void _create_layout()
+    {
+        auto depth = _fanout_depth.load(std::memory_order_relaxed);
+        auto width = _fanout_width.load(std::memory_order_relaxed);
+        auto marker = _path
+            / (std::string(_layout_marker) + std::to_string(depth) + "x" + std::to_string(width));
+        std::error_code ec;
+        if (std::filesystem::exists(marker, ec))
+            return;
+        auto digits = _hex_digits(width);
+        std::vector<std::filesystem::path> level { _path };
+        std::vector<std::string> parents;
+        for (std::size_t d = 0; d < depth; ++d)
+        {
+            std::vector<std::filesystem::path> next;
+            next.reserve(level.size() * width);
+            for (const auto& dir : level)
             {
-                if (recursive && std::filesystem::is_directory(file_path))
-                    return std::filesystem::remove_all(file_path) > 0;
-                else
-                    return std::filesystem::remove(file_path);
+                parents.push_back(dir.string());
+                for (std::size_t i = 0; i < width; ++i)
+                {
+                    next.push_back(dir / _hex(i, digits));
+                    std::filesystem::create_directory(next.back(), ec);
+                }
             }
-            return false;
+            level.swap(next);
         }
-        catch (const std::exception& e)
-        {
-            std::cerr << "Error deleting file: " << e.what() << std::endl;
+        // Persist the new entries before any value lands in them.
+        _sync_dirs(parents);
+        std::filesystem::create_directory(marker, ec);
+    }
+
+    // A write found its directory missing: recreate it. Returns false if it
+    // was there (the write failed for another reason); otherwise adds the
+    // directories whose entries changed to `dirs`.
+    bool _restore_dirs(const std::filesystem::path& rel_path, std::vector<std::string>& dirs)
+    {
+        auto parent = rel_path.parent_path();
+        std::error_code ec;
+        if (std::filesystem::exists(_path / parent, ec)
+            || !std::filesystem::create_directories(_path / parent, ec))
             return false;
+        for (auto p = parent.parent_path();; p = p.parent_path())
+        {
+            dirs.push_back((_path / p).string());
+            if (p.empty())
+                break;
         }
+        return true;
     }
 
-    [[nodiscard]] inline std::optional<Buffer> load(const std::filesystem::path& stored)
+    static void _sync_dirs([[maybe_unused]] const std::vector<std::string>& dirs)
     {
-        try
+#if !defined(_WIN32)
+        for (const auto& d : dirs)
         {
-            auto file_path = abs_path(stored);
-            auto key = file_path.string();
+            int fd = ::open(d.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (fd < 0)
+                continue;
+            (void)BatchIo::sync_data(fd);
+            ::close(fd);
+        }
+#endif
+    }
 
+#if !defined(_WIN32)
+    // Open, fdatasync and close every path, one batch wave per step.
+    static void _sync_batch(BatchIo& io, const std::vector<std::string>& paths, int open_flags)
+    {
+        std::vector<IoOp> opens;
+        opens.reserve(paths.size());
+        for (const auto& p : paths)
+            opens.push_back(IoOp::open(p.c_str(), open_flags));
+        io.run(opens);
+        std::vector<IoOp> syncs;
+        std::vector<IoOp> closes;
+        for (const auto& op : opens)
+        {
+            if (op.result >= 0)
             {
-                std::lock_guard lk { _cache_mutex };
-                if (auto cached = _cache_get_locked(key))
-                    return Buffer(std::static_pointer_cast<IMemoryView>(cached));
+                syncs.push_back(IoOp::fdatasync(op.result));
+                closes.push_back(IoOp::close(op.result));
             }
+        }
+        io.run(syncs);
+        io.run(closes);
+    }
+#endif
 
-            if (!std::filesystem::exists(file_path))
-                return std::nullopt;
+    // Queue files (and the directories whose entries changed for them) for
+    // the next group wave, on the list of the tier they live on.
+    void _queue_unsynced(std::vector<std::string> files, const std::vector<std::string>& dirs)
+    {
+        if (files.empty())
+            return;
+        const auto& root = _cold_path.native();
+        const bool cold = !root.empty() && files.front().starts_with(root)
+            && files.front().size() > root.size()
+            && files.front()[root.size()] == std::filesystem::path::preferred_separator;
+        std::lock_guard lk { _unsynced_mutex };
+        auto& pending = _unsynced[cold ? 1 : 0];
+        pending.files.insert(pending.files.end(), std::make_move_iterator(files.begin()),
+                             std::make_move_iterator(files.end()));
+        pending.dirs.insert(pending.dirs.end(), dirs.begin(), dirs.end());
+    }
+
+#if !defined(_WIN32)
+    static bool _write_file(const char* file_path, const char* data, std::size_t size, bool sync)
+    {
+        int fd = ::open(file_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return false;
+        std::size_t done = 0;
+        while (done < size)
+        {
+            auto n = ::write(fd, data + done, size - done);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            done += static_cast<std::size_t>(n);
+        }
+        bool ok = done == size && (!sync || BatchIo::sync_data(fd) == 0);
+        return ::close(fd) == 0 && ok;
+    }
+
+    [[nodiscard]] bool _chunks(std::size_t size) const
+    {
+        auto threshold = _chunk_threshold.load(std::memory_order_relaxed);
+        return threshold != 0 && size >= threshold;
+    }
+
+    // Write a value as the chunk files of the directory `rel_path`, with up
+    // to _chunk_workers threads pulling chunks off a shared counter. In sync
+    // mode the directory is filled under a temporary name and renamed into
+    // place once every chunk is on the device, so a chunked value is never
+    // seen half-written either. Returns the bytes the chunks take on disk.
+    std::optional<std::size_t> _write_chunked(const std::filesystem::path& rel_path,
+                                              const char* data, std::size_t size)
+    {
+        auto dir = (_path / rel_path).string();
+        std::vector<std::string> dirs { (_path / rel_path.parent_path()).string() };
+        const auto mode = _durability.load(std::memory_order_relaxed);
+        const bool sync = mode == Durability::sync;
+        auto target = sync ? dir + ".tmp" : dir;
+        if (::mkdir(target.c_str(), 0755) != 0
+            && !(errno == ENOENT && _restore_dirs(rel_path, dirs)
+                 && ::mkdir(target.c_str(), 0755) == 0))
+            return std::nullopt;
 
-            auto mmf = std::make_shared<MemoryMappedFile>(key);
+        const auto chunk = _chunk_size.load(std::memory_order_relaxed);
+        const auto count = std::max<std::size_t>(1, (size + chunk - 1) / chunk);
+        std::vector<std::string> files(count);
+        std::atomic<std::size_t> next { 0 };
+        std::atomic<bool> ok { true };
+        auto work = [&]
+        {
+            while (ok.load(std::memory_order_relaxed))
             {
-                std::lock_guard lk { _cache_mutex };
-                _cache_put_locked(key, mmf);
+                auto i = next.fetch_add(1, std::memory_order_relaxed);
+                if (i >= count)
+                    break;
+                char name[24];
+                std::snprintf(name, sizeof name, "/%06zu", i);
+                files[i] = target + name;
+                auto offset = i * chunk;
+                if (!_write_file(files[i].c_str(), data + offset, std::min(chunk, size - offset),
+                                 sync))
+                    ok.store(false, std::memory_order_relaxed);
             }
-            return Buffer(std::static_pointer_cast<IMemoryView>(mmf));
+        };
+        auto workers = std::min(_chunk_workers.load(std::memory_order_relaxed), count);
+        std::vector<std::thread> pool;
+        try
+        {
+            for (std::size_t w = 1; w < workers; ++w)
+                pool.emplace_back(work);
         }
-        catch (const std::exception& e)
+        catch (const std::system_error&)
         {
-            std::cerr << "Error reading bytes from file: " << e.what() << std::endl;
+            // Out of threads: the ones running share the chunks.
+        }
+        work();
+        for (auto& t : pool)
+            t.join();
+        if (ok && sync)
+        {
+            _sync_dirs({ target });
+            ok = ::rename(target.c_str(), dir.c_str()) == 0;
+        }
+        if (!ok)
+        {
+            std::error_code ec;
+            std::filesystem::remove_all(target, ec);
             return std::nullopt;
         }
+        if (sync)
+            _sync_dirs(dirs);
+        else if (mode == Durability::group)
+        {
+            dirs.push_back(std::move(dir));
+            _queue_unsynced(std::move(files), dirs);
+        }
+        return (count - 1) * footprint(chunk) + footprint(size - (count - 1) * chunk);
     }
+#endif
 
-    void clear_mmap_cache()
+    [[nodiscard]] inline bool _write(const std::filesystem::path& rel_path,
+                                    const Bytes auto & value)
     {
-        std::lock_guard lk { _cache_mutex };
-        _mmap_cache.clear();
-        _lru_order.clear();
+        try
+        {
+            auto file_path = (_path / rel_path).string();
+            std::vector<std::string> dirs { (_path / rel_path.parent_path()).string() };
+#if !defined(_WIN32)
+            const char* data = std::data(value);
+            const auto size = static_cast<std::size_t>(std::size(value));
+            const auto mode = _durability.load(std::memory_order_relaxed);
+            auto attempt = [&]
+            {
+                if (mode != Durability::sync)
+                    return _write_file(file_path.c_str(), data, size, false);
+                auto tmp = file_path + ".tmp";
+                if (_write_file(tmp.c_str(), data, size, true)
+                    && ::rename(tmp.c_str(), file_path.c_str()) == 0)
+                    return true;
+                ::unlink(tmp.c_str());
+                return false;
+            };
+            if (!attempt() && !(_restore_dirs(rel_path, dirs) && attempt()))
+                return false;
+            if (mode == Durability::sync)
+                _sync_dirs(dirs);
+            else if (mode == Durability::group)
+                _queue_unsynced({ std::move(file_path) }, dirs);
+            return true;
+#else
+            auto attempt = [&]
+            {
+                std::ofstream ofs(file_path, std::ios::binary);
+                if (!ofs)
+                    return false;
+                ofs.write(value.data(), value.size());
+                return ofs.good();
+            };
+            return attempt() || (_restore_dirs(rel_path, dirs) && attempt());
+#endif
+        }
+        catch (const std::exception& e)
+        {
+            throw std::runtime_error(
+                std::string("Failed to write file: ") + e.what());
+        }
     }
 
+public:
+    static constexpr std::size_t default_pread_cutoff = 128 * 1024;
 
-     [[nodiscard]] inline  std::optional<std::filesystem::path> store(const Bytes auto & value)
+    DiskStorage(const std::filesystem::path& path,
+                std::size_t mmap_cache_bytes = MmapHandleCache::default_capacity_bytes)
+            : gen(rd()), uuid_generator { gen }, _path(path)
+            , _mmap_cache(mmap_cache_bytes)
     {
-        auto filename = generate_random_filename();
-        auto rel_path = std::filesystem::path(filename.substr(0, 2))
-            / filename.substr(2, 2) / filename;
-        if (_write(_path / rel_path, value))
-            return rel_path;
+        if (!std::filesystem::exists(path))
+        {
+            std::filesystem::create_directories(path);
+        }
+        _block_size = _detect_block_size(_path);
+        _seed_names();
+        _create_layout();
+        _requeue_trash(trash_path());
+    }
+
+    DiskStorage()
+            : gen(rd()), uuid_generator { gen }, _path(".")
+    {
+        if (!std::filesystem::exists(_path))
+        {
+            std::filesystem::create_directories(_path);
+        }
+        _block_size = _detect_block_size(_path);
+        _seed_names();
+        _create_layout();
+        _requeue_trash(trash_path());
+    }
+
+    ~DiskStorage()
+    {
+#if !defined(_WIN32)
+        if (_intent_fd >= 0)
+        {
+            // A clean shutdown leaves nothing to recover.
+            if (_in_flight.empty())
+                ::unlink(_intent_log.c_str());
+            ::close(_intent_fd);
+        }
+#endif
+    }
+
+    DiskStorage(const DiskStorage&) = delete;
+    DiskStorage& operator=(const DiskStorage&) = delete;
+
+    // Values live in files (see MemoryStorage for the in-RAM variant).
+    static constexpr bool in_memory = false;
+    static constexpr std::string_view trash_dirname = ".trash";
+
+    [[nodiscard]] inline std::filesystem::path path() const { return _path; }
+
+    [[nodiscard]] inline std::filesystem::path trash_path() const { return _path / trash_dirname; }
+
+    static constexpr std::string_view cold_dirname = ".cold";
+
+    [[nodiscard]] inline std::filesystem::path cold_path() const { return _cold_path; }
+
+    [[nodiscard]] inline std::filesystem::path cold_trash_path() const
+    {
+        return _cold_path.empty() ? std::filesystem::path {} : _cold_path / trash_dirname;
+    }
+
+    // Resolve cold paths against `path` from now on, creating it if needed,
+    // and queue whatever an earlier run left in its trash.
+    inline void set_cold_path(const std::filesystem::path& path)
+    {
+        if (path.empty() || path == _cold_path)
+            return;
+        std::error_code ec;
+        std::filesystem::create_directories(path, ec);
+        _cold_path = path;
+        _requeue_trash(cold_trash_path());
+    }
+
+    static constexpr std::string_view chunks_suffix = ".chunks";
+
+    // Whether a stored path names the directory of a chunked value.
+    [[nodiscard]] static inline bool is_chunked(const std::filesystem::path& stored)
+    {
+        const auto& s = stored.native();
+        return s.size() > chunks_suffix.size()
+            && std::equal(chunks_suffix.rbegin(), chunks_suffix.rend(), s.rbegin());
+    }
+
+    // Whether a stored path names a file on the cold tier.
+    [[nodiscard]] static inline bool is_cold(const std::filesystem::path& stored)
+    {
+        const auto& s = stored.native();
+        constexpr auto n = cold_dirname.size();
+        return s.size() > n && (s[n] == '/' || s[n] == std::filesystem::path::preferred_separator)
+            && std::equal(cold_dirname.begin(), cold_dirname.end(), s.begin());
+    }
+
+    [[nodiscard]] inline std::size_t block_size() const { return _block_size; }
+
+    // Space a file of `bytes` takes on disk.
+    [[nodiscard]] inline std::size_t footprint(std::size_t bytes) const
+    {
+        return (bytes + _block_size - 1) / _block_size * _block_size;
+    }
+
+    [[nodiscard]] inline int64_t bytes_delta() const
+    {
+        return _bytes_delta.load(std::memory_order_relaxed);
+    }
+
+    inline int64_t take_bytes_delta() { return _bytes_delta.exchange(0, std::memory_order_relaxed); }
+
+    inline void add_bytes_delta(int64_t delta)
+    {
+        _bytes_delta.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    // Paths are stored in the DB relative to the cache root so the whole
+    // cache directory can be moved/copied and still resolve. Resolve a stored
+    // path back to an absolute one against the current root. Absolute inputs
+    // (legacy DBs written before this change, or the root itself) pass through
+    // unchanged.
+    [[nodiscard]] inline std::filesystem::path abs_path(const std::filesystem::path& stored) const
+    {
+        if (stored.is_absolute())
+            return stored;
+        if (is_cold(stored) && !_cold_path.empty())
+            return _cold_path / stored.native().substr(cold_dirname.size() + 1);
+        return _path / stored;
+    }
+
+    [[nodiscard]] inline std::string generate_random_filename()
+    {
+        return uuids::to_string(uuid_generator());
+    }
+
+    inline bool remove(const std::filesystem::path& stored , bool recursive = false)
+    {
+        auto file_path = abs_path(stored);
+        _mmap_cache.erase(MmapHandleCache::compact_id(file_path.native()));
+        try
+        {
+            if (std::filesystem::exists(file_path))
+            {
+                if (std::filesystem::is_directory(file_path) && !recursive && !is_chunked(stored))
+                    return std::filesystem::remove(file_path);
+                return _unlink_accounted(file_path) > 0;
+            }
+            return false;
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Error deleting file: " << e.what() << std::endl;
+            return false;
+        }
+    }
+
+    // Hand a file whose row has been deleted over to the deletion queue.
+    // Falls back to an immediate remove() if it cannot be moved to the trash.
+    // Returns the number of queued removals.
+    inline std::size_t defer_remove(const std::filesystem::path& stored)
+    {
+        auto file_path = abs_path(stored);
+        _mmap_cache.erase(MmapHandleCache::compact_id(file_path.native()));
+        // Each tier has its own trash: a rename never crosses volumes.
+        auto trash = is_cold(stored) && !_cold_path.empty() ? cold_trash_path() : trash_path();
+        auto target = trash / file_path.filename();
+        std::error_code ec;
+        std::filesystem::rename(file_path, target, ec);
+        if (ec == std::errc::no_such_file_or_directory && std::filesystem::exists(file_path))
+        {
+            std::filesystem::create_directories(trash, ec);
+            ec.clear();
+            std::filesystem::rename(file_path, target, ec);
+        }
+        if (ec)
+        {
+            if (std::filesystem::exists(file_path))
+                remove(stored);
+            return pending_removals();
+        }
+        std::lock_guard lk { _trash_mutex };
+        _trash_queue.push_back(std::move(target));
+        return _trash_queue.size();
+    }
+
+    // Move whole entries (typically top-level value directories) into one
+    // fresh trash subdirectory and queue it: O(entries) renames, however many
+    // files they hold. drain_removals() then purges the tree incrementally.
+    inline void defer_remove_all(const std::vector<std::filesystem::path>& entries)
+    {
+        _mmap_cache.clear();
+        std::error_code ec;
+        auto target = trash_path() / ("purge-" + generate_random_filename());
+        std::filesystem::create_directories(target, ec);
+        for (const auto& entry : entries)
+        {
+            auto src = abs_path(entry);
+            ec.clear();
+            std::filesystem::rename(src, target / src.filename(), ec);
+            if (ec)
+                remove(entry, true);
+        }
+        // The fan-out directories went along.
+        _create_layout();
+        auto cold_target = _defer_remove_cold();
+        std::lock_guard lk { _trash_mutex };
+        _trash_queue.push_back(std::move(target));
+        if (!cold_target.empty())
+            _trash_queue.push_back(std::move(cold_target));
+    }
+
+    // Copy a value file to the other tier, under the same name, and return
+    // the path its row should store from then on. The original is left in
+    // place: the caller repoints the row, then removes whichever copy lost.
+    // Since the original goes away right after, the copy is on the device
+    // before this returns whatever the durability mode: the value was
+    // already durable, moving it must not make it less so.
+    [[nodiscard]] inline std::optional<std::filesystem::path> copy_to_tier(
+        const std::filesystem::path& stored, bool cold)
+    {
+        if (stored.is_absolute() || is_cold(stored) == cold || _cold_path.empty())
+            return std::nullopt;
+        auto target = cold ? std::filesystem::path(cold_dirname) / stored
+                           : std::filesystem::path(stored.native().substr(cold_dirname.size() + 1));
+        auto src = abs_path(stored);
+        auto dst = abs_path(target);
+        auto tmp = dst;
+        tmp += ".tmp";
+        const bool chunked = is_chunked(stored);
+        std::error_code ec;
+        std::filesystem::create_directories(dst.parent_path(), ec);
+        std::filesystem::remove_all(tmp, ec);
+        if (chunked)
+            std::filesystem::copy(src, tmp, std::filesystem::copy_options::recursive, ec);
+        else
+            std::filesystem::copy_file(src, tmp, std::filesystem::copy_options::overwrite_existing,
+                                       ec);
+        auto files = chunked ? _chunk_files(tmp) : std::vector<std::filesystem::path> { tmp };
+        std::size_t bytes = 0;
+        for (std::size_t i = 0; i < files.size() && !ec; ++i)
+            bytes += footprint(std::filesystem::file_size(files[i], ec));
+        if (ec || files.empty())
+        {
+            std::filesystem::remove_all(tmp, ec);
+            return std::nullopt;
+        }
+#if !defined(_WIN32)
+        bool synced = true;
+        for (const auto& f : files)
+        {
+            int fd = ::open(f.c_str(), O_RDONLY | O_CLOEXEC);
+            synced = synced && fd >= 0 && BatchIo::sync_data(fd) == 0;
+            if (fd >= 0)
+                ::close(fd);
+        }
+        if (chunked)
+            _sync_dirs({ tmp.string() });
+        if (!synced)
+        {
+            std::filesystem::remove_all(tmp, ec);
+            return std::nullopt;
+        }
+#endif
+        std::filesystem::rename(tmp, dst, ec);
+        if (ec)
+        {
+            std::filesystem::remove_all(tmp, ec);
+            return std::nullopt;
+        }
+        _sync_dirs({ dst.parent_path().string() });
+        _bytes_delta.fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+        return target;
+    }
+
+    // Unlink up to max_files queued files. A queued directory is purged
+    // max_files entries at a time and stays at the head of the queue until
+    // empty. The queue lock is only held to pop/push items, never across the
+    // unlinks, and an item is popped while being worked on so concurrent
+    // drainers never share one; draining everything (the default) also
+    // waits for the items other drainers hold. Returns the number of
+    // entries removed.
+    inline std::size_t drain_removals(std::size_t max_files = SIZE_MAX)
+    {
+        std::size_t removed = 0;
+        // Plain files are unlinked together in one batch at the end.
+        std::vector<std::filesystem::path> singles;
+        for (;;)
+        {
+            std::filesystem::path item;
+            {
+                std::unique_lock lk { _trash_mutex };
+                if (max_files == SIZE_MAX)
+                    _trash_cv.wait(lk, [this] { return !_trash_queue.empty() || _draining == 0; });
+                if (_trash_queue.empty() || removed >= max_files)
+                    break;
+                item = std::move(_trash_queue.front());
+                _trash_queue.pop_front();
+                ++_draining;
+            }
+            std::error_code ec;
+            if (max_files == SIZE_MAX)
+            {
+                removed += std::max<std::size_t>(_unlink_accounted(item), 1);
+                _done_draining(1);
+                continue;
+            }
+            if (!std::filesystem::is_directory(item, ec))
+            {
+                singles.push_back(std::move(item));
+                ++removed;
+                continue;
+            }
+            std::vector<std::filesystem::path> files;
+            auto budget = max_files - removed;
+            for (auto it = std::filesystem::recursive_directory_iterator(item, ec);
+                 !ec && it != std::filesystem::recursive_directory_iterator()
+                 && files.size() < budget;
+                 it.increment(ec))
+            {
+                if (!it->is_directory(ec))
+                    files.push_back(it->path());
+            }
+            _unlink_batch(files);
+            removed += files.size();
+            if (files.size() < budget)
+            {
+                // Only (now empty) directories are left.
+                std::filesystem::remove_all(item, ec);
+                removed += files.empty() ? 1 : 0;
+            }
+            else
+            {
+                std::lock_guard lk { _trash_mutex };
+                _trash_queue.push_front(std::move(item));
+            }
+            _done_draining(1);
+        }
+        _unlink_batch(singles);
+        _done_draining(singles.size());
+        return removed;
+    }
+
+    [[nodiscard]] inline std::size_t pending_removals() const
+    {
+        std::lock_guard lk { _trash_mutex };
+        return _trash_queue.size();
+    }
+
+    // A forked child shares the trash directory with its parent, which still
+    // owns the inherited queue entries; drop them rather than racing it.
+    inline void forget_pending_removals()
+    {
+        std::lock_guard lk { _trash_mutex };
+        _trash_queue.clear();
+        _draining = 0;
+    }
+
+    // Journal file names start with `prefix` (a path); an empty prefix turns
+    // the intent log off.
+    inline void set_intent_log_prefix(const std::filesystem::path& prefix)
+    {
+        std::lock_guard lk { _intent_mutex };
+        _intent_prefix = prefix;
+    }
+
+    // The writes logged so far are committed (or were cleaned up by the
+    // caller): forget them.
+    inline void commit_intents()
+    {
+        std::lock_guard lk { _intent_mutex };
+        if (_in_flight.empty())
+            return;
+        _in_flight.clear();
+        _truncate_intent_log_locked();
+    }
+
+    // The transaction covering the logged writes rolled back: their files
+    // have no row and are removed.
+    inline void abort_intents()
+    {
+        std::vector<std::filesystem::path> files;
+        {
+            std::lock_guard lk { _intent_mutex };
+            files.swap(_in_flight);
+            _truncate_intent_log_locked();
+        }
+        for (const auto& f : files)
+            remove(f);
+    }
+
+    // A forked child shares the parent's journal (and its lock); give it up
+    // without touching it. The child opens its own on its first write.
+    inline void forget_intent_log()
+    {
+        std::lock_guard lk { _intent_mutex };
+#if !defined(_WIN32)
+        if (_intent_fd >= 0)
+            ::close(_intent_fd);
+#endif
+        _intent_fd = -1;
+        _intent_log.clear();
+        _in_flight.clear();
+    }
+
+    // Replay the journals of dead processes: every logged file for which
+    // is_committed(path, key) is false never got its row and is removed.
+    // Runs in time proportional to the number of interrupted writes.
+    // Returns the number of files removed.
+    inline std::size_t recover_intents(auto&& is_committed)
+    {
+        std::size_t removed = 0;
+#if !defined(_WIN32)
+        if (_intent_prefix.empty())
+            return 0;
+        auto dir = _intent_prefix.parent_path();
+        auto stem = _intent_prefix.filename().string();
+        std::error_code ec;
+        for (auto it = std::filesystem::directory_iterator(dir, ec);
+             !ec && it != std::filesystem::directory_iterator(); it.increment(ec))
+        {
+            auto name = it->path().filename().string();
+            if (!name.starts_with(stem) || name.ends_with(".tmp") || it->path() == _intent_log)
+                continue;
+            int fd = ::open(it->path().c_str(), O_RDWR | O_CLOEXEC);
+            if (fd < 0)
+                continue;
+            if (::flock(fd, LOCK_EX | LOCK_NB) != 0)
+            {
+                ::close(fd); // held by a live process
+                continue;
+            }
+            std::string content;
+            char buf[4096];
+            for (ssize_t n; (n = ::read(fd, buf, sizeof buf)) > 0;)
+                content.append(buf, static_cast<std::size_t>(n));
+            // path \t key-length \t key \n; a torn last record was logged
+            // before its file was written, so there is nothing to undo.
+            std::size_t pos = 0;
+            while (pos < content.size())
+            {
+                auto tab = content.find('\t', pos);
+                auto tab2 = tab == std::string::npos ? tab : content.find('\t', tab + 1);
+                if (tab2 == std::string::npos)
+                    break;
+                auto path = content.substr(pos, tab - pos);
+                auto len = std::strtoull(content.c_str() + tab + 1, nullptr, 10);
+                if (tab2 + 1 + len >= content.size())
+                    break;
+                auto key = content.substr(tab2 + 1, len);
+                pos = tab2 + 1 + len + 1;
+                if (!is_committed(std::filesystem::path(path), key)
+                    && (is_chunked(path) ? std::filesystem::remove_all(abs_path(path), ec) > 0
+                                         : std::filesystem::remove(abs_path(path), ec)))
+                    ++removed;
+            }
+            ::unlink(it->path().c_str());
+            ::close(fd);
+        }
+#else
+        (void)is_committed;
+#endif
+        return removed;
+    }
+
+    [[nodiscard]] inline std::optional<Buffer> load(const std::filesystem::path& stored)
+    {
+        try
+        {
+            // Mapped afresh each time: the mapping costs no reads, and
+            // values this large would crowd the handle cache out.
+            if (is_chunked(stored))
+                return _load_chunked(abs_path(stored));
+
+            auto name = MmapHandleCache::file_name(stored.native());
+            auto id = MmapHandleCache::compact_id(name);
+            if (auto cached = _mmap_cache.get(id, name))
+                return Buffer(std::static_pointer_cast<IMemoryView>(cached));
+
+            auto file_path = abs_path(stored);
+            std::error_code ec;
+            auto size = std::filesystem::file_size(file_path, ec);
+            if (ec)
+                return std::nullopt;
+
+            if (size < _pread_cutoff.load(std::memory_order_relaxed))
+            {
+                if (auto view = _read_whole(file_path, size))
+                    return Buffer(std::static_pointer_cast<IMemoryView>(view));
+                return std::nullopt;
+            }
+
+            auto mmf = std::make_shared<MemoryMappedFile>(file_path.string());
+            mmf->advise_willneed();
+            _mmap_cache.put(id, name, mmf);
+            return Buffer(std::static_pointer_cast<IMemoryView>(mmf));
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Error reading bytes from file: " << e.what() << std::endl;
+            return std::nullopt;
+        }
+    }
+
+    // Bytes [offset, offset + size) of a stored value, clipped to its end,
+    // reading no more of it than needed: a slice of its mapping (only the
+    // chunks the range covers for a chunked value), with a WILLNEED hint on
+    // the range only, or a pread() for a range under the pread cutoff of a
+    // file not already mapped.
+    [[nodiscard]] inline std::optional<Buffer> load_range(const std::filesystem::path& stored,
+                                                          std::size_t offset, std::size_t size)
+    {
+        try
+        {
+            std::optional<Buffer> range;
+            if (is_chunked(stored))
+            {
+#if !defined(_WIN32)
+                return _load_chunked_range(abs_path(stored), offset, size);
+#else
+                if (auto whole = _load_chunked(abs_path(stored)))
+                    range = whole->slice(offset, size);
+                else
+                    return std::nullopt;
+#endif
+            }
+            else
+            {
+                auto name = MmapHandleCache::file_name(stored.native());
+                auto id = MmapHandleCache::compact_id(name);
+                if (auto cached = _mmap_cache.get(id, name))
+                    return Buffer(std::static_pointer_cast<IMemoryView>(cached)).slice(offset, size);
+
+                auto file_path = abs_path(stored);
+                std::error_code ec;
+                auto file_size = std::filesystem::file_size(file_path, ec);
+                if (ec)
+                    return std::nullopt;
+                offset = std::min<std::size_t>(offset, file_size);
+                size = std::min<std::size_t>(size, file_size - offset);
+                if (size < _pread_cutoff.load(std::memory_order_relaxed))
+                {
+                    if (auto view = _read_whole(file_path, size, offset))
+                        return Buffer(std::static_pointer_cast<IMemoryView>(view));
+                    return std::nullopt;
+                }
+                auto mmf = std::make_shared<MemoryMappedFile>(file_path.string());
+                _mmap_cache.put(id, name, mmf);
+                range = Buffer(std::static_pointer_cast<IMemoryView>(mmf)).slice(offset, size);
+            }
+            _advise_willneed(*range);
+            return range;
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Error reading bytes from file: " << e.what() << std::endl;
+            return std::nullopt;
+        }
+    }
+
+    // A value mapped straight from its file(s), bypassing the mmap handle
+    // cache, for sweeps over the whole cache. nullopt if it cannot be read.
+    [[nodiscard]] inline std::optional<Buffer> map(const std::filesystem::path& stored) const
+    {
+        try
+        {
+            if (is_chunked(stored))
+                return _load_chunked(abs_path(stored));
+            return Buffer(abs_path(stored));
+        }
+        catch (const std::exception&)
+        {
+            return std::nullopt;
+        }
+    }
+
+    // Size of a stored value: its file's, or the sum of its chunks'. Sets
+    // `ec` if it cannot be read.
+    [[nodiscard]] inline std::size_t value_size(const std::filesystem::path& stored,
+                                                std::error_code& ec) const
+    {
+        auto file_path = abs_path(stored);
+        if (!is_chunked(stored))
+            return std::filesystem::file_size(file_path, ec);
+        if (!std::filesystem::is_directory(file_path, ec))
+        {
+            if (!ec)
+                ec = std::make_error_code(std::errc::no_such_file_or_directory);
+            return 0;
+        }
+        std::size_t size = 0;
+        for (const auto& chunk : _chunk_files(file_path))
+        {
+            size += std::filesystem::file_size(chunk, ec);
+            if (ec)
+                return 0;
+        }
+        return size;
+    }
+
+    // Load several files at once. Cached mappings and files at or above the
+    // pread cutoff go through load(); the others are read with one wave
+    // each of opens, reads and closes through the batch I/O ring instead of
+    // three syscalls per file. Results are in the order of `stored`.
+    [[nodiscard]] std::vector<std::optional<Buffer>> load_many(
+        std::span<const std::filesystem::path> stored)
+    {
+        std::vector<std::optional<Buffer>> results(stored.size());
+#if !defined(_WIN32)
+        std::vector<std::size_t> index;
+        std::vector<std::string> paths;
+        std::vector<std::shared_ptr<PooledMemoryView>> views;
+        const auto cutoff = _pread_cutoff.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < stored.size(); ++i)
+        {
+            if (is_chunked(stored[i]))
+            {
+                results[i] = load(stored[i]);
+                continue;
+            }
+            auto name = MmapHandleCache::file_name(stored[i].native());
+            if (auto cached = _mmap_cache.get(MmapHandleCache::compact_id(name), name))
+            {
+                results[i] = Buffer(std::static_pointer_cast<IMemoryView>(cached));
+                continue;
+            }
+            auto file_path = abs_path(stored[i]);
+            std::error_code ec;
+            auto size = std::filesystem::file_size(file_path, ec);
+            if (ec)
+                continue;
+            if (size >= cutoff)
+            {
+                results[i] = load(stored[i]);
+                continue;
+            }
+            index.push_back(i);
+            paths.push_back(file_path.string());
+            views.push_back(_read_pool->acquire(size));
+        }
+        if (index.empty())
+            return results;
+
+        std::lock_guard lk { _io_mutex };
+        auto& io = _batch_io(_io);
+        std::vector<IoOp> opens;
+        opens.reserve(index.size());
+        for (const auto& p : paths)
+            opens.push_back(IoOp::open(p.c_str(), O_RDONLY | O_CLOEXEC));
+        io.run(opens);
+
+        std::vector<IoOp> reads;
+        std::vector<std::size_t> read_of;
+        for (std::size_t k = 0; k < index.size(); ++k)
+        {
+            if (opens[k].result >= 0 && views[k]->size() > 0)
+            {
+                reads.push_back(IoOp::read(opens[k].result, views[k]->mutable_data(),
+                                           views[k]->size()));
+                read_of.push_back(k);
+            }
+        }
+        io.run(reads);
+        std::vector<std::size_t> done(index.size(), 0);
+        for (std::size_t r = 0; r < reads.size(); ++r)
+        {
+            auto k = read_of[r];
+            done[k] = reads[r].result > 0 ? static_cast<std::size_t>(reads[r].result) : 0;
+            // Short read: finish it the plain way (rare on regular files).
+            while (reads[r].result > 0 && done[k] < views[k]->size())
+            {
+                auto n = ::pread(opens[k].result, views[k]->mutable_data() + done[k],
+                                 views[k]->size() - done[k], static_cast<off_t>(done[k]));
+                if (n <= 0)
+                    break;
+                done[k] += static_cast<std::size_t>(n);
+            }
+        }
+
+        std::vector<IoOp> closes;
+        for (const auto& op : opens)
+            if (op.result >= 0)
+                closes.push_back(IoOp::close(op.result));
+        io.run(closes);
+
+        for (std::size_t k = 0; k < index.size(); ++k)
+        {
+            if (opens[k].result < 0)
+                continue;
+            views[k]->shrink(done[k]);
+            results[index[k]] = Buffer(std::static_pointer_cast<IMemoryView>(views[k]));
+        }
+#else
+        for (std::size_t i = 0; i < stored.size(); ++i)
+            results[i] = load(stored[i]);
+#endif
+        return results;
+    }
+
+    // Write several values at once, like store() but with one wave each of
+    // opens, writes, (in sync mode) fdatasyncs and closes through the batch
+    // I/O ring. `owners`, if given, holds the key of each value for the
+    // intent log. Returns each value's stored path, or nullopt where the
+    // write failed.
+    [[nodiscard]] std::vector<std::optional<std::filesystem::path>> store_many(
+        std::span<const std::span<const char>> values,
+        std::span<const std::string_view> owners = {})
+    {
+        std::vector<std::optional<std::filesystem::path>> results(values.size());
+#if !defined(_WIN32)
+        // Values to be chunked are written one by one, each by a pool of its
+        // own (see store()), and the others as one batch.
+        if (std::ranges::any_of(values, [this](std::span<const char> v) { return _chunks(v.size()); }))
+        {
+            std::vector<std::span<const char>> rest;
+            std::vector<std::string_view> rest_owners;
+            std::vector<std::size_t> rest_of;
+            for (std::size_t i = 0; i < values.size(); ++i)
+            {
+                auto owner = owners.empty() ? std::string_view {} : owners[i];
+                if (_chunks(values[i].size()))
+                    results[i] = store(values[i], owner);
+                else
+                {
+                    rest.push_back(values[i]);
+                    rest_owners.push_back(owner);
+                    rest_of.push_back(i);
+                }
+            }
+            auto written = store_many(rest, rest_owners);
+            for (std::size_t k = 0; k < written.size(); ++k)
+                results[rest_of[k]] = std::move(written[k]);
+            return results;
+        }
+        const auto mode = _durability.load(std::memory_order_relaxed);
+        const bool sync = mode == Durability::sync;
+        std::vector<std::filesystem::path> rel_paths;
+        std::vector<std::string> paths;
+        std::vector<std::string> tmp_paths;
+        std::vector<std::string> dirs;
+        rel_paths.reserve(values.size());
+        paths.reserve(values.size());
+        for (std::size_t i = 0; i < values.size(); ++i)
+        {
+            auto rel_path = _next_rel_path();
+            _log_intent(rel_path, owners.empty() ? std::string_view {} : owners[i]);
+            paths.push_back((_path / rel_path).string());
+            dirs.push_back((_path / rel_path.parent_path()).string());
+            if (sync)
+                tmp_paths.push_back(paths.back() + ".tmp");
+            rel_paths.push_back(std::move(rel_path));
+        }
+        const auto& targets = sync ? tmp_paths : paths;
+
+        std::unique_lock lk { _io_mutex };
+        auto& io = _batch_io(_io);
+        std::vector<IoOp> opens;
+        opens.reserve(values.size());
+        constexpr int open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+        for (const auto& p : targets)
+            opens.push_back(IoOp::open(p.c_str(), open_flags));
+        io.run(opens);
+        for (std::size_t i = 0; i < values.size(); ++i)
+        {
+            if (opens[i].result == -ENOENT && _restore_dirs(rel_paths[i], dirs))
+            {
+                auto fd = ::open(targets[i].c_str(), open_flags, 0644);
+                opens[i].result = fd >= 0 ? fd : -errno;
+            }
+        }
+        std::sort(dirs.begin(), dirs.end());
+        dirs.erase(std::unique(dirs.begin(), dirs.end()), dirs.end());
+
+        std::vector<bool> ok(values.size());
+        std::vector<IoOp> writes;
+        std::vector<std::size_t> write_of;
+        for (std::size_t i = 0; i < values.size(); ++i)
+        {
+            ok[i] = opens[i].result >= 0;
+            if (ok[i] && !values[i].empty())
+            {
+                writes.push_back(IoOp::write(opens[i].result, values[i].data(), values[i].size()));
+                write_of.push_back(i);
+            }
+        }
+        io.run(writes);
+        for (std::size_t w = 0; w < writes.size(); ++w)
+        {
+            auto i = write_of[w];
+            if (writes[w].result < 0)
+            {
+                ok[i] = false;
+                continue;
+            }
+            auto written = static_cast<std::size_t>(writes[w].result);
+            while (written < values[i].size())
+            {
+                auto n = ::pwrite(opens[i].result, values[i].data() + written,
+                                  values[i].size() - written, static_cast<off_t>(written));
+                if (n <= 0)
+                {
+                    ok[i] = false;
+                    break;
+                }
+                written += static_cast<std::size_t>(n);
+            }
+        }
+
+        if (sync)
+        {
+            std::vector<IoOp> syncs;
+            std::vector<std::size_t> sync_of;
+            for (std::size_t i = 0; i < values.size(); ++i)
+            {
+                if (ok[i])
+                {
+                    syncs.push_back(IoOp::fdatasync(opens[i].result));
+                    sync_of.push_back(i);
+                }
+            }
+            io.run(syncs);
+            for (std::size_t k = 0; k < syncs.size(); ++k)
+                if (syncs[k].result < 0)
+                    ok[sync_of[k]] = false;
+        }
+
+        std::vector<IoOp> closes;
+        for (const auto& op : opens)
+            if (op.result >= 0)
+                closes.push_back(IoOp::close(op.result));
+        io.run(closes);
+        lk.unlock();
+
+        std::vector<std::string> written;
+        for (std::size_t i = 0; i < values.size(); ++i)
+        {
+            if (ok[i] && sync && ::rename(tmp_paths[i].c_str(), paths[i].c_str()) != 0)
+                ok[i] = false;
+            if (!ok[i])
+            {
+                ::unlink(targets[i].c_str());
+                continue;
+            }
+            _bytes_delta.fetch_add(static_cast<int64_t>(footprint(values[i].size())),
+                                   std::memory_order_relaxed);
+            results[i] = std::move(rel_paths[i]);
+            if (mode == Durability::group)
+                written.push_back(std::move(paths[i]));
+        }
+        if (sync)
+        {
+            // The renames are only durable once their directories are.
+            lk.lock();
+            _sync_batch(_batch_io(_io), dirs, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        }
+        _queue_unsynced(std::move(written), dirs);
+#else
+        for (std::size_t i = 0; i < values.size(); ++i)
+            results[i] = store(values[i], owners.empty() ? std::string_view {} : owners[i]);
+#endif
+        return results;
+    }
+
+    [[nodiscard]] Durability durability() const
+    {
+        return _durability.load(std::memory_order_relaxed);
+    }
+
+    // Files already written keep the guarantee they were written with,
+    // except that files still waiting for a group wave get it regardless.
+    void set_durability(Durability mode) { _durability.store(mode, std::memory_order_relaxed); }
+
+    // Files written in group mode that no wave has flushed yet.
+    [[nodiscard]] std::size_t unsynced_files() const
+    {
+        std::lock_guard lk { _unsynced_mutex };
+        return _unsynced[0].files.size() + _unsynced[1].files.size();
+    }
+
+    // From this many files on a tier, a wave is a single syncfs() of the
+    // filesystem holding that tier instead of one fdatasync per file: one journal
+    // commit for the lot, 5-10x cheaper per file on a 256-file wave, at the
+    // price of also flushing whatever else is dirty on that filesystem.
+    static constexpr std::size_t syncfs_threshold = 64;
+
+    // Run one group wave: flush the files queued since the last one, then
+    // the directories whose entries changed, tier by tier. Returns once
+    // every file queued before the call is on the device. Returns the
+    // number of files flushed.
+    std::size_t sync_pending()
+    {
+        std::lock_guard io_lk { _drain_io_mutex };
+        std::array<_Unsynced, 2> pending;
+        {
+            std::lock_guard lk { _unsynced_mutex };
+            pending.swap(_unsynced);
+        }
+        std::size_t flushed = 0;
+        for (std::size_t tier = 0; tier < pending.size(); ++tier)
+        {
+            auto& [files, dirs] = pending[tier];
+            flushed += files.size();
+            if (files.empty() && dirs.empty())
+                continue;
+#if !defined(_WIN32)
+#if defined(__linux__)
+            if (files.size() >= syncfs_threshold)
+            {
+                const auto& root = tier == 0 ? _path : _cold_path;
+                int fd = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                bool done = fd >= 0 && ::syncfs(fd) == 0;
+                if (fd >= 0)
+                    ::close(fd);
+                if (done)
+                    continue;
+            }
+#endif
+            std::sort(dirs.begin(), dirs.end());
+            dirs.erase(std::unique(dirs.begin(), dirs.end()), dirs.end());
+            auto& io = _batch_io(_drain_io);
+            // A file deleted since it was queued simply fails to open. The
+            // directories go second: a new entry is only worth persisting
+            // once the data it names is.
+            _sync_batch(io, files, O_RDONLY | O_CLOEXEC);
+            _sync_batch(io, dirs, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+#endif
+        }
+        return flushed;
+    }
+
+    // A forked child leaves the parent's pending files to the parent.
+    void forget_unsynced()
+    {
+        std::lock_guard lk { _unsynced_mutex };
+        _unsynced = {};
+    }
+
+    // Whether batches go through io_uring: only once enabled, and where the
+    // kernel provides it. Otherwise batches issue one plain syscall per
+    // operation.
+    [[nodiscard]] bool uses_io_uring()
+    {
+        std::lock_guard lk { _io_mutex };
+        return _batch_io(_io).uses_io_uring();
+    }
+
+    void set_io_uring_enabled(bool enabled)
+    {
+        _use_io_uring.store(enabled, std::memory_order_relaxed);
+        reset_batch_io();
+    }
+
+    // Rings are per process: a forked child must not submit to its
+    // parent's, so it drops them and creates its own on first use.
+    void reset_batch_io()
+    {
+        {
+            std::lock_guard lk { _io_mutex };
+            _io.reset();
+        }
+        std::lock_guard lk { _drain_io_mutex };
+        _drain_io.reset();
+    }
+
+    // A forked child would otherwise draw the same file names (and random
+    // names) as its parent.
+    void reseed_file_names()
+    {
+        gen.seed(rd());
+        _seed_names();
+    }
+
+    [[nodiscard]] StorageLayout layout() const
+    {
+        return { _fanout_depth.load(std::memory_order_relaxed),
+                 _fanout_width.load(std::memory_order_relaxed) };
+    }
+
+    // New files go to the new layout, whose directories are created now
+    // (unless an earlier open already did); existing files stay where they
+    // are, their rows hold the full path.
+    void set_layout(StorageLayout layout)
+    {
+        layout.depth = std::clamp<std::size_t>(layout.depth, 1, 3);
+        layout.width = std::clamp<std::size_t>(layout.width, 1, 4096);
+        auto directories = [&layout]
+        {
+            std::size_t n = 1;
+            for (std::size_t d = 0; d < layout.depth; ++d)
+                n *= layout.width;
+            return n;
+        };
+        while (directories() > 65536)
+            layout.width /= 2;
+        _fanout_depth.store(layout.depth, std::memory_order_relaxed);
+        _fanout_width.store(layout.width, std::memory_order_relaxed);
+        _create_layout();
+    }
+
+    [[nodiscard]] ChunkPolicy chunk_policy() const
+    {
+        return { _chunk_threshold.load(std::memory_order_relaxed),
+                 _chunk_size.load(std::memory_order_relaxed),
+                 _chunk_workers.load(std::memory_order_relaxed) };
+    }
+
+    // Applies to values written from now on; chunked values already on disk
+    // keep their chunks.
+    void set_chunk_policy(ChunkPolicy policy)
+    {
+        std::size_t page = 4096;
+#if !defined(_WIN32)
+        page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+#endif
+        policy.chunk_size = std::max(page, (policy.chunk_size + page - 1) / page * page);
+        policy.workers = std::clamp<std::size_t>(policy.workers, 1, 64);
+        _chunk_size.store(policy.chunk_size, std::memory_order_relaxed);
+        _chunk_workers.store(policy.workers, std::memory_order_relaxed);
+        _chunk_threshold.store(policy.threshold, std::memory_order_relaxed);
+    }
+
+    // Ask the kernel to start reading a value file into the page cache.
+    inline void prefetch(const std::filesystem::path& stored) const
+    {
+#if !defined(_WIN32) && defined(POSIX_FADV_WILLNEED)
+        auto file_path = abs_path(stored);
+        auto files = is_chunked(stored) ? _chunk_files(file_path)
+                                        : std::vector<std::filesystem::path> { file_path };
+        for (const auto& f : files)
+        {
+            int fd = ::open(f.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                continue;
+            (void)::posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+            ::close(fd);
+        }
+#else
+        (void)stored;
+#endif
+    }
+
+    void clear_mmap_cache() { _mmap_cache.clear(); }
+
+    [[nodiscard]] inline std::size_t pread_cutoff() const
+    {
+        return _pread_cutoff.load(std::memory_order_relaxed);
+    }
+
+    // 0 maps every file; SIZE_MAX reads every file with pread().
+    inline void set_pread_cutoff(std::size_t bytes)
+    {
+        _pread_cutoff.store(bytes, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] MmapCacheStats mmap_cache_stats() const { return _mmap_cache.stats(); }
+
+    [[nodiscard]] std::size_t mmap_cache_capacity() const { return _mmap_cache.capacity(); }
+
+    void set_mmap_cache_capacity(std::size_t bytes) { _mmap_cache.set_capacity(bytes); }
+
+    void reset_mmap_cache_stats() { _mmap_cache.reset_stats(); }
+
+
+    // `owner` is the key the file is written for; it is logged in the
+    // intent log (when enabled) before the file is created.
+     [[nodiscard]] inline  std::optional<std::filesystem::path> store(const Bytes auto & value,
+                                                                     std::string_view owner = {})
+    {
+        auto rel_path = _next_rel_path();
+#if !defined(_WIN32)
+        if (_chunks(std::size(value)))
+        {
+            rel_path += chunks_suffix;
+            _log_intent(rel_path, owner);
+            auto bytes = _write_chunked(rel_path, std::data(value), std::size(value));
+            if (!bytes)
+                return {};
+            _bytes_delta.fetch_add(static_cast<int64_t>(*bytes), std::memory_order_relaxed);
+            return rel_path;
+        }
+#endif
+        _log_intent(rel_path, owner);
+        if (_write(rel_path, value))
+        {
+            _bytes_delta.fetch_add(static_cast<int64_t>(footprint(std::size(value))),
+                                   std::memory_order_relaxed);
+            return rel_path;
+        }
         return {};
     }
 };
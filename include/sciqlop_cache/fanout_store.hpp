@@ -1,5 +1,6 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
 #include <filesystem>
 #include <fmt/format.h>
@@ -35,14 +36,15 @@ public:
 
     explicit FanoutStore(const std::filesystem::path& path,
                          std::size_t shard_count = 8,
-                         std::size_t max_size = 0)
+                         std::size_t max_size = 0,
+                         const StoreOptions& options = {})
     {
         _shards.reserve(shard_count);
         for (std::size_t i = 0; i < shard_count; ++i)
         {
             auto shard_path = path / fmt::format("{:02d}", i);
             std::filesystem::create_directories(shard_path);
-            _shards.push_back(std::make_unique<StoreType>(shard_path, max_size));
+            _shards.push_back(std::make_unique<StoreType>(shard_path, max_size, options));
         }
     }
 
@@ -52,11 +54,32 @@ public:
 
     inline bool del(const std::string& key) { return _shard(key).del(key); }
 
+    // Keys of one prefix or pattern hash to every shard: each deletes its own.
+    inline std::size_t del_prefix(const std::string& prefix)
+    {
+        std::size_t total = 0;
+        _for_each_shard([&](auto& s) { total += s.del_prefix(prefix); });
+        return total;
+    }
+
+    inline std::size_t del_glob(const std::string& pattern)
+    {
+        std::size_t total = 0;
+        _for_each_shard([&](auto& s) { total += s.del_glob(pattern); });
+        return total;
+    }
+
     [[nodiscard]] inline std::optional<Buffer> get(const std::string& key)
     {
         return _shard(key).get(key);
     }
 
+    [[nodiscard]] inline std::optional<Buffer> get_range(const std::string& key,
+                                                         std::size_t offset, std::size_t size)
+    {
+        return _shard(key).get_range(key, offset, size);
+    }
+
     [[nodiscard]] inline std::optional<Buffer> pop(const std::string& key)
     {
         return _shard(key).pop(key);
@@ -130,6 +153,13 @@ public:
         return total;
     }
 
+    [[nodiscard]] std::size_t logical_size()
+    {
+        std::size_t total = 0;
+        _for_each_shard([&](auto& s) { total += s.logical_size(); });
+        return total;
+    }
+
     [[nodiscard]] std::size_t volume()
     {
         std::size_t total = 0;
@@ -148,9 +178,13 @@ public:
         return all;
     }
 
+    // The shards' key cursors one after the other: each streams its keys a
+    // page at a time (see _Store::KeyCursor), so memory stays at one page.
     class KeyCursor
     {
         std::vector<std::unique_ptr<StoreType>>& _shards;
+        std::string _prefix;
+        std::size_t _page_size;
         std::size_t _shard_idx = 0;
         std::optional<typename StoreType::KeyCursor> _cursor;
 
@@ -159,7 +193,7 @@ public:
             _cursor.reset();
             while (_shard_idx < _shards.size())
             {
-                _cursor.emplace(_shards[_shard_idx]->iterkeys());
+                _cursor.emplace(_shards[_shard_idx]->iterkeys(_prefix, _page_size));
                 auto val = _cursor->next();
                 if (val)
                 {
@@ -174,8 +208,11 @@ public:
         std::optional<std::string> _pending;
 
     public:
-        explicit KeyCursor(std::vector<std::unique_ptr<StoreType>>& shards)
-            : _shards(shards)
+        static constexpr std::size_t default_page_size = StoreType::KeyCursor::default_page_size;
+
+        explicit KeyCursor(std::vector<std::unique_ptr<StoreType>>& shards, std::string prefix = {},
+                           std::size_t page_size = default_page_size)
+            : _shards(shards), _prefix(std::move(prefix)), _page_size(page_size)
         {
             _advance_shard();
         }
@@ -205,9 +242,18 @@ public:
         }
     };
 
-    [[nodiscard]] KeyCursor iterkeys()
+    using ItemCursor = _ItemCursor<FanoutStore>;
+
+    [[nodiscard]] KeyCursor iterkeys(std::string prefix = {},
+                                     std::size_t page_size = KeyCursor::default_page_size)
     {
-        return KeyCursor(_shards);
+        return KeyCursor(_shards, std::move(prefix), page_size);
+    }
+
+    [[nodiscard]] ItemCursor items(std::string prefix = {},
+                                   std::size_t page_size = KeyCursor::default_page_size)
+    {
+        return ItemCursor(*this, iterkeys(std::move(prefix), page_size), page_size);
     }
 
     void clear()
@@ -225,17 +271,39 @@ public:
             combined.orphaned_files += r.orphaned_files;
             combined.dangling_rows += r.dangling_rows;
             combined.size_mismatches += r.size_mismatches;
+            combined.checksum_mismatches += r.checksum_mismatches;
             if (!r.counters_consistent) combined.counters_consistent = false;
             if (!r.sqlite_integrity_ok) combined.sqlite_integrity_ok = false;
+            if (!r.volume_consistent) combined.volume_consistent = false;
+            combined.rows_checked += r.rows_checked;
         });
         combined.ok = combined.sqlite_integrity_ok
                    && combined.dangling_rows == 0
                    && combined.size_mismatches == 0
+                   && combined.checksum_mismatches == 0
                    && combined.orphaned_files == 0
                    && combined.counters_consistent;
         return combined;
     }
 
+    // Advances every shard's cursor by one slice of max_rows / shard_count rows.
+    CheckResult check_incremental(std::size_t max_rows = 4096, bool fix = false)
+    {
+        CheckResult combined;
+        auto per_shard = std::max<std::size_t>(max_rows / _shards.size(), 1);
+        _for_each_shard([&](auto& s) {
+            auto r = s.check_incremental(per_shard, fix);
+            combined.dangling_rows += r.dangling_rows;
+            combined.size_mismatches += r.size_mismatches;
+            combined.checksum_mismatches += r.checksum_mismatches;
+            combined.rows_checked += r.rows_checked;
+            if (!r.pass_complete) combined.pass_complete = false;
+        });
+        combined.ok = combined.dangling_rows == 0 && combined.size_mismatches == 0
+            && combined.checksum_mismatches == 0;
+        return combined;
+    }
+
     [[nodiscard]] std::filesystem::path path() const
     {
         return _shards[0]->path().parent_path();
@@ -277,6 +345,178 @@ public:
         return _shards[0]->max_cache_size();
     }
 
+    inline void set_pread_cutoff(std::size_t bytes)
+    {
+        _for_each_shard([bytes](auto& s) { s.set_pread_cutoff(bytes); });
+    }
+
+    [[nodiscard]] inline std::size_t pread_cutoff() const
+    {
+        return _shards[0]->pread_cutoff();
+    }
+
+    inline void set_io_uring_enabled(bool enabled)
+    {
+        _for_each_shard([enabled](auto& s) { s.set_io_uring_enabled(enabled); });
+    }
+
+    [[nodiscard]] inline bool uses_io_uring() { return _shards[0]->uses_io_uring(); }
+
+    inline void set_storage_layout(StorageLayout layout)
+    {
+        _for_each_shard([layout](auto& s) { s.set_storage_layout(layout); });
+    }
+
+    [[nodiscard]] inline StorageLayout storage_layout() const
+    {
+        return _shards[0]->storage_layout();
+    }
+
+    inline void set_durability(Durability mode)
+    {
+        _for_each_shard([mode](auto& s) { s.set_durability(mode); });
+    }
+
+    inline void set_dedup_threshold(std::size_t bytes)
+    {
+        _for_each_shard([bytes](auto& s) { s.set_dedup_threshold(bytes); });
+    }
+
+    [[nodiscard]] inline std::size_t dedup_threshold() const
+    {
+        return _shards[0]->dedup_threshold();
+    }
+
+    inline void set_chunk_policy(const ChunkPolicy& policy)
+    {
+        _for_each_shard([&policy](auto& s) { s.set_chunk_policy(policy); });
+    }
+
+    [[nodiscard]] inline ChunkPolicy chunk_policy() const { return _shards[0]->chunk_policy(); }
+
+    inline void set_verify_policy(const VerifyPolicy& policy)
+    {
+        _for_each_shard([&policy](auto& s) { s.set_verify_policy(policy); });
+    }
+
+    [[nodiscard]] inline VerifyPolicy verify_policy() const { return _shards[0]->verify_policy(); }
+
+    [[nodiscard]] inline uint64_t corrupt_values()
+    {
+        uint64_t total = 0;
+        _for_each_shard([&](auto& s) { total += s.corrupt_values(); });
+        return total;
+    }
+
+    [[nodiscard]] inline Durability durability() const { return _shards[0]->durability(); }
+
+    // Each shard gets its own subdirectory of cold_path, named like its hot
+    // one; hot_bytes applies per shard, like max_size.
+    inline void set_tier_policy(const TierPolicy& policy)
+        requires requires(StoreType& s) { s.set_tier_policy(policy); }
+    {
+        for (std::size_t i = 0; i < _shards.size(); ++i)
+        {
+            auto shard_policy = policy;
+            if (!policy.cold_path.empty())
+                shard_policy.cold_path = policy.cold_path / fmt::format("{:02d}", i);
+            _shards[i]->set_tier_policy(shard_policy);
+        }
+    }
+
+    [[nodiscard]] inline TierPolicy tier_policy() const
+        requires requires(const StoreType& s) { s.tier_policy(); }
+    {
+        auto policy = _shards[0]->tier_policy();
+        policy.cold_path = policy.cold_path.parent_path();
+        return policy;
+    }
+
+    inline std::size_t migrate_tiers()
+        requires requires(StoreType& s) { s.migrate_tiers(); }
+    {
+        std::size_t total = 0;
+        _for_each_shard([&](auto& s) { total += s.migrate_tiers(); });
+        return total;
+    }
+
+    inline bool set_compression(CompressionPolicy policy)
+        requires requires(StoreType& s) { s.set_compression(policy); }
+    {
+        bool ok = true;
+        _for_each_shard([&](auto& s) { ok &= s.set_compression(policy); });
+        return ok;
+    }
+
+    [[nodiscard]] inline CompressionPolicy compression() const
+        requires requires(const StoreType& s) { s.compression(); }
+    {
+        return _shards[0]->compression();
+    }
+
+    inline void sync()
+    {
+        _for_each_shard([](auto& s) { s.sync(); });
+    }
+
+    // --- Batched get/set ---
+
+    std::vector<std::optional<Buffer>> get_many(const std::vector<std::string>& keys)
+    {
+        std::vector<std::vector<std::string>> per_shard(_shards.size());
+        std::vector<std::vector<std::size_t>> index(_shards.size());
+        for (std::size_t i = 0; i < keys.size(); ++i)
+        {
+            auto shard = _shard_for(keys[i]);
+            per_shard[shard].push_back(keys[i]);
+            index[shard].push_back(i);
+        }
+        std::vector<std::optional<Buffer>> results(keys.size());
+        for (std::size_t s = 0; s < _shards.size(); ++s)
+        {
+            if (per_shard[s].empty())
+                continue;
+            auto values = _shards[s]->get_many(per_shard[s]);
+            for (std::size_t k = 0; k < values.size(); ++k)
+                results[index[s][k]] = std::move(values[k]);
+        }
+        return results;
+    }
+
+    // Atomic per shard only: on failure, shards already written keep their
+    // entries.
+    bool set_many(std::span<const std::pair<std::string, std::span<const char>>> items)
+    {
+        std::vector<std::vector<std::pair<std::string, std::span<const char>>>> per_shard(
+            _shards.size());
+        for (const auto& item : items)
+            per_shard[_shard_for(item.first)].push_back(item);
+        bool ok = true;
+        for (std::size_t s = 0; s < _shards.size(); ++s)
+            if (!per_shard[s].empty())
+                ok = _shards[s]->set_many(per_shard[s]) && ok;
+        return ok;
+    }
+
+    // --- prefetch ---
+
+    void prefetch(const std::vector<std::string>& keys)
+    {
+        std::vector<std::vector<std::string>> per_shard(_shards.size());
+        for (const auto& key : keys)
+            per_shard[_shard_for(key)].push_back(key);
+        for (std::size_t i = 0; i < _shards.size(); ++i)
+            if (!per_shard[i].empty())
+                _shards[i]->prefetch(per_shard[i]);
+    }
+
+    [[nodiscard]] uint64_t prefetched()
+    {
+        uint64_t total = 0;
+        _for_each_shard([&](auto& s) { total += s.prefetched(); });
+        return total;
+    }
+
     // --- Tags ---
 
     inline std::size_t evict_tag(const std::string& tag)
@@ -309,6 +549,83 @@ public:
         _for_each_shard([](auto& s) { s.reset_stats(); });
     }
 
+    // --- WAL checkpointing ---
+
+    // Applied to every shard. Page caches, mmap windows and mmap caches are
+    // per shard: n shards use up to n times the sizes given.
+    void set_options(const StoreOptions& options)
+    {
+        _for_each_shard([&](auto& s) { s.set_options(options); });
+    }
+
+    [[nodiscard]] StoreOptions options() const { return _shards[0]->options(); }
+
+    void set_file_size_threshold(std::size_t bytes)
+    {
+        _for_each_shard([&](auto& s) { s.set_file_size_threshold(bytes); });
+    }
+
+    [[nodiscard]] std::size_t file_size_threshold() const
+    {
+        return _shards[0]->file_size_threshold();
+    }
+
+    // Each shard tunes its own threshold, from the values it holds.
+    void set_threshold_tuning(const ThresholdTuning& tuning)
+    {
+        _for_each_shard([&](auto& s) { s.set_threshold_tuning(tuning); });
+    }
+
+    [[nodiscard]] ThresholdTuning threshold_tuning() const
+    {
+        return _shards[0]->threshold_tuning();
+    }
+
+    void set_checkpoint_policy(const CheckpointPolicy& policy)
+    {
+        _for_each_shard([&](auto& s) { s.set_checkpoint_policy(policy); });
+    }
+
+    [[nodiscard]] CheckpointPolicy checkpoint_policy() const
+    {
+        return _shards[0]->checkpoint_policy();
+    }
+
+    WalStats wal_stats()
+    {
+        WalStats total {};
+        _for_each_shard([&](auto& s) {
+            auto w = s.wal_stats();
+            total.wal_pages += w.wal_pages;
+            total.wal_bytes += w.wal_bytes;
+            total.checkpoints += w.checkpoints;
+            total.truncating_checkpoints += w.truncating_checkpoints;
+            total.last_checkpoint_us = std::max(total.last_checkpoint_us, w.last_checkpoint_us);
+            total.max_checkpoint_us = std::max(total.max_checkpoint_us, w.max_checkpoint_us);
+            total.total_checkpoint_us += w.total_checkpoint_us;
+        });
+        return total;
+    }
+
+    MmapCacheStats mmap_cache_stats()
+    {
+        MmapCacheStats total {};
+        _for_each_shard([&](auto& s) {
+            auto st = s.mmap_cache_stats();
+            total.hits += st.hits;
+            total.misses += st.misses;
+            total.entries += st.entries;
+            total.mapped_bytes += st.mapped_bytes;
+            total.capacity_bytes += st.capacity_bytes;
+        });
+        return total;
+    }
+
+    void reset_mmap_cache_stats()
+    {
+        _for_each_shard([](auto& s) { s.reset_mmap_cache_stats(); });
+    }
+
     // --- incr / decr ---
 
     inline int64_t incr(const std::string& key, int64_t delta = 1, int64_t default_value = 0)
@@ -0,0 +1,319 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include "sciqlop_cache/disk_storage.hpp"
+#include "sciqlop_cache/utils/buffer.hpp"
+#include "sciqlop_cache/utils/concepts.hpp"
+
+// Values above the file size threshold of an ephemeral store (see
+// EphemeralCache), kept in RAM instead of in files. Each value is one
+// immutable block named "mem-<n>"; that name is what its row stores as its
+// path. Reads hand out the block itself, so a Buffer stays valid after the
+// entry is overwritten or deleted. The interface mirrors DiskStorage so
+// _Store runs on top unchanged; the file-only settings (durability, layout,
+// chunking, io_uring, the read cutoff, the mmap cache) are kept but change
+// nothing, and there is no cold tier.
+class MemoryStorage
+{
+    mutable std::shared_mutex _mutex;
+    std::unordered_map<std::string, std::shared_ptr<VectorMemoryView>> _values;
+    std::size_t _held_bytes = 0;
+    std::atomic<uint64_t> _name_counter { 0 };
+    std::atomic<int64_t> _bytes_delta { 0 };
+
+    // Blocks stored since the last commit_intents(), dropped again if the
+    // transaction that was to reference them rolls back.
+    std::mutex _intent_mutex;
+    std::vector<std::string> _in_flight;
+
+    std::atomic<Durability> _durability { Durability::none };
+    std::atomic<std::size_t> _fanout_depth { StorageLayout {}.depth };
+    std::atomic<std::size_t> _fanout_width { StorageLayout {}.width };
+    std::atomic<std::size_t> _chunk_threshold { ChunkPolicy {}.threshold };
+    std::atomic<std::size_t> _chunk_size { ChunkPolicy {}.chunk_size };
+    std::atomic<std::size_t> _chunk_workers { ChunkPolicy {}.workers };
+    std::atomic<std::size_t> _pread_cutoff { DiskStorage::default_pread_cutoff };
+    std::atomic<std::size_t> _mmap_cache_capacity { MmapHandleCache::default_capacity_bytes };
+
+    std::shared_ptr<VectorMemoryView> _find(const std::filesystem::path& stored) const
+    {
+        std::shared_lock lk { _mutex };
+        auto it = _values.find(stored.string());
+        return it == _values.end() ? nullptr : it->second;
+    }
+
+    bool _erase(const std::string& name)
+    {
+        std::lock_guard lk { _mutex };
+        auto it = _values.find(name);
+        if (it == _values.end())
+            return false;
+        _held_bytes -= it->second->size();
+        _bytes_delta.fetch_sub(static_cast<int64_t>(it->second->size()),
+                               std::memory_order_relaxed);
+        _values.erase(it);
+        return true;
+    }
+
+public:
+    static constexpr bool in_memory = true;
+    static constexpr std::string_view trash_dirname = DiskStorage::trash_dirname;
+    static constexpr std::string_view cold_dirname = DiskStorage::cold_dirname;
+    static constexpr std::string_view chunks_suffix = DiskStorage::chunks_suffix;
+
+    // The path only names the store; nothing is created there.
+    explicit MemoryStorage(const std::filesystem::path& = {},
+                           std::size_t mmap_cache_bytes = MmapHandleCache::default_capacity_bytes)
+            : _mmap_cache_capacity(mmap_cache_bytes)
+    {
+    }
+
+    MemoryStorage(const MemoryStorage&) = delete;
+    MemoryStorage& operator=(const MemoryStorage&) = delete;
+
+    [[nodiscard]] inline std::filesystem::path trash_path() const { return {}; }
+    [[nodiscard]] inline std::filesystem::path cold_path() const { return {}; }
+    [[nodiscard]] inline std::filesystem::path cold_trash_path() const { return {}; }
+    inline void set_cold_path(const std::filesystem::path&) { }
+    [[nodiscard]] static inline bool is_chunked(const std::filesystem::path&) { return false; }
+    [[nodiscard]] static inline bool is_cold(const std::filesystem::path&) { return false; }
+    [[nodiscard]] inline std::optional<std::filesystem::path> copy_to_tier(
+        const std::filesystem::path&, bool)
+    {
+        return std::nullopt;
+    }
+
+    // Accounted to the byte, like a filesystem with 1-byte blocks.
+    [[nodiscard]] inline std::size_t block_size() const { return 1; }
+    [[nodiscard]] inline std::size_t footprint(std::size_t bytes) const { return bytes; }
+    [[nodiscard]] inline int64_t bytes_delta() const
+    {
+        return _bytes_delta.load(std::memory_order_relaxed);
+    }
+    inline int64_t take_bytes_delta() { return _bytes_delta.exchange(0, std::memory_order_relaxed); }
+    inline void add_bytes_delta(int64_t delta)
+    {
+        _bytes_delta.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    // Bytes held right now, for check() to reconcile volume() against.
+    [[nodiscard]] inline std::size_t held_bytes() const
+    {
+        std::shared_lock lk { _mutex };
+        return _held_bytes;
+    }
+
+    // Blocks whose name is not in `referenced`; removed as well if `fix`.
+    inline std::size_t collect_unreferenced(const std::unordered_set<std::string>& referenced,
+                                            bool fix)
+    {
+        std::vector<std::string> orphans;
+        {
+            std::shared_lock lk { _mutex };
+            for (const auto& [name, _] : _values)
+                if (!referenced.contains(name))
+                    orphans.push_back(name);
+        }
+        if (fix)
+            for (const auto& name : orphans)
+                _erase(name);
+        return orphans.size();
+    }
+
+    [[nodiscard]] inline std::filesystem::path abs_path(const std::filesystem::path& stored) const
+    {
+        return stored;
+    }
+
+    inline bool remove(const std::filesystem::path& stored, bool = false)
+    {
+        return _erase(stored.string());
+    }
+
+    // Nothing to defer: freeing a block is as cheap as queuing it.
+    inline std::size_t defer_remove(const std::filesystem::path& stored)
+    {
+        (void)_erase(stored.string());
+        return 0;
+    }
+
+    inline void defer_remove_all(const std::vector<std::filesystem::path>&)
+    {
+        std::lock_guard lk { _mutex };
+        _bytes_delta.fetch_sub(static_cast<int64_t>(_held_bytes), std::memory_order_relaxed);
+        _held_bytes = 0;
+        _values.clear();
+    }
+
+    inline std::size_t drain_removals(std::size_t = SIZE_MAX) { return 0; }
+    [[nodiscard]] inline std::size_t pending_removals() const { return 0; }
+    inline void forget_pending_removals() { }
+
+    inline void set_intent_log_prefix(const std::filesystem::path&) { }
+
+    inline void commit_intents()
+    {
+        std::lock_guard lk { _intent_mutex };
+        _in_flight.clear();
+    }
+
+    inline void abort_intents()
+    {
+        std::vector<std::string> names;
+        {
+            std::lock_guard lk { _intent_mutex };
+            names.swap(_in_flight);
+        }
+        for (const auto& name : names)
+            _erase(name);
+    }
+
+    inline void forget_intent_log() { }
+    inline std::size_t recover_intents(auto&&) { return 0; }
+
+    [[nodiscard]] inline std::optional<Buffer> load(const std::filesystem::path& stored)
+    {
+        return map(stored);
+    }
+
+    [[nodiscard]] inline std::optional<Buffer> load_range(const std::filesystem::path& stored,
+                                                          std::size_t offset, std::size_t size)
+    {
+        if (auto whole = map(stored))
+            return whole->slice(offset, size);
+        return std::nullopt;
+    }
+
+    [[nodiscard]] inline std::optional<Buffer> map(const std::filesystem::path& stored) const
+    {
+        if (auto value = _find(stored))
+            return Buffer(std::static_pointer_cast<IMemoryView>(std::move(value)));
+        return std::nullopt;
+    }
+
+    [[nodiscard]] inline std::size_t value_size(const std::filesystem::path& stored,
+                                                std::error_code& ec) const
+    {
+        if (auto value = _find(stored))
+            return value->size();
+        ec = std::make_error_code(std::errc::no_such_file_or_directory);
+        return 0;
+    }
+
+    [[nodiscard]] std::vector<std::optional<Buffer>> load_many(
+        std::span<const std::filesystem::path> stored)
+    {
+        std::vector<std::optional<Buffer>> results;
+        results.reserve(stored.size());
+        for (const auto& s : stored)
+            results.push_back(map(s));
+        return results;
+    }
+
+    [[nodiscard]] inline std::optional<std::filesystem::path> store(const Bytes auto& value,
+                                                                    std::string_view = {})
+    {
+        char name[24];
+        std::snprintf(name, sizeof name, "mem-%llx",
+                      static_cast<unsigned long long>(
+                          _name_counter.fetch_add(1, std::memory_order_relaxed)));
+        auto block = std::make_shared<VectorMemoryView>(
+            std::vector<char>(std::data(value), std::data(value) + std::size(value)));
+        {
+            std::lock_guard lk { _mutex };
+            _held_bytes += block->size();
+            _values.emplace(name, std::move(block));
+        }
+        _bytes_delta.fetch_add(static_cast<int64_t>(std::size(value)), std::memory_order_relaxed);
+        std::lock_guard lk { _intent_mutex };
+        _in_flight.emplace_back(name);
+        return std::filesystem::path(name);
+    }
+
+    [[nodiscard]] std::vector<std::optional<std::filesystem::path>> store_many(
+        std::span<const std::span<const char>> values,
+        std::span<const std::string_view> = {})
+    {
+        std::vector<std::optional<std::filesystem::path>> results;
+        results.reserve(values.size());
+        for (const auto& v : values)
+            results.push_back(store(v));
+        return results;
+    }
+
+    [[nodiscard]] Durability durability() const
+    {
+        return _durability.load(std::memory_order_relaxed);
+    }
+    void set_durability(Durability mode) { _durability.store(mode, std::memory_order_relaxed); }
+    [[nodiscard]] std::size_t unsynced_files() const { return 0; }
+    std::size_t sync_pending() { return 0; }
+    void forget_unsynced() { }
+
+    [[nodiscard]] bool uses_io_uring() { return false; }
+    void set_io_uring_enabled(bool) { }
+    void reset_batch_io() { }
+    // A forked child owns a copy of every block; names cannot clash.
+    void reseed_file_names() { }
+
+    [[nodiscard]] StorageLayout layout() const
+    {
+        return { _fanout_depth.load(std::memory_order_relaxed),
+                 _fanout_width.load(std::memory_order_relaxed) };
+    }
+    void set_layout(StorageLayout layout)
+    {
+        _fanout_depth.store(layout.depth, std::memory_order_relaxed);
+        _fanout_width.store(layout.width, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] ChunkPolicy chunk_policy() const
+    {
+        return { _chunk_threshold.load(std::memory_order_relaxed),
+                 _chunk_size.load(std::memory_order_relaxed),
+                 _chunk_workers.load(std::memory_order_relaxed) };
+    }
+    void set_chunk_policy(ChunkPolicy policy)
+    {
+        _chunk_threshold.store(policy.threshold, std::memory_order_relaxed);
+        _chunk_size.store(policy.chunk_size, std::memory_order_relaxed);
+        _chunk_workers.store(policy.workers, std::memory_order_relaxed);
+    }
+
+    inline void prefetch(const std::filesystem::path&) const { }
+
+    [[nodiscard]] inline std::size_t pread_cutoff() const
+    {
+        return _pread_cutoff.load(std::memory_order_relaxed);
+    }
+    inline void set_pread_cutoff(std::size_t bytes)
+    {
+        _pread_cutoff.store(bytes, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] MmapCacheStats mmap_cache_stats() const { return {}; }
+    [[nodiscard]] std::size_t mmap_cache_capacity() const
+    {
+        return _mmap_cache_capacity.load(std::memory_order_relaxed);
+    }
+    void set_mmap_cache_capacity(std::size_t bytes)
+    {
+        _mmap_cache_capacity.store(bytes, std::memory_order_relaxed);
+    }
+    void reset_mmap_cache_stats() { }
+};
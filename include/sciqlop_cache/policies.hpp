@@ -38,16 +38,34 @@ struct WithEviction
     static std::string insert_placeholders() { return ", ?"; }
 };
 
+// Tags double as namespaces: each carries a generation counter in meta
+// ('gen:<tag>', absent = 0) and rows record the generation they were written
+// under. evict_tag() bumps the counter, which hides every older row at once;
+// the background thread garbage-collects them later.
 struct WithTags
 {
-    static std::string where_valid() { return ""; }
-    static std::string extra_columns() { return ", tag TEXT DEFAULT NULL"; }
+    static std::string current_generation(const std::string& tag_expr)
+    {
+        return "COALESCE((SELECT value FROM meta WHERE meta.key = 'gen:' || " + tag_expr
+            + "), 0)";
+    }
+    static std::string stale()
+    {
+        return "cache.tag IS NOT NULL AND cache.tag_gen < " + current_generation("cache.tag");
+    }
+    static std::string where_valid() { return " AND NOT (" + stale() + ")"; }
+    static std::string extra_columns()
+    {
+        return ", tag TEXT DEFAULT NULL, tag_gen INT NOT NULL DEFAULT 0";
+    }
     static std::string extra_indexes()
     {
-        return "CREATE INDEX IF NOT EXISTS idx_cache_tag ON cache(tag) WHERE tag IS NOT NULL;";
+        return "CREATE INDEX IF NOT EXISTS idx_cache_tag_gen ON cache(tag, tag_gen) "
+               "WHERE tag IS NOT NULL;";
     }
-    static std::string insert_columns() { return ", tag"; }
-    static std::string insert_placeholders() { return ", ?"; }
+    static std::string insert_columns() { return ", tag, tag_gen"; }
+    // The tag is bound twice: once for the column, once for its generation.
+    static std::string insert_placeholders() { return ", ?, " + current_generation("?"); }
 };
 
 struct WithStats
@@ -61,3 +79,31 @@ struct WithStats
     static std::string insert_columns() { return ""; }
     static std::string insert_placeholders() { return ""; }
 };
+
+// Values of at least min_size bytes are encoded with the selected codec (see
+// utils/compression.hpp) and kept compressed only if that shrinks them to
+// max_ratio of their size. `size` stays the stored byte count, so max_size,
+// volume() and check() all see what is on disk; logical_size records the
+// decoded size of compressed rows and is NULL otherwise.
+struct CompressionPolicy
+{
+    uint8_t codec = 0;
+    std::size_t min_size = 512;
+    double max_ratio = 0.9;
+};
+
+struct WithCompression
+{
+    std::atomic<uint8_t> _codec { 0 };
+    std::atomic<std::size_t> _min_compressed_size { CompressionPolicy {}.min_size };
+    std::atomic<double> _max_compression_ratio { CompressionPolicy {}.max_ratio };
+
+    static std::string where_valid() { return ""; }
+    static std::string extra_columns()
+    {
+        return ", codec INT NOT NULL DEFAULT 0, logical_size INT DEFAULT NULL";
+    }
+    static std::string extra_indexes() { return ""; }
+    static std::string insert_columns() { return ", codec, logical_size"; }
+    static std::string insert_placeholders() { return ", ?, ?"; }
+};
@@ -9,8 +9,13 @@
 
 #include "store.hpp"
 
-using Cache = _Store<DiskStorage, WithExpiration, WithEviction, WithTags, WithStats>;
+using Cache = _Store<DiskStorage, WithExpiration, WithEviction, WithTags, WithStats,
+                     WithCompression>;
 using Index = _Store<DiskStorage>;
+// Everything in memory (see MemoryStorage): for tests and scratch data.
+using EphemeralCache = _Store<MemoryStorage, WithExpiration, WithEviction, WithTags, WithStats,
+                              WithCompression>;
+using EphemeralIndex = _Store<MemoryStorage>;
 
 #include "fanout_store.hpp"
 
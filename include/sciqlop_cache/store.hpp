@@ -2,8 +2,11 @@
 
 #include "database.hpp"
 #include "disk_storage.hpp"
+#include "memory_storage.hpp"
 #include "policies.hpp"
+#include "utils/compression.hpp"
 #include "utils/concepts.hpp"
+#include "utils/hash.hpp"
 #include <cpp_utils/io/memory_mapped_file.hpp>
 #include <cstdio>
 #include <cstring>
@@ -12,7 +15,10 @@
 #include <optional>
 #include <span>
 #include <sqlite3.h>
+#include <stdexcept>
+#include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
 #include <mutex>
 #include <string>
@@ -99,6 +105,263 @@ inline void _unregister_fork_aware(_ForkAware* s)
     _fork_registry().erase(s);
 }
 
+// --- WAL checkpointing -----------------------------------------------------
+// SQLite's own autocheckpoint is disabled (wal_autocheckpoint=0) so that a
+// checkpoint never runs inline on a user thread's COMMIT. Instead a wal_hook
+// records the WAL size after every commit and wakes the background thread as
+// soon as it crosses passive_pages; an idle cache with an empty WAL does no
+// checkpoint I/O at all.
+struct CheckpointPolicy
+{
+    // WAL size (in pages) that triggers a PASSIVE checkpoint. 1000 pages is
+    // SQLite's default autocheckpoint threshold.
+    std::size_t passive_pages = 1000;
+    // WAL size at which the checkpoint escalates to TRUNCATE: it waits
+    // (briefly) for readers so the whole log can be backfilled, then resets
+    // the -wal file to zero bytes instead of letting it keep its high-water size.
+    std::size_t truncate_pages = 16000;
+    // Period of the background housekeeping pass (expiration, LRU eviction,
+    // counter resync). A non-empty WAL below passive_pages is also
+    // checkpointed on this tick.
+    std::chrono::milliseconds housekeeping_interval { 1000 };
+
+    bool operator==(const CheckpointPolicy&) const = default;
+};
+
+struct WalStats
+{
+    uint64_t wal_pages;              // WAL frames reported by the last commit
+    uint64_t wal_bytes;              // current size of the -wal file
+    uint64_t checkpoints;
+    uint64_t truncating_checkpoints;
+    uint64_t last_checkpoint_us;
+    uint64_t max_checkpoint_us;
+    uint64_t total_checkpoint_us;
+};
+
+// --- Value checksums ------------------------------------------------------
+// Every file-backed value is hashed (XXH3, utils/hash.hpp) while it is
+// written and the hash is kept in its row's `checksum` column, so a
+// bit-flipped, truncated or overwritten value file can be told from the
+// value that was stored. Inline values live in SQLite's pages and carry no
+// checksum. A value that fails verification is dropped like a missing one:
+// the read is a miss and the row and its file go.
+enum class VerifyMode : uint8_t
+{
+    off,    // reads trust the file
+    sample, // sample_percent of the reads hash what they load
+    always, // every read of a file-backed value does
+};
+
+struct VerifyPolicy
+{
+    VerifyMode mode = VerifyMode::off;
+    double sample_percent = 1.0;
+    // File-backed rows the background thread re-hashes per housekeeping
+    // tick, resuming in key order where the last tick stopped; 0 disables
+    // scrubbing.
+    std::size_t scrub_rows = 0;
+};
+
+// --- Storage tiers ---------------------------------------------------------
+// File-backed values can spill from the cache directory (the hot tier, say a
+// small NVMe volume) to a second directory (the cold tier, a large HDD or
+// NFS volume). New values are always written hot. Once the hot tier holds
+// more than hot_bytes of them, the background thread moves the least
+// recently used ones cold: it copies the file, then repoints the row, so a
+// reader finds the value on one tier or the other, never on neither.
+// Inline values stay in the database.
+struct TierPolicy
+{
+    // Persisted in the database once set; rows on the cold tier store paths
+    // relative to it, so the directory can be moved and set again.
+    std::filesystem::path cold_path;
+    // Bytes of file-backed values kept on the hot tier; 0 keeps them all.
+    std::size_t hot_bytes = 0;
+    // A get() of a cold value queues its move back to the hot tier; the
+    // read itself is served from the cold copy.
+    bool promote_on_read = false;
+};
+
+// --- Threshold tuning ------------------------------------------------------
+// Where a value is best stored depends on the volume under the store: a file
+// of its own is cheap on tmpfs and costly on NFS. With tuning enabled, sets
+// and gets of values within a factor of two of the file size threshold are
+// timed, and one in probe_every of those sets stores its value the other way,
+// so both storage paths are measured at the same sizes. Once both paths have
+// min_samples timed sets on one side of the threshold, a housekeeping tick
+// halves the threshold if files were faster just below it, or doubles it if
+// the database was faster just above it, within [min_bytes, max_bytes]. The
+// result is kept in meta, and every process that tunes the store follows it.
+struct ThresholdTuning
+{
+    bool enabled = false;
+    std::size_t min_bytes = 1024;
+    std::size_t max_bytes = 1024 * 1024;
+    std::size_t probe_every = 16;
+    std::size_t min_samples = 32;
+
+    bool operator==(const ThresholdTuning&) const = default;
+};
+
+// --- Store options ---------------------------------------------------------
+// Memory and I/O sizing of a store. The defaults suit a desktop; the presets
+// are starting points for other machines and workloads. Everything but
+// page_size and separate_values also applies to an open store (see
+// set_options()); page_size and hashed_keys only take effect when the
+// database file is created, separate_values when the store is opened.
+struct StoreOptions
+{
+    // SQLite page cache of each connection.
+    std::size_t page_cache_bytes = 10000 * 4096;
+    // Bytes of the database file SQLite reads through a memory mapping
+    // (PRAGMA mmap_size; capped by SQLite's compile-time maximum, 2 GiB by
+    // default); 0 reads it with plain I/O.
+    std::size_t mmap_size = 256 * 1024 * 1024;
+    // How long a call waits for another process' write lock before failing.
+    std::chrono::milliseconds busy_timeout { 600'000 };
+    // Database page size: a power of two from 512 to 65536.
+    std::size_t page_size = 4096;
+    // Values larger than this get a file of their own; smaller ones are
+    // stored in the database.
+    std::size_t file_size_threshold = 8 * 1024;
+    // Mapped value files kept open for reuse (see MmapHandleCache).
+    std::size_t mmap_cache_bytes = MmapHandleCache::default_capacity_bytes;
+    CheckpointPolicy checkpoint {};
+    // Off by default; when on, file_size_threshold is only where tuning
+    // starts from if meta holds no tuned value yet.
+    ThresholdTuning threshold_tuning {};
+    // Inline values go to a table of their own, cache_values, and each row
+    // of `cache` keeps only the id of its value there. Scans of the keys and
+    // metadata (keys(), count(), eviction, counter resyncs) then read small
+    // rows instead of dragging up to file_size_threshold bytes of value
+    // pages each through the page cache, for one more B-tree lookup per get.
+    // Opening a store with it moves the inline values already there; values
+    // written without it stay readable either way.
+    bool separate_values = false;
+    // The primary key of `cache` is a 64-bit hash of the key instead of the
+    // key itself, which moves to a key_text column only keys() and the reads
+    // read. Keys of a few hundred bytes then make a B-tree of 8-byte keys,
+    // shallower and with more of it in the page cache. Reads compare the
+    // stored key as well, so they never return another key's value; a write
+    // whose key collides with a stored one replaces that entry, as if it had
+    // been evicted. A database keeps the layout it was created with.
+    bool hashed_keys = false;
+
+    bool operator==(const StoreOptions&) const = default;
+
+    // Small memory footprint, fewer wake-ups, and a WAL kept short.
+    [[nodiscard]] static StoreOptions laptop()
+    {
+        StoreOptions o;
+        o.page_cache_bytes = 8 * 1024 * 1024;
+        o.mmap_size = 64 * 1024 * 1024;
+        o.mmap_cache_bytes = 64 * 1024 * 1024;
+        o.checkpoint.truncate_pages = 4000;
+        o.checkpoint.housekeeping_interval = std::chrono::milliseconds { 5000 };
+        return o;
+    }
+
+    // Caches of hundreds of GB on a machine with RAM to spare.
+    [[nodiscard]] static StoreOptions server()
+    {
+        StoreOptions o;
+        o.page_cache_bytes = std::size_t { 1 } << 30;
+        o.mmap_size = std::size_t { 2 } << 30;
+        o.page_size = 8192;
+        o.file_size_threshold = 16 * 1024;
+        o.mmap_cache_bytes = std::size_t { 4 } << 30;
+        o.checkpoint.passive_pages = 4000;
+        o.checkpoint.truncate_pages = 64000;
+        o.separate_values = true;
+        return o;
+    }
+
+    // Written once, read many times: more values inline, where reads come
+    // straight from the mapped database, and more of everything cached.
+    [[nodiscard]] static StoreOptions read_mostly()
+    {
+        StoreOptions o;
+        o.page_cache_bytes = 256 * 1024 * 1024;
+        o.mmap_size = std::size_t { 2 } << 30;
+        o.file_size_threshold = 32 * 1024;
+        o.mmap_cache_bytes = std::size_t { 2 } << 30;
+        return o;
+    }
+
+    // Sustained writes: values past 4 KiB skip the WAL's double write, and
+    // checkpoints run less often, over a longer log.
+    [[nodiscard]] static StoreOptions write_heavy()
+    {
+        StoreOptions o;
+        o.page_cache_bytes = 64 * 1024 * 1024;
+        o.file_size_threshold = 4 * 1024;
+        o.checkpoint.passive_pages = 8000;
+        o.checkpoint.truncate_pages = 64000;
+        return o;
+    }
+};
+
+// The entries under the keys of a key cursor, as (key, value) pairs: keys are
+// taken a page at a time and their values read with one get_many(), which
+// also counts as a use of each. Entries gone in between are skipped.
+template <typename StoreType>
+class _ItemCursor
+{
+    using Item = std::pair<std::string, Buffer>;
+
+    StoreType* _store;
+    typename StoreType::KeyCursor _keys;
+    std::size_t _page_size;
+    std::vector<Item> _page;
+    std::size_t _pos = 0;
+    bool _done = false;
+
+    void _fetch_page()
+    {
+        _page.clear();
+        _pos = 0;
+        std::vector<std::string> keys;
+        while (keys.size() < _page_size)
+        {
+            auto key = _keys.next();
+            if (!key)
+            {
+                _done = true;
+                break;
+            }
+            keys.push_back(std::move(*key));
+        }
+        if (keys.empty())
+            return;
+        auto values = _store->get_many(keys);
+        for (std::size_t i = 0; i < keys.size(); ++i)
+            if (values[i])
+                _page.emplace_back(std::move(keys[i]), std::move(*values[i]));
+    }
+
+public:
+    _ItemCursor(StoreType& store, typename StoreType::KeyCursor keys, std::size_t page_size)
+            : _store(&store), _keys(std::move(keys)), _page_size(std::max<std::size_t>(page_size, 1))
+    {
+    }
+
+    _ItemCursor(const _ItemCursor&) = delete;
+    _ItemCursor& operator=(const _ItemCursor&) = delete;
+    _ItemCursor(_ItemCursor&&) noexcept = default;
+
+    std::optional<Item> next()
+    {
+        while (_pos >= _page.size())
+        {
+            if (_done)
+                return std::nullopt;
+            _fetch_page();
+        }
+        return std::move(_page[_pos++]);
+    }
+};
+
 template <typename Storage, typename... Policies>
 class _Store : private Policies..., private _ForkAware
 {
@@ -106,16 +369,74 @@ class _Store : private Policies..., private _ForkAware
     static constexpr bool has_eviction = has_policy_v<WithEviction, Policies...>;
     static constexpr bool has_tags = has_policy_v<WithTags, Policies...>;
     static constexpr bool has_stats = has_policy_v<WithStats, Policies...>;
+    static constexpr bool has_compression = has_policy_v<WithCompression, Policies...>;
+    // An in-memory database over a MemoryStorage: nothing touches the disk
+    // unless a snapshot is asked for, and housekeeping runs inline on the
+    // writing threads instead of on a background thread.
+    static constexpr bool _ephemeral = Storage::in_memory;
 
     std::filesystem::path cache_path;
     size_t max_size;
     std::unique_ptr<Storage> storage;
-    std::size_t _file_size_threshold = 8 * 1024;
+    std::atomic<std::size_t> _file_size_threshold { StoreOptions {}.file_size_threshold };
+    // The PRAGMA part of the options (see StoreOptions); the others live
+    // where they take effect. Guarded by _mtx.
+    StoreOptions _options;
+    // StoreOptions::separate_values as of opening; read by the statements below.
+    bool _value_table = false;
+    // StoreOptions::hashed_keys, or the layout the database already has.
+    bool _hashed_keys = false;
+    // File-backed values at least this large are deduplicated; 0 disables.
+    std::atomic<std::size_t> _dedup_threshold { 0 };
+    std::atomic<VerifyMode> _verify_mode { VerifyMode::off };
+    // Sampled reads per million, for VerifyMode::sample.
+    std::atomic<uint32_t> _verify_ppm { 10'000 };
+    std::atomic<uint64_t> _verify_seq { 0 };
+    std::atomic<std::size_t> _scrub_rows { 0 };
+    std::atomic<uint64_t> _corrupt_values { 0 };
+    // Last key scrubbed by the background thread (only it touches this).
+    std::string _scrub_cursor;
+    // See TierPolicy; the cold root itself lives in the storage.
+    std::atomic<std::size_t> _hot_bytes { 0 };
+    std::atomic<bool> _promote_on_read { false };
+    // Serialises tier passes: two copies of one file must never race.
+    std::mutex _tier_mutex;
+    // See ThresholdTuning; the bounds live in _options. Latencies are summed
+    // by [side of the threshold][value stored inline][timed a get].
+    std::atomic<bool> _tuning_enabled { false };
+    std::atomic<std::size_t> _probe_every { ThresholdTuning {}.probe_every };
+    std::atomic<uint64_t> _tuning_writes { 0 };
+    std::atomic<uint64_t> _tuning_count[2][2][2] {};
+    std::atomic<uint64_t> _tuning_ns[2][2][2] {};
+    static constexpr std::string_view _tuned_threshold_key = "file_size_threshold";
 
     std::thread _checkpoint_thread;
     std::atomic<bool> _stop_checkpoint { false };
     std::mutex _checkpoint_mutex;
     std::condition_variable _checkpoint_cv;
+    std::atomic<bool> _checkpoint_requested { false };
+    std::atomic<bool> _drain_requested { false };
+    std::atomic<bool> _policy_changed { false };
+    std::atomic<bool> _prefetch_requested { false };
+    std::atomic<bool> _sync_requested { false };
+    // Keys handed to prefetch(), consumed by the background thread. The
+    // mutex also guards the cold rows get() read under promote_on_read.
+    std::mutex _prefetch_mutex;
+    std::vector<std::string> _prefetch_queue;
+    std::atomic<std::size_t> _wal_passive_pages { CheckpointPolicy {}.passive_pages };
+    std::atomic<std::size_t> _wal_truncate_pages { CheckpointPolicy {}.truncate_pages };
+    std::atomic<int64_t> _housekeeping_ms { CheckpointPolicy {}.housekeeping_interval.count() };
+    // Ephemeral stores: steady clock (ms) of the next inline tick.
+    std::atomic<int64_t> _next_inline_housekeeping_ms { 0 };
+    // Ephemeral stores: close() saves a snapshot to cache_path.
+    std::atomic<bool> _snapshot_on_close { false };
+    std::atomic<uint64_t> _wal_pages { 0 };
+    std::atomic<uint64_t> _checkpoints { 0 };
+    std::atomic<uint64_t> _truncating_checkpoints { 0 };
+    std::atomic<uint64_t> _last_checkpoint_us { 0 };
+    std::atomic<uint64_t> _max_checkpoint_us { 0 };
+    std::atomic<uint64_t> _total_checkpoint_us { 0 };
+    std::atomic<uint64_t> _prefetched { 0 };
     _sq_pid_t _owner_pid;
     mutable Database _db;
     mutable std::recursive_mutex _mtx;
@@ -125,6 +446,8 @@ class _Store : private Policies..., private _ForkAware
     std::size_t _txn_depth = 0;
 
     std::atomic<std::size_t> _total_size { 0 };
+    // Decoded bytes: equals _total_size unless rows are compressed.
+    std::atomic<std::size_t> _total_logical { 0 };
     std::atomic<std::size_t> _total_count { 0 };
 
     // --- SQL building helpers (derived from policy fold expressions) ---
@@ -154,50 +477,149 @@ class _Store : private Policies..., private _ForkAware
         return (Policies::insert_placeholders() + ... + std::string {});
     }
 
+    // Decoded size of a row.
+    static std::string _logical_sql()
+    {
+        return has_compression ? "COALESCE(logical_size, size)" : "size";
+    }
+
+    // How a value is encoded: codec id and decoded size (0, 0 when stored as-is).
+    static std::string _codec_columns()
+    {
+        return has_compression ? ", codec, logical_size" : ", 0, 0";
+    }
+
+    // An inline value, in the row or in cache_values (see
+    // StoreOptions::separate_values): reads take either, whichever way the
+    // process that wrote the row was configured.
+    static std::string _inline_value_sql() { return "COALESCE(cache.value, cache_values.value)"; }
+    static std::string _value_join_sql()
+    {
+        return " LEFT JOIN cache_values ON cache_values.id = cache.value_id";
+    }
+
+    // The column an inline write binds its value, or its cache_values id, to.
+    std::string _value_column() const { return _value_table ? "value_id" : "value"; }
+
+    // Keys as the statements take them (see StoreOptions::hashed_keys). With
+    // hashed keys a statement binds the key once, as :key, and SQL hashes it
+    // with sciqlop_key_hash(); _key_is() also checks the stored key, while
+    // _key_slot() matches whichever row the key's hash lands on, as a write
+    // would replace it. Rows read back from `cache` carry the hash as their
+    // key and are matched with a plain "key = ?".
+    std::string _key_is() const
+    {
+        return _hashed_keys ? "key = sciqlop_key_hash(:key) AND key_text = :key" : "key = ?";
+    }
+    std::string _key_slot() const
+    {
+        return _hashed_keys ? "key = sciqlop_key_hash(?)" : "key = ?";
+    }
+    std::string _key_columns() const { return _hashed_keys ? "key, key_text" : "key"; }
+    std::string _key_values() const
+    {
+        return _hashed_keys ? "sciqlop_key_hash(:key), :key" : "?";
+    }
+    // The key as given to set(), for what hands keys back.
+    std::string _user_key_sql() const { return _hashed_keys ? "key_text" : "key"; }
+
+    static sqlite3_int64 _key_hash(std::string_view key)
+    {
+        return static_cast<sqlite3_int64>(xxh3_64(std::span<const char>(key.data(), key.size())));
+    }
+
+    // The key a row of `key` stores, for the statements that match rows.
+    std::string _row_key(const std::string& key) const
+    {
+        return _hashed_keys ? std::to_string(_key_hash(key)) : key;
+    }
+
+    // The smallest string greater than every string starting with prefix;
+    // nullopt if there is none (no prefix, or only 0xFF bytes).
+    static std::optional<std::string> _prefix_upper_bound(std::string prefix)
+    {
+        while (!prefix.empty() && static_cast<unsigned char>(prefix.back()) == 0xFF)
+            prefix.pop_back();
+        if (prefix.empty())
+            return std::nullopt;
+        prefix.back() = static_cast<char>(static_cast<unsigned char>(prefix.back()) + 1);
+        return prefix;
+    }
+
+    static void _key_hash_function(sqlite3_context* ctx, int, sqlite3_value** argv)
+    {
+        if (sqlite3_value_type(argv[0]) == SQLITE_NULL)
+            return sqlite3_result_null(ctx);
+        auto text = reinterpret_cast<const char*>(sqlite3_value_text(argv[0]));
+        auto size = static_cast<std::size_t>(sqlite3_value_bytes(argv[0]));
+        sqlite3_result_int64(ctx, _key_hash({ text, size }));
+    }
+
     // --- Compiled statements (SQL built from policies) ---
 
     CompiledStatement COUNT_STMT {
         std::string("SELECT COUNT(*) FROM cache WHERE 1=1") + _where_valid() + ";"
     };
     CompiledStatement KEYS_STMT {
-        std::string("SELECT key FROM cache WHERE 1=1") + _where_valid() + ";"
+        "SELECT " + _user_key_sql() + " FROM cache WHERE 1=1" + _where_valid() + ";"
     };
     CompiledStatement EXISTS_STMT {
-        std::string("SELECT 1 FROM cache WHERE key = ?") + _where_valid() + " LIMIT 1;"
+        "SELECT 1 FROM cache WHERE " + _key_is() + _where_valid() + " LIMIT 1;"
     };
     CompiledStatement GET_STMT {
-        std::string("SELECT value, path FROM cache WHERE key = ?") + _where_valid() + ";"
+        "SELECT " + _inline_value_sql() + ", path" + _codec_columns() + ", checksum FROM cache"
+        + _value_join_sql() + " WHERE " + _key_is() + _where_valid() + ";"
+    };
+    CompiledStatement GET_PATH_SIZE_STMT {
+        "SELECT path, size, " + _logical_sql() + " FROM cache WHERE " + _key_slot() + ";"
     };
-    CompiledStatement GET_PATH_SIZE_STMT { "SELECT path, size FROM cache WHERE key = ?;" };
     CompiledStatement REPLACE_VALUE_STMT {
-        std::string("REPLACE INTO cache (key, value, size") + _insert_extra_cols()
-        + ", path) VALUES (?, ?, ?" + _insert_extra_placeholders() + ", NULL);"
+        "REPLACE INTO cache (" + _key_columns() + ", " + _value_column() + ", size"
+        + _insert_extra_cols() + ", path) VALUES (" + _key_values() + ", ?, ?"
+        + _insert_extra_placeholders() + ", NULL);"
     };
     CompiledStatement REPLACE_PATH_STMT {
-        std::string("REPLACE INTO cache (key, path, size") + _insert_extra_cols()
-        + ", value) VALUES (?, ?, ?" + _insert_extra_placeholders() + ", NULL);"
+        "REPLACE INTO cache (" + _key_columns() + ", path, size" + _insert_extra_cols()
+        + ", value, checksum) VALUES (" + _key_values() + ", ?, ?" + _insert_extra_placeholders()
+        + ", NULL, ?);"
     };
     CompiledStatement INSERT_VALUE_STMT {
-        std::string("INSERT OR IGNORE INTO cache (key, value, size") + _insert_extra_cols()
-        + ") VALUES (?, ?, ?" + _insert_extra_placeholders() + ");"
+        "INSERT OR IGNORE INTO cache (" + _key_columns() + ", " + _value_column() + ", size"
+        + _insert_extra_cols() + ") VALUES (" + _key_values() + ", ?, ?"
+        + _insert_extra_placeholders() + ");"
     };
+    CompiledStatement INSERT_VALUE_ROW_STMT { "INSERT INTO cache_values (value) VALUES (?);" };
     CompiledStatement INSERT_PATH_STMT {
-        std::string("INSERT OR IGNORE INTO cache (key, path, size") + _insert_extra_cols()
-        + ") VALUES (?, ?, ?" + _insert_extra_placeholders() + ");"
+        "INSERT OR IGNORE INTO cache (" + _key_columns() + ", path, size" + _insert_extra_cols()
+        + ", checksum) VALUES (" + _key_values() + ", ?, ?" + _insert_extra_placeholders()
+        + ", ?);"
     };
-    CompiledStatement DELETE_STMT { "DELETE FROM cache WHERE key = ?;" };
+    CompiledStatement DELETE_STMT { "DELETE FROM cache WHERE " + _key_is() + ";" };
     CompiledStatement SET_META_STMT { "INSERT OR REPLACE INTO meta (key, value) VALUES (?, ?);" };
     CompiledStatement GET_META_STMT { "SELECT value FROM meta WHERE key = ?;" };
 
+    // Deduplicated value files (see set_dedup_threshold())
+    CompiledStatement FIND_BLOB_STMT { "SELECT path FROM blobs WHERE hash = ? AND size = ?;" };
+    CompiledStatement INSERT_BLOB_STMT {
+        "INSERT INTO blobs (path, hash, size, refs) VALUES (?, ?, ?, 1);"
+    };
+    CompiledStatement REF_BLOB_STMT { "UPDATE blobs SET refs = refs + 1 WHERE path = ?;" };
+    CompiledStatement UNREF_BLOB_STMT { "UPDATE blobs SET refs = refs - 1 WHERE path = ?;" };
+    CompiledStatement DELETE_BLOB_STMT { "DELETE FROM blobs WHERE path = ?;" };
+    CompiledStatement IS_BLOB_STMT { "SELECT 1 FROM blobs WHERE path = ?;" };
+
     // Incr/decr statements
     CompiledStatement INCR_GET_STMT {
-        std::string("SELECT value FROM cache WHERE key = ?") + _where_valid() + ";"
+        "SELECT " + _inline_value_sql() + _codec_columns() + " FROM cache" + _value_join_sql()
+        + " WHERE " + _key_is() + _where_valid() + ";"
     };
-    static std::string _incr_update_sql()
+    std::string _incr_update_sql() const
     {
-        std::string sql = "UPDATE cache SET value = ?, size = ?";
+        std::string sql = "UPDATE cache SET " + _value_column() + " = ?, "
+            + (_value_table ? "value" : "value_id") + " = NULL, size = ?";
         if constexpr (has_eviction) sql += ", last_use = ?";
-        sql += ", path = NULL WHERE key = ?;";
+        if constexpr (has_compression) sql += ", codec = 0, logical_size = NULL";
+        sql += ", path = NULL, checksum = NULL WHERE " + _key_is() + ";";
         return sql;
     }
     CompiledStatement INCR_UPDATE_STMT { _incr_update_sql() };
@@ -213,9 +635,12 @@ class _Store : private Policies..., private _ForkAware
     };
 
     [[no_unique_address]] std::conditional_t<has_expiration, CompiledStatement, NoStmt>
-        TOUCH_STMT { "UPDATE cache SET expire = ? WHERE key = ?;" };
+        TOUCH_STMT { "UPDATE cache SET expire = ? WHERE " + _key_is() + ";" };
     [[no_unique_address]] std::conditional_t<has_expiration, CompiledStatement, NoStmt>
-        EXPIRE_STMT { "SELECT path, size FROM cache WHERE expire IS NOT NULL AND expire <= unixepoch('now');" };
+        EXPIRE_STMT {
+            "SELECT path, size, " + _logical_sql()
+            + " FROM cache WHERE expire IS NOT NULL AND expire <= unixepoch('now');"
+        };
     [[no_unique_address]] std::conditional_t<has_expiration, CompiledStatement, NoStmt>
         EVICT_EXPIRED_STMT { "DELETE FROM cache WHERE expire IS NOT NULL AND expire <= unixepoch('now');" };
 
@@ -223,15 +648,36 @@ class _Store : private Policies..., private _ForkAware
         UPDATE_LAST_USE_STMT {
             "UPDATE cache SET last_use = ?, "
             "access_count_since_last_update = access_count_since_last_update + 1 "
-            "WHERE key = ?;"
+            "WHERE " + _key_is() + ";"
         };
     [[no_unique_address]] std::conditional_t<has_eviction, CompiledStatement, NoStmt>
-        EVICT_LRU_STMT { "SELECT key, path, size FROM cache ORDER BY last_use ASC;" };
+        EVICT_LRU_STMT {
+            "SELECT " + _user_key_sql() + ", path, size, " + _logical_sql()
+            + " FROM cache ORDER BY last_use ASC;"
+        };
 
+    // Meta key prefix of the per-tag generations (see WithTags).
+    static constexpr std::string_view _tag_gen_prefix = "gen:";
+
+    [[no_unique_address]] std::conditional_t<has_tags, CompiledStatement, NoStmt>
+        COUNT_TAG_STMT {
+            "SELECT COUNT(*) FROM cache WHERE tag = ?1 AND tag_gen = "
+            + WithTags::current_generation("?1") + ";"
+        };
+    [[no_unique_address]] std::conditional_t<has_tags, CompiledStatement, NoStmt>
+        BUMP_TAG_GEN_STMT {
+            "INSERT INTO meta (key, value) VALUES ('gen:' || ?1, 1) "
+            "ON CONFLICT(key) DO UPDATE SET value = value + 1;"
+        };
     [[no_unique_address]] std::conditional_t<has_tags, CompiledStatement, NoStmt>
-        EVICT_TAG_PATH_STMT { "SELECT path FROM cache WHERE tag = ?;" };
+        GET_STALE_STMT {
+            "SELECT path, size, " + _logical_sql() + " FROM cache WHERE " + _key_slot()
+            + " AND " + WithTags::stale() + ";"
+        };
     [[no_unique_address]] std::conditional_t<has_tags, CompiledStatement, NoStmt>
-        EVICT_TAG_STMT { "DELETE FROM cache WHERE tag = ?;" };
+        DELETE_STALE_STMT {
+            "DELETE FROM cache WHERE " + _key_slot() + " AND " + WithTags::stale() + ";"
+        };
 
     auto _all_statements()
     {
@@ -239,8 +685,10 @@ class _Store : private Policies..., private _ForkAware
             &COUNT_STMT, &KEYS_STMT, &EXISTS_STMT, &GET_STMT,
             &GET_PATH_SIZE_STMT,
             &REPLACE_VALUE_STMT, &REPLACE_PATH_STMT,
-            &INSERT_VALUE_STMT, &INSERT_PATH_STMT, &DELETE_STMT,
+            &INSERT_VALUE_STMT, &INSERT_VALUE_ROW_STMT, &INSERT_PATH_STMT, &DELETE_STMT,
             &SET_META_STMT, &GET_META_STMT,
+            &FIND_BLOB_STMT, &INSERT_BLOB_STMT, &REF_BLOB_STMT, &UNREF_BLOB_STMT,
+            &DELETE_BLOB_STMT, &IS_BLOB_STMT,
             &INCR_GET_STMT, &INCR_UPDATE_STMT
         };
         if constexpr (has_expiration)
@@ -256,8 +704,10 @@ class _Store : private Policies..., private _ForkAware
         }
         if constexpr (has_tags)
         {
-            stmts.push_back(&EVICT_TAG_PATH_STMT);
-            stmts.push_back(&EVICT_TAG_STMT);
+            stmts.push_back(&COUNT_TAG_STMT);
+            stmts.push_back(&BUMP_TAG_GEN_STMT);
+            stmts.push_back(&GET_STALE_STMT);
+            stmts.push_back(&DELETE_STALE_STMT);
         }
         return stmts;
     }
@@ -281,45 +731,119 @@ class _Store : private Policies..., private _ForkAware
 
     // --- Schema ---
 
-    static std::string _schema_sql()
+    std::string _schema_sql() const
     {
-        return std::string(
-            "CREATE TABLE IF NOT EXISTS cache ("
-            "key TEXT PRIMARY KEY NOT NULL,"
-            "path TEXT DEFAULT NULL,"
+        return std::string("CREATE TABLE IF NOT EXISTS cache (")
+            + (_hashed_keys ? "key INT PRIMARY KEY NOT NULL, key_text TEXT NOT NULL,"
+                            : "key TEXT PRIMARY KEY NOT NULL,")
+            + "path TEXT DEFAULT NULL,"
             "value BLOB DEFAULT NULL,"
-            "size INT NOT NULL DEFAULT 0")
+            "size INT NOT NULL DEFAULT 0,"
+            "checksum INT DEFAULT NULL,"
+            "value_id INT DEFAULT NULL"
             + _extra_schema_columns()
             + ") WITHOUT ROWID;"
+              " CREATE TABLE IF NOT EXISTS cache_values (id INTEGER PRIMARY KEY, value BLOB);"
             + " CREATE TABLE IF NOT EXISTS meta ("
               "key TEXT PRIMARY KEY, value);"
               " INSERT OR IGNORE INTO meta (key, value) VALUES ('size', '0');"
-            + _extra_schema_indexes();
+            + _blob_schema_sql();
+    }
+
+    // A deduplicated value file is shared by every row whose value has its
+    // content, and counts them in `refs`. The triggers drop a reference
+    // whenever a row stops pointing at the file, whichever connection or
+    // process deletes it, and forget the file with its last reference; the
+    // deleter then finds no blob for the path and removes the file as usual.
+    static std::string _blob_schema_sql()
+    {
+        static constexpr auto unref =
+            "UPDATE blobs SET refs = refs - 1 WHERE path = OLD.path;"
+            " DELETE FROM blobs WHERE path = OLD.path AND refs <= 0;";
+        return std::string(
+                   " CREATE TABLE IF NOT EXISTS blobs ("
+                   "path TEXT PRIMARY KEY NOT NULL, hash INT NOT NULL, size INT NOT NULL,"
+                   " refs INT NOT NULL) WITHOUT ROWID;"
+                   " CREATE INDEX IF NOT EXISTS idx_blobs_hash ON blobs(hash, size);"
+                   " CREATE TRIGGER IF NOT EXISTS cache_blob_unref AFTER DELETE ON cache"
+                   " WHEN OLD.path IS NOT NULL BEGIN ")
+            + unref
+            + " END;"
+              " CREATE TRIGGER IF NOT EXISTS cache_blob_repath AFTER UPDATE OF path ON cache"
+              " WHEN OLD.path IS NOT NULL AND NEW.path IS NOT OLD.path BEGIN "
+            + unref + " END;";
+    }
+
+    // A cache_values row lives as long as the row pointing at it, whichever
+    // connection or process replaces or deletes that row.
+    static std::string _value_trigger_sql()
+    {
+        return " CREATE TRIGGER IF NOT EXISTS cache_value_drop AFTER DELETE ON cache"
+               " WHEN OLD.value_id IS NOT NULL BEGIN"
+               " DELETE FROM cache_values WHERE id = OLD.value_id; END;"
+               " CREATE TRIGGER IF NOT EXISTS cache_value_repoint AFTER UPDATE OF value_id ON cache"
+               " WHEN OLD.value_id IS NOT NULL AND NEW.value_id IS NOT OLD.value_id BEGIN"
+               " DELETE FROM cache_values WHERE id = OLD.value_id; END;";
     }
 
+    // Separate from _schema_sql() so an older database gets its missing
+    // columns from _migrate_schema() before indexes and triggers reference them.
+    static std::string _index_sql() { return _extra_schema_indexes() + _value_trigger_sql(); }
+
     static inline constexpr auto _PRAGMA_SQL =
         R"(
             PRAGMA journal_mode=WAL;
             PRAGMA synchronous=NORMAL;
             PRAGMA wal_autocheckpoint=0;
-            PRAGMA cache_size=10000;
             PRAGMA temp_store=MEMORY;
-            PRAGMA mmap_size=268435456;
             PRAGMA analysis_limit=1000;
-            PRAGMA busy_timeout=600000;
             PRAGMA recursive_triggers=ON;
         )";
 
+    // No WAL, checkpoints or fsyncs: the database lives and dies with the
+    // connection.
+    static inline constexpr auto _EPHEMERAL_PRAGMA_SQL =
+        R"(
+            PRAGMA journal_mode=MEMORY;
+            PRAGMA synchronous=OFF;
+            PRAGMA temp_store=MEMORY;
+            PRAGMA recursive_triggers=ON;
+        )";
+
+    // The sizing PRAGMAs of StoreOptions each connection applies.
+    std::string _connection_pragma_sql() const
+    {
+        return "PRAGMA cache_size=-" + std::to_string(_options.page_cache_bytes / 1024)
+            + "; PRAGMA mmap_size=" + std::to_string(_options.mmap_size) + ";";
+    }
+
+    // page_size first: it only counts before the database has any content.
+    std::string _pragma_sql() const
+    {
+        return "PRAGMA page_size=" + std::to_string(_options.page_size) + ";"
+            + (_ephemeral ? _EPHEMERAL_PRAGMA_SQL : _PRAGMA_SQL) + _connection_pragma_sql()
+            + " PRAGMA busy_timeout=" + std::to_string(_options.busy_timeout.count()) + ";";
+    }
+
     void _init_db()
     {
-        auto init_stmts = { std::string(_PRAGMA_SQL), _schema_sql() };
+        auto init_stmts = { _pragma_sql(), _schema_sql() };
         for (int attempt = 0; attempt < 5; ++attempt)
         {
             try
             {
-                _db.open(this->cache_path / db_fname, init_stmts);
-                _compile_statements();
+                _db.open(_ephemeral ? std::filesystem::path(":memory:") : cache_path / db_fname,
+                         init_stmts);
+                sqlite3_wal_hook(_db.get(), &_Store::_wal_hook, this);
+                _register_key_hash(_db.get());
+                // Another process created the database first, another way.
+                if (_key_layout(_db.get()).value_or(_hashed_keys) != _hashed_keys)
+                    throw std::runtime_error("The database was created with another key layout");
                 _migrate_schema();
+                (void)_db.exec(_index_sql());
+                if (storage->durability() == Durability::sync)
+                    (void)_db.exec("PRAGMA synchronous=FULL;");
+                _compile_statements();
                 _load_counters();
                 return;
             }
@@ -332,12 +856,81 @@ class _Store : private Policies..., private _ForkAware
         }
     }
 
+    static void _register_key_hash(sqlite3* conn)
+    {
+        sqlite3_create_function_v2(conn, "sciqlop_key_hash", 1,
+                                   SQLITE_UTF8 | SQLITE_DETERMINISTIC | SQLITE_INNOCUOUS, nullptr,
+                                   &_Store::_key_hash_function, nullptr, nullptr, nullptr);
+    }
+
+    // Whether the cache table of `conn` has hashed keys; nullopt if there is
+    // no cache table (yet).
+    static std::optional<bool> _key_layout(sqlite3* conn)
+    {
+        std::optional<bool> hashed;
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(conn,
+                               "SELECT COUNT(*), COALESCE(SUM(name = 'key_text'), 0)"
+                               " FROM pragma_table_info('cache');",
+                               -1, &stmt, nullptr)
+                == SQLITE_OK
+            && sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_int(stmt, 0) > 0)
+            hashed = sqlite3_column_int(stmt, 1) > 0;
+        sqlite3_finalize(stmt);
+        return hashed;
+    }
+
+    // The statements are built with the store, before _init_db(): look up the
+    // layout of an existing database first, so that it wins over the options.
+    static bool _stored_key_layout(const std::filesystem::path& cache_path,
+                                   const StoreOptions& options)
+    {
+        auto file = cache_path / db_fname;
+        std::error_code ec;
+        if (_ephemeral || !std::filesystem::exists(file, ec))
+            return options.hashed_keys;
+        std::optional<bool> hashed;
+        sqlite3* conn = nullptr;
+        if (sqlite3_open_v2(file.string().c_str(), &conn,
+                            SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, nullptr)
+            == SQLITE_OK)
+        {
+            sqlite3_busy_timeout(conn, static_cast<int>(options.busy_timeout.count()));
+            hashed = _key_layout(conn);
+        }
+        sqlite3_close(conn);
+        return hashed.value_or(options.hashed_keys);
+    }
+
+    // Value files logged by a process that died before committing their row.
+    void _recover_interrupted_writes()
+    {
+        auto db = this->db();
+        storage->recover_intents(
+            [&](const std::filesystem::path& path, const std::string& key)
+            {
+                auto row = db->template exec<std::filesystem::path, std::size_t>(
+                    GET_PATH_SIZE_STMT, key);
+                return row && std::get<0>(*row) == path;
+            });
+    }
+
     void _load_counters()
     {
-        if (auto r = _db.exec<std::size_t>("SELECT COALESCE(SUM(size), 0) FROM cache;"))
-            _total_size.store(*r, std::memory_order_relaxed);
+        if (auto r = _db.exec<std::size_t, std::size_t>(
+                "SELECT COALESCE(SUM(size), 0), COALESCE(SUM(" + _logical_sql() + "), 0) FROM cache;"))
+        {
+            _total_size.store(std::get<0>(*r), std::memory_order_relaxed);
+            _total_logical.store(std::get<1>(*r), std::memory_order_relaxed);
+        }
         if (auto r = _db.exec<std::size_t>("SELECT COUNT(*) FROM cache;"))
             _total_count.store(*r, std::memory_order_relaxed);
+        // Seed the persisted file-byte total of a database that predates it
+        // from the rows; the trash is not accounted until check(fix) walks.
+        if (!_db.exec<std::size_t>("SELECT 1 FROM meta WHERE key = 'file_bytes';"))
+            (void)_db.exec("INSERT OR IGNORE INTO meta (key, value) SELECT 'file_bytes', "
+                           "COALESCE(SUM(" + _footprint_sql()
+                           + "), 0) FROM cache WHERE path IS NOT NULL;");
         // last_use is the monotonic access counter. Resume it above the
         // persisted maximum so entries written after a reopen are ranked
         // more-recently-used than older ones (otherwise the counter restarts
@@ -358,15 +951,64 @@ class _Store : private Policies..., private _ForkAware
                 "ALTER TABLE cache ADD COLUMN tag TEXT DEFAULT NULL;",
                 nullptr, nullptr, nullptr);
             sqlite3_exec(_db.get(),
-                "CREATE INDEX IF NOT EXISTS idx_cache_tag ON cache(tag) WHERE tag IS NOT NULL;",
+                "ALTER TABLE cache ADD COLUMN tag_gen INT NOT NULL DEFAULT 0;",
+                nullptr, nullptr, nullptr);
+            // Superseded by idx_cache_tag_gen.
+            sqlite3_exec(_db.get(), "DROP INDEX IF EXISTS idx_cache_tag;",
+                nullptr, nullptr, nullptr);
+        }
+        if constexpr (has_compression)
+        {
+            sqlite3_exec(_db.get(),
+                "ALTER TABLE cache ADD COLUMN codec INT NOT NULL DEFAULT 0;",
+                nullptr, nullptr, nullptr);
+            sqlite3_exec(_db.get(),
+                "ALTER TABLE cache ADD COLUMN logical_size INT DEFAULT NULL;",
                 nullptr, nullptr, nullptr);
         }
+        sqlite3_exec(_db.get(), "ALTER TABLE cache ADD COLUMN checksum INT DEFAULT NULL;",
+            nullptr, nullptr, nullptr);
+        sqlite3_exec(_db.get(), "ALTER TABLE cache ADD COLUMN value_id INT DEFAULT NULL;",
+            nullptr, nullptr, nullptr);
+        _migrate_value_layout();
         // Drop any triggers from previous versions (replaced by in-memory tracking)
         sqlite3_exec(_db.get(), "DROP TRIGGER IF EXISTS cache_insert_meta;", nullptr, nullptr, nullptr);
         sqlite3_exec(_db.get(), "DROP TRIGGER IF EXISTS cache_delete_meta;", nullptr, nullptr, nullptr);
         sqlite3_exec(_db.get(), "DROP TRIGGER IF EXISTS cache_update_size;", nullptr, nullptr, nullptr);
     }
 
+    // With separate_values, move the values still inline in `cache` (the
+    // database was written without it) to cache_values, in key order, in one
+    // transaction, rolled back if any step fails. meta's `separate_values`
+    // records that it was done; a store opened without the option drops it,
+    // as its inline writes stay in `cache`.
+    void _migrate_value_layout()
+    {
+        static constexpr auto marker = "SELECT 1 FROM meta WHERE key = 'separate_values';";
+        if (!_value_table)
+        {
+            if (_db.exec<std::size_t>(marker))
+                (void)_db.exec("DELETE FROM meta WHERE key = 'separate_values';");
+            return;
+        }
+        if (_db.exec<std::size_t>(marker))
+            return;
+        _NestedTxn txn(*this);
+        for (const auto* sql : {
+                 "CREATE TEMP TABLE moved_values AS SELECT key,"
+                 " (SELECT COALESCE(MAX(id), 0) FROM cache_values)"
+                 " + ROW_NUMBER() OVER (ORDER BY key) AS id FROM cache WHERE value IS NOT NULL;",
+                 "INSERT INTO cache_values (id, value)"
+                 " SELECT m.id, c.value FROM moved_values m JOIN cache c ON c.key = m.key;",
+                 "UPDATE cache SET value_id ="
+                 " (SELECT id FROM moved_values m WHERE m.key = cache.key),"
+                 " value = NULL WHERE value IS NOT NULL;",
+                 "DROP TABLE temp.moved_values;",
+                 "INSERT OR REPLACE INTO meta (key, value) VALUES ('separate_values', 1);" })
+            (void)_db.exec(sql);
+        txn.commit();
+    }
+
     // --- Fork safety (pthread_atfork hooks; see _ForkAware above) ---
 
     void _stop_checkpoint_thread()
@@ -379,6 +1021,8 @@ class _Store : private Policies..., private _ForkAware
 
     void _start_checkpoint_thread()
     {
+        if constexpr (_ephemeral)
+            return;
         _stop_checkpoint.store(false, std::memory_order_relaxed);
         _checkpoint_thread = std::thread(&_Store::_checkpoint_loop, this);
     }
@@ -391,11 +1035,13 @@ class _Store : private Policies..., private _ForkAware
     {
         _stop_checkpoint_thread();
         _mtx.lock();
+        _prefetch_mutex.lock();
     }
 
     // parent: undo prepare — release _mtx and resume checkpointing.
     void _fork_parent() override
     {
+        _prefetch_mutex.unlock();
         _mtx.unlock();
         _start_checkpoint_thread();
     }
@@ -405,166 +1051,931 @@ class _Store : private Policies..., private _ForkAware
     // reinitialise it in place (no destructor: that is undefined while locked).
     // The inherited SQLite connection is reopened on a clean slate; prepare
     // already closed the checkpoint connection, so nothing else is open here.
+    // An ephemeral store keeps its connection: the child's copy of the
+    // in-memory database is all it has, and no other process shares it.
     void _fork_child() override
     {
         new (&_mtx) std::recursive_mutex();
+        _prefetch_mutex.unlock();
+        _prefetch_queue.clear();
+        _promote_queue.clear();
         _txn_depth = 0;
         _owner_pid = _sq_getpid();
-        _finalize_statements();
-        _db.close();
-        _init_db();
+        storage->forget_pending_removals();
+        storage->forget_intent_log();
+        storage->reset_batch_io();
+        storage->forget_unsynced();
+        storage->reseed_file_names();
+        if constexpr (_ephemeral)
+        {
+            // A transaction the forking thread had open is the parent's.
+            if (!sqlite3_get_autocommit(_db.get()))
+                sqlite3_exec(_db.get(), "ROLLBACK;", nullptr, nullptr, nullptr);
+        }
+        else
+        {
+            // The parent flushes the byte delta accrued before the fork.
+            (void)storage->take_bytes_delta();
+            _finalize_statements();
+            _db.close();
+            _init_db();
+        }
         _start_checkpoint_thread();
     }
 
     // --- Background checkpoint / eviction ---
 
-    void _bg_evict([[maybe_unused]] sqlite3* bg_db)
+    // Rows deleted per _mtx acquisition, so a large eviction interleaves with
+    // foreground traffic instead of stalling it for the whole batch.
+    static constexpr std::size_t _bg_delete_chunk = 256;
+    // Queued files unlinked per background wake-up.
+    static constexpr std::size_t _removal_batch = 1024;
+
+    struct _Victim
     {
-        bool modified = false;
+        std::string key;
+        std::string path;
+        int64_t last_use;
+    };
 
-        if constexpr (has_expiration)
+    // Cold rows read under promote_on_read, consumed by _bg_tier.
+    std::vector<_Victim> _promote_queue;
+
+    // Delete the selected victims chunk by chunk, each chunk in one
+    // transaction under _mtx. `delete_sql` re-checks the row (key = ?1 AND
+    // path IS ?2 [AND last_use = ?3]) so an entry rewritten since it was
+    // selected survives. Only files whose rows were actually deleted are
+    // queued, after the lock is released.
+    void _bg_delete(sqlite3* bg_db, const char* delete_sql, const std::vector<_Victim>& victims)
+    {
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(bg_db, delete_sql, -1, &stmt, nullptr) != SQLITE_OK)
         {
-            sqlite3_stmt* stmt = nullptr;
-            sqlite3_prepare_v2(bg_db,
-                "SELECT path FROM cache WHERE expire IS NOT NULL AND expire <= unixepoch('now');",
-                -1, &stmt, nullptr);
-            std::vector<std::filesystem::path> files;
-            while (stmt && sqlite3_step(stmt) == SQLITE_ROW)
-            {
-                auto p = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-                if (p && p[0])
-                    files.emplace_back(p);
-            }
             if (stmt) sqlite3_finalize(stmt);
-            sqlite3_exec(bg_db,
-                "DELETE FROM cache WHERE expire IS NOT NULL AND expire <= unixepoch('now');",
-                nullptr, nullptr, nullptr);
-            if (sqlite3_changes(bg_db) > 0)
-                modified = true;
-            for (auto& f : files)
-                storage->remove(f);
+            return;
         }
-
-        if constexpr (has_eviction)
+        const bool guard_last_use = sqlite3_bind_parameter_count(stmt) >= 3;
+        sqlite3_stmt* blob_stmt = nullptr;
+        sqlite3_prepare_v2(bg_db, "SELECT 1 FROM blobs WHERE path = ?1;", -1, &blob_stmt, nullptr);
+        // False for a deduplicated file other rows still reference.
+        auto unreferenced = [blob_stmt](const std::string& path)
         {
-            if (max_size > 0)
+            if (!blob_stmt)
+                return true;
+            sqlite3_bind_text(blob_stmt, 1, path.c_str(), -1, SQLITE_STATIC);
+            bool shared = sqlite3_step(blob_stmt) == SQLITE_ROW;
+            sqlite3_reset(blob_stmt);
+            return !shared;
+        };
+        std::vector<std::string> files;
+        for (std::size_t begin = 0; begin < victims.size(); begin += _bg_delete_chunk)
+        {
+            auto end = std::min(victims.size(), begin + _bg_delete_chunk);
             {
-                auto current_size = _total_size.load(std::memory_order_relaxed);
-                if (current_size > max_size)
+                std::lock_guard mtx_guard(_mtx);
+                if (sqlite3_exec(bg_db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) != SQLITE_OK)
+                    break; // another process holds the write lock: retry next tick
+                for (auto i = begin; i < end; ++i)
                 {
-                    auto target = max_size * 9 / 10;
-                    sqlite3_stmt* stmt = nullptr;
-                    sqlite3_prepare_v2(bg_db, "SELECT key, path, size FROM cache ORDER BY last_use ASC;",
-                                       -1, &stmt, nullptr);
-                    struct Entry { std::string key; std::filesystem::path path; };
-                    std::vector<Entry> to_evict;
-                    while (stmt && current_size > target && sqlite3_step(stmt) == SQLITE_ROW)
-                    {
-                        auto k = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-                        auto p = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-                        auto sz = static_cast<std::size_t>(sqlite3_column_int64(stmt, 2));
-                        to_evict.push_back({ k ? k : "", p ? p : "" });
-                        current_size -= std::min(current_size, sz);
-                    }
-                    if (stmt) sqlite3_finalize(stmt);
-
-                    stmt = nullptr;
-                    sqlite3_prepare_v2(bg_db, "DELETE FROM cache WHERE key = ?;", -1, &stmt, nullptr);
-                    for (auto& [key, path] : to_evict)
-                    {
-                        if (stmt)
-                        {
-                            sqlite3_bind_text(stmt, 1, key.c_str(), -1, SQLITE_TRANSIENT);
-                            sqlite3_step(stmt);
-                            sqlite3_reset(stmt);
-                        }
-                        if (!path.empty())
-                            storage->remove(path);
-                    }
-                    if (stmt) sqlite3_finalize(stmt);
-                    if (!to_evict.empty())
-                        modified = true;
+                    const auto& v = victims[i];
+                    sqlite3_bind_text(stmt, 1, v.key.c_str(), -1, SQLITE_STATIC);
+                    if (v.path.empty())
+                        sqlite3_bind_null(stmt, 2);
+                    else
+                        sqlite3_bind_text(stmt, 2, v.path.c_str(), -1, SQLITE_STATIC);
+                    if (guard_last_use)
+                        sqlite3_bind_int64(stmt, 3, v.last_use);
+                    if (sqlite3_step(stmt) == SQLITE_DONE && sqlite3_changes(bg_db) > 0
+                        && !v.path.empty() && unreferenced(v.path))
+                        files.push_back(v.path);
+                    sqlite3_reset(stmt);
+                }
+                if (sqlite3_exec(bg_db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK)
+                {
+                    sqlite3_exec(bg_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+                    files.clear();
+                    break;
                 }
             }
+            for (const auto& f : files)
+                storage->defer_remove(f);
+            files.clear();
         }
-
-        if (modified)
-            _resync_counters(bg_db);
+        sqlite3_finalize(blob_stmt);
+        sqlite3_finalize(stmt);
     }
 
-    void _resync_counters(sqlite3* conn)
+    static std::vector<_Victim> _bg_select(sqlite3* bg_db, const char* select_sql,
+                                           std::size_t bytes_to_free = SIZE_MAX)
     {
+        std::vector<_Victim> victims;
         sqlite3_stmt* stmt = nullptr;
-        sqlite3_prepare_v2(conn,
-            "SELECT COUNT(*), COALESCE(SUM(size), 0) FROM cache;",
-            -1, &stmt, nullptr);
-        if (stmt && sqlite3_step(stmt) == SQLITE_ROW)
+        if (sqlite3_prepare_v2(bg_db, select_sql, -1, &stmt, nullptr) != SQLITE_OK)
         {
-            _total_count.store(
-                static_cast<std::size_t>(sqlite3_column_int64(stmt, 0)),
-                std::memory_order_relaxed);
-            _total_size.store(
-                static_cast<std::size_t>(sqlite3_column_int64(stmt, 1)),
-                std::memory_order_relaxed);
+            if (stmt) sqlite3_finalize(stmt);
+            return victims;
         }
-        if (stmt) sqlite3_finalize(stmt);
+        std::size_t freed = 0;
+        while (freed < bytes_to_free && sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            auto k = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            auto p = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+            freed += static_cast<std::size_t>(sqlite3_column_int64(stmt, 2));
+            victims.push_back({ k ? k : "", p ? p : "", sqlite3_column_int64(stmt, 3) });
+        }
+        sqlite3_finalize(stmt);
+        return victims;
     }
 
-    void _checkpoint_loop()
-    {
-        auto db_path = (cache_path / db_fname).string();
-        sqlite3* cp_db = nullptr;
+    static constexpr std::string_view _purge_table_prefix = "cache_purge_";
+    static constexpr std::string_view _purge_values_prefix = "cache_values_purge_";
 
-        while (!_stop_checkpoint.load(std::memory_order_relaxed))
+    // Empty the tables clear() renamed aside, one small transaction per batch
+    // within a time budget per tick, and drop each once empty (cheap by
+    // then). No _mtx: these rows are invisible to every store operation and
+    // don't take part in the counters.
+    void _bg_purge_tables(sqlite3* bg_db)
+    {
+        // (table, the column its rows are deleted by)
+        std::vector<std::pair<std::string, std::string_view>> tables;
+        for (auto [prefix, column] : { std::pair { _purge_table_prefix, std::string_view("key") },
+                                       std::pair { _purge_values_prefix, std::string_view("id") } })
         {
-            if (sqlite3_open_v2(db_path.c_str(), &cp_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX,
-                                nullptr)
-                == SQLITE_OK)
-                break;
-            if (cp_db)
+            sqlite3_stmt* stmt = nullptr;
+            auto sql = std::string("SELECT name FROM sqlite_master WHERE type = 'table' AND name LIKE '")
+                + std::string(prefix) + "%';";
+            if (sqlite3_prepare_v2(bg_db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK)
             {
-                sqlite3_close(cp_db);
-                cp_db = nullptr;
+                while (sqlite3_step(stmt) == SQLITE_ROW)
+                    tables.emplace_back(
+                        reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)), column);
             }
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            if (stmt) sqlite3_finalize(stmt);
         }
-
-        if (!cp_db)
-            return;
-
-        while (!_stop_checkpoint.load(std::memory_order_relaxed))
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+        for (const auto& [table, column] : tables)
         {
-            std::unique_lock lock(_checkpoint_mutex);
-            _checkpoint_cv.wait_for(lock, std::chrono::seconds(1));
-            if (_stop_checkpoint.load(std::memory_order_relaxed))
-                break;
-            sqlite3_wal_checkpoint_v2(cp_db, nullptr, SQLITE_CHECKPOINT_PASSIVE, nullptr, nullptr);
-            // Hold _mtx across _bg_evict + _resync_counters so we don't clobber
-            // user-thread atomic counters mid-update. Without this, sequence:
-            //   user: SQL commit (DB has +1 row, atomic still old)
-            //   bg:   _resync reads DB → stores atomic to DB-truth
-            //   user: fetch_add(1) → atomic now over-counts by 1
-            // is observable. _mtx is recursive_mutex so it's safe to take
-            // here even though main-thread paths also hold it via DbGuard.
-            std::lock_guard mtx_guard(_mtx);
-            if constexpr (has_expiration || has_eviction)
-                _bg_evict(cp_db);
-            _resync_counters(cp_db);
+            auto del = "DELETE FROM \"" + table + "\" WHERE " + std::string(column) + " IN (SELECT "
+                + std::string(column) + " FROM \"" + table + "\" LIMIT 2048);";
+            while (std::chrono::steady_clock::now() < deadline)
+            {
+                if (sqlite3_exec(bg_db, del.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK)
+                    return; // busy or already dropped by another process: next tick
+                if (sqlite3_changes(bg_db) == 0)
+                {
+                    sqlite3_exec(bg_db, ("DROP TABLE IF EXISTS \"" + table + "\";").c_str(),
+                                 nullptr, nullptr, nullptr);
+                    break;
+                }
+            }
         }
-
-        sqlite3_wal_checkpoint_v2(cp_db, nullptr, SQLITE_CHECKPOINT_PASSIVE, nullptr, nullptr);
-        sqlite3_close(cp_db);
     }
 
-    // --- DbGuard ---
-
-    struct DbGuard
+    // Delete the rows hidden by evict_tag(), a bounded batch at a time within
+    // a time budget per tick. The (tag, tag_gen) index turns each invalidated
+    // tag into a range seek over its stale rows only.
+    void _bg_collect_stale([[maybe_unused]] sqlite3* bg_db)
     {
-        Database& ref;
-        std::unique_lock<std::recursive_mutex> lock;
-        Database* operator->() { return &ref; }
-        Database& operator*() { return ref; }
-    };
+        if constexpr (has_tags)
+        {
+            static constexpr std::size_t batch = 2048;
+            auto select_sql = std::string(
+                "SELECT c.key, c.path, c.size, 0 FROM meta m JOIN cache c "
+                "ON c.tag = substr(m.key, 5) AND c.tag_gen < m.value "
+                "WHERE m.key LIKE 'gen:%' LIMIT ") + std::to_string(batch) + ";";
+            auto delete_sql = "DELETE FROM cache WHERE key = ?1 AND path IS ?2 AND "
+                + WithTags::stale() + ";";
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+            while (std::chrono::steady_clock::now() < deadline)
+            {
+                auto victims = _bg_select(bg_db, select_sql.c_str());
+                _bg_delete(bg_db, delete_sql.c_str(), victims);
+                if (victims.size() < batch)
+                    break;
+            }
+        }
+    }
+
+    // Victim selection runs on the background connection without _mtx (a WAL
+    // reader never blocks the store's writers); only the guarded row
+    // deletions take the lock, and file unlinks go through the storage's
+    // deletion queue, drained outside the lock by _checkpoint_loop.
+    void _bg_evict([[maybe_unused]] sqlite3* bg_db)
+    {
+        if constexpr (has_expiration)
+        {
+            auto victims = _bg_select(bg_db,
+                "SELECT key, path, size, 0 FROM cache "
+                "WHERE expire IS NOT NULL AND expire <= unixepoch('now');");
+            _bg_delete(bg_db,
+                "DELETE FROM cache WHERE key = ?1 AND path IS ?2 "
+                "AND expire IS NOT NULL AND expire <= unixepoch('now');",
+                victims);
+        }
+
+        if constexpr (has_eviction)
+        {
+            if (max_size > 0)
+            {
+                auto current_size = _total_size.load(std::memory_order_relaxed);
+                if (current_size > max_size)
+                {
+                    auto target = max_size * 9 / 10;
+                    auto victims = _bg_select(bg_db,
+                        "SELECT key, path, size, last_use FROM cache ORDER BY last_use ASC;",
+                        current_size - target);
+                    _bg_delete(bg_db,
+                        "DELETE FROM cache WHERE key = ?1 AND path IS ?2 AND last_use = ?3;",
+                        victims);
+                }
+            }
+        }
+    }
+
+    // Re-hash the next scrub_rows value files against their checksums and
+    // drop the rows of those that changed. Reads run on the background
+    // connection without _mtx; the deletions re-check the path.
+    void _bg_scrub(sqlite3* bg_db)
+    {
+        auto limit = _scrub_rows.load(std::memory_order_relaxed);
+        if (limit == 0)
+            return;
+        auto rows = _select_file_rows(
+            bg_db, _scrub_cursor.empty() ? std::nullopt : std::optional { _scrub_cursor }, limit);
+        _scrub_cursor = rows.size() < limit ? std::string {} : rows.back().key;
+        std::vector<_Victim> victims;
+        for (const auto& row : rows)
+        {
+            if (row.checksum != 0 && !_file_matches(row.path, row.checksum))
+            {
+                std::cerr << "Checksum mismatch for key: " << row.key << ", deleting entry."
+                          << std::endl;
+                victims.push_back({ row.key, row.path, 0 });
+            }
+        }
+        _corrupt_values.fetch_add(victims.size(), std::memory_order_relaxed);
+        _bg_delete(bg_db, "DELETE FROM cache WHERE key = ?1 AND path IS ?2;", victims);
+    }
+
+    // Rows whose value file is on the hot tier.
+    static std::string _hot_file_sql()
+    {
+        auto dir = std::string(Storage::cold_dirname);
+        return "path IS NOT NULL AND substr(path, 1, " + std::to_string(dir.size() + 1)
+            + ") NOT IN ('" + dir + "/', '" + dir + "\\')";
+    }
+
+    // Whether reads keep last_use up to date: LRU eviction and tiering rank
+    // rows by it.
+    bool _tracks_use() const
+    {
+        return max_size > 0 || _hot_bytes.load(std::memory_order_relaxed) > 0;
+    }
+
+    void _queue_promotion(const std::string& key, const std::filesystem::path& path)
+    {
+        if (!_promote_on_read.load(std::memory_order_relaxed) || !Storage::is_cold(path))
+            return;
+        std::lock_guard lk { _prefetch_mutex };
+        if (_promote_queue.size() < _max_prefetch_queue)
+            _promote_queue.push_back({ _row_key(key), path.string(), 0 });
+    }
+
+    // Move the victims' files to the other tier, a chunk at a time within a
+    // time budget. Files are copied without _mtx; each chunk's rows are then
+    // repointed in one transaction under it, guarded like _bg_delete
+    // (key = ?3 AND path = ?1 [AND last_use = ?4]) so a row rewritten, or
+    // read, since it was selected keeps its file. A deduplicated file moves
+    // with its blob while it has a single reference; otherwise the moved
+    // row gets a private copy. Whichever copy lost is removed after the
+    // lock is released. Returns the number of rows moved.
+    std::size_t _bg_move(sqlite3* bg_db, const std::vector<_Victim>& victims, bool cold,
+                         bool guard_last_use)
+    {
+        if (victims.empty())
+            return 0;
+        auto move_sql = std::string("UPDATE cache SET path = ?2 WHERE key = ?3 AND path = ?1")
+            + (guard_last_use ? " AND last_use = ?4;" : ";");
+        std::array<const char*, 4> sql { move_sql.c_str(),
+                                         "UPDATE blobs SET path = ?2 WHERE path = ?1 AND refs = 1;",
+                                         "UPDATE blobs SET path = ?1 WHERE path = ?2;",
+                                         "SELECT 1 FROM blobs WHERE path = ?1;" };
+        std::array<sqlite3_stmt*, 4> stmts {};
+        auto finalize = [&stmts]
+        {
+            for (auto* s : stmts)
+                sqlite3_finalize(s);
+        };
+        for (std::size_t i = 0; i < sql.size(); ++i)
+        {
+            if (sqlite3_prepare_v2(bg_db, sql[i], -1, &stmts[i], nullptr) != SQLITE_OK)
+            {
+                finalize();
+                return 0;
+            }
+        }
+        auto [move, move_blob, unmove_blob, is_blob] = stmts;
+        auto run = [bg_db](sqlite3_stmt* stmt, const std::string& from, const std::string& to,
+                           const _Victim* v = nullptr)
+        {
+            sqlite3_bind_text(stmt, 1, from.c_str(), -1, SQLITE_STATIC);
+            if (sqlite3_bind_parameter_count(stmt) >= 2)
+                sqlite3_bind_text(stmt, 2, to.c_str(), -1, SQLITE_STATIC);
+            if (v)
+            {
+                sqlite3_bind_text(stmt, 3, v->key.c_str(), -1, SQLITE_STATIC);
+                if (sqlite3_bind_parameter_count(stmt) >= 4)
+                    sqlite3_bind_int64(stmt, 4, v->last_use);
+            }
+            auto rc = sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+            if (sqlite3_stmt_readonly(stmt))
+                return rc == SQLITE_ROW;
+            return rc == SQLITE_DONE && sqlite3_changes(bg_db) > 0;
+        };
+
+        std::size_t moved = 0;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+        std::size_t next = 0;
+        while (next < victims.size() && std::chrono::steady_clock::now() < deadline)
+        {
+            std::vector<std::pair<const _Victim*, std::string>> copies;
+            for (; next < victims.size() && copies.size() < _bg_delete_chunk
+                 && std::chrono::steady_clock::now() < deadline;
+                 ++next)
+            {
+                if (auto to = storage->copy_to_tier(victims[next].path, cold))
+                    copies.emplace_back(&victims[next], to->string());
+            }
+            std::vector<std::string> lost;
+            std::vector<std::string> replaced;
+            {
+                std::lock_guard mtx_guard(_mtx);
+                bool began =
+                    sqlite3_exec(bg_db, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr) == SQLITE_OK;
+                for (const auto& [v, to] : copies)
+                {
+                    if (!began)
+                    {
+                        lost.push_back(to);
+                        continue;
+                    }
+                    bool blob_moved = run(move_blob, v->path, to);
+                    if (run(move, v->path, to, v))
+                    {
+                        // The row let go of a file other rows still share.
+                        if (blob_moved || !run(is_blob, v->path, {}))
+                            replaced.push_back(v->path);
+                        continue;
+                    }
+                    if (blob_moved)
+                        run(unmove_blob, v->path, to);
+                    lost.push_back(to);
+                }
+                if (began && sqlite3_exec(bg_db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK)
+                {
+                    sqlite3_exec(bg_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+                    lost.clear();
+                    for (const auto& copy : copies)
+                        lost.push_back(copy.second);
+                    replaced.clear();
+                }
+                if (!began || lost.size() == copies.size())
+                    next = victims.size(); // busy or all contended: retry next tick
+                moved += copies.size() - lost.size();
+            }
+            for (const auto& f : lost)
+                storage->remove(f);
+            for (const auto& f : replaced)
+                storage->defer_remove(f);
+        }
+        finalize();
+        return moved;
+    }
+
+    // Move file-backed values between the storage tiers (see TierPolicy):
+    // first the cold rows get() queued for promotion, then, while the hot
+    // tier holds more than hot_bytes, the least recently used hot files go
+    // cold, down to 90% of it like eviction. Shared deduplicated files stay
+    // where they are. Returns the number of rows moved. Callers hold
+    // _tier_mutex, taken before _mtx.
+    std::size_t _bg_tier(sqlite3* bg_db)
+    {
+        std::vector<_Victim> promotions;
+        {
+            std::lock_guard lk { _prefetch_mutex };
+            promotions.swap(_promote_queue);
+        }
+        if (storage->cold_path().empty())
+            return 0;
+        // One copy per file: two copies of a file share a destination.
+        std::sort(promotions.begin(), promotions.end(),
+                  [](const _Victim& a, const _Victim& b) { return a.path < b.path; });
+        promotions.erase(std::unique(promotions.begin(), promotions.end(),
+                                     [](const _Victim& a, const _Victim& b)
+                                     { return a.path == b.path; }),
+                         promotions.end());
+        auto moved = _bg_move(bg_db, promotions, false, false);
+
+        auto hot_bytes = _hot_bytes.load(std::memory_order_relaxed);
+        if (hot_bytes == 0)
+            return moved;
+        std::size_t hot = 0;
+        sqlite3_stmt* stmt = nullptr;
+        auto sum_sql = "SELECT COALESCE(SUM(size), 0) FROM cache WHERE " + _hot_file_sql() + ";";
+        if (sqlite3_prepare_v2(bg_db, sum_sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK
+            && sqlite3_step(stmt) == SQLITE_ROW)
+            hot = static_cast<std::size_t>(sqlite3_column_int64(stmt, 0));
+        sqlite3_finalize(stmt);
+        if (hot <= hot_bytes)
+            return moved;
+        auto victims = _bg_select(bg_db,
+            ("SELECT key, path, size, last_use FROM cache WHERE " + _hot_file_sql()
+             + " AND path NOT IN (SELECT path FROM blobs WHERE refs > 1)"
+               " ORDER BY last_use ASC;")
+                .c_str(),
+            hot - hot_bytes * 9 / 10);
+        return moved + _bg_move(bg_db, victims, true, true);
+    }
+
+    // SQL expression for the on-disk footprint of a file-backed row.
+    std::string _footprint_sql() const
+    {
+        auto block = std::to_string(storage->block_size());
+        return "(size + " + block + " - 1) / " + block + " * " + block;
+    }
+
+    // Fold this process's file-byte delta into the persisted total in meta.
+    // Deltas commute, so processes sharing the cache flush independently; a
+    // failed write (another process holds the lock) hands the delta back.
+    void _flush_file_bytes(sqlite3* conn)
+    {
+        auto delta = storage->take_bytes_delta();
+        if (delta == 0)
+            return;
+        sqlite3_stmt* stmt = nullptr;
+        int rc = sqlite3_prepare_v2(conn,
+            "UPDATE meta SET value = MAX(value + ?, 0) WHERE key = 'file_bytes';",
+            -1, &stmt, nullptr);
+        if (rc == SQLITE_OK)
+        {
+            sqlite3_bind_int64(stmt, 1, delta);
+            rc = sqlite3_step(stmt);
+        }
+        if (stmt) sqlite3_finalize(stmt);
+        if (rc != SQLITE_DONE)
+            storage->add_bytes_delta(delta);
+    }
+
+    // One step of ThresholdTuning. A threshold another process tuned is
+    // adopted first. Otherwise, on a side of the threshold where both paths
+    // have enough timed sets, each path costs its mean set plus, when both
+    // paths have enough timed gets there too, its mean get weighted by the
+    // gets per set seen; the other path must win by 10% to move the
+    // threshold, so noise does not make it swing.
+    void _bg_tune_threshold(sqlite3* conn)
+    {
+        if (!_tuning_enabled.load(std::memory_order_relaxed))
+            return;
+        ThresholdTuning tuning;
+        {
+            std::lock_guard mtx_guard(_mtx);
+            tuning = _options.threshold_tuning;
+        }
+        auto current = _file_size_threshold.load(std::memory_order_relaxed);
+        if (auto tuned = _read_tuned_threshold(conn, tuning); tuned && *tuned != current)
+        {
+            _file_size_threshold.store(*tuned, std::memory_order_relaxed);
+            _reset_tuning_samples();
+            return;
+        }
+
+        auto count = [this](int side, bool in, bool get)
+        { return _tuning_count[side][in][get].load(std::memory_order_relaxed); };
+        auto mean = [&](int side, bool in, bool get)
+        {
+            auto n = count(side, in, get);
+            return n ? static_cast<double>(_tuning_ns[side][in][get].load(std::memory_order_relaxed))
+                    / static_cast<double>(n)
+                     : 0.0;
+        };
+        auto ready = [&](int side, bool get)
+        { return count(side, true, get) >= tuning.min_samples
+              && count(side, false, get) >= tuning.min_samples; };
+        auto cost = [&](int side, bool in)
+        {
+            double c = mean(side, in, false);
+            if (ready(side, true))
+                c += static_cast<double>(count(side, true, true) + count(side, false, true))
+                    / static_cast<double>(count(side, true, false) + count(side, false, false))
+                    * mean(side, in, true);
+            return c;
+        };
+
+        auto next = current;
+        if (ready(0, false) && cost(0, false) * 1.1 < cost(0, true))
+            next = std::max(current / 2, tuning.min_bytes);
+        else if (ready(1, false) && cost(1, true) * 1.1 < cost(1, false))
+            next = std::min(current * 2, tuning.max_bytes);
+        else if (!ready(0, false) || !ready(1, false))
+            return;
+        if (next != current)
+        {
+            // Kept if meta cannot be written now: the samples stay for the next tick.
+            sqlite3_stmt* stmt = nullptr;
+            int rc = sqlite3_prepare_v2(conn,
+                "INSERT OR REPLACE INTO meta (key, value) VALUES (?, ?);", -1, &stmt, nullptr);
+            if (rc == SQLITE_OK)
+            {
+                sqlite3_bind_text(stmt, 1, _tuned_threshold_key.data(),
+                                  static_cast<int>(_tuned_threshold_key.size()), SQLITE_STATIC);
+                sqlite3_bind_int64(stmt, 2, static_cast<sqlite3_int64>(next));
+                rc = sqlite3_step(stmt);
+            }
+            if (stmt) sqlite3_finalize(stmt);
+            if (rc != SQLITE_DONE)
+                return;
+            _file_size_threshold.store(next, std::memory_order_relaxed);
+        }
+        _reset_tuning_samples();
+    }
+
+    // The threshold recorded in meta, if it is an integer within this
+    // store's tuning range: the key is writable through set_meta(), and a
+    // stray 0 would send every value to a file.
+    std::optional<std::size_t> _read_tuned_threshold(sqlite3* conn, const ThresholdTuning& tuning)
+    {
+        std::optional<std::size_t> tuned;
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(conn, "SELECT value FROM meta WHERE key = ?;", -1, &stmt, nullptr)
+            == SQLITE_OK)
+        {
+            sqlite3_bind_text(stmt, 1, _tuned_threshold_key.data(),
+                              static_cast<int>(_tuned_threshold_key.size()), SQLITE_STATIC);
+            if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) == SQLITE_INTEGER)
+            {
+                auto value = sqlite3_column_int64(stmt, 0);
+                if (value >= static_cast<sqlite3_int64>(tuning.min_bytes)
+                    && value <= static_cast<sqlite3_int64>(tuning.max_bytes))
+                    tuned = static_cast<std::size_t>(value);
+            }
+        }
+        if (stmt) sqlite3_finalize(stmt);
+        return tuned;
+    }
+
+    void _resync_counters(sqlite3* conn)
+    {
+        static const auto sql = "SELECT COUNT(*), COALESCE(SUM(size), 0), COALESCE(SUM("
+            + _logical_sql() + "), 0) FROM cache;";
+        sqlite3_stmt* stmt = nullptr;
+        sqlite3_prepare_v2(conn, sql.c_str(), -1, &stmt, nullptr);
+        if (stmt && sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            _total_count.store(
+                static_cast<std::size_t>(sqlite3_column_int64(stmt, 0)),
+                std::memory_order_relaxed);
+            _total_size.store(
+                static_cast<std::size_t>(sqlite3_column_int64(stmt, 1)),
+                std::memory_order_relaxed);
+            _total_logical.store(
+                static_cast<std::size_t>(sqlite3_column_int64(stmt, 2)),
+                std::memory_order_relaxed);
+        }
+        if (stmt) sqlite3_finalize(stmt);
+    }
+
+    // Called by SQLite after every commit on a connection in WAL mode, with
+    // the number of frames now in the log. Runs on the committing thread
+    // (under _mtx for user connections), so it only records and signals.
+    static int _wal_hook(void* self, sqlite3*, const char*, int pages)
+    {
+        auto* store = static_cast<_Store*>(self);
+        store->_wal_pages.store(static_cast<uint64_t>(pages), std::memory_order_relaxed);
+        if (static_cast<std::size_t>(pages)
+            >= store->_wal_passive_pages.load(std::memory_order_relaxed))
+            store->_wake_background(store->_checkpoint_requested);
+        return SQLITE_OK;
+    }
+
+    void _wake_background(std::atomic<bool>& reason)
+    {
+        if (reason.exchange(true, std::memory_order_relaxed))
+            return;
+        // Lock/unlock pairs with the wait predicate so the wake-up cannot
+        // slip in between the check and the sleep.
+        { std::lock_guard lk(_checkpoint_mutex); }
+        _checkpoint_cv.notify_one();
+    }
+
+    // Queue a file whose row deletion has committed. The unlink happens on
+    // the background thread; a backlog of a full batch wakes it early.
+    void _queue_removal(const std::filesystem::path& stored)
+    {
+        // A deduplicated file another row still references (callers hold _mtx).
+        if (_db.exec<std::size_t>(IS_BLOB_STMT, stored.string()))
+            return;
+        if (storage->defer_remove(stored) >= _removal_batch)
+            _wake_background(_drain_requested);
+    }
+
+    void _run_checkpoint(sqlite3* cp_db)
+    {
+        auto start = std::chrono::steady_clock::now();
+        int log_frames = 0;
+        int ckpt_frames = 0;
+        sqlite3_wal_checkpoint_v2(cp_db, nullptr, SQLITE_CHECKPOINT_PASSIVE,
+                                  &log_frames, &ckpt_frames);
+        if (log_frames >= 0
+            && static_cast<std::size_t>(log_frames)
+                >= _wal_truncate_pages.load(std::memory_order_relaxed))
+        {
+            // TRUNCATE invokes the busy handler while waiting for readers and
+            // writers; bound the wait so a long reader only delays truncation
+            // to the next trigger instead of stalling this thread.
+            sqlite3_busy_timeout(cp_db, 200);
+            if (sqlite3_wal_checkpoint_v2(cp_db, nullptr, SQLITE_CHECKPOINT_TRUNCATE,
+                                          &log_frames, &ckpt_frames)
+                == SQLITE_OK)
+                _truncating_checkpoints.fetch_add(1, std::memory_order_relaxed);
+            sqlite3_busy_timeout(cp_db, 0);
+        }
+        if (log_frames >= 0 && ckpt_frames >= 0)
+            _wal_pages.store(static_cast<uint64_t>(log_frames - ckpt_frames),
+                             std::memory_order_relaxed);
+
+        auto us = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count());
+        _checkpoints.fetch_add(1, std::memory_order_relaxed);
+        _last_checkpoint_us.store(us, std::memory_order_relaxed);
+        _total_checkpoint_us.fetch_add(us, std::memory_order_relaxed);
+        if (us > _max_checkpoint_us.load(std::memory_order_relaxed))
+            _max_checkpoint_us.store(us, std::memory_order_relaxed);
+    }
+
+    // Unlink one bounded batch of queued files (outside _mtx); if a backlog
+    // remains, come straight back for the next batch instead of sleeping.
+    void _drain_removal_batch()
+    {
+        storage->drain_removals(_removal_batch);
+        if (storage->pending_removals() >= _removal_batch)
+            _drain_requested.store(true, std::memory_order_relaxed);
+    }
+
+    // Unsynced group-mode files that wake the background thread for a wave
+    // ahead of the next housekeeping tick.
+    static constexpr std::size_t _group_sync_batch = 1024;
+
+    void _note_file_written()
+    {
+        if (storage->durability() == Durability::group
+            && storage->unsynced_files() >= _group_sync_batch)
+            _wake_background(_sync_requested);
+    }
+
+    // fsync the WAL through `db`'s handle on it: every commit in it becomes
+    // durable, without waiting for a checkpoint.
+    static void _sync_wal(sqlite3* db)
+    {
+        sqlite3_file* wal = nullptr;
+        if (sqlite3_file_control(db, "main", SQLITE_FCNTL_JOURNAL_POINTER, &wal) == SQLITE_OK
+            && wal && wal->pMethods)
+            (void)wal->pMethods->xSync(wal, SQLITE_SYNC_NORMAL);
+    }
+
+    // One group-durability wave: the pending value files first, then the WAL
+    // holding their rows (and the inline values committed meanwhile). Runs
+    // ahead of any checkpoint, so rows never reach the main database before
+    // their files reach the device.
+    void _group_sync(sqlite3* bg_db)
+    {
+        auto files = storage->sync_pending();
+        if (files > 0
+            || (storage->durability() == Durability::group
+                && _wal_pages.load(std::memory_order_relaxed) > 0))
+            _sync_wal(bg_db);
+    }
+
+    // Copy the whole main database of `from` over that of `to`, in one step.
+    static bool _backup(sqlite3* from, sqlite3* to)
+    {
+        auto* backup = sqlite3_backup_init(to, "main", from, "main");
+        if (!backup)
+            return false;
+        auto rc = sqlite3_backup_step(backup, -1);
+        sqlite3_backup_finish(backup);
+        return rc == SQLITE_DONE;
+    }
+
+    // Keys resolved per query by _bg_prefetch; stays under SQLite's
+    // historical 999 bound parameter limit.
+    static constexpr std::size_t _prefetch_chunk = 512;
+    static constexpr std::size_t _max_prefetch_queue = 64 * 1024;
+
+    // Resolve the queued keys on the background connection. Stepping over
+    // an inline row reads its value, which pulls its pages (overflow pages
+    // included) into the OS page cache the user connection reads from;
+    // file-backed rows are handed to the storage to be read ahead.
+    void _bg_prefetch(sqlite3* bg_db)
+    {
+        std::vector<std::string> keys;
+        {
+            std::lock_guard lk { _prefetch_mutex };
+            keys.swap(_prefetch_queue);
+        }
+        std::vector<std::string> files;
+        for (std::size_t begin = 0; begin < keys.size(); begin += _prefetch_chunk)
+        {
+            auto end = std::min(keys.size(), begin + _prefetch_chunk);
+            std::string sql = "SELECT path, " + _inline_value_sql() + " FROM cache"
+                + _value_join_sql() + " WHERE key IN (?";
+            for (auto i = begin + 1; i < end; ++i)
+                sql += ",?";
+            sql += ");";
+            sqlite3_stmt* stmt = nullptr;
+            if (sqlite3_prepare_v2(bg_db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+            {
+                if (stmt) sqlite3_finalize(stmt);
+                return;
+            }
+            for (auto i = begin; i < end; ++i)
+            {
+                auto col = static_cast<int>(i - begin + 1);
+                if (_hashed_keys)
+                    sqlite3_bind_int64(stmt, col, _key_hash(keys[i]));
+                else
+                    sqlite3_bind_text(stmt, col, keys[i].c_str(),
+                                      static_cast<int>(keys[i].size()), SQLITE_STATIC);
+            }
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                if (auto p = sqlite3_column_text(stmt, 0))
+                    files.emplace_back(reinterpret_cast<const char*>(p));
+                else
+                    (void)sqlite3_column_bytes(stmt, 1);
+            }
+            sqlite3_finalize(stmt);
+        }
+        for (const auto& f : files)
+            storage->prefetch(f);
+        _prefetched.fetch_add(keys.size(), std::memory_order_relaxed);
+    }
+
+    // Not busy_timeout: the background connection has none, its passes
+    // retry at the next tick rather than wait.
+    void _apply_connection_pragmas(sqlite3* conn)
+    {
+        std::string sql;
+        {
+            std::lock_guard mtx_guard(_mtx);
+            sql = _connection_pragma_sql();
+        }
+        sqlite3_exec(conn, sql.c_str(), nullptr, nullptr, nullptr);
+    }
+
+    void _checkpoint_loop()
+    {
+        auto db_path = (cache_path / db_fname).string();
+        sqlite3* cp_db = nullptr;
+
+        while (!_stop_checkpoint.load(std::memory_order_relaxed))
+        {
+            if (sqlite3_open_v2(db_path.c_str(), &cp_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX,
+                                nullptr)
+                == SQLITE_OK)
+                break;
+            if (cp_db)
+            {
+                sqlite3_close(cp_db);
+                cp_db = nullptr;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+
+        if (!cp_db)
+            return;
+        // A connection only notices the database is in WAL mode once it has
+        // read from it; until then checkpoints are silent no-ops.
+        sqlite3_exec(cp_db, "PRAGMA schema_version;", nullptr, nullptr, nullptr);
+        _apply_connection_pragmas(cp_db);
+        // _bg_evict commits on this connection grow the WAL too.
+        sqlite3_wal_hook(cp_db, &_Store::_wal_hook, this);
+
+        auto last_housekeeping = std::chrono::steady_clock::now();
+        auto next_housekeeping = last_housekeeping
+            + std::chrono::milliseconds(_housekeeping_ms.load(std::memory_order_relaxed));
+        while (!_stop_checkpoint.load(std::memory_order_relaxed))
+        {
+            {
+                std::unique_lock lock(_checkpoint_mutex);
+                _checkpoint_cv.wait_until(lock, next_housekeeping, [this] {
+                    return _stop_checkpoint.load(std::memory_order_relaxed)
+                        || _checkpoint_requested.load(std::memory_order_relaxed)
+                        || _drain_requested.load(std::memory_order_relaxed)
+                        || _policy_changed.load(std::memory_order_relaxed)
+                        || _prefetch_requested.load(std::memory_order_relaxed)
+                        || _sync_requested.load(std::memory_order_relaxed);
+                });
+            }
+            if (_stop_checkpoint.load(std::memory_order_relaxed))
+                break;
+            if (_policy_changed.exchange(false, std::memory_order_relaxed))
+            {
+                next_housekeeping = last_housekeeping
+                    + std::chrono::milliseconds(_housekeeping_ms.load(std::memory_order_relaxed));
+                _apply_connection_pragmas(cp_db);
+            }
+
+            // Ahead of everything else: the reads it warms up are imminent.
+            if (_prefetch_requested.exchange(false, std::memory_order_relaxed))
+                _bg_prefetch(cp_db);
+
+            auto now = std::chrono::steady_clock::now();
+            bool housekeeping_due = now >= next_housekeeping;
+            bool requested = _checkpoint_requested.exchange(false, std::memory_order_relaxed);
+            bool drain = _drain_requested.exchange(false, std::memory_order_relaxed);
+            if (_sync_requested.exchange(false, std::memory_order_relaxed) || requested
+                || housekeeping_due)
+                _group_sync(cp_db);
+            if (requested || (housekeeping_due && _wal_pages.load(std::memory_order_relaxed) > 0))
+                _run_checkpoint(cp_db);
+            if (drain && !housekeeping_due)
+                _drain_removal_batch();
+            if (!housekeeping_due)
+                continue;
+            last_housekeeping = now;
+            next_housekeeping = now
+                + std::chrono::milliseconds(_housekeeping_ms.load(std::memory_order_relaxed));
+            _housekeep(cp_db);
+        }
+
+        sqlite3_wal_checkpoint_v2(cp_db, nullptr, SQLITE_CHECKPOINT_PASSIVE, nullptr, nullptr);
+        sqlite3_close(cp_db);
+    }
+
+    // One housekeeping tick on `conn`: the background connection, or for an
+    // ephemeral store its only one, with _mtx held throughout.
+    void _housekeep(sqlite3* conn)
+    {
+        if constexpr (has_expiration || has_eviction)
+            _bg_evict(conn);
+        _bg_collect_stale(conn);
+        _bg_purge_tables(conn);
+        if constexpr (has_eviction && !_ephemeral)
+        {
+            std::lock_guard tier_guard(_tier_mutex);
+            _bg_tier(conn);
+        }
+        _bg_scrub(conn);
+        _bg_tune_threshold(conn);
+        {
+            // Hold _mtx across _resync_counters so we don't clobber
+            // user-thread atomic counters mid-update. Without this, sequence:
+            //   user: SQL commit (DB has +1 row, atomic still old)
+            //   bg:   _resync reads DB → stores atomic to DB-truth
+            //   user: fetch_add(1) → atomic now over-counts by 1
+            // is observable. _mtx is recursive_mutex so it's safe to take
+            // here even though main-thread paths also hold it via DbGuard.
+            std::lock_guard mtx_guard(_mtx);
+            _resync_counters(conn);
+            _flush_file_bytes(conn);
+        }
+        _drain_removal_batch();
+    }
+
+    // An ephemeral store's stand-in for the background thread, called by
+    // the writers before they take _mtx: a housekeeping tick once the
+    // interval has passed, or as soon as the store outgrew max_size. Skipped
+    // inside a transaction, whose writes it would otherwise commit.
+    void _housekeep_if_due()
+    {
+        if constexpr (_ephemeral)
+        {
+            auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+            bool over_size = false;
+            if constexpr (has_eviction)
+                over_size = max_size > 0 && _total_size.load(std::memory_order_relaxed) > max_size;
+            if (!over_size && now < _next_inline_housekeeping_ms.load(std::memory_order_relaxed))
+                return;
+            std::lock_guard mtx_guard(_mtx);
+            if (_txn_depth > 0)
+                return;
+            _next_inline_housekeeping_ms.store(
+                now + _housekeeping_ms.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            _housekeep(_db.get());
+        }
+    }
+
+    // --- DbGuard ---
+
+    struct DbGuard
+    {
+        Database& ref;
+        std::unique_lock<std::recursive_mutex> lock;
+        Database* operator->() { return &ref; }
+        Database& operator*() { return ref; }
+    };
 
     DbGuard db() const { return { _db, std::unique_lock(_mtx) }; }
 
@@ -589,58 +2000,114 @@ class _Store : private Policies..., private _ForkAware
         }
         _NestedTxn(const _NestedTxn&) = delete;
         _NestedTxn& operator=(const _NestedTxn&) = delete;
-        ~_NestedTxn()
-        {
-            if (!finished)
-            {
-                if (store._txn_depth > 0) --store._txn_depth;
-                // ~Transaction will rollback if not committed.
-            }
-        }
+        ~_NestedTxn() { rollback(); }
+        // The outermost level also settles the value files written inside
+        // the transaction with the storage's intent log; a failed COMMIT
+        // rolls back and drops them, as their rows are gone.
         void commit()
         {
             if (finished) return;
             finished = true;
             if (store._txn_depth > 0) --store._txn_depth;
-            if (outermost && txn) txn->commit();
+            if (outermost && txn)
+            {
+                try
+                {
+                    txn->commit();
+                }
+                catch (...)
+                {
+                    (void)txn->rollback();
+                    store.storage->abort_intents();
+                    throw;
+                }
+                store.storage->commit_intents();
+            }
         }
         void rollback() noexcept
         {
             if (finished) return;
             finished = true;
             if (store._txn_depth > 0) --store._txn_depth;
-            if (outermost && txn) (void)txn->rollback();
+            if (outermost && txn)
+            {
+                (void)txn->rollback();
+                store.storage->abort_intents();
+            }
         }
     };
 
 public:
-    // Snapshot iterator: pulls all keys into memory under the store mutex at
-    // construction, then iterates lock-free. Trade-off: O(N) memory at start,
-    // but no lock contention for other threads while the user iterates.
-    // Snapshot semantics: keys added after iter starts are not seen — same as
-    // calling keys() then iterating the returned vector.
+    // Streams the keys, optionally only those starting with a prefix, a page
+    // at a time in primary key order: each page is one range query resuming
+    // after the last row of the previous one (keyset pagination), run under
+    // the store mutex, which is free again while the page is consumed.
+    // Memory stays at one page whatever the size of the store. A key is seen
+    // at most once; keys written or deleted ahead of the cursor while it runs
+    // are seen or skipped accordingly. With hashed keys the pages follow the
+    // hashes and the prefix filters each page instead of bounding the range.
     class KeyCursor
     {
-        std::vector<std::string> _keys;
+        _Store* _store;
+        std::string _prefix;
+        std::optional<std::string> _prefix_end;
+        std::size_t _page_size;
+        std::optional<std::string> _last;
+        std::vector<std::string> _page;
         std::size_t _pos = 0;
+        bool _done = false;
 
-    public:
-        KeyCursor(std::recursive_mutex& mtx, sqlite3* db, const std::string& sql)
+        void _fetch_page()
         {
-            std::lock_guard lk { mtx };
+            _page.clear();
+            _pos = 0;
+            auto user_key = _store->_user_key_sql();
+            auto sql = "SELECT " + user_key + " FROM cache WHERE 1=1" + _Store::_where_valid()
+                + (_last ? " AND key > ?1" : "")
+                + (_prefix.empty() ? "" : " AND " + user_key + " >= ?2")
+                + (_prefix_end ? " AND " + user_key + " < ?3" : "") + " ORDER BY key LIMIT ?4;";
+            auto g = _store->db();
             sqlite3_stmt* stmt = nullptr;
-            if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+            if (sqlite3_prepare_v2(g->get(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
             {
-                std::string err = sqlite3_errmsg(db);
+                std::string err = sqlite3_errmsg(g->get());
                 if (stmt) sqlite3_finalize(stmt);
                 throw std::runtime_error("Failed to prepare key iterator: " + err);
             }
+            if (_last && _store->_hashed_keys)
+                sqlite3_bind_int64(stmt, 1, _Store::_key_hash(*_last));
+            else if (_last)
+                sqlite3_bind_text(stmt, 1, _last->data(), static_cast<int>(_last->size()),
+                                  SQLITE_STATIC);
+            if (!_prefix.empty())
+                sqlite3_bind_text(stmt, 2, _prefix.data(), static_cast<int>(_prefix.size()),
+                                  SQLITE_STATIC);
+            if (_prefix_end)
+                sqlite3_bind_text(stmt, 3, _prefix_end->data(),
+                                  static_cast<int>(_prefix_end->size()), SQLITE_STATIC);
+            sqlite3_bind_int64(stmt, 4, static_cast<sqlite3_int64>(_page_size));
             while (sqlite3_step(stmt) == SQLITE_ROW)
             {
                 auto v = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-                _keys.emplace_back(v ? v : "");
+                _page.emplace_back(v ? v : "",
+                                   static_cast<std::size_t>(sqlite3_column_bytes(stmt, 0)));
             }
             sqlite3_finalize(stmt);
+            _done = _page.size() < _page_size;
+            if (!_page.empty())
+                _last = _page.back();
+        }
+
+    public:
+        static constexpr std::size_t default_page_size = 1024;
+
+        explicit KeyCursor(_Store& store, std::string prefix = {},
+                           std::size_t page_size = default_page_size)
+                : _store(&store)
+                , _prefix(std::move(prefix))
+                , _prefix_end(_prefix_upper_bound(_prefix))
+                , _page_size(std::max<std::size_t>(page_size, 1))
+        {
         }
 
         KeyCursor(const KeyCursor&) = delete;
@@ -649,11 +2116,22 @@ public:
 
         std::optional<std::string> next()
         {
-            if (_pos >= _keys.size()) return std::nullopt;
-            return std::move(_keys[_pos++]);
+            if (_pos >= _page.size())
+            {
+                if (_done)
+                    return std::nullopt;
+                _fetch_page();
+                if (_page.empty())
+                    return std::nullopt;
+            }
+            return std::move(_page[_pos++]);
         }
     };
 
+    // The entries of a KeyCursor, read a page of keys at a time with
+    // get_many(); see ItemCursor.
+    using ItemCursor = _ItemCursor<_Store>;
+
     // User-facing transaction guard. Reentrant: nested same-thread
     // begin_user_transaction() is allowed (depth-counted); only the
     // outermost level issues a real SQLite BEGIN/COMMIT. Inner commit()
@@ -703,17 +2181,40 @@ public:
             _finished = true;
             if (_store._txn_depth > 0) --_store._txn_depth;
             if (_outermost && _txn)
-                return _txn->commit();
+            {
+                bool committed = false;
+                try
+                {
+                    committed = _txn->commit();
+                }
+                catch (...)
+                {
+                    (void)_txn->rollback();
+                    _store.storage->abort_intents();
+                    throw;
+                }
+                if (committed)
+                    _store.storage->commit_intents();
+                else
+                    _store.storage->abort_intents();
+                return committed;
+            }
             return true;
         }
 
+        // Files written by set()/add() inside a rolled-back transaction have
+        // no row: the intent log removes them.
         bool rollback()
         {
             if (_finished) return false;
             _finished = true;
             if (_store._txn_depth > 0) --_store._txn_depth;
             if (_outermost && _txn)
-                return _txn->rollback();
+            {
+                bool rolled_back = _txn->rollback();
+                _store.storage->abort_intents();
+                return rolled_back;
+            }
             return true;
         }
     };
@@ -722,134 +2223,645 @@ private:
 
     // --- Bind helpers for policy-aware INSERT/REPLACE ---
 
-    void _bind_core_and_policies(sqlite3_stmt* stmt, const std::string& col1,
-                                 const Bytes auto& col2, std::size_t sz,
-                                 [[maybe_unused]] std::optional<double> abs_exp,
-                                 [[maybe_unused]] std::size_t seq,
-                                 [[maybe_unused]] const std::optional<std::string>& tag) const
-    {
-        int i = 1;
-        sql_bind(stmt, i++, col1);
-        sql_bind(stmt, i++, col2);
-        sql_bind(stmt, i++, sz);
-        if constexpr (has_expiration) sql_bind(stmt, i++, abs_exp);
-        if constexpr (has_eviction) sql_bind(stmt, i++, seq);
-        if constexpr (has_tags) sql_bind(stmt, i++, tag);
+    // How a stored value is encoded; codec 0 means as-is.
+    struct _Encoding
+    {
+        uint8_t codec = 0;
+        std::size_t logical_size = 0;
+    };
+
+    // The cache_values row an inline value was written to (see
+    // StoreOptions::separate_values).
+    struct _ValueId
+    {
+        sqlite3_int64 id;
+    };
+
+    // Returns the index of the next parameter (the checksum of a path row).
+    int _bind_core_and_policies(sqlite3_stmt* stmt, const std::string& col1,
+                                 const Bytes auto& col2, std::size_t sz,
+                                 std::optional<double> abs_exp, std::size_t seq,
+                                 const std::optional<std::string>& tag, _Encoding enc = {}) const
+    {
+        sql_bind(stmt, 1, col1);
+        sql_bind(stmt, 2, col2);
+        sql_bind(stmt, 3, sz);
+        return _bind_policies(stmt, 4, abs_exp, seq, tag, enc);
+    }
+
+    int _bind_core_and_policies(sqlite3_stmt* stmt, const std::string& col1,
+                                 const std::string& col2, std::size_t sz,
+                                 std::optional<double> abs_exp, std::size_t seq,
+                                 const std::optional<std::string>& tag, _Encoding enc = {}) const
+    {
+        sql_bind(stmt, 1, col1);
+        sql_bind(stmt, 2, col2);
+        sql_bind(stmt, 3, sz);
+        return _bind_policies(stmt, 4, abs_exp, seq, tag, enc);
+    }
+
+    int _bind_core_and_policies(sqlite3_stmt* stmt, const std::string& col1, _ValueId col2,
+                                 std::size_t sz, std::optional<double> abs_exp, std::size_t seq,
+                                 const std::optional<std::string>& tag, _Encoding enc = {}) const
+    {
+        sql_bind(stmt, 1, col1);
+        sqlite3_bind_int64(stmt, 2, col2.id);
+        sql_bind(stmt, 3, sz);
+        return _bind_policies(stmt, 4, abs_exp, seq, tag, enc);
+    }
+
+    // Binds an inline row of REPLACE_VALUE_STMT or INSERT_VALUE_STMT. With
+    // separate_values its value is written to cache_values first, and the
+    // caller's transaction must cover both writes.
+    int _bind_inline_row(DbGuard& db, sqlite3_stmt* stmt, const std::string& key,
+                         const Bytes auto& value, std::size_t sz, std::optional<double> abs_exp,
+                         std::size_t seq, const std::optional<std::string>& tag,
+                         _Encoding enc = {})
+    {
+        if (auto id = _insert_value_row(db, value))
+            return _bind_core_and_policies(stmt, key, *id, sz, abs_exp, seq, tag, enc);
+        return _bind_core_and_policies(stmt, key, value, sz, abs_exp, seq, tag, enc);
+    }
+
+    std::optional<_ValueId> _insert_value_row(DbGuard& db, const Bytes auto& value)
+    {
+        if (!_value_table)
+            return std::nullopt;
+        {
+            auto binded = INSERT_VALUE_ROW_STMT.bind_all();
+            sql_bind(binded.get(), 1, value);
+            sqlite3_step(binded.get());
+        }
+        return _ValueId { sqlite3_last_insert_rowid(db->get()) };
+    }
+
+    int _bind_policies(sqlite3_stmt* stmt, int i, [[maybe_unused]] std::optional<double> abs_exp,
+                       [[maybe_unused]] std::size_t seq,
+                       [[maybe_unused]] const std::optional<std::string>& tag,
+                       [[maybe_unused]] _Encoding enc) const
+    {
+        if constexpr (has_expiration) sql_bind(stmt, i++, abs_exp);
+        if constexpr (has_eviction) sql_bind(stmt, i++, seq);
+        if constexpr (has_tags)
+        {
+            sql_bind(stmt, i++, tag);
+            sql_bind(stmt, i++, tag);
+        }
+        if constexpr (has_compression)
+        {
+            sql_bind(stmt, i++, std::size_t { enc.codec });
+            if (enc.codec)
+                sql_bind(stmt, i++, enc.logical_size);
+            else
+                sqlite3_bind_null(stmt, i++);
+        }
+        return i;
+    }
+
+    static void _bind_checksum(sqlite3_stmt* stmt, int i, std::optional<uint64_t> checksum)
+    {
+        if (checksum)
+            sql_bind(stmt, i, static_cast<std::size_t>(*checksum));
+        else
+            sqlite3_bind_null(stmt, i);
+    }
+
+    // --- set/add implementation ---
+
+    inline bool _set_impl(const std::string& key, const Bytes auto& value,
+                           [[maybe_unused]] std::optional<double> expires_secs,
+                           [[maybe_unused]] std::optional<std::string> tag = std::nullopt,
+                           _Encoding enc = {})
+    {
+        // Encoded before taking the lock: compression is the costly part.
+        if constexpr (has_compression)
+        {
+            if (auto packed = _encode(value, enc))
+                return _set_impl(key, *packed, expires_secs, std::move(tag), enc);
+        }
+        std::span<const char> bytes(std::data(value), std::size(value));
+        auto tuning_side = _tuning_side(bytes.size());
+        const bool inline_value = _stores_inline(bytes.size(), tuning_side.has_value());
+        std::optional<uint64_t> checksum;
+        if (!inline_value)
+            checksum = xxh3_64(bytes);
+        auto content_hash = _dedup_hash(bytes, checksum);
+        _housekeep_if_due();
+        auto db = this->db();
+        std::chrono::steady_clock::time_point start;
+        if (tuning_side)
+            start = std::chrono::steady_clock::now();
+        std::size_t seq = 0;
+        if constexpr (has_eviction)
+            seq = WithEviction::_access_seq.fetch_add(1, std::memory_order_relaxed);
+
+        std::optional<double> abs_exp;
+        if constexpr (has_expiration)
+            abs_exp = _abs_expire(expires_secs);
+
+        auto new_size = std::size(value);
+        auto new_logical = enc.codec ? enc.logical_size : new_size;
+
+        // BEGIN EXCLUSIVE here covers BOTH branches: the SELECT of the old
+        // entry and the REPLACE must see the same DB state. Without it a
+        // concurrent process can swap the entry between our SELECT and our
+        // REPLACE — we'd then `storage->remove(old_filepath_we_read)` while
+        // the file actually attached to the row now is the *other* process's
+        // path, which we leak. (See test_no_orphans_after_concurrent_mixed_size_set.)
+        _NestedTxn txn(*this);
+
+        // Single query to get old path and sizes (saves a round-trip vs separate queries)
+        auto old_entry = db->template exec<std::filesystem::path, std::size_t, std::size_t>(
+            GET_PATH_SIZE_STMT, key);
+        std::optional<_Sizes> old_sizes;
+        std::filesystem::path old_filepath;
+        if (old_entry)
+        {
+            old_filepath = std::get<0>(*old_entry);
+            old_sizes = _Sizes { std::get<1>(*old_entry), std::get<2>(*old_entry) };
+        }
+
+        if (inline_value)
+        {
+            auto binded = REPLACE_VALUE_STMT.bind_all();
+            _bind_inline_row(db, binded.get(), key, value, new_size, abs_exp, seq, tag, enc);
+            sqlite3_step(binded.get());
+            txn.commit();
+            _update_counters_after_set(old_sizes, { new_size, new_logical });
+            if (!old_filepath.empty())
+                _queue_removal(old_filepath);
+            _record_latency(tuning_side, true, false, start);
+            return true;
+        }
+
+        auto new_file = _store_file(db, value, key, content_hash);
+        if (!new_file)
+        {
+            txn.rollback();
+            return false;
+        }
+        {
+            auto path_str = new_file->path.string();
+            auto binded = REPLACE_PATH_STMT.bind_all();
+            _bind_checksum(binded.get(),
+                           _bind_core_and_policies(binded.get(), key, path_str, new_size,
+                                                   abs_exp, seq, tag, enc),
+                           checksum);
+            sqlite3_step(binded.get());
+        }
+        try
+        {
+            txn.commit();
+        }
+        catch (const std::runtime_error&)
+        {
+            txn.rollback();
+            if (!new_file->shared)
+                storage->remove(new_file->path);
+            throw;
+        }
+        if (!old_filepath.empty())
+            _queue_removal(old_filepath);
+        _update_counters_after_set(old_sizes, { new_size, new_logical });
+        _record_latency(tuning_side, false, false, start);
+        return true;
+    }
+
+    // A row whose value file cannot be loaded is dropped. Path-aware:
+    // without the `AND path = ?`, a concurrent process that swapped the
+    // entry between our SELECT and this fallback would have its file removed
+    // (a bare del() re-reads the row, finds the new path, removes the wrong
+    // file). The DELETE only fires if the row still references the path we
+    // just failed to load.
+    void _drop_unloadable(DbGuard& db, const std::string& key, const std::filesystem::path& path)
+    {
+        _delete_file_row(db, _row_key(key), path);
+        std::cerr << "Error loading file for key: " << key << ", deleting entry." << std::endl;
+    }
+
+    // Same for a value that failed its checksum; its file goes too, unless
+    // deduplicated rows still reference it.
+    void _drop_corrupt(DbGuard& db, const std::string& key, const std::filesystem::path& path)
+    {
+        _corrupt_values.fetch_add(1, std::memory_order_relaxed);
+        if (_delete_file_row(db, _row_key(key), path))
+            _queue_removal(path);
+        std::cerr << "Checksum mismatch for key: " << key << ", deleting entry." << std::endl;
+    }
+
+    // Rows deleted per transaction by del_prefix() and del_glob().
+    static constexpr std::size_t _del_batch = 1024;
+
+    // Delete the rows whose key starts with `prefix` and, if given, matches
+    // `glob`: a batch at a time in key order, each batch one exclusive
+    // transaction with one aggregate query for the counters and one DELETE.
+    // Returns the number of rows a reader could still see: expired and
+    // invalidated ones go too, but only come off the counters.
+    // Batches follow each other by keyset on the primary key, each statement
+    // bounded by (last key of the previous batch, last key of this one]:
+    // with hashed keys the prefix only filters key_text, and restarting from
+    // the first hash would rescan the deleted range at every batch. The
+    // store lock is free between batches.
+    std::size_t _del_matching(const std::string& prefix, const std::optional<std::string>& glob)
+    {
+        auto user_key = _user_key_sql();
+        std::vector<std::string> params;
+        std::string from_prefix, to_prefix, matching;
+        auto add = [&](const char* clause, std::string value, std::string& sql)
+        {
+            params.push_back(std::move(value));
+            sql += " AND " + user_key + clause + std::to_string(params.size());
+        };
+        if (!prefix.empty())
+            add(" >= ?", prefix, from_prefix);
+        if (auto upper = _prefix_upper_bound(prefix))
+            add(" < ?", std::move(*upper), to_prefix);
+        if (glob)
+            add(" GLOB ?", *glob, matching);
+        using OwnedValue = std::unique_ptr<sqlite3_value, decltype(&sqlite3_value_free)>;
+        OwnedValue last { nullptr, &sqlite3_value_free };
+        OwnedValue bound { nullptr, &sqlite3_value_free };
+        auto last_param = static_cast<int>(params.size() + 1);
+        auto bound_param = last_param + 1;
+        // Plain keys are bounded by the batch alone once it is known: left
+        // next to its bounds, the prefix's may be the ones the planner seeks
+        // between.
+        auto after_last = [&]
+        {
+            if (!last)
+                return from_prefix;
+            return " AND key > ?" + std::to_string(last_param)
+                + (_hashed_keys ? from_prefix : std::string {});
+        };
+        auto prepare = [&](DbGuard& db, const std::string& sql)
+        {
+            sqlite3_stmt* stmt = nullptr;
+            if (sqlite3_prepare_v2(db->get(), sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+            {
+                sqlite3_finalize(stmt);
+                throw std::runtime_error(std::string("Failed to prepare bulk delete: ")
+                                         + sqlite3_errmsg(db->get()));
+            }
+            for (std::size_t i = 0; i < params.size(); ++i)
+                sqlite3_bind_text(stmt, static_cast<int>(i + 1), params[i].data(),
+                                  static_cast<int>(params[i].size()), SQLITE_STATIC);
+            if (last)
+                sqlite3_bind_value(stmt, last_param, last.get());
+            if (bound && sqlite3_bind_parameter_count(stmt) >= bound_param)
+                sqlite3_bind_value(stmt, bound_param, bound.get());
+            return std::unique_ptr<sqlite3_stmt, decltype(&sqlite3_finalize)>(stmt,
+                                                                             &sqlite3_finalize);
+        };
+
+        std::size_t deleted = 0;
+        for (;;)
+        {
+            auto db = this->db();
+            _NestedTxn txn(*this);
+            bound.reset();
+            {
+                auto end = prepare(db, "SELECT MAX(key) FROM (SELECT key FROM cache WHERE 1=1"
+                                           + after_last() + to_prefix + matching
+                                           + " ORDER BY key LIMIT "
+                                           + std::to_string(_del_batch) + ");");
+                if (sqlite3_step(end.get()) == SQLITE_ROW
+                    && sqlite3_column_type(end.get(), 0) != SQLITE_NULL)
+                    bound.reset(sqlite3_value_dup(sqlite3_column_value(end.get(), 0)));
+            }
+            if (!bound)
+                break;
+            auto batch = " WHERE 1=1" + after_last() + " AND key <= ?" + std::to_string(bound_param)
+                + (_hashed_keys ? to_prefix : std::string {}) + matching;
+            std::size_t count = 0;
+            std::size_t visible = 0;
+            _Sizes sizes { 0, 0 };
+            {
+                auto totals = prepare(db, "SELECT COUNT(*), COALESCE(SUM(size), 0), COALESCE(SUM("
+                                              + _logical_sql()
+                                              + "), 0), COALESCE(SUM(CASE WHEN 1=1"
+                                              + _where_valid() + " THEN 1 ELSE 0 END), 0) FROM cache"
+                                              + batch + ";");
+                if (sqlite3_step(totals.get()) == SQLITE_ROW)
+                {
+                    count = static_cast<std::size_t>(sqlite3_column_int64(totals.get(), 0));
+                    sizes.stored = static_cast<std::size_t>(sqlite3_column_int64(totals.get(), 1));
+                    sizes.logical = static_cast<std::size_t>(sqlite3_column_int64(totals.get(), 2));
+                    visible = static_cast<std::size_t>(sqlite3_column_int64(totals.get(), 3));
+                }
+            }
+            std::vector<std::filesystem::path> files;
+            {
+                auto paths = prepare(db, "SELECT DISTINCT path FROM cache" + batch
+                                             + " AND path IS NOT NULL;");
+                while (sqlite3_step(paths.get()) == SQLITE_ROW)
+                    files.emplace_back(
+                        reinterpret_cast<const char*>(sqlite3_column_text(paths.get(), 0)));
+            }
+            {
+                auto del = prepare(db, "DELETE FROM cache" + batch + ";");
+                if (sqlite3_step(del.get()) != SQLITE_DONE)
+                    throw std::runtime_error(std::string("Bulk delete failed: ")
+                                             + sqlite3_errmsg(db->get()));
+            }
+            txn.commit();
+            last = std::move(bound);
+            // Once the rows are gone, so shared files lose their references first.
+            for (const auto& f : files)
+                _queue_removal(f);
+            _remove_from_counters(sizes, count);
+            deleted += visible;
+        }
+        return deleted;
+    }
+
+    // `key` as the row stores it (see _row_key()).
+    bool _delete_file_row(DbGuard& db, const std::string& key, const std::filesystem::path& path)
+    {
+        auto path_str = path.string();
+        auto sizes = db->template exec<std::size_t, std::size_t>(
+            "SELECT size, " + _logical_sql() + " FROM cache WHERE key = ? AND path = ?;", key,
+            path_str);
+        db->exec("DELETE FROM cache WHERE key = ? AND path = ?;", key, path_str);
+        if (sqlite3_changes(db->get()) == 0 || !sizes)
+            return false;
+        _remove_from_counters({ std::get<0>(*sizes), std::get<1>(*sizes) });
+        return true;
+    }
+
+    // Whether this read hashes the value it loaded (see VerifyPolicy).
+    bool _sampled_for_verify()
+    {
+        switch (_verify_mode.load(std::memory_order_relaxed))
+        {
+            case VerifyMode::always:
+                return true;
+            case VerifyMode::sample:
+            {
+                // Exactly ppm reads per million, evenly spread.
+                constexpr uint64_t million = 1'000'000;
+                auto ppm = _verify_ppm.load(std::memory_order_relaxed);
+                auto seq = _verify_seq.fetch_add(1, std::memory_order_relaxed) % million;
+                return seq * ppm % million < ppm;
+            }
+            default:
+                return false;
+        }
+    }
+
+    // Check a loaded file-backed value against its row's checksum (0: the
+    // row has none) and drop the row if they disagree. Called without _mtx:
+    // the hash is the costly part.
+    bool _verify_read(const std::string& key, const std::filesystem::path& path,
+                      const Buffer& stored, std::size_t checksum)
+    {
+        if (checksum == 0 || !_sampled_for_verify())
+            return true;
+        if (xxh3_64(std::span<const char>(stored.data(), stored.size())) == checksum)
+            return true;
+        auto db = this->db();
+        _drop_corrupt(db, key, path);
+        return false;
+    }
+
+    // Whether a value file still holds the bytes its row was written with.
+    // Mapped directly rather than through storage->load(), so sweeps over
+    // the whole cache leave the mmap handle cache alone.
+    bool _file_matches(const std::string& path, std::size_t checksum) const
+    {
+        auto file = storage->map(path);
+        return file && *file
+            && xxh3_64(std::span<const char>(file->data(), file->size())) == checksum;
+    }
+
+    // Stored and decoded size of a row.
+    struct _Sizes
+    {
+        std::size_t stored;
+        std::size_t logical;
+    };
+
+    static void _adjust(std::atomic<std::size_t>& total, std::size_t old_value,
+                        std::size_t new_value)
+    {
+        if (new_value >= old_value)
+            total.fetch_add(new_value - old_value, std::memory_order_relaxed);
+        else
+            total.fetch_sub(old_value - new_value, std::memory_order_relaxed);
+    }
+
+    void _update_counters_after_set(const std::optional<_Sizes>& old_sizes, _Sizes new_sizes)
+    {
+        if (old_sizes)
+        {
+            _adjust(_total_size, old_sizes->stored, new_sizes.stored);
+            _adjust(_total_logical, old_sizes->logical, new_sizes.logical);
+        }
+        else
+        {
+            _add_to_counters(new_sizes);
+        }
+    }
+
+    void _add_to_counters(_Sizes sizes, std::size_t count = 1)
+    {
+        _total_size.fetch_add(sizes.stored, std::memory_order_relaxed);
+        _total_logical.fetch_add(sizes.logical, std::memory_order_relaxed);
+        _total_count.fetch_add(count, std::memory_order_relaxed);
     }
 
-    void _bind_core_and_policies(sqlite3_stmt* stmt, const std::string& col1,
-                                 const std::string& col2, std::size_t sz,
-                                 [[maybe_unused]] std::optional<double> abs_exp,
-                                 [[maybe_unused]] std::size_t seq,
-                                 [[maybe_unused]] const std::optional<std::string>& tag) const
-    {
-        int i = 1;
-        sql_bind(stmt, i++, col1);
-        sql_bind(stmt, i++, col2);
-        sql_bind(stmt, i++, sz);
-        if constexpr (has_expiration) sql_bind(stmt, i++, abs_exp);
-        if constexpr (has_eviction) sql_bind(stmt, i++, seq);
-        if constexpr (has_tags) sql_bind(stmt, i++, tag);
+    void _remove_from_counters(_Sizes sizes, std::size_t count = 1)
+    {
+        _total_size.fetch_sub(sizes.stored, std::memory_order_relaxed);
+        _total_logical.fetch_sub(sizes.logical, std::memory_order_relaxed);
+        _total_count.fetch_sub(count, std::memory_order_relaxed);
     }
 
-    // --- set/add implementation ---
+    // The policy's compressed form of `value`, if it selects a codec, the
+    // value is large enough and the codec shrinks it enough.
+    std::optional<std::vector<char>> _encode(const Bytes auto& value, _Encoding& enc) const
+        requires (has_compression)
+    {
+        auto id = WithCompression::_codec.load(std::memory_order_relaxed);
+        if (id == 0 || enc.codec != 0
+            || std::size(value) < WithCompression::_min_compressed_size.load(std::memory_order_relaxed))
+            return std::nullopt;
+        auto* codec = CodecRegistry::instance().find(id);
+        if (!codec)
+            return std::nullopt;
+        auto packed = compress_value(*codec,
+            std::span<const char>(std::data(value), std::size(value)),
+            WithCompression::_max_compression_ratio.load(std::memory_order_relaxed));
+        if (packed)
+            enc = { id, std::size(value) };
+        return packed;
+    }
 
-    inline bool _set_impl(const std::string& key, const Bytes auto& value,
-                           [[maybe_unused]] std::optional<double> expires_secs,
-                           [[maybe_unused]] std::optional<std::string> tag = std::nullopt)
+    // Undo _encode(). A value this build cannot decode (unknown codec,
+    // corrupt data) reads as a miss but is left in place: another process
+    // may have the codec.
+    static std::optional<Buffer> _decode(Buffer&& stored, std::size_t codec,
+                                         std::size_t logical_size, const std::string& key)
     {
-        auto db = this->db();
-        std::size_t seq = 0;
-        if constexpr (has_eviction)
-            seq = WithEviction::_access_seq.fetch_add(1, std::memory_order_relaxed);
+        if (codec == 0)
+            return std::move(stored);
+        if (auto value = decompress_value(static_cast<uint8_t>(codec),
+                                          std::span<const char>(stored.data(), stored.size()),
+                                          logical_size))
+            return Buffer(std::move(*value));
+        std::cerr << "Cannot decode value for key: " << key << " (codec " << codec << ")"
+                  << std::endl;
+        return std::nullopt;
+    }
 
-        std::optional<double> abs_exp;
-        if constexpr (has_expiration)
-            abs_exp = _abs_expire(expires_secs);
+    // Checksum of a value that will go to a file (see VerifyPolicy).
+    // Computed before the store lock is taken.
+    std::optional<uint64_t> _file_checksum(std::span<const char> value) const
+    {
+        if (value.size() <= _file_size_threshold.load(std::memory_order_relaxed))
+            return std::nullopt;
+        return xxh3_64(value);
+    }
 
-        auto new_size = std::size(value);
+    // --- threshold tuning (see ThresholdTuning) ---
 
-        // BEGIN EXCLUSIVE here covers BOTH branches: the SELECT of the old
-        // entry and the REPLACE must see the same DB state. Without it a
-        // concurrent process can swap the entry between our SELECT and our
-        // REPLACE — we'd then `storage->remove(old_filepath_we_read)` while
-        // the file actually attached to the row now is the *other* process's
-        // path, which we leak. (See test_no_orphans_after_concurrent_mixed_size_set.)
-        _NestedTxn txn(*this);
+    // Side of the threshold a value of this size is timed on: 0 just below
+    // it, 1 just above it, none further away or with tuning off.
+    std::optional<int> _tuning_side(std::size_t size) const
+    {
+        if (!_tuning_enabled.load(std::memory_order_relaxed))
+            return std::nullopt;
+        auto threshold = _file_size_threshold.load(std::memory_order_relaxed);
+        if (size > threshold / 2 && size <= threshold)
+            return 0;
+        if (size > threshold && size - threshold <= threshold)
+            return 1;
+        return std::nullopt;
+    }
 
-        // Single query to get old path and size (saves a round-trip vs separate queries)
-        auto old_entry = db->template exec<std::filesystem::path, std::size_t>(
-            GET_PATH_SIZE_STMT, key);
-        std::optional<std::size_t> old_size_opt;
-        std::filesystem::path old_filepath;
-        if (old_entry)
+    // Where set() puts a value: inline up to the threshold, but the other
+    // way for the probes among the timed values.
+    bool _stores_inline(std::size_t size, bool timed)
+    {
+        bool below = size <= _file_size_threshold.load(std::memory_order_relaxed);
+        if (timed)
         {
-            old_filepath = std::get<0>(*old_entry);
-            old_size_opt = std::get<1>(*old_entry);
+            auto every = std::max<std::size_t>(_probe_every.load(std::memory_order_relaxed), 1);
+            if (_tuning_writes.fetch_add(1, std::memory_order_relaxed) % every == 0)
+                return !below;
         }
+        return below;
+    }
 
-        if (new_size <= _file_size_threshold)
-        {
-            auto binded = REPLACE_VALUE_STMT.bind_all();
-            _bind_core_and_policies(binded.get(), key, value, new_size, abs_exp, seq, tag);
-            sqlite3_step(binded.get());
-            txn.commit();
-            _update_counters_after_set(old_size_opt, new_size);
-            if (!old_filepath.empty())
-                storage->remove(old_filepath);
-            return true;
-        }
+    void _record_latency(std::optional<int> side, bool inline_value, bool get,
+                         std::chrono::steady_clock::time_point start)
+    {
+        if (!side)
+            return;
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        _tuning_count[*side][inline_value][get].fetch_add(1, std::memory_order_relaxed);
+        _tuning_ns[*side][inline_value][get].fetch_add(static_cast<uint64_t>(ns),
+                                                       std::memory_order_relaxed);
+    }
 
-        auto new_filepath = storage->store(value);
-        if (!new_filepath)
-        {
-            txn.rollback();
-            return false;
-        }
-        {
-            auto path_str = new_filepath->string();
-            auto binded = REPLACE_PATH_STMT.bind_all();
-            _bind_core_and_policies(binded.get(), key, path_str, new_size,
-                                    abs_exp, seq, tag);
-            sqlite3_step(binded.get());
-        }
-        try
-        {
-            txn.commit();
-        }
-        catch (const std::runtime_error&)
+    void _reset_tuning_samples()
+    {
+        for (auto& per_side : _tuning_count)
+            for (auto& per_path : per_side)
+                for (auto& n : per_path)
+                    n.store(0, std::memory_order_relaxed);
+        for (auto& per_side : _tuning_ns)
+            for (auto& per_path : per_side)
+                for (auto& ns : per_path)
+                    ns.store(0, std::memory_order_relaxed);
+    }
+
+    // The content hash a file-backed value large enough to be deduplicated
+    // (see set_dedup_threshold()) is looked up under: its checksum.
+    std::optional<uint64_t> _dedup_hash(std::span<const char> value,
+                                        std::optional<uint64_t> checksum) const
+    {
+        auto threshold = _dedup_threshold.load(std::memory_order_relaxed);
+        if (threshold == 0 || value.size() < threshold)
+            return std::nullopt;
+        return checksum;
+    }
+
+    // A value file holding exactly these bytes. The hash only picks the
+    // candidates and their bytes are compared: a collision costs the
+    // sharing, never the value.
+    std::optional<std::filesystem::path> _find_blob(DbGuard& db, uint64_t hash,
+                                                    std::span<const char> value)
+    {
+        auto binded = FIND_BLOB_STMT.bind_all(static_cast<std::size_t>(hash), value.size());
+        while (auto path = db->template step<std::filesystem::path>(binded))
         {
-            txn.rollback();
-            storage->remove(*new_filepath);
-            throw;
+            auto existing = storage->load(*path);
+            if (existing && existing->size() == value.size()
+                && std::memcmp(existing->data(), value.data(), value.size()) == 0)
+                return path;
         }
-        if (!old_filepath.empty())
-            storage->remove(old_filepath);
-        _update_counters_after_set(old_size_opt, new_size);
-        return true;
+        return std::nullopt;
     }
 
-    void _update_counters_after_set(const std::optional<std::size_t>& old_size,
-                                     std::size_t new_size)
+    struct _StoredFile
+    {
+        std::filesystem::path path;
+        bool shared = false;
+    };
+
+    // The file a new row for `value` points at: with a content hash, an
+    // existing file with the same bytes (taking a reference on it) or else
+    // a new one registered as a blob; without, a new private file. Runs in
+    // the caller's transaction.
+    std::optional<_StoredFile> _store_file(DbGuard& db, const Bytes auto& value,
+                                           const std::string& key, std::optional<uint64_t> hash)
     {
-        if (old_size)
+        std::span<const char> bytes(std::data(value), std::size(value));
+        if (hash)
         {
-            if (new_size >= *old_size)
-                _total_size.fetch_add(new_size - *old_size, std::memory_order_relaxed);
-            else
-                _total_size.fetch_sub(*old_size - new_size, std::memory_order_relaxed);
+            if (auto path = _find_blob(db, *hash, bytes))
+            {
+                db->exec(REF_BLOB_STMT, path->string());
+                return _StoredFile { std::move(*path), true };
+            }
         }
-        else
+        auto path = storage->store(value, key);
+        if (!path)
+            return std::nullopt;
+        _note_file_written();
+        if (hash)
+            db->exec(INSERT_BLOB_STMT, path->string(), static_cast<std::size_t>(*hash),
+                     bytes.size());
+        return _StoredFile { std::move(*path), false };
+    }
+
+    // Undo _store_file() for a row that was not written.
+    void _discard_file(DbGuard& db, const _StoredFile& file)
+    {
+        if (file.shared)
         {
-            _total_size.fetch_add(new_size, std::memory_order_relaxed);
-            _total_count.fetch_add(1, std::memory_order_relaxed);
+            db->exec(UNREF_BLOB_STMT, file.path.string());
+            return;
         }
+        db->exec(DELETE_BLOB_STMT, file.path.string());
+        storage->remove(file.path);
     }
 
     inline bool _add_impl(const std::string& key, const Bytes auto& value,
                            [[maybe_unused]] std::optional<double> expires_secs,
-                           [[maybe_unused]] std::optional<std::string> tag = std::nullopt)
+                           [[maybe_unused]] std::optional<std::string> tag = std::nullopt,
+                           _Encoding enc = {})
     {
+        if constexpr (has_compression)
+        {
+            if (auto packed = _encode(value, enc))
+                return _add_impl(key, *packed, expires_secs, std::move(tag), enc);
+        }
+        std::span<const char> bytes(std::data(value), std::size(value));
+        auto checksum = _file_checksum(bytes);
+        auto content_hash = _dedup_hash(bytes, checksum);
+        _housekeep_if_due();
         auto db = this->db();
         std::size_t seq = 0;
         if constexpr (has_eviction)
@@ -860,42 +2872,90 @@ private:
             abs_exp = _abs_expire(expires_secs);
 
         auto new_size = std::size(value);
+        _Sizes new_sizes { new_size, enc.codec ? enc.logical_size : new_size };
 
-        if (new_size <= _file_size_threshold)
+        if constexpr (has_tags)
+            _reap_stale(db, key);
+
+        if (new_size <= _file_size_threshold.load(std::memory_order_relaxed))
         {
+            std::optional<_NestedTxn> txn;
+            if (_value_table)
+                txn.emplace(*this);
+            auto value_id = _insert_value_row(db, value);
             auto binded = INSERT_VALUE_STMT.bind_all();
-            _bind_core_and_policies(binded.get(), key, value, new_size, abs_exp, seq, tag);
+            if (value_id)
+                _bind_core_and_policies(binded.get(), key, *value_id, new_size, abs_exp, seq, tag,
+                                        enc);
+            else
+                _bind_core_and_policies(binded.get(), key, value, new_size, abs_exp, seq, tag,
+                                        enc);
             sqlite3_step(binded.get());
             if (sqlite3_changes(db->get()) > 0)
             {
-                _total_size.fetch_add(new_size, std::memory_order_relaxed);
-                _total_count.fetch_add(1, std::memory_order_relaxed);
+                if (txn)
+                    txn->commit();
+                _add_to_counters(new_sizes);
                 return true;
             }
+            // The key was taken: drop the value row written for it.
+            if (txn)
+            {
+                (void)db->exec("DELETE FROM cache_values WHERE id = ?;",
+                               static_cast<std::size_t>(value_id->id));
+                txn->commit();
+            }
             return false;
         }
 
-        auto file_path = storage->store(value);
-        if (!file_path)
+        // A shared file's reference and the row go in together.
+        std::optional<_NestedTxn> txn;
+        if (content_hash)
+            txn.emplace(*this);
+        auto file = _store_file(db, value, key, content_hash);
+        if (!file)
             return false;
 
         {
-            auto path_str = file_path->string();
+            auto path_str = file->path.string();
             auto binded = INSERT_PATH_STMT.bind_all();
-            _bind_core_and_policies(binded.get(), key, path_str, new_size,
-                                    abs_exp, seq, tag);
+            _bind_checksum(binded.get(),
+                           _bind_core_and_policies(binded.get(), key, path_str, new_size,
+                                                   abs_exp, seq, tag, enc),
+                           checksum);
             sqlite3_step(binded.get());
         }
-        if (sqlite3_changes(db->get()) == 0)
-        {
-            storage->remove(*file_path);
+        bool inserted = sqlite3_changes(db->get()) > 0;
+        if (!inserted)
+            _discard_file(db, *file);
+        if (txn)
+            txn->commit();
+        // Autocommit: the row (if any) is durable already.
+        if (_txn_depth == 0)
+            storage->commit_intents();
+        if (!inserted)
             return false;
-        }
-        _total_size.fetch_add(new_size, std::memory_order_relaxed);
-        _total_count.fetch_add(1, std::memory_order_relaxed);
+        _add_to_counters(new_sizes);
         return true;
     }
 
+    // A row hidden by evict_tag() but not yet collected must neither block
+    // add() nor be resurrected by incr()'s in-place UPDATE.
+    void _reap_stale(DbGuard& db, const std::string& key)
+        requires (has_tags)
+    {
+        auto stale = db->template exec<std::filesystem::path, std::size_t, std::size_t>(
+            GET_STALE_STMT, key);
+        if (!stale)
+            return;
+        db->exec(DELETE_STALE_STMT, key);
+        if (sqlite3_changes(db->get()) == 0)
+            return;
+        _remove_from_counters({ std::get<1>(*stale), std::get<2>(*stale) });
+        if (!std::get<0>(*stale).empty())
+            _queue_removal(std::get<0>(*stale));
+    }
+
     static std::optional<double> _abs_expire(std::optional<double> offset_secs)
     {
         if (!offset_secs) return std::nullopt;
@@ -908,14 +2968,25 @@ public:
     static constexpr std::string_view db_fname = "sciqlop-cache.db";
 
     explicit _Store(const std::filesystem::path& cache_path = ".cache/",
-                    size_t max_size = 0)
+                    size_t max_size = 0, const StoreOptions& options = {})
             : cache_path(cache_path)
             , max_size(max_size)
-            , storage(std::make_unique<Storage>(cache_path))
+            , storage(std::make_unique<Storage>(cache_path, options.mmap_cache_bytes))
+            , _file_size_threshold(options.file_size_threshold)
+            , _options(options)
+            , _value_table(options.separate_values)
+            , _hashed_keys(_stored_key_layout(cache_path, options))
             , _owner_pid(_sq_getpid())
     {
+        set_checkpoint_policy(options.checkpoint);
+        // Named after the database so directory walks skip the journals.
+        storage->set_intent_log_prefix(cache_path / (std::string(db_fname) + "-intent-"));
         _init_db();
-        _checkpoint_thread = std::thread(&_Store::_checkpoint_loop, this);
+        if (auto cold = _db.exec<std::string>(GET_META_STMT, std::string("cold_path")))
+            storage->set_cold_path(*cold);
+        set_threshold_tuning(options.threshold_tuning);
+        _recover_interrupted_writes();
+        _start_checkpoint_thread();
         // Register last, once fully built, so a concurrent fork's handlers only
         // ever see a complete store.
         _register_fork_aware(this);
@@ -952,11 +3023,212 @@ public:
     inline bool close()
     {
         auto g = db();
+        if constexpr (_ephemeral)
+        {
+            if (g->opened() && _snapshot_on_close.load(std::memory_order_relaxed))
+                (void)save_snapshot(cache_path);
+        }
+        storage->sync_pending();
+        storage->drain_removals();
+        if (g->opened())
+            _flush_file_bytes(g->get());
         return _finalize_statements() & g->close();
     }
 
     [[nodiscard]] inline std::filesystem::path path() { return cache_path; }
 
+    // --- Ephemeral snapshots ---
+
+    // Write the entries of an ephemeral store to `dir` as a regular cache
+    // directory, which a Cache or Index opens as-is and load_snapshot()
+    // reads back. A snapshot already in `dir` is replaced (and its value
+    // files removed) only once the new one is complete; `dir` must not be
+    // open as a store meanwhile. Returns false, leaving any earlier snapshot
+    // in place, if it could not be written.
+    bool save_snapshot(const std::filesystem::path& dir)
+        requires (_ephemeral)
+    {
+        auto g = db();
+        auto target = dir / db_fname;
+        auto tmp = target;
+        tmp += "-snapshot";
+        std::vector<std::filesystem::path> written;
+        std::error_code ec;
+        try
+        {
+            std::filesystem::create_directories(dir);
+            std::filesystem::remove(tmp, ec);
+            std::vector<std::string> old_files;
+            if (std::filesystem::exists(target, ec))
+            {
+                try
+                {
+                    Database old;
+                    old.open(target);
+                    if (auto r = old.exec<std::vector<std::string>>(
+                            "SELECT DISTINCT path FROM cache WHERE path IS NOT NULL;"))
+                        old_files = std::move(*r);
+                }
+                catch (const std::runtime_error&)
+                {
+                    // Not a readable cache: overwritten, its files left alone.
+                }
+            }
+            {
+                Database snap;
+                snap.open(tmp);
+                if (!_backup(_db.get(), snap.get()))
+                    throw std::runtime_error("snapshot backup failed");
+                DiskStorage disk(dir);
+                disk.set_durability(Durability::group);
+                auto paths = snap.exec<std::vector<std::string>>(
+                    "SELECT DISTINCT path FROM cache WHERE path IS NOT NULL;");
+                (void)snap.exec("BEGIN;");
+                for (const auto& path : paths.value_or(std::vector<std::string> {}))
+                {
+                    auto value = storage->map(path);
+                    auto file = value ? disk.store(std::span<const char>(value->data(), value->size()))
+                                      : std::nullopt;
+                    if (!file)
+                        throw std::runtime_error("snapshot value write failed");
+                    written.push_back(*file);
+                    // Blobs first: the repath trigger then finds nothing to unref.
+                    (void)snap.exec("UPDATE blobs SET path = ?2 WHERE path = ?1;", path,
+                                    file->string());
+                    (void)snap.exec("UPDATE cache SET path = ?2 WHERE path = ?1;", path,
+                                    file->string());
+                }
+                (void)snap.exec("INSERT OR REPLACE INTO meta (key, value) VALUES ('file_bytes', ?);",
+                                static_cast<std::size_t>(std::max<int64_t>(disk.take_bytes_delta(), 0)));
+                (void)snap.exec("COMMIT;");
+                disk.sync_pending();
+            }
+            for (const auto* suffix : { "-wal", "-shm" })
+            {
+                auto journal = target;
+                journal += suffix;
+                std::filesystem::remove(journal, ec);
+            }
+            std::filesystem::rename(tmp, target);
+            for (const auto& f : old_files)
+                if (!DiskStorage::is_cold(f))
+                    std::filesystem::remove_all(dir / f, ec);
+            return true;
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Error saving snapshot: " << e.what() << std::endl;
+            for (const auto& f : written)
+                std::filesystem::remove_all(dir / f, ec);
+            std::filesystem::remove(tmp, ec);
+            return false;
+        }
+    }
+
+    bool save_snapshot()
+        requires (_ephemeral)
+    {
+        return save_snapshot(cache_path);
+    }
+
+    // Replace the entries of an ephemeral store with the snapshot in `dir`
+    // (see save_snapshot()); entries whose value file is gone are dropped.
+    // Returns false, leaving the store as it was, if there is no snapshot
+    // there, it cannot be read, or a transaction is open.
+    bool load_snapshot(const std::filesystem::path& dir)
+        requires (_ephemeral)
+    {
+        auto g = db();
+        auto source = dir / db_fname;
+        std::error_code ec;
+        if (_txn_depth > 0 || !std::filesystem::exists(source, ec))
+            return false;
+        try
+        {
+            // Staged in a database of its own until every value is in.
+            Database staging;
+            staging.open(":memory:");
+            {
+                sqlite3* src = nullptr;
+                bool copied = sqlite3_open_v2(source.string().c_str(), &src,
+                                              SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, nullptr)
+                        == SQLITE_OK
+                    && _backup(src, staging.get());
+                sqlite3_close(src);
+                if (!copied)
+                    return false;
+            }
+            if (_key_layout(staging.get()).value_or(_hashed_keys) != _hashed_keys)
+                throw std::runtime_error("the snapshot was saved with another key layout");
+            DiskStorage disk(dir);
+            if (auto cold = staging.exec<std::string>(
+                    "SELECT value FROM meta WHERE key = 'cold_path';"))
+                disk.set_cold_path(*cold);
+            std::unordered_set<std::string> loaded;
+            auto paths = staging.exec<std::vector<std::string>>(
+                "SELECT DISTINCT path FROM cache WHERE path IS NOT NULL;");
+            (void)staging.exec("BEGIN;");
+            (void)staging.exec("DELETE FROM meta WHERE key = 'cold_path';");
+            for (const auto& path : paths.value_or(std::vector<std::string> {}))
+            {
+                auto value = disk.map(path);
+                auto block = value ? storage->store(std::span<const char>(value->data(), value->size()))
+                                   : std::nullopt;
+                if (!block)
+                {
+                    (void)staging.exec("DELETE FROM cache WHERE path = ?1;", path);
+                    continue;
+                }
+                loaded.insert(block->string());
+                (void)staging.exec("UPDATE blobs SET path = ?2 WHERE path = ?1;", path,
+                                   block->string());
+                (void)staging.exec("UPDATE cache SET path = ?2 WHERE path = ?1;", path,
+                                   block->string());
+            }
+            (void)staging.exec("COMMIT;");
+
+            _finalize_statements();
+            bool copied = _backup(staging.get(), _db.get());
+            _migrate_schema();
+            (void)_db.exec(_index_sql());
+            _compile_statements();
+            if (!copied)
+                throw std::runtime_error(sqlite3_errmsg(_db.get()));
+            storage->commit_intents();
+            // Everything held now is the snapshot's, and accounted as such.
+            (void)storage->collect_unreferenced(loaded, true);
+            (void)storage->take_bytes_delta();
+            _db.exec(SET_META_STMT, std::string("file_bytes"), storage->held_bytes());
+            _load_counters();
+            return true;
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "Error loading snapshot: " << e.what() << std::endl;
+            storage->abort_intents();
+            return false;
+        }
+    }
+
+    bool load_snapshot()
+        requires (_ephemeral)
+    {
+        return load_snapshot(cache_path);
+    }
+
+    // Whether close() (and so the destructor) saves a snapshot to path().
+    void set_snapshot_on_close(bool enabled)
+        requires (_ephemeral)
+    {
+        _snapshot_on_close.store(enabled, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] bool snapshot_on_close() const
+        requires (_ephemeral)
+    {
+        return _snapshot_on_close.load(std::memory_order_relaxed);
+    }
+
     [[nodiscard]] inline size_t max_cache_size()
         requires (has_eviction)
     { return max_size; }
@@ -965,7 +3237,228 @@ public:
         requires (has_eviction)
     { max_size = value; }
 
-    [[nodiscard]] inline std::size_t file_size_threshold() { return _file_size_threshold; }
+    [[nodiscard]] inline std::size_t file_size_threshold() const
+    {
+        return _file_size_threshold.load(std::memory_order_relaxed);
+    }
+
+    // Applies to values written from now on; stored ones stay where they are.
+    // With ThresholdTuning on, tuning resumes from here in every process.
+    inline void set_file_size_threshold(std::size_t bytes)
+    {
+        auto g = db();
+        _file_size_threshold.store(bytes, std::memory_order_relaxed);
+        if (_tuning_enabled.load(std::memory_order_relaxed))
+        {
+            g->exec(SET_META_STMT, std::string(_tuned_threshold_key), bytes);
+            _reset_tuning_samples();
+        }
+    }
+
+    [[nodiscard]] inline ThresholdTuning threshold_tuning() const
+    {
+        auto g = db();
+        return _options.threshold_tuning;
+    }
+
+    // See ThresholdTuning. Turning it on adopts the threshold tuned so far,
+    // if any; turning it off keeps the threshold where tuning left it.
+    inline void set_threshold_tuning(const ThresholdTuning& tuning)
+    {
+        auto g = db();
+        _options.threshold_tuning = tuning;
+        _probe_every.store(tuning.probe_every, std::memory_order_relaxed);
+        if (tuning.enabled)
+        {
+            if (auto tuned = _read_tuned_threshold(g->get(), tuning))
+                _file_size_threshold.store(*tuned, std::memory_order_relaxed);
+        }
+        _reset_tuning_samples();
+        _tuning_enabled.store(tuning.enabled, std::memory_order_relaxed);
+    }
+
+    // The options in effect, whichever setter changed them last; page_size
+    // is the database's actual one.
+    [[nodiscard]] StoreOptions options() const
+    {
+        auto g = db();
+        auto o = _options;
+        if (auto ps = g->template exec<std::size_t>("PRAGMA page_size;"))
+            o.page_size = *ps;
+        o.file_size_threshold = file_size_threshold();
+        o.mmap_cache_bytes = storage->mmap_cache_capacity();
+        o.checkpoint = checkpoint_policy();
+        o.separate_values = _value_table;
+        o.hashed_keys = _hashed_keys;
+        return o;
+    }
+
+    // Everything applies at once (the background connection picks the
+    // PRAGMAs up at its next wake-up) except page_size, kept for a database
+    // created later, separate_values, kept for the next opening, and
+    // hashed_keys, fixed when the database was created.
+    void set_options(const StoreOptions& options)
+    {
+        {
+            auto g = db();
+            _options = options;
+            (void)g->exec(_connection_pragma_sql() + " PRAGMA busy_timeout="
+                          + std::to_string(options.busy_timeout.count()) + ";");
+        }
+        _file_size_threshold.store(options.file_size_threshold, std::memory_order_relaxed);
+        set_threshold_tuning(options.threshold_tuning);
+        storage->set_mmap_cache_capacity(options.mmap_cache_bytes);
+        set_checkpoint_policy(options.checkpoint);
+    }
+
+    // File-backed values below this size are read with pread(), larger ones
+    // are memory-mapped (see DiskStorage::load).
+    [[nodiscard]] inline std::size_t pread_cutoff() const { return storage->pread_cutoff(); }
+
+    inline void set_pread_cutoff(std::size_t bytes) { storage->set_pread_cutoff(bytes); }
+
+    // Route the storage's batched file I/O (get_many/set_many, deletion
+    // queue) through io_uring where the kernel provides it.
+    inline void set_io_uring_enabled(bool enabled) { storage->set_io_uring_enabled(enabled); }
+
+    [[nodiscard]] inline bool uses_io_uring() { return storage->uses_io_uring(); }
+
+    [[nodiscard]] inline StorageLayout storage_layout() const { return storage->layout(); }
+
+    // Fan-out of the directories new value files go to (see StorageLayout).
+    inline void set_storage_layout(StorageLayout layout) { storage->set_layout(layout); }
+
+    [[nodiscard]] inline ChunkPolicy chunk_policy() const { return storage->chunk_policy(); }
+
+    // Split very large values into chunk files written in parallel (see
+    // ChunkPolicy); read them back whole with get() or in part with
+    // get_range().
+    inline void set_chunk_policy(const ChunkPolicy& policy) { storage->set_chunk_policy(policy); }
+
+    [[nodiscard]] inline std::size_t dedup_threshold() const
+    {
+        return _dedup_threshold.load(std::memory_order_relaxed);
+    }
+
+    // File-backed values of at least `bytes` are stored once per distinct
+    // content: a set() whose value is already on disk only takes a reference
+    // on that file (after comparing the bytes), and the file goes with the
+    // last row pointing at it. 0, the default, turns it off; values written
+    // meanwhile keep being shared either way.
+    inline void set_dedup_threshold(std::size_t bytes)
+    {
+        _dedup_threshold.store(bytes, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] inline VerifyPolicy verify_policy() const
+    {
+        return { _verify_mode.load(std::memory_order_relaxed),
+                 _verify_ppm.load(std::memory_order_relaxed) / 10'000.0,
+                 _scrub_rows.load(std::memory_order_relaxed) };
+    }
+
+    // How reads and the background thread check file-backed values against
+    // their checksums (see VerifyPolicy). sample_percent is clamped to
+    // [0, 100].
+    inline void set_verify_policy(const VerifyPolicy& policy)
+    {
+        auto percent = std::clamp(policy.sample_percent, 0.0, 100.0);
+        _verify_ppm.store(static_cast<uint32_t>(percent * 10'000.0 + 0.5),
+                          std::memory_order_relaxed);
+        _verify_mode.store(policy.mode, std::memory_order_relaxed);
+        _scrub_rows.store(policy.scrub_rows, std::memory_order_relaxed);
+    }
+
+    // Values this process dropped because they failed their checksum, on a
+    // read, in check(fix) or while scrubbing.
+    [[nodiscard]] inline uint64_t corrupt_values() const
+    {
+        return _corrupt_values.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] inline TierPolicy tier_policy() const
+        requires (has_eviction)
+    {
+        return { storage->cold_path(), _hot_bytes.load(std::memory_order_relaxed),
+                 _promote_on_read.load(std::memory_order_relaxed) };
+    }
+
+    // See TierPolicy. An empty cold_path keeps the current cold root: values
+    // already moved there still need it, so it can be moved but not
+    // dropped. Set it before the store is shared between threads.
+    inline void set_tier_policy(const TierPolicy& policy)
+        requires (has_eviction)
+    {
+        if (!policy.cold_path.empty())
+        {
+            auto g = db();
+            storage->set_cold_path(policy.cold_path);
+            g->exec(SET_META_STMT, std::string("cold_path"), storage->cold_path().string());
+        }
+        _hot_bytes.store(policy.hot_bytes, std::memory_order_relaxed);
+        _promote_on_read.store(policy.promote_on_read, std::memory_order_relaxed);
+    }
+
+    // Run the background thread's tier pass now (queued promotions, then
+    // demotions down to the hot budget). Returns the number of values moved;
+    // a pass cut short by its time budget goes on at the next tick. Like the
+    // background thread it runs on a connection of its own, so the files are
+    // copied without _mtx. Throws from inside a transaction.
+    inline std::size_t migrate_tiers()
+        requires (has_eviction)
+    {
+        {
+            std::lock_guard g(_mtx);
+            if (_txn_depth > 0)
+                throw std::runtime_error("migrate_tiers() cannot run inside a transaction");
+        }
+        std::lock_guard tier_guard(_tier_mutex);
+        if constexpr (_ephemeral)
+        {
+            std::lock_guard g(_mtx);
+            return _bg_tier(_db.get());
+        }
+        else
+        {
+            sqlite3* conn = nullptr;
+            auto db_path = (cache_path / db_fname).string();
+            if (sqlite3_open_v2(db_path.c_str(), &conn,
+                                SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX, nullptr)
+                != SQLITE_OK)
+            {
+                std::string error = conn ? sqlite3_errmsg(conn) : "out of memory";
+                sqlite3_close(conn);
+                throw std::runtime_error("Failed to open a tiering connection: " + error);
+            }
+            std::unique_ptr<sqlite3, decltype(&sqlite3_close)> owned { conn, &sqlite3_close };
+            _apply_connection_pragmas(conn);
+            sqlite3_wal_hook(conn, &_Store::_wal_hook, this);
+            return _bg_tier(conn);
+        }
+    }
+
+    [[nodiscard]] inline Durability durability() const { return storage->durability(); }
+
+    // See Durability. Commits sync the WAL (synchronous=FULL) in sync mode
+    // only; group waves sync it from the background thread.
+    inline void set_durability(Durability mode)
+    {
+        auto g = db();
+        storage->set_durability(mode);
+        (void)g->exec(mode == Durability::sync ? std::string("PRAGMA synchronous=FULL;")
+                                               : std::string("PRAGMA synchronous=NORMAL;"));
+    }
+
+    // Run a group wave now: once it returns, every entry committed before
+    // the call is durable. Files written in none mode are not tracked, so
+    // this does not cover them.
+    inline void sync()
+    {
+        storage->sync_pending();
+        auto g = db();
+        if (g->opened())
+            _sync_wal(g->get());
+    }
 
     [[nodiscard]] inline std::size_t count()
     {
@@ -987,6 +3480,39 @@ public:
         return _total_size.load(std::memory_order_relaxed);
     }
 
+    // Decoded bytes of all entries. size() counts the bytes actually stored,
+    // which is less once values are compressed (see WithCompression).
+    [[nodiscard]] inline size_t logical_size()
+    {
+        return _total_logical.load(std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] inline CompressionPolicy compression() const
+        requires (has_compression)
+    {
+        return { WithCompression::_codec.load(std::memory_order_relaxed),
+                 WithCompression::_min_compressed_size.load(std::memory_order_relaxed),
+                 WithCompression::_max_compression_ratio.load(std::memory_order_relaxed) };
+    }
+
+    // Applies to values written from now on; stored ones keep their codec.
+    // Returns false (and changes nothing) if the codec is not registered.
+    inline bool set_compression(CompressionPolicy policy)
+        requires (has_compression)
+    {
+        if (policy.codec != 0 && !CodecRegistry::instance().find(policy.codec))
+            return false;
+        WithCompression::_min_compressed_size.store(policy.min_size, std::memory_order_relaxed);
+        WithCompression::_max_compression_ratio.store(std::clamp(policy.max_ratio, 0.0, 1.0),
+                                                      std::memory_order_relaxed);
+        WithCompression::_codec.store(policy.codec, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Database pages plus the block-rounded size of every value file, live or
+    // waiting in the trash. The file part is tracked incrementally (a
+    // persisted total plus this process's unflushed delta); check() is the
+    // one place that walks the directory to reconcile it.
     [[nodiscard]] inline size_t volume()
     {
         auto g = db();
@@ -994,18 +3520,10 @@ public:
         if (auto pc = g->template exec<std::size_t>("PRAGMA page_count;"))
             if (auto ps = g->template exec<std::size_t>("PRAGMA page_size;"))
                 db_size = *pc * *ps;
-        std::size_t file_size = 0;
-        if (std::filesystem::exists(cache_path) && std::filesystem::is_directory(cache_path))
-        {
-            for (const auto& entry : std::filesystem::recursive_directory_iterator(cache_path))
-            {
-                if (entry.is_regular_file() && entry.path().extension() != ".db"
-                    && entry.path().extension() != ".db-wal"
-                    && entry.path().extension() != ".db-shm")
-                    file_size += entry.file_size();
-            }
-        }
-        return db_size + file_size;
+        int64_t file_size = storage->bytes_delta();
+        if (auto r = g->template exec<std::size_t>(GET_META_STMT, std::string("file_bytes")))
+            file_size += static_cast<int64_t>(*r);
+        return db_size + static_cast<std::size_t>(std::max<int64_t>(file_size, 0));
     }
 
     [[nodiscard]] inline std::vector<std::string> keys()
@@ -1015,10 +3533,16 @@ public:
         return {};
     }
 
-    [[nodiscard]] inline KeyCursor iterkeys()
+    [[nodiscard]] inline KeyCursor iterkeys(
+        std::string prefix = {}, std::size_t page_size = KeyCursor::default_page_size)
+    {
+        return KeyCursor(*this, std::move(prefix), page_size);
+    }
+
+    [[nodiscard]] inline ItemCursor items(std::string prefix = {},
+                                          std::size_t page_size = KeyCursor::default_page_size)
     {
-        auto sql = std::string("SELECT key FROM cache WHERE 1=1") + _where_valid() + ";";
-        return KeyCursor(_mtx, _db.get(), sql);
+        return ItemCursor(*this, iterkeys(std::move(prefix), page_size), page_size);
     }
 
     [[nodiscard]] inline bool exists(const std::string& key)
@@ -1064,49 +3588,46 @@ public:
     inline std::optional<Buffer> get(const std::string& key)
     {
         auto db = this->db();
-        if (auto values = db->template exec<std::vector<char>, std::filesystem::path>(GET_STMT, key))
+        const bool timed = _tuning_enabled.load(std::memory_order_relaxed);
+        std::chrono::steady_clock::time_point start;
+        if (timed)
+            start = std::chrono::steady_clock::now();
+        if (auto values = db->template exec<std::vector<char>, std::filesystem::path, std::size_t,
+                                            std::size_t, std::size_t>(GET_STMT, key))
         {
             if constexpr (has_stats)
                 WithStats::_hits.fetch_add(1, std::memory_order_relaxed);
 
             if constexpr (has_eviction)
             {
-                if (max_size > 0)
+                if (_tracks_use())
                     db->exec(UPDATE_LAST_USE_STMT,
                              WithEviction::_access_seq.fetch_add(1, std::memory_order_relaxed), key);
             }
 
-            const auto& [_, path] = *values;
+            const auto& [_, path, codec, logical_size, checksum] = *values;
+            std::optional<Buffer> stored;
             if (!path.empty())
             {
-                if (auto result = storage->load(path))
-                    return result;
-                else
+                stored = storage->load(path);
+                if (!stored)
                 {
-                    // Path-aware cleanup. Without this, a concurrent process
-                    // that swapped the entry between our SELECT and this
-                    // fallback would have its file removed by the bare del()
-                    // (del re-reads the row, finds the new path, removes the
-                    // wrong file). DELETE WHERE key=? AND path=? only fires
-                    // if the row still references the path we just failed to
-                    // load.
-                    auto path_str = path.string();
-                    auto size_opt = db->template exec<std::size_t>(
-                        "SELECT size FROM cache WHERE key = ? AND path = ?;",
-                        key, path_str);
-                    db->exec("DELETE FROM cache WHERE key = ? AND path = ?;",
-                             key, path_str);
-                    if (sqlite3_changes(db->get()) > 0 && size_opt)
-                    {
-                        _total_size.fetch_sub(*size_opt, std::memory_order_relaxed);
-                        _total_count.fetch_sub(1, std::memory_order_relaxed);
-                    }
-                    std::cerr << "Error loading file for key: " << key << ", deleting entry."
-                              << std::endl;
+                    _drop_unloadable(db, key, path);
                     return std::nullopt;
                 }
+                if constexpr (has_eviction)
+                    _queue_promotion(key, path);
             }
-            return Buffer(std::move(std::get<0>(*values)));
+            else
+                stored = Buffer(std::move(std::get<0>(*values)));
+            if (timed)
+                _record_latency(_tuning_side(stored->size()), path.empty(), true, start);
+            db.lock.unlock();
+            if (!_verify_read(key, path, *stored, checksum))
+                return std::nullopt;
+            if (codec == 0)
+                return stored;
+            return _decode(std::move(*stored), codec, logical_size, key);
         }
 
         if constexpr (has_stats)
@@ -1114,6 +3635,301 @@ public:
         return std::nullopt;
     }
 
+    // Bytes [offset, offset + size) of a value, clipped to its end. A
+    // file-backed value is read no further than the range needs: a slice of
+    // its mapping, a small pread(), or, for a chunked value (see
+    // ChunkPolicy), the chunks the range covers. A compressed value is
+    // decoded whole first. Unlike get(), the bytes are not checked against
+    // the value's checksum, which would mean reading all of them.
+    inline std::optional<Buffer> get_range(const std::string& key, std::size_t offset,
+                                           std::size_t size)
+    {
+        auto db = this->db();
+        auto values = db->template exec<std::vector<char>, std::filesystem::path, std::size_t,
+                                        std::size_t, std::size_t>(GET_STMT, key);
+        if (!values)
+        {
+            if constexpr (has_stats)
+                WithStats::_misses.fetch_add(1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        if constexpr (has_stats)
+            WithStats::_hits.fetch_add(1, std::memory_order_relaxed);
+        if constexpr (has_eviction)
+        {
+            if (_tracks_use())
+                db->exec(UPDATE_LAST_USE_STMT,
+                         WithEviction::_access_seq.fetch_add(1, std::memory_order_relaxed), key);
+        }
+
+        const auto& [_, path, codec, logical_size, checksum] = *values;
+        std::optional<Buffer> stored;
+        if (!path.empty())
+        {
+            stored = codec == 0 ? storage->load_range(path, offset, size) : storage->load(path);
+            if (!stored)
+            {
+                _drop_unloadable(db, key, path);
+                return std::nullopt;
+            }
+            if constexpr (has_eviction)
+                _queue_promotion(key, path);
+        }
+        else
+            stored = Buffer(std::move(std::get<0>(*values)));
+        db.lock.unlock();
+        if (codec == 0 && path.empty())
+            return stored->slice(offset, size);
+        if (codec == 0)
+            return stored;
+        if (!_verify_read(key, path, *stored, checksum))
+            return std::nullopt;
+        if (auto decoded = _decode(std::move(*stored), codec, logical_size, key))
+            return decoded->slice(offset, size);
+        return std::nullopt;
+    }
+
+    // --- Batched get/set ---
+
+    // get() for several keys under one lock acquisition, with the
+    // file-backed values read in one batch (see DiskStorage::load_many).
+    // Results follow the order of `keys`.
+    std::vector<std::optional<Buffer>> get_many(const std::vector<std::string>& keys)
+    {
+        std::vector<std::optional<Buffer>> results(keys.size());
+        std::vector<_Encoding> encodings(keys.size());
+        std::vector<std::size_t> file_of;
+        std::vector<std::filesystem::path> files;
+        std::vector<std::size_t> checksums;
+        auto db = this->db();
+        for (std::size_t i = 0; i < keys.size(); ++i)
+        {
+            auto values = db->template exec<std::vector<char>, std::filesystem::path, std::size_t,
+                                            std::size_t, std::size_t>(GET_STMT, keys[i]);
+            if (!values)
+            {
+                if constexpr (has_stats)
+                    WithStats::_misses.fetch_add(1, std::memory_order_relaxed);
+                continue;
+            }
+            if constexpr (has_stats)
+                WithStats::_hits.fetch_add(1, std::memory_order_relaxed);
+            if constexpr (has_eviction)
+            {
+                if (_tracks_use())
+                    db->exec(UPDATE_LAST_USE_STMT,
+                             WithEviction::_access_seq.fetch_add(1, std::memory_order_relaxed),
+                             keys[i]);
+            }
+            auto& [value, path, codec, logical_size, checksum] = *values;
+            encodings[i] = { static_cast<uint8_t>(codec), logical_size };
+            if (path.empty())
+                results[i] = Buffer(std::move(value));
+            else
+            {
+                file_of.push_back(i);
+                files.push_back(std::move(path));
+                checksums.push_back(checksum);
+            }
+        }
+        auto loaded = storage->load_many(files);
+        for (std::size_t k = 0; k < files.size(); ++k)
+        {
+            if (loaded[k])
+            {
+                results[file_of[k]] = std::move(loaded[k]);
+                if constexpr (has_eviction)
+                    _queue_promotion(keys[file_of[k]], files[k]);
+            }
+            else
+                _drop_unloadable(db, keys[file_of[k]], files[k]);
+        }
+        db.lock.unlock();
+        for (std::size_t k = 0; k < files.size(); ++k)
+        {
+            auto& result = results[file_of[k]];
+            if (result && !_verify_read(keys[file_of[k]], files[k], *result, checksums[k]))
+                result.reset();
+        }
+        for (std::size_t i = 0; i < keys.size(); ++i)
+        {
+            if (results[i] && encodings[i].codec != 0)
+                results[i] = _decode(std::move(*results[i]), encodings[i].codec,
+                                     encodings[i].logical_size, keys[i]);
+        }
+        return results;
+    }
+
+    // set() for several entries in one transaction: all of them are stored
+    // or none is. File-backed values are written in one batch (see
+    // DiskStorage::store_many) before any row is touched.
+    bool set_many(std::span<const std::pair<std::string, std::span<const char>>> items)
+    {
+        _housekeep_if_due();
+        // What each row stores: the caller's bytes, or their compressed form.
+        std::vector<std::span<const char>> stored(items.size());
+        std::vector<_Encoding> encodings(items.size());
+        [[maybe_unused]] std::vector<std::vector<char>> packed;
+        if constexpr (has_compression)
+            packed.reserve(items.size());
+        for (std::size_t i = 0; i < items.size(); ++i)
+        {
+            stored[i] = items[i].second;
+            if constexpr (has_compression)
+            {
+                if (auto p = _encode(items[i].second, encodings[i]))
+                {
+                    packed.push_back(std::move(*p));
+                    stored[i] = packed.back();
+                }
+            }
+        }
+        std::vector<std::optional<uint64_t>> checksums(items.size());
+        std::vector<std::optional<uint64_t>> hashes(items.size());
+        for (std::size_t i = 0; i < items.size(); ++i)
+        {
+            checksums[i] = _file_checksum(stored[i]);
+            hashes[i] = _dedup_hash(stored[i], checksums[i]);
+        }
+
+        auto db = this->db();
+        _NestedTxn txn(*this);
+
+        std::vector<std::span<const char>> big;
+        std::vector<std::string_view> owners;
+        std::vector<std::size_t> big_of;
+        std::vector<std::string> file_for(items.size());
+        // A deduplicated value already on disk, or earlier in this batch,
+        // is not written again: it shares that file.
+        std::vector<std::size_t> same_as(items.size(), items.size());
+        for (std::size_t i = 0; i < items.size(); ++i)
+        {
+            if (stored[i].size() <= _file_size_threshold.load(std::memory_order_relaxed))
+                continue;
+            if (hashes[i])
+            {
+                if (auto path = _find_blob(db, *hashes[i], stored[i]))
+                {
+                    file_for[i] = path->string();
+                    db->exec(REF_BLOB_STMT, file_for[i]);
+                    continue;
+                }
+                auto earlier = std::find_if(big_of.begin(), big_of.end(), [&](std::size_t j)
+                    { return hashes[j] == hashes[i] && std::ranges::equal(stored[j], stored[i]); });
+                if (earlier != big_of.end())
+                {
+                    same_as[i] = *earlier;
+                    continue;
+                }
+            }
+            big.push_back(stored[i]);
+            owners.push_back(items[i].first);
+            big_of.push_back(i);
+        }
+        auto written = storage->store_many(big, owners);
+        for (std::size_t k = 0; k < written.size(); ++k)
+        {
+            if (!written[k])
+            {
+                // Also removes the files of this batch already written.
+                txn.rollback();
+                return false;
+            }
+            auto i = big_of[k];
+            file_for[i] = written[k]->string();
+            if (hashes[i])
+                db->exec(INSERT_BLOB_STMT, file_for[i], static_cast<std::size_t>(*hashes[i]),
+                         stored[i].size());
+        }
+        for (std::size_t i = 0; i < items.size(); ++i)
+        {
+            if (same_as[i] == items.size())
+                continue;
+            file_for[i] = file_for[same_as[i]];
+            db->exec(REF_BLOB_STMT, file_for[i]);
+        }
+        _note_file_written();
+
+        std::vector<std::pair<std::optional<_Sizes>, _Sizes>> sizes;
+        std::vector<std::filesystem::path> old_files;
+        sizes.reserve(items.size());
+        for (std::size_t i = 0; i < items.size(); ++i)
+        {
+            const auto& key = items[i].first;
+            const auto& value = stored[i];
+            const auto& enc = encodings[i];
+            std::size_t seq = 0;
+            if constexpr (has_eviction)
+                seq = WithEviction::_access_seq.fetch_add(1, std::memory_order_relaxed);
+            std::optional<_Sizes> old_sizes;
+            if (auto old_entry = db->template exec<std::filesystem::path, std::size_t, std::size_t>(
+                    GET_PATH_SIZE_STMT, key))
+            {
+                if (!std::get<0>(*old_entry).empty())
+                    old_files.push_back(std::get<0>(*old_entry));
+                old_sizes = _Sizes { std::get<1>(*old_entry), std::get<2>(*old_entry) };
+            }
+            if (file_for[i].empty())
+            {
+                auto binded = REPLACE_VALUE_STMT.bind_all();
+                _bind_inline_row(db, binded.get(), key, value, value.size(), std::nullopt, seq,
+                                 std::nullopt, enc);
+                sqlite3_step(binded.get());
+            }
+            else
+            {
+                auto binded = REPLACE_PATH_STMT.bind_all();
+                _bind_checksum(binded.get(),
+                               _bind_core_and_policies(binded.get(), key, file_for[i],
+                                                       value.size(), std::nullopt, seq,
+                                                       std::nullopt, enc),
+                               checksums[i]);
+                sqlite3_step(binded.get());
+            }
+            sizes.emplace_back(old_sizes, _Sizes { value.size(),
+                                                   enc.codec ? enc.logical_size : value.size() });
+        }
+        try
+        {
+            txn.commit();
+        }
+        catch (const std::runtime_error&)
+        {
+            txn.rollback();
+            throw;
+        }
+        for (const auto& [old_sizes, new_sizes] : sizes)
+            _update_counters_after_set(old_sizes, new_sizes);
+        for (const auto& f : old_files)
+            _queue_removal(f);
+        return true;
+    }
+
+    // --- prefetch() ---
+
+    // Warm up the keys about to be read, e.g. everything a panel will fetch
+    // in the next second. Returns at once: the background thread resolves
+    // the keys in a few queries, reads inline values and asks the kernel to
+    // read file-backed ones ahead, so the later get() calls hit the page
+    // cache. Unknown keys are ignored; keys beyond a bounded backlog are
+    // dropped. A no-op on an ephemeral store, already all in memory.
+    void prefetch(const std::vector<std::string>& keys)
+    {
+        if (_ephemeral || keys.empty())
+            return;
+        {
+            std::lock_guard lk { _prefetch_mutex };
+            auto room = _max_prefetch_queue - std::min(_max_prefetch_queue, _prefetch_queue.size());
+            auto n = std::min(room, keys.size());
+            _prefetch_queue.insert(_prefetch_queue.end(), keys.begin(),
+                                   keys.begin() + static_cast<std::ptrdiff_t>(n));
+        }
+        _wake_background(_prefetch_requested);
+    }
+
+    // Keys the background thread has run through prefetch so far.
+    [[nodiscard]] uint64_t prefetched() const { return _prefetched.load(std::memory_order_relaxed); }
+
     // --- add() overloads ---
 
     inline bool add(const std::string& key, const Bytes auto& value)
@@ -1155,7 +3971,7 @@ public:
         // instead of the one we actually displaced).
         auto db = this->db();
         _NestedTxn txn(*this);
-        auto old_entry = db->template exec<std::filesystem::path, std::size_t>(
+        auto old_entry = db->template exec<std::filesystem::path, std::size_t, std::size_t>(
             GET_PATH_SIZE_STMT, key);
         if (!db->exec(DELETE_STMT, key))
         {
@@ -1170,10 +3986,9 @@ public:
         txn.commit();
         if (old_entry)
         {
-            _total_size.fetch_sub(std::get<1>(*old_entry), std::memory_order_relaxed);
-            _total_count.fetch_sub(1, std::memory_order_relaxed);
+            _remove_from_counters({ std::get<1>(*old_entry), std::get<2>(*old_entry) });
             if (!std::get<0>(*old_entry).empty())
-                storage->remove(std::get<0>(*old_entry));
+                _queue_removal(std::get<0>(*old_entry));
         }
         return true;
     }
@@ -1194,6 +4009,27 @@ public:
         return result;
     }
 
+    // Delete every entry whose key starts with `prefix`, expired ones
+    // included, and return how many of them were still live. Their value
+    // files are removed in the background, like those of del(). An empty
+    // prefix is refused: emptying the cache is clear()'s job.
+    inline std::size_t del_prefix(const std::string& prefix)
+    {
+        if (prefix.empty())
+            throw std::invalid_argument("del_prefix() needs a non-empty prefix, use clear()");
+        return _del_matching(prefix, {});
+    }
+
+    // Same for the keys matching a GLOB pattern (`*`, `?`, `[...]`, case
+    // sensitive); the literal characters it starts with bound the scan. A
+    // pattern of stars only, matching every key, is refused likewise.
+    inline std::size_t del_glob(const std::string& pattern)
+    {
+        if (!pattern.empty() && pattern.find_first_not_of('*') == std::string::npos)
+            throw std::invalid_argument("del_glob() pattern matches every key, use clear()");
+        return _del_matching(pattern.substr(0, pattern.find_first_of("*?[")), pattern);
+    }
+
     // --- Expiration-specific ---
 
     inline bool touch(const std::string& key, DurationConcept auto expire)
@@ -1210,24 +4046,26 @@ public:
     {
         auto db = this->db();
         std::size_t exp_count = 0;
-        std::size_t exp_size = 0;
+        _Sizes exp_sizes { 0, 0 };
+        std::vector<std::filesystem::path> files;
         {
             auto binded = EXPIRE_STMT.bind_all();
-            while (auto r = db->template step<std::filesystem::path, std::size_t>(binded))
+            while (auto r = db->template step<std::filesystem::path, std::size_t, std::size_t>(binded))
             {
-                auto [file_path, entry_size] = *r;
+                auto [file_path, entry_size, entry_logical] = *r;
                 ++exp_count;
-                exp_size += entry_size;
-                if (!file_path.empty() && !storage->remove(file_path))
-                    std::cerr << "Failed to delete file: " << file_path << std::endl;
+                exp_sizes.stored += entry_size;
+                exp_sizes.logical += entry_logical;
+                if (!file_path.empty())
+                    files.push_back(std::move(file_path));
             }
         }
         db->exec(EVICT_EXPIRED_STMT);
+        // Once the rows are gone, so shared files lose their references first.
+        for (const auto& f : files)
+            _queue_removal(f);
         if (exp_count > 0)
-        {
-            _total_count.fetch_sub(exp_count, std::memory_order_relaxed);
-            _total_size.fetch_sub(exp_size, std::memory_order_relaxed);
-        }
+            _remove_from_counters(exp_sizes, exp_count);
     }
 
     // --- Eviction-specific ---
@@ -1248,27 +4086,27 @@ public:
         auto target = max_size * 9 / 10;
         auto db = this->db();
 
-        struct Entry { std::string key; std::filesystem::path path; std::size_t entry_size; };
+        struct Entry { std::string key; std::filesystem::path path; _Sizes sizes; };
         std::vector<Entry> to_evict;
         {
             auto binded = EVICT_LRU_STMT.bind_all();
             while (current_size > target)
             {
-                auto r = db->template step<std::string, std::filesystem::path, std::size_t>(binded);
+                auto r = db->template step<std::string, std::filesystem::path, std::size_t,
+                                           std::size_t>(binded);
                 if (!r) break;
-                auto& [key, path, entry_size] = *r;
-                to_evict.push_back({ std::move(key), std::move(path), entry_size });
+                auto& [key, path, entry_size, entry_logical] = *r;
+                to_evict.push_back({ std::move(key), std::move(path), { entry_size, entry_logical } });
                 current_size -= std::min(current_size, entry_size);
             }
         }
 
-        for (auto& [key, path, entry_size] : to_evict)
+        for (auto& [key, path, sizes] : to_evict)
         {
             db->exec(DELETE_STMT, key);
-            _total_size.fetch_sub(entry_size, std::memory_order_relaxed);
-            _total_count.fetch_sub(1, std::memory_order_relaxed);
+            _remove_from_counters(sizes);
             if (!path.empty())
-                storage->remove(path);
+                _queue_removal(path);
         }
 
         return to_evict.size();
@@ -1276,42 +4114,20 @@ public:
 
     // --- Tag-specific ---
 
+    // O(1) in the number of tagged entries: bumping the tag's generation
+    // hides every row written under an older one (see WithTags). The rows and
+    // their files stay until the background thread collects them
+    // (_bg_collect_stale), so size() and count-based eviction still see them
+    // until then. Returns the number of entries invalidated.
     inline std::size_t evict_tag(const std::string& tag)
         requires (has_tags)
     {
-        // Wrap the whole op in BEGIN EXCLUSIVE so SELECT-paths, DELETE, and
-        // counter resync all see the same DB snapshot.
-        // Recompute total counters from the DB inside the txn instead of
-        // subtracting per-process deltas: evict_tag can wipe rows written
-        // by *other* processes, which our local atomic counters never saw.
-        // Subtracting their sizes from a counter that doesn't include them
-        // underflows the atomic (observed: size() = 0xFFFF...).
         auto db = this->db();
         _NestedTxn txn(*this);
-
-        std::vector<std::filesystem::path> files;
-        {
-            auto binded = EVICT_TAG_PATH_STMT.bind_all(tag);
-            while (auto r = db->template step<std::filesystem::path>(binded))
-            {
-                if (!r->empty())
-                    files.push_back(std::move(*r));
-            }
-        }
-        db->exec(EVICT_TAG_STMT, tag);
-        auto evicted = static_cast<std::size_t>(sqlite3_changes(db->get()));
-        // Authoritative recomputation while we still hold the EXCLUSIVE lock.
-        auto new_size = db->template exec<std::size_t>(
-            "SELECT COALESCE(SUM(size), 0) FROM cache;").value_or(0);
-        auto new_count = db->template exec<std::size_t>(
-            "SELECT COUNT(*) FROM cache;").value_or(0);
+        auto evicted = db->template exec<std::size_t>(COUNT_TAG_STMT, tag).value_or(0);
+        if (evicted > 0)
+            db->exec(BUMP_TAG_GEN_STMT, tag);
         txn.commit();
-
-        _total_size.store(new_size, std::memory_order_relaxed);
-        _total_count.store(new_count, std::memory_order_relaxed);
-
-        for (auto& f : files)
-            storage->remove(f);
         return evicted;
     }
 
@@ -1321,12 +4137,21 @@ public:
     {
         auto db = this->db();
         _NestedTxn txn(*this);
+        if constexpr (has_tags)
+            _reap_stale(db, key);
 
         int64_t current = default_value;
-        if (auto blob = db->template exec<std::vector<char>>(INCR_GET_STMT, key))
+        if (auto row = db->template exec<std::vector<char>, std::size_t, std::size_t>(
+                INCR_GET_STMT, key))
         {
-            if (blob->size() == sizeof(int64_t))
-                std::memcpy(&current, blob->data(), sizeof(int64_t));
+            auto& [blob, codec, logical_size] = *row;
+            if (codec != 0)
+            {
+                if (auto value = decompress_value(static_cast<uint8_t>(codec), blob, logical_size))
+                    blob = std::move(*value);
+            }
+            if (blob.size() == sizeof(int64_t))
+                std::memcpy(&current, blob.data(), sizeof(int64_t));
         }
 
         int64_t new_value = current + delta;
@@ -1337,11 +4162,15 @@ public:
         std::array<char, sizeof(int64_t)> buf;
         std::memcpy(buf.data(), &new_value, sizeof(int64_t));
         auto data = std::span<const char>(buf.data(), buf.size());
+        auto value_id = _insert_value_row(db, data);
 
         {
             auto binded = INCR_UPDATE_STMT.bind_all();
             int i = 1;
-            sql_bind(binded.get(), i++, data);
+            if (value_id)
+                sqlite3_bind_int64(binded.get(), i++, value_id->id);
+            else
+                sql_bind(binded.get(), i++, data);
             sql_bind(binded.get(), i++, sizeof(int64_t));
             if constexpr (has_eviction) sql_bind(binded.get(), i++, seq);
             sql_bind(binded.get(), i++, key);
@@ -1350,12 +4179,17 @@ public:
         if (sqlite3_changes(db->get()) == 0)
         {
             auto binded = REPLACE_VALUE_STMT.bind_all();
-            _bind_core_and_policies(binded.get(), key, data, sizeof(int64_t),
-                                    std::optional<double> {}, seq, std::optional<std::string> {});
+            if (value_id)
+                _bind_core_and_policies(binded.get(), key, *value_id, sizeof(int64_t),
+                                        std::optional<double> {}, seq,
+                                        std::optional<std::string> {});
+            else
+                _bind_core_and_policies(binded.get(), key, data, sizeof(int64_t),
+                                        std::optional<double> {}, seq,
+                                        std::optional<std::string> {});
             sqlite3_step(binded.get());
             // New entry created
-            _total_size.fetch_add(sizeof(int64_t), std::memory_order_relaxed);
-            _total_count.fetch_add(1, std::memory_order_relaxed);
+            _add_to_counters({ sizeof(int64_t), sizeof(int64_t) });
         }
         // Size doesn't change on update (always sizeof(int64_t))
 
@@ -1370,33 +4204,82 @@ public:
 
     // --- clear ---
 
+    // Independent of the number of entries. In one transaction the cache
+    // table is renamed aside and a fresh one created; the value directories
+    // are then moved into the storage's trash with a handful of renames. The
+    // background thread deletes the old rows in small batches
+    // (_bg_purge_tables) and unlinks the files through the deletion queue.
     inline void clear()
     {
         auto db = this->db();
-        sqlite3_exec(db->get(), "DELETE FROM cache;", nullptr, nullptr, nullptr);
+        {
+            _NestedTxn txn(*this);
+            auto stamp = std::chrono::system_clock::now().time_since_epoch().count();
+            // Indexes and triggers would follow the renamed tables and,
+            // keeping their names, stop the fresh tables from getting their
+            // own (the triggers would also slow the purge down): drop
+            // whichever exist. Every value file goes, so every blob does; the
+            // values table is purged along with the rows.
+            std::string drops;
+            {
+                sqlite3_stmt* stmt = nullptr;
+                if (sqlite3_prepare_v2(db->get(),
+                        "SELECT type, name FROM sqlite_master"
+                        " WHERE tbl_name IN ('cache', 'cache_values')"
+                        " AND type IN ('index', 'trigger') AND sql IS NOT NULL;",
+                        -1, &stmt, nullptr)
+                    == SQLITE_OK)
+                {
+                    while (sqlite3_step(stmt) == SQLITE_ROW)
+                        drops += std::string(" DROP ")
+                            + reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))
+                            + " IF EXISTS \""
+                            + reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)) + "\";";
+                }
+                sqlite3_finalize(stmt);
+            }
+            (void)db->exec(drops + " DELETE FROM blobs;"
+                           + " ALTER TABLE cache RENAME TO " + std::string(_purge_table_prefix)
+                           + std::to_string(stamp) + ";"
+                           + " ALTER TABLE cache_values RENAME TO "
+                           + std::string(_purge_values_prefix) + std::to_string(stamp) + ";"
+                           + _schema_sql() + _index_sql());
+            txn.commit();
+        }
         _total_size.store(0, std::memory_order_relaxed);
+        _total_logical.store(0, std::memory_order_relaxed);
         _total_count.store(0, std::memory_order_relaxed);
-        // Drop every mmap handle BEFORE removing files. On Linux removing an
-        // mmap'd file succeeds (the inode lingers), but on Windows the file
-        // can't be removed while a mapping exists — clear() would silently
-        // leave files behind. Linux-side this is also a small leak: stale
-        // shared_ptr<MemoryMappedFile> entries pointing at deleted inodes.
-        storage->clear_mmap_cache();
-        if (std::filesystem::exists(cache_path) && std::filesystem::is_directory(cache_path))
+        // defer_remove_all() drops every mmap handle BEFORE moving files. On
+        // Linux moving an mmap'd file succeeds (the inode lingers), but on
+        // Windows the file can't be moved while a mapping exists — clear()
+        // would silently leave files behind. Linux-side this is also a small
+        // leak: stale shared_ptr<MemoryMappedFile> entries pointing at
+        // deleted inodes.
+        std::vector<std::filesystem::path> entries;
+        if (!_ephemeral && std::filesystem::exists(cache_path)
+            && std::filesystem::is_directory(cache_path))
         {
             for (const auto& entry : std::filesystem::directory_iterator(cache_path))
             {
                 auto fname = entry.path().filename().string();
-                if (fname != db_fname && !fname.starts_with(std::string(db_fname)))
-                    std::filesystem::remove_all(entry);
+                if (fname != db_fname && !fname.starts_with(std::string(db_fname))
+                    && fname != DiskStorage::trash_dirname)
+                    entries.push_back(entry.path());
             }
         }
+        storage->defer_remove_all(entries);
+        _wake_background(_drain_requested);
     }
 
     // --- meta ---
 
+    // Keys starting with "gen:" hold the tag generations of evict_tag() and
+    // are reserved: a foreign value there would hide the tag's entries.
     inline void set_meta(const std::string& key, const std::string& value)
     {
+        if (key.starts_with(_tag_gen_prefix))
+            throw std::invalid_argument("meta keys starting with \""
+                                        + std::string(_tag_gen_prefix) + "\" are reserved");
         db()->exec(SET_META_STMT, key, value);
     }
 
@@ -1409,10 +4292,23 @@ public:
     {
         bool ok = true;
         std::size_t orphaned_files = 0;
+        // Rows of cache_values (see StoreOptions::separate_values) no entry
+        // points at.
+        std::size_t orphaned_values = 0;
         std::size_t dangling_rows = 0;
         std::size_t size_mismatches = 0;
+        // Files of the right size whose bytes no longer hash to their row's
+        // checksum.
+        std::size_t checksum_mismatches = 0;
         bool counters_consistent = true;
         bool sqlite_integrity_ok = true;
+        // Whether volume()'s running total matched the directory walk. Not
+        // part of ok: other live processes may hold unflushed deltas.
+        bool volume_consistent = true;
+        std::size_t rows_checked = 0;
+        // check_incremental(): the slice reached the end of the key space
+        // and the next call starts over.
+        bool pass_complete = true;
 
         explicit operator bool() const { return ok; }
     };
@@ -1421,21 +4317,83 @@ public:
     {
         auto db = this->db();
         CheckResult result;
+        // Files already queued for deletion are neither orphans nor live.
+        storage->drain_removals();
 
         result.sqlite_integrity_ok = _check_sqlite_integrity(db);
-        result.dangling_rows = _check_dangling_rows(db, fix);
-        result.size_mismatches = _check_size_mismatches(db, fix);
-        result.orphaned_files = _check_orphaned_files(db, fix);
+        // One read of the file-backed rows serves the dangling-row, size,
+        // checksum and orphan checks.
+        auto rows = _select_file_rows(db->get(), std::nullopt, SIZE_MAX);
+        _stat_file_rows(rows);
+        _tally_file_rows(rows, result);
+        if (fix)
+            _fix_file_rows(db, rows);
+        result.orphaned_files = _check_orphaned_files(rows, fix);
+        _check_value_rows(db, result, fix);
         result.counters_consistent = _check_counters(db, fix);
+        result.volume_consistent = _check_volume(db, fix);
 
         result.ok = result.sqlite_integrity_ok
                  && result.dangling_rows == 0
                  && result.size_mismatches == 0
+                 && result.checksum_mismatches == 0
                  && result.orphaned_files == 0
+                 && result.orphaned_values == 0
                  && result.counters_consistent;
         return result;
     }
 
+    // Entries whose cache_values row is gone are dangling; cache_values rows
+    // no entry points at are orphans. `fix` deletes both.
+    void _check_value_rows(DbGuard& db, CheckResult& result, bool fix)
+    {
+        static const std::string dangling =
+            " FROM cache WHERE value_id IS NOT NULL AND value_id NOT IN (SELECT id FROM cache_values);";
+        static const std::string orphans =
+            " FROM cache_values WHERE id NOT IN"
+            " (SELECT value_id FROM cache WHERE value_id IS NOT NULL);";
+        auto dangling_rows = db->template exec<std::size_t>("SELECT COUNT(*)" + dangling).value_or(0);
+        result.dangling_rows += dangling_rows;
+        result.orphaned_values = db->template exec<std::size_t>("SELECT COUNT(*)" + orphans).value_or(0);
+        if (fix && dangling_rows > 0)
+            (void)db->exec("DELETE" + dangling);
+        if (fix && result.orphaned_values > 0)
+            (void)db->exec("DELETE" + orphans);
+    }
+
+    // Check the next `max_rows` file-backed rows, in key order, for missing
+    // files, size and checksum mismatches, resuming from a cursor persisted in meta so
+    // successive calls (from any process) sweep the whole cache. The store
+    // lock is held only to read the slice and to apply fixes, never across
+    // the stat and hash calls. Orphan, counter and volume checks need a view of the
+    // whole cache and remain check()'s job.
+    CheckResult check_incremental(std::size_t max_rows = 4096, bool fix = false)
+    {
+        max_rows = std::max<std::size_t>(max_rows, 1);
+        CheckResult result;
+        std::vector<_FileRow> rows;
+        {
+            auto db = this->db();
+            auto cursor = db->template exec<std::string>(GET_META_STMT, std::string(_check_cursor_key));
+            rows = _select_file_rows(db->get(), cursor, max_rows);
+        }
+        _stat_file_rows(rows);
+        _tally_file_rows(rows, result);
+        {
+            auto db = this->db();
+            if (fix)
+                _fix_file_rows(db, rows);
+            result.pass_complete = rows.size() < max_rows;
+            if (result.pass_complete)
+                db->exec("DELETE FROM meta WHERE key = ?;", std::string(_check_cursor_key));
+            else
+                db->exec(SET_META_STMT, std::string(_check_cursor_key), rows.back().key);
+        }
+        result.ok = result.dangling_rows == 0 && result.size_mismatches == 0
+            && result.checksum_mismatches == 0;
+        return result;
+    }
+
     // --- Stats (only with WithStats) ---
 
     struct Stats
@@ -1458,6 +4416,45 @@ public:
         WithStats::_misses.store(0, std::memory_order_relaxed);
     }
 
+    // --- WAL checkpointing ---
+
+    [[nodiscard]] CheckpointPolicy checkpoint_policy() const
+    {
+        return { _wal_passive_pages.load(std::memory_order_relaxed),
+                 _wal_truncate_pages.load(std::memory_order_relaxed),
+                 std::chrono::milliseconds(_housekeeping_ms.load(std::memory_order_relaxed)) };
+    }
+
+    void set_checkpoint_policy(const CheckpointPolicy& policy)
+    {
+        _wal_passive_pages.store(std::max<std::size_t>(policy.passive_pages, 1),
+                                 std::memory_order_relaxed);
+        _wal_truncate_pages.store(policy.truncate_pages, std::memory_order_relaxed);
+        _housekeeping_ms.store(std::max<int64_t>(policy.housekeeping_interval.count(), 1),
+                               std::memory_order_relaxed);
+        // Reschedule the pending housekeeping tick under the new interval.
+        _wake_background(_policy_changed);
+    }
+
+    [[nodiscard]] WalStats wal_stats() const
+    {
+        std::error_code ec;
+        auto wal_bytes = std::filesystem::file_size(
+            cache_path / (std::string(db_fname) + "-wal"), ec);
+        return { _wal_pages.load(std::memory_order_relaxed),
+                 ec ? 0 : static_cast<uint64_t>(wal_bytes),
+                 _checkpoints.load(std::memory_order_relaxed),
+                 _truncating_checkpoints.load(std::memory_order_relaxed),
+                 _last_checkpoint_us.load(std::memory_order_relaxed),
+                 _max_checkpoint_us.load(std::memory_order_relaxed),
+                 _total_checkpoint_us.load(std::memory_order_relaxed) };
+    }
+
+    // Hit/miss counters and occupancy of the storage's mmap handle cache.
+    [[nodiscard]] MmapCacheStats mmap_cache_stats() const { return storage->mmap_cache_stats(); }
+
+    void reset_mmap_cache_stats() { storage->reset_mmap_cache_stats(); }
+
     bool _check_sqlite_integrity(DbGuard& db)
     {
         if (auto r = db->template exec<std::string>("PRAGMA integrity_check;"))
@@ -1465,142 +4462,254 @@ public:
         return false;
     }
 
-    std::size_t _check_dangling_rows(DbGuard& db, bool fix)
-    {
-        std::size_t count = 0;
+    static constexpr std::string_view _check_cursor_key = "check_cursor";
 
-        struct Dangling { std::string key; std::size_t entry_size; };
-        std::vector<Dangling> to_fix;
+    struct _FileRow
+    {
+        std::string key;
+        std::string path;
+        std::size_t size;
+        std::size_t logical_size;
+        std::size_t checksum; // 0: none recorded
+        std::optional<std::size_t> on_disk;
+        bool missing = false;
+        bool corrupt = false;
+    };
 
+    // File-backed rows in key order, strictly after `after` when given.
+    static std::vector<_FileRow> _select_file_rows(sqlite3* conn,
+                                                   const std::optional<std::string>& after,
+                                                   std::size_t limit)
+    {
+        std::vector<_FileRow> rows;
+        auto sql = "SELECT key, path, size, " + _logical_sql()
+            + ", COALESCE(checksum, 0) FROM cache WHERE path IS NOT NULL"
+            + (after ? " AND key > ?1" : "") + " ORDER BY key LIMIT ?2;";
+        sqlite3_stmt* stmt = nullptr;
+        sqlite3_prepare_v2(conn, sql.c_str(), -1, &stmt, nullptr);
+        if (after)
+            sqlite3_bind_text(stmt, 1, after->c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int64(stmt, 2,
+            static_cast<sqlite3_int64>(std::min<std::size_t>(limit, INT64_MAX)));
+        while (sqlite3_step(stmt) == SQLITE_ROW)
         {
-            sqlite3_stmt* stmt = nullptr;
-            sqlite3_prepare_v2(db->get(),
-                "SELECT key, path, size FROM cache WHERE path IS NOT NULL;",
-                -1, &stmt, nullptr);
-            while (sqlite3_step(stmt) == SQLITE_ROW)
-            {
-                auto path = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-                if (path && !std::filesystem::exists(storage->abs_path(path)))
-                {
-                    ++count;
-                    if (fix)
-                    {
-                        auto key = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-                        auto sz = static_cast<std::size_t>(sqlite3_column_int64(stmt, 2));
-                        to_fix.push_back({ key, sz });
-                    }
-                }
-            }
-            sqlite3_finalize(stmt);
+            auto key = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            auto path = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+            rows.push_back({ key ? key : "", path ? path : "",
+                             static_cast<std::size_t>(sqlite3_column_int64(stmt, 2)),
+                             static_cast<std::size_t>(sqlite3_column_int64(stmt, 3)),
+                             static_cast<std::size_t>(sqlite3_column_int64(stmt, 4)),
+                             std::nullopt, false, false });
         }
+        sqlite3_finalize(stmt);
+        return rows;
+    }
 
-        if (fix)
+    // stat() every row's file across a small worker pool: on a cold or
+    // networked cache directory the calls are latency-bound, not CPU-bound.
+    // Files of the recorded size are hashed against their checksum too.
+    void _stat_file_rows(std::vector<_FileRow>& rows) const
+    {
+        auto stat_range = [this, &rows](std::size_t begin, std::size_t end)
         {
-            for (auto& [key, sz] : to_fix)
+            for (auto i = begin; i < end; ++i)
             {
-                db->exec(DELETE_STMT, key);
-                _total_size.fetch_sub(sz, std::memory_order_relaxed);
-                _total_count.fetch_sub(1, std::memory_order_relaxed);
+                auto& row = rows[i];
+                std::error_code ec;
+                auto sz = storage->value_size(row.path, ec);
+                if (!ec)
+                    row.on_disk = sz;
+                else if (ec == std::errc::no_such_file_or_directory)
+                    row.missing = true;
+                if (row.checksum != 0 && row.on_disk == row.size)
+                    row.corrupt = !_file_matches(row.path, row.checksum);
             }
+        };
+        constexpr std::size_t rows_per_worker = 256;
+        auto workers = std::min<std::size_t>(
+            { std::max(1u, std::thread::hardware_concurrency()), std::size_t { 8 },
+              (rows.size() + rows_per_worker - 1) / rows_per_worker });
+        if (workers <= 1)
+        {
+            stat_range(0, rows.size());
+            return;
         }
-
-        return count;
+        auto chunk = (rows.size() + workers - 1) / workers;
+        std::vector<std::thread> pool;
+        for (std::size_t w = 1; w < workers; ++w)
+            pool.emplace_back(stat_range, w * chunk, std::min(rows.size(), (w + 1) * chunk));
+        stat_range(0, chunk);
+        for (auto& t : pool)
+            t.join();
     }
 
-    std::size_t _check_size_mismatches(DbGuard& db, bool fix)
+    static void _tally_file_rows(const std::vector<_FileRow>& rows, CheckResult& result)
     {
-        std::size_t count = 0;
-
-        struct Mismatch { std::string key; std::size_t db_size; std::size_t file_size; };
-        std::vector<Mismatch> to_fix;
-
+        for (const auto& row : rows)
         {
-            sqlite3_stmt* stmt = nullptr;
-            sqlite3_prepare_v2(db->get(),
-                "SELECT key, path, size FROM cache WHERE path IS NOT NULL;",
-                -1, &stmt, nullptr);
-            while (sqlite3_step(stmt) == SQLITE_ROW)
-            {
-                auto path = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-                auto abs = path ? storage->abs_path(path) : std::filesystem::path {};
-                if (!path || !std::filesystem::exists(abs))
-                    continue; // dangling row — handled separately
-
-                auto db_size = static_cast<std::size_t>(sqlite3_column_int64(stmt, 2));
-                auto file_size = std::filesystem::file_size(abs);
-                if (db_size != file_size)
-                {
-                    ++count;
-                    if (fix)
-                    {
-                        auto key = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
-                        to_fix.push_back({ key, db_size, file_size });
-                    }
-                }
-            }
-            sqlite3_finalize(stmt);
+            if (row.missing)
+                ++result.dangling_rows;
+            else if (row.on_disk && *row.on_disk != row.size)
+                ++result.size_mismatches;
+            else if (row.corrupt)
+                ++result.checksum_mismatches;
         }
+        result.rows_checked += rows.size();
+    }
 
-        if (fix)
+    // Drop rows whose file is gone or corrupt and align sizes with the
+    // files. Each fix re-checks the path, so a row rewritten since it was
+    // read is left alone.
+    void _fix_file_rows(DbGuard& db, const std::vector<_FileRow>& rows)
+    {
+        for (const auto& row : rows)
         {
-            for (auto& [key, db_size, file_size] : to_fix)
+            if (row.missing)
             {
-                db->exec("UPDATE cache SET size = ? WHERE key = ?;", file_size, key);
-                if (file_size > db_size)
-                    _total_size.fetch_add(file_size - db_size, std::memory_order_relaxed);
-                else
-                    _total_size.fetch_sub(db_size - file_size, std::memory_order_relaxed);
+                db->exec("DELETE FROM cache WHERE key = ? AND path = ?;", row.key, row.path);
+                if (sqlite3_changes(db->get()) == 0)
+                    continue;
+                _remove_from_counters({ row.size, row.logical_size });
+            }
+            else if (row.on_disk && *row.on_disk != row.size)
+            {
+                // The file is taken as it is: the checksum of what was
+                // written no longer describes it.
+                db->exec("UPDATE cache SET size = ?, checksum = NULL WHERE key = ? AND path = ?;",
+                         *row.on_disk, row.key, row.path);
+                if (sqlite3_changes(db->get()) == 0)
+                    continue;
+                _adjust(_total_size, row.size, *row.on_disk);
+                // An uncompressed row's decoded size is its size.
+                if (row.logical_size == row.size)
+                    _adjust(_total_logical, row.size, *row.on_disk);
+            }
+            else if (row.corrupt && _delete_file_row(db, row.key, row.path))
+            {
+                _corrupt_values.fetch_add(1, std::memory_order_relaxed);
+                _queue_removal(row.path);
             }
         }
+    }
 
-        return count;
+    // The directories value files live in: the cache directory, and the
+    // cold tier's root if there is one.
+    std::vector<std::filesystem::path> _value_roots() const
+    {
+        std::vector<std::filesystem::path> roots { cache_path };
+        if (auto cold = storage->cold_path(); !cold.empty())
+            roots.push_back(std::move(cold));
+        return roots;
     }
 
-    std::size_t _check_orphaned_files(DbGuard& db, bool fix)
+    // Block-rounded bytes of the value files found under the value roots;
+    // for an ephemeral store, the bytes its storage holds.
+    std::size_t _walk_value_bytes() const
     {
-        // Collect all known file paths from DB
-        std::unordered_set<std::string> known_paths;
+        if constexpr (_ephemeral)
+            return storage->held_bytes();
+        std::size_t walked = 0;
+        for (const auto& root : _value_roots())
         {
-            sqlite3_stmt* stmt = nullptr;
-            sqlite3_prepare_v2(db->get(),
-                "SELECT path FROM cache WHERE path IS NOT NULL;",
-                -1, &stmt, nullptr);
-            while (sqlite3_step(stmt) == SQLITE_ROW)
+            std::error_code ec;
+            for (auto it = std::filesystem::recursive_directory_iterator(root, ec);
+                 !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
             {
-                if (auto p = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)))
-                    known_paths.insert(storage->abs_path(p).lexically_normal().string());
+                std::error_code fec;
+                if (!it->is_regular_file(fec))
+                    continue;
+                auto fname = it->path().filename().string();
+                if (fname == db_fname || fname.starts_with(std::string(db_fname)))
+                    continue;
+                walked += storage->footprint(it->file_size(fec));
             }
-            sqlite3_finalize(stmt);
         }
+        return walked;
+    }
+
+    bool _check_volume(DbGuard& db, bool fix)
+    {
+        auto walked = _walk_value_bytes();
+        auto tracked = storage->bytes_delta()
+            + static_cast<int64_t>(
+                db->template exec<std::size_t>(GET_META_STMT, std::string("file_bytes")).value_or(0));
+        bool consistent = tracked == static_cast<int64_t>(walked);
+        if (!consistent && fix)
+        {
+            (void)storage->take_bytes_delta();
+            db->exec(SET_META_STMT, std::string("file_bytes"), walked);
+        }
+        return consistent;
+    }
+
+    std::size_t _check_orphaned_files(const std::vector<_FileRow>& rows, bool fix)
+    {
+        std::unordered_set<std::string> known_paths;
+        known_paths.reserve(rows.size());
+        for (const auto& row : rows)
+            known_paths.insert(storage->abs_path(row.path).lexically_normal().string());
+        if constexpr (_ephemeral)
+            return storage->collect_unreferenced(known_paths, fix);
 
         std::size_t count = 0;
 
         if (!std::filesystem::exists(cache_path))
             return 0;
 
-        for (auto& entry : std::filesystem::recursive_directory_iterator(cache_path))
+        auto trash = storage->trash_path().lexically_normal();
+        auto cold_trash = storage->cold_trash_path().lexically_normal();
+        for (const auto& root : _value_roots())
         {
-            if (!entry.is_regular_file())
+            if (!std::filesystem::exists(root))
                 continue;
+            for (auto it = std::filesystem::recursive_directory_iterator(root);
+                 it != std::filesystem::recursive_directory_iterator(); ++it)
+            {
+                const auto& entry = *it;
+                if (entry.is_directory()
+                    && (entry.path().lexically_normal() == trash
+                        || entry.path().lexically_normal() == cold_trash))
+                {
+                    it.disable_recursion_pending();
+                    continue;
+                }
+                // A chunked value, or one left half-written in sync mode,
+                // is one entry however many chunks it has.
+                if (auto name = entry.path().filename().string();
+                    entry.is_directory()
+                    && (name.ends_with(DiskStorage::chunks_suffix)
+                        || name.ends_with(std::string(DiskStorage::chunks_suffix) + ".tmp")))
+                {
+                    it.disable_recursion_pending();
+                    if (known_paths.contains(entry.path().lexically_normal().string()))
+                        continue;
+                    ++count;
+                    if (fix)
+                        std::filesystem::remove_all(entry.path());
+                    continue;
+                }
+                if (!entry.is_regular_file())
+                    continue;
 
-            auto fname = entry.path().filename().string();
-            // Skip database files (db, WAL, SHM, journal)
-            if (fname == db_fname || fname.starts_with(std::string(db_fname)))
-                continue;
+                auto fname = entry.path().filename().string();
+                // Skip database files (db, WAL, SHM, journal)
+                if (fname == db_fname || fname.starts_with(std::string(db_fname)))
+                    continue;
 
-            auto path_str = entry.path().lexically_normal().string();
-            if (known_paths.find(path_str) == known_paths.end())
-            {
-                ++count;
-                if (fix)
-                    std::filesystem::remove(entry.path());
+                auto path_str = entry.path().lexically_normal().string();
+                if (known_paths.find(path_str) == known_paths.end())
+                {
+                    ++count;
+                    if (fix)
+                        std::filesystem::remove(entry.path());
+                }
             }
         }
 
         return count;
     }
 
-    // The background checkpoint thread now takes _mtx around _bg_evict and
+    // The background checkpoint thread takes _mtx around its row deletions and
     // _resync_counters, so check() and the BG thread no longer race on the
     // atomic counters.
     bool _check_counters(DbGuard& db, bool fix)
@@ -0,0 +1,399 @@
+/*
+** CNRS LPP PROJECT, 2025
+** Cache
+** File description:
+** Batched file I/O: io_uring on Linux, plain syscalls elsewhere
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/types.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>) && !defined(SCIQLOP_CACHE_NO_IO_URING)
+#define SCIQLOP_CACHE_HAS_IO_URING 1
+#include <atomic>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+// One independent file operation of a batch. `result` follows the syscall
+// convention of io_uring: >= 0 on success (fd, bytes, 0), -errno on failure.
+struct IoOp
+{
+    enum class Kind : uint8_t
+    {
+        open,
+        read,
+        write,
+        close,
+        unlink,
+        fdatasync
+    };
+
+    Kind kind;
+    int fd = -1;
+    const char* path = nullptr;
+    char* buf = nullptr;
+    std::size_t len = 0;
+    uint64_t offset = 0;
+    int flags = 0;
+    int result = 0;
+
+    static IoOp open(const char* path, int flags)
+    {
+        return { Kind::open, -1, path, nullptr, 0, 0, flags, 0 };
+    }
+    static IoOp read(int fd, char* buf, std::size_t len, uint64_t offset = 0)
+    {
+        return { Kind::read, fd, nullptr, buf, len, offset, 0, 0 };
+    }
+    static IoOp write(int fd, const char* buf, std::size_t len, uint64_t offset = 0)
+    {
+        return { Kind::write, fd, nullptr, const_cast<char*>(buf), len, offset, 0, 0 };
+    }
+    static IoOp close(int fd) { return { Kind::close, fd, nullptr, nullptr, 0, 0, 0, 0 }; }
+    static IoOp unlink(const char* path) { return { Kind::unlink, -1, path, nullptr, 0, 0, 0, 0 }; }
+    static IoOp fdatasync(int fd) { return { Kind::fdatasync, fd, nullptr, nullptr, 0, 0, 0, 0 }; }
+};
+
+// Runs batches of IoOp to completion. On Linux the batch goes through an
+// io_uring: a whole wave of opens, reads, writes, syncs, closes or unlinks
+// costs one io_uring_enter() instead of one syscall per file, and the kernel
+// can keep the device queue full (many fdatasyncs in flight at once let the
+// filesystem merge their journal commits). Where io_uring is missing (old kernel, seccomp,
+// io_uring_disabled, other OSes, or built with SCIQLOP_CACHE_NO_IO_URING) and
+// for opcodes the running kernel does not know, each op falls back to the
+// equivalent plain syscall, so callers never need a second code path.
+// Not thread-safe: callers serialize access to one instance.
+class BatchIo
+{
+public:
+    static constexpr unsigned ring_entries = 256;
+
+    explicit BatchIo(bool use_io_uring = true)
+    {
+#if defined(SCIQLOP_CACHE_HAS_IO_URING)
+        if (use_io_uring)
+            _setup();
+#else
+        (void)use_io_uring;
+#endif
+    }
+
+    ~BatchIo() { _teardown(); }
+
+    BatchIo(const BatchIo&) = delete;
+    BatchIo& operator=(const BatchIo&) = delete;
+
+    [[nodiscard]] bool uses_io_uring() const noexcept
+    {
+#if defined(SCIQLOP_CACHE_HAS_IO_URING)
+        return _ring_fd >= 0;
+#else
+        return false;
+#endif
+    }
+
+    // Fills in every op's result. Ops of one call must not depend on each
+    // other: they may run in any order.
+    void run(std::span<IoOp> ops)
+    {
+#if defined(SCIQLOP_CACHE_HAS_IO_URING)
+        if (_ring_fd >= 0)
+        {
+            for (std::size_t begin = 0; begin < ops.size(); begin += _sq_entries)
+            {
+                auto wave = ops.subspan(begin, std::min<std::size_t>(_sq_entries, ops.size() - begin));
+                if (_ring_fd < 0 || !_run_wave(wave))
+                    for (auto& op : wave)
+                        op.result = -EAGAIN;
+            }
+            // -EINVAL is also what a kernel too old for an opcode answers.
+            for (auto& op : ops)
+                if (op.result == -EINVAL || op.result == -EOPNOTSUPP || op.result == -EAGAIN)
+                    _run_sync(op);
+            return;
+        }
+#endif
+        for (auto& op : ops)
+            _run_sync(op);
+    }
+
+    // Flush a file's data (and the metadata needed to read it back) to the
+    // device. macOS's fsync() stops at the drive cache; F_FULLFSYNC does not.
+    static int sync_data([[maybe_unused]] int fd)
+    {
+#if defined(__APPLE__)
+        if (::fcntl(fd, F_FULLFSYNC) == 0)
+            return 0;
+        return ::fsync(fd);
+#elif defined(_WIN32)
+        return -1;
+#elif defined(_POSIX_SYNCHRONIZED_IO) && _POSIX_SYNCHRONIZED_IO > 0
+        return ::fdatasync(fd);
+#else
+        return ::fsync(fd);
+#endif
+    }
+
+private:
+    static void _run_sync(IoOp& op)
+    {
+#if !defined(_WIN32)
+        long r = -ENOSYS;
+        switch (op.kind)
+        {
+            case IoOp::Kind::open:
+                r = ::open(op.path, op.flags, 0644);
+                break;
+            case IoOp::Kind::read:
+                r = ::pread(op.fd, op.buf, op.len, static_cast<off_t>(op.offset));
+                break;
+            case IoOp::Kind::write:
+                r = ::pwrite(op.fd, op.buf, op.len, static_cast<off_t>(op.offset));
+                break;
+            case IoOp::Kind::close:
+                r = ::close(op.fd);
+                break;
+            case IoOp::Kind::unlink:
+                r = ::unlink(op.path);
+                break;
+            case IoOp::Kind::fdatasync:
+                r = sync_data(op.fd);
+                break;
+        }
+        op.result = r < 0 ? -errno : static_cast<int>(r);
+#else
+        op.result = -ENOSYS;
+#endif
+    }
+
+#if defined(SCIQLOP_CACHE_HAS_IO_URING)
+    int _ring_fd = -1;
+    unsigned _sq_entries = 0;
+    void* _sq_ring = MAP_FAILED;
+    void* _cq_ring = MAP_FAILED;
+    std::size_t _sq_ring_size = 0;
+    std::size_t _cq_ring_size = 0;
+    io_uring_sqe* _sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    std::size_t _sqes_size = 0;
+    unsigned* _sq_tail = nullptr;
+    unsigned* _sq_mask = nullptr;
+    unsigned* _sq_array = nullptr;
+    unsigned* _cq_head = nullptr;
+    unsigned* _cq_tail = nullptr;
+    unsigned* _cq_mask = nullptr;
+    io_uring_cqe* _cqes = nullptr;
+
+    static unsigned _load_acquire(unsigned* p)
+    {
+        return std::atomic_ref<unsigned>(*p).load(std::memory_order_acquire);
+    }
+
+    static void _store_release(unsigned* p, unsigned v)
+    {
+        std::atomic_ref<unsigned>(*p).store(v, std::memory_order_release);
+    }
+
+    void _setup()
+    {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        int fd = static_cast<int>(::syscall(__NR_io_uring_setup, ring_entries, &p));
+        if (fd < 0)
+            return;
+        _ring_fd = fd;
+        _sq_entries = p.sq_entries;
+        _sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        _cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        const bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single_mmap)
+            _sq_ring_size = _cq_ring_size = std::max(_sq_ring_size, _cq_ring_size);
+        _sq_ring = ::mmap(nullptr, _sq_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+        if (_sq_ring == MAP_FAILED)
+            return _teardown();
+        _cq_ring = single_mmap ? _sq_ring
+                               : ::mmap(nullptr, _cq_ring_size, PROT_READ | PROT_WRITE,
+                                        MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (_cq_ring == MAP_FAILED)
+            return _teardown();
+        _sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+        _sqes = static_cast<io_uring_sqe*>(::mmap(nullptr, _sqes_size, PROT_READ | PROT_WRITE,
+                                                  MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES));
+        if (_sqes == MAP_FAILED)
+            return _teardown();
+        auto* sq = static_cast<char*>(_sq_ring);
+        auto* cq = static_cast<char*>(_cq_ring);
+        _sq_tail = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        _sq_mask = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        _sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        _cq_head = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        _cq_tail = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        _cq_mask = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        _cqes = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+    }
+
+    static void _prep(io_uring_sqe& sqe, const IoOp& op)
+    {
+        std::memset(&sqe, 0, sizeof(sqe));
+        if (op.len > _max_len)
+        {
+            // Too large for an io_uring length (and an int result): done
+            // synchronously by run().
+            sqe.opcode = IORING_OP_NOP;
+            return;
+        }
+        switch (op.kind)
+        {
+            case IoOp::Kind::open:
+                sqe.opcode = IORING_OP_OPENAT;
+                sqe.fd = AT_FDCWD;
+                sqe.addr = reinterpret_cast<uint64_t>(op.path);
+                sqe.len = 0644;
+                sqe.open_flags = static_cast<uint32_t>(op.flags);
+                break;
+            case IoOp::Kind::read:
+                sqe.opcode = IORING_OP_READ;
+                sqe.fd = op.fd;
+                sqe.addr = reinterpret_cast<uint64_t>(op.buf);
+                sqe.len = static_cast<uint32_t>(op.len);
+                sqe.off = op.offset;
+                break;
+            case IoOp::Kind::write:
+                sqe.opcode = IORING_OP_WRITE;
+                sqe.fd = op.fd;
+                sqe.addr = reinterpret_cast<uint64_t>(op.buf);
+                sqe.len = static_cast<uint32_t>(op.len);
+                sqe.off = op.offset;
+                break;
+            case IoOp::Kind::close:
+                sqe.opcode = IORING_OP_CLOSE;
+                sqe.fd = op.fd;
+                break;
+            case IoOp::Kind::unlink:
+                sqe.opcode = IORING_OP_UNLINKAT;
+                sqe.fd = AT_FDCWD;
+                sqe.addr = reinterpret_cast<uint64_t>(op.path);
+                break;
+            case IoOp::Kind::fdatasync:
+                sqe.opcode = IORING_OP_FSYNC;
+                sqe.fd = op.fd;
+                sqe.fsync_flags = IORING_FSYNC_DATASYNC;
+                break;
+        }
+    }
+
+    static constexpr std::size_t _max_len = 1u << 30;
+
+    // Submit at most one ring's worth of ops and wait for all of them.
+    // Returns false if none could be submitted. Once io_uring_enter() fails
+    // for good, the SQEs the kernel never took are taken back (-EAGAIN: run()
+    // redoes them synchronously) and the ring is only drained. Ops in flight
+    // may still use their descriptors and buffers, so they are waited for,
+    // never redone, or failed (-EIO) if even that does not work. The ring is
+    // torn down afterwards either way.
+    bool _run_wave(std::span<IoOp> wave)
+    {
+        auto tail = *_sq_tail;
+        for (std::size_t i = 0; i < wave.size(); ++i, ++tail)
+        {
+            auto slot = tail & *_sq_mask;
+            _prep(_sqes[slot], wave[i]);
+            _sqes[slot].user_data = i;
+            _sq_array[slot] = slot;
+            wave[i].result = -EINPROGRESS;
+        }
+        _store_release(_sq_tail, tail);
+
+        std::size_t submitted = 0;
+        std::size_t completed = 0;
+        std::size_t expected = wave.size();
+        bool failed = false;
+        int drain_errors = 0;
+        while (completed < expected)
+        {
+            auto to_submit = failed ? 0u : static_cast<unsigned>(wave.size() - submitted);
+            auto r = ::syscall(__NR_io_uring_enter, _ring_fd, to_submit,
+                               static_cast<unsigned>(expected - completed),
+                               IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (r < 0 && errno != EINTR)
+            {
+                if (!failed && submitted == 0 && completed == 0)
+                {
+                    // Nothing reached the kernel: take the SQEs back.
+                    _store_release(_sq_tail, tail - static_cast<unsigned>(wave.size()));
+                    return false;
+                }
+                if (!failed)
+                {
+                    // The kernel takes SQEs in ring order: the ops from
+                    // `submitted` on never reached it.
+                    failed = true;
+                    _store_release(_sq_tail,
+                                   tail - static_cast<unsigned>(wave.size() - submitted));
+                    for (auto i = submitted; i < wave.size(); ++i)
+                        wave[i].result = -EAGAIN;
+                    expected = submitted;
+                }
+                else if (errno != EBUSY && errno != EAGAIN && ++drain_errors > 3)
+                    break;
+            }
+            if (r > 0)
+                submitted += static_cast<std::size_t>(r);
+            auto head = *_cq_head;
+            auto cq_tail = _load_acquire(_cq_tail);
+            for (; head != cq_tail; ++head)
+            {
+                const auto& cqe = _cqes[head & *_cq_mask];
+                if (cqe.user_data < wave.size())
+                {
+                    auto& op = wave[cqe.user_data];
+                    op.result = op.len > _max_len ? -EAGAIN : cqe.res;
+                }
+                ++completed;
+            }
+            _store_release(_cq_head, head);
+        }
+        if (failed)
+        {
+            // Closing the ring cancels whatever is still in flight.
+            _teardown();
+            for (auto& op : wave)
+                if (op.result == -EINPROGRESS)
+                    op.result = -EIO;
+        }
+        return true;
+    }
+
+    void _teardown()
+    {
+        if (_sqes != MAP_FAILED)
+            ::munmap(_sqes, _sqes_size);
+        if (_cq_ring != MAP_FAILED && _cq_ring != _sq_ring)
+            ::munmap(_cq_ring, _cq_ring_size);
+        if (_sq_ring != MAP_FAILED)
+            ::munmap(_sq_ring, _sq_ring_size);
+        _sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+        _cq_ring = _sq_ring = MAP_FAILED;
+        if (_ring_fd >= 0)
+            ::close(_ring_fd);
+        _ring_fd = -1;
+    }
+#else
+    void _teardown() { }
+#endif
+};
@@ -1,13 +1,22 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <cpp_utils/io/memory_mapped_file.hpp>
 #include <cstdio>
 #include <filesystem>
 #include <memory>
+#include <mutex>
 #include <sqlite3.h>
 #include <string>
 #include <uuid.h>
 #include <vector>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 using namespace cpp_utils::io;
 
@@ -43,8 +52,222 @@ public:
     {
         return std::vector<char>(mmf.data(), mmf.data() + mmf.size());
     }
+
+    // Values are nearly always consumed whole: ask the kernel to start
+    // reading the mapping in ahead of the first page faults.
+    inline void advise_willneed() const noexcept
+    {
+#if !defined(_WIN32)
+        if (mmf.data() && mmf.size())
+            (void)::posix_madvise(const_cast<char*>(mmf.data()), mmf.size(),
+                                  POSIX_MADV_WILLNEED);
+#endif
+    }
+};
+
+#if !defined(_WIN32)
+// A value stored as several chunk files (see DiskStorage::set_chunk_policy),
+// mapped side by side into one reserved address range so that it reads as a
+// single contiguous block. Nothing is read up front: pages come in as they
+// are touched, each chunk with its own readahead, so a range read faults in
+// only the chunks it covers. Every chunk but the last must be a whole
+// number of pages.
+class ChunkedMappedFile:public IMemoryView
+{
+    char* _base = nullptr;
+    std::size_t _size = 0;
+    std::size_t _reserved = 0;
+
+public:
+    explicit ChunkedMappedFile(const std::vector<std::filesystem::path>& chunks)
+    {
+        const auto page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        std::vector<std::size_t> sizes;
+        sizes.reserve(chunks.size());
+        for (std::size_t i = 0; i < chunks.size(); ++i)
+        {
+            sizes.push_back(std::filesystem::file_size(chunks[i]));
+            if (i + 1 < chunks.size() && sizes.back() % page != 0)
+                throw std::runtime_error("Misaligned value chunk: " + chunks[i].string());
+            _size += sizes.back();
+        }
+        _reserved = std::max(page, (_size + page - 1) / page * page);
+        auto* base = ::mmap(nullptr, _reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED)
+            throw std::runtime_error("Failed to reserve address space for a chunked value");
+        _base = static_cast<char*>(base);
+        std::size_t offset = 0;
+        for (std::size_t i = 0; i < chunks.size(); ++i)
+        {
+            if (sizes[i] == 0)
+                continue;
+            int fd = ::open(chunks[i].c_str(), O_RDONLY | O_CLOEXEC);
+            auto* p = fd < 0 ? MAP_FAILED
+                             : ::mmap(_base + offset, sizes[i], PROT_READ, MAP_SHARED | MAP_FIXED,
+                                      fd, 0);
+            if (fd >= 0)
+                ::close(fd);
+            if (p == MAP_FAILED)
+            {
+                ::munmap(_base, _reserved);
+                _base = nullptr;
+                throw std::runtime_error("Failed to map value chunk: " + chunks[i].string());
+            }
+            offset += sizes[i];
+        }
+    }
+
+    ~ChunkedMappedFile()
+    {
+        if (_base)
+            ::munmap(_base, _reserved);
+    }
+
+    ChunkedMappedFile(const ChunkedMappedFile&) = delete;
+    ChunkedMappedFile& operator=(const ChunkedMappedFile&) = delete;
+
+    [[nodiscard]] inline operator bool() const noexcept { return _base != nullptr; }
+
+    [[nodiscard]] inline const char* data() const noexcept { return _base; }
+
+    [[nodiscard]] inline size_t size() const noexcept { return _size; }
+
+    [[nodiscard]] inline std::vector<char> to_vector() const
+    {
+        return std::vector<char>(_base, _base + _size);
+    }
+};
+#endif
+
+// Bytes [offset, offset + size) of another view, which it keeps alive.
+class SliceMemoryView:public IMemoryView
+{
+    std::shared_ptr<IMemoryView> _parent;
+    std::size_t _offset;
+    std::size_t _size;
+
+public:
+    SliceMemoryView(std::shared_ptr<IMemoryView> parent, std::size_t offset, std::size_t size)
+            : _parent(std::move(parent))
+            , _offset(std::min(offset, _parent->size()))
+            , _size(std::min(size, _parent->size() - _offset))
+    {
+    }
+
+    // An empty slice is still a valid (empty) value.
+    [[nodiscard]] inline operator bool() const noexcept { return bool(*_parent); }
+
+    [[nodiscard]] inline const char* data() const noexcept { return _parent->data() + _offset; }
+
+    [[nodiscard]] inline size_t size() const noexcept { return _size; }
+
+    [[nodiscard]] inline std::vector<char> to_vector() const
+    {
+        return std::vector<char>(data(), data() + _size);
+    }
+};
+
+class ReadBufferPool;
+
+// A value read into a block borrowed from a ReadBufferPool; the block goes
+// back to the pool (if it still exists) when the last Buffer lets go of it.
+class PooledMemoryView:public IMemoryView
+{
+    std::unique_ptr<char[]> _block;
+    std::size_t _capacity;
+    std::size_t _size;
+    std::weak_ptr<ReadBufferPool> _pool;
+public:
+    PooledMemoryView(std::unique_ptr<char[]>&& block, std::size_t capacity, std::size_t size,
+                     std::weak_ptr<ReadBufferPool> pool)
+            : _block(std::move(block)), _capacity(capacity), _size(size), _pool(std::move(pool))
+    {
+    }
+
+    inline ~PooledMemoryView();
+
+    [[nodiscard]] inline char* mutable_data() noexcept { return _block.get(); }
+
+    inline void shrink(std::size_t size) noexcept { _size = std::min(_size, size); }
+
+    [[nodiscard]] inline operator bool() const noexcept { return _block != nullptr; }
+
+    [[nodiscard]] inline const char* data() const noexcept { return _block.get(); }
+
+    [[nodiscard]] inline size_t size() const noexcept { return _size; }
+
+    [[nodiscard]] inline std::vector<char> to_vector() const
+    {
+        return std::vector<char>(_block.get(), _block.get() + _size);
+    }
 };
 
+// Free lists of power-of-two heap blocks for pread-loaded values, so reading
+// a medium-sized value costs a single read() rather than an allocation, an
+// mmap and an munmap. Only a few blocks per size class are kept.
+class ReadBufferPool:public std::enable_shared_from_this<ReadBufferPool>
+{
+public:
+    static constexpr std::size_t min_block = 4 * 1024;
+    static constexpr std::size_t max_block = 256 * 1024;
+    static constexpr std::size_t blocks_per_class = 8;
+
+    [[nodiscard]] static std::shared_ptr<ReadBufferPool> create()
+    {
+        return std::shared_ptr<ReadBufferPool>(new ReadBufferPool());
+    }
+
+    [[nodiscard]] std::shared_ptr<PooledMemoryView> acquire(std::size_t size)
+    {
+        auto block_size = std::bit_ceil(std::max(size, min_block));
+        std::unique_ptr<char[]> block;
+        if (block_size <= max_block)
+        {
+            std::lock_guard lk { _mtx };
+            auto& list = _free[_class_of(block_size)];
+            if (!list.empty())
+            {
+                block = std::move(list.back());
+                list.pop_back();
+            }
+        }
+        if (!block)
+            block.reset(new char[block_size]);
+        return std::make_shared<PooledMemoryView>(std::move(block), block_size, size,
+                                                  weak_from_this());
+    }
+
+    void release(std::unique_ptr<char[]>&& block, std::size_t block_size)
+    {
+        if (block_size > max_block)
+            return;
+        std::lock_guard lk { _mtx };
+        auto& list = _free[_class_of(block_size)];
+        if (list.size() < blocks_per_class)
+            list.push_back(std::move(block));
+    }
+
+private:
+    static constexpr std::size_t _class_count
+        = std::countr_zero(max_block) - std::countr_zero(min_block) + 1;
+
+    std::mutex _mtx;
+    std::array<std::vector<std::unique_ptr<char[]>>, _class_count> _free;
+
+    ReadBufferPool() = default;
+
+    static std::size_t _class_of(std::size_t block_size)
+    {
+        return std::countr_zero(block_size) - std::countr_zero(min_block);
+    }
+};
+
+inline PooledMemoryView::~PooledMemoryView()
+{
+    if (auto pool = _pool.lock())
+        pool->release(std::move(_block), _capacity);
+}
+
 class VectorMemoryView:public IMemoryView
 {
     std::vector<char> vec;
@@ -118,4 +341,13 @@ public:
     {
         return _data ? _data->to_vector() : std::vector<char>{};
     }
+
+    // Bytes [offset, offset + size) of this buffer, clipped to it, sharing
+    // its storage.
+    [[nodiscard]] inline Buffer slice(std::size_t offset, std::size_t size) const
+    {
+        if (!_data)
+            return *this;
+        return Buffer(std::make_shared<SliceMemoryView>(_data, offset, size));
+    }
 };
@@ -0,0 +1,246 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef SCIQLOP_CACHE_WITH_ZLIB
+#include <zlib.h>
+#endif
+#ifdef SCIQLOP_CACHE_WITH_LZ4
+#include <lz4.h>
+#endif
+#ifdef SCIQLOP_CACHE_WITH_ZSTD
+#include <zstd.h>
+#endif
+
+// --- Value compression -----------------------------------------------------
+// A codec turns a value into a smaller byte string and back. Its id is
+// persisted in the `codec` column of every row it encoded, so ids must never
+// be reused for a different format. 0 means "stored as-is". The built-in
+// codecs are compiled in on request (SCIQLOP_CACHE_WITH_ZLIB / _LZ4 / _ZSTD,
+// see meson_options.txt); a row whose codec is not available in the reading
+// build reads as a miss and is left in place.
+enum class CodecId : uint8_t
+{
+    none = 0,
+    zlib = 1,
+    lz4 = 2,
+    zstd = 3,
+    // Ids from here up are left to applications (register_codec()).
+    first_user = 128,
+};
+
+class Codec
+{
+public:
+    virtual ~Codec() = default;
+    [[nodiscard]] virtual uint8_t id() const noexcept = 0;
+    [[nodiscard]] virtual std::string_view name() const noexcept = 0;
+    // Upper bound of compress()'s output for `size` input bytes.
+    [[nodiscard]] virtual std::size_t max_compressed_size(std::size_t size) const noexcept = 0;
+    // Bytes written to `out`, or 0 if the input could not be encoded in it.
+    [[nodiscard]] virtual std::size_t compress(std::span<const char> in,
+                                               std::span<char> out) const noexcept = 0;
+    // True if `in` decoded to exactly out.size() bytes.
+    [[nodiscard]] virtual bool decompress(std::span<const char> in,
+                                          std::span<char> out) const noexcept = 0;
+};
+
+#ifdef SCIQLOP_CACHE_WITH_ZLIB
+// Available everywhere. Level 1: values are compressed on the write path.
+class ZlibCodec final : public Codec
+{
+public:
+    uint8_t id() const noexcept override { return static_cast<uint8_t>(CodecId::zlib); }
+    std::string_view name() const noexcept override { return "zlib"; }
+    std::size_t max_compressed_size(std::size_t size) const noexcept override
+    {
+        return compressBound(static_cast<uLong>(size));
+    }
+    std::size_t compress(std::span<const char> in, std::span<char> out) const noexcept override
+    {
+        auto out_len = static_cast<uLongf>(out.size());
+        if (::compress2(reinterpret_cast<Bytef*>(out.data()), &out_len,
+                        reinterpret_cast<const Bytef*>(in.data()),
+                        static_cast<uLong>(in.size()), 1)
+            != Z_OK)
+            return 0;
+        return out_len;
+    }
+    bool decompress(std::span<const char> in, std::span<char> out) const noexcept override
+    {
+        auto out_len = static_cast<uLongf>(out.size());
+        return ::uncompress(reinterpret_cast<Bytef*>(out.data()), &out_len,
+                            reinterpret_cast<const Bytef*>(in.data()),
+                            static_cast<uLong>(in.size()))
+            == Z_OK
+            && out_len == out.size();
+    }
+};
+#endif
+
+#ifdef SCIQLOP_CACHE_WITH_LZ4
+// Fastest: decodes at memory bandwidth, for values read far more often than
+// they are written.
+class Lz4Codec final : public Codec
+{
+public:
+    uint8_t id() const noexcept override { return static_cast<uint8_t>(CodecId::lz4); }
+    std::string_view name() const noexcept override { return "lz4"; }
+    std::size_t max_compressed_size(std::size_t size) const noexcept override
+    {
+        return size > LZ4_MAX_INPUT_SIZE
+            ? 0
+            : static_cast<std::size_t>(LZ4_compressBound(static_cast<int>(size)));
+    }
+    std::size_t compress(std::span<const char> in, std::span<char> out) const noexcept override
+    {
+        if (in.size() > LZ4_MAX_INPUT_SIZE)
+            return 0;
+        auto n = LZ4_compress_default(in.data(), out.data(), static_cast<int>(in.size()),
+                                      static_cast<int>(std::min<std::size_t>(out.size(), INT32_MAX)));
+        return n > 0 ? static_cast<std::size_t>(n) : 0;
+    }
+    bool decompress(std::span<const char> in, std::span<char> out) const noexcept override
+    {
+        if (in.size() > INT32_MAX || out.size() > INT32_MAX)
+            return false;
+        return LZ4_decompress_safe(in.data(), out.data(), static_cast<int>(in.size()),
+                                   static_cast<int>(out.size()))
+            == static_cast<int>(out.size());
+    }
+};
+#endif
+
+#ifdef SCIQLOP_CACHE_WITH_ZSTD
+// Best ratio at a write cost close to zlib's; level 3 is zstd's default.
+class ZstdCodec final : public Codec
+{
+public:
+    uint8_t id() const noexcept override { return static_cast<uint8_t>(CodecId::zstd); }
+    std::string_view name() const noexcept override { return "zstd"; }
+    std::size_t max_compressed_size(std::size_t size) const noexcept override
+    {
+        return ZSTD_compressBound(size);
+    }
+    std::size_t compress(std::span<const char> in, std::span<char> out) const noexcept override
+    {
+        auto n = ZSTD_compress(out.data(), out.size(), in.data(), in.size(), 3);
+        return ZSTD_isError(n) ? 0 : n;
+    }
+    bool decompress(std::span<const char> in, std::span<char> out) const noexcept override
+    {
+        auto n = ZSTD_decompress(out.data(), out.size(), in.data(), in.size());
+        return !ZSTD_isError(n) && n == out.size();
+    }
+};
+#endif
+
+// Process-wide table of codecs by id. Lookups on the read path are a single
+// atomic load; registered codecs live until exit.
+class CodecRegistry
+{
+    std::array<std::atomic<const Codec*>, 256> _by_id {};
+    std::vector<std::unique_ptr<Codec>> _owned;
+    std::mutex _mutex;
+
+    CodecRegistry()
+    {
+#ifdef SCIQLOP_CACHE_WITH_ZLIB
+        add(std::make_unique<ZlibCodec>());
+#endif
+#ifdef SCIQLOP_CACHE_WITH_LZ4
+        add(std::make_unique<Lz4Codec>());
+#endif
+#ifdef SCIQLOP_CACHE_WITH_ZSTD
+        add(std::make_unique<ZstdCodec>());
+#endif
+    }
+
+public:
+    [[nodiscard]] static CodecRegistry& instance()
+    {
+        static CodecRegistry registry;
+        return registry;
+    }
+
+    // False if the id is 0 or already taken.
+    bool add(std::unique_ptr<Codec> codec)
+    {
+        if (!codec || codec->id() == 0)
+            return false;
+        std::lock_guard lk { _mutex };
+        auto& slot = _by_id[codec->id()];
+        if (slot.load(std::memory_order_relaxed))
+            return false;
+        slot.store(codec.get(), std::memory_order_release);
+        _owned.push_back(std::move(codec));
+        return true;
+    }
+
+    [[nodiscard]] const Codec* find(uint8_t id) const noexcept
+    {
+        return _by_id[id].load(std::memory_order_acquire);
+    }
+
+    [[nodiscard]] const Codec* find(std::string_view name) noexcept
+    {
+        std::lock_guard lk { _mutex };
+        for (const auto& c : _owned)
+            if (c->name() == name)
+                return c.get();
+        return nullptr;
+    }
+
+    [[nodiscard]] std::vector<std::string> names()
+    {
+        std::lock_guard lk { _mutex };
+        std::vector<std::string> result;
+        for (const auto& c : _owned)
+            result.emplace_back(c->name());
+        return result;
+    }
+};
+
+inline bool register_codec(std::unique_ptr<Codec> codec)
+{
+    return CodecRegistry::instance().add(std::move(codec));
+}
+
+// Encode `value` with `codec` and keep the result only if it is smaller
+// than the value and at most `max_ratio` of its size.
+[[nodiscard]] inline std::optional<std::vector<char>> compress_value(
+    const Codec& codec, std::span<const char> value, double max_ratio)
+{
+    auto bound = codec.max_compressed_size(value.size());
+    if (bound == 0)
+        return std::nullopt;
+    std::vector<char> out(bound);
+    auto n = codec.compress(value, out);
+    if (n == 0 || n >= value.size()
+        || static_cast<double>(n) > max_ratio * static_cast<double>(value.size()))
+        return std::nullopt;
+    out.resize(n);
+    return out;
+}
+
+[[nodiscard]] inline std::optional<std::vector<char>> decompress_value(
+    uint8_t codec_id, std::span<const char> stored, std::size_t logical_size)
+{
+    auto* codec = CodecRegistry::instance().find(codec_id);
+    if (!codec)
+        return std::nullopt;
+    std::vector<char> out(logical_size);
+    if (!codec->decompress(stored, out))
+        return std::nullopt;
+    return out;
+}
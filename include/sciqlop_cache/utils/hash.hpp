@@ -0,0 +1,287 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// XXH3 (Yann Collet's xxHash, 64-bit output, seed 0, default secret). Long
+// inputs — every file-backed value — go through its stripe loop, which runs
+// on SSE2 (AVX2 when the build targets it) and hashes at memory bandwidth;
+// short ones take the scalar paths of the reference. The result does not
+// depend on the instruction set used, so it can be persisted.
+namespace xxh3_detail
+{
+inline constexpr uint64_t p32_1 = 0x9E3779B1U;
+inline constexpr uint64_t p32_2 = 0x85EBCA77U;
+inline constexpr uint64_t p32_3 = 0xC2B2AE3DU;
+inline constexpr uint64_t p64_1 = 0x9E3779B185EBCA87ULL;
+inline constexpr uint64_t p64_2 = 0xC2B2AE3D27D4EB4FULL;
+inline constexpr uint64_t p64_3 = 0x165667B19E3779F9ULL;
+inline constexpr uint64_t p64_4 = 0x85EBCA77C2B2AE63ULL;
+inline constexpr uint64_t p64_5 = 0x27D4EB2F165667C5ULL;
+inline constexpr uint64_t mx1 = 0x165667919E3779F9ULL;
+inline constexpr uint64_t mx2 = 0x9FB21C651E98DF25ULL;
+
+inline constexpr std::size_t stripe_len = 64;
+inline constexpr std::size_t secret_size = 192;
+inline constexpr std::size_t stripes_per_block = (secret_size - stripe_len) / 8;
+inline constexpr std::size_t block_len = stripe_len * stripes_per_block;
+
+alignas(64) inline constexpr unsigned char secret[secret_size] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+inline uint64_t bswap64(uint64_t v) noexcept
+{
+#ifdef _MSC_VER
+    return _byteswap_uint64(v);
+#else
+    return __builtin_bswap64(v);
+#endif
+}
+
+inline uint64_t read64(const void* p) noexcept
+{
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    if constexpr (std::endian::native == std::endian::big)
+        v = bswap64(v);
+    return v;
+}
+
+inline uint32_t read32(const void* p) noexcept
+{
+    uint32_t v;
+    std::memcpy(&v, p, sizeof(v));
+    if constexpr (std::endian::native == std::endian::big)
+        v = static_cast<uint32_t>(bswap64(v) >> 32);
+    return v;
+}
+
+// Low and high halves of the 128-bit product, xor-ed.
+inline uint64_t fold_mul(uint64_t a, uint64_t b) noexcept
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    uint64_t hi;
+    uint64_t lo = _umul128(a, b, &hi);
+    return lo ^ hi;
+#else
+    __extension__ using u128 = unsigned __int128;
+    auto product = static_cast<u128>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#endif
+}
+
+inline uint64_t xxh64_avalanche(uint64_t h) noexcept
+{
+    h ^= h >> 33;
+    h *= p64_2;
+    h ^= h >> 29;
+    h *= p64_3;
+    return h ^ (h >> 32);
+}
+
+inline uint64_t avalanche(uint64_t h) noexcept
+{
+    h ^= h >> 37;
+    h *= mx1;
+    return h ^ (h >> 32);
+}
+
+inline uint64_t rrmxmx(uint64_t h, uint64_t len) noexcept
+{
+    h ^= std::rotl(h, 49) ^ std::rotl(h, 24);
+    h *= mx2;
+    h ^= (h >> 35) + len;
+    h *= mx2;
+    return h ^ (h >> 28);
+}
+
+inline uint64_t mix16(const unsigned char* in, const unsigned char* sec) noexcept
+{
+    return fold_mul(read64(in) ^ read64(sec), read64(in + 8) ^ read64(sec + 8));
+}
+
+inline uint64_t hash_0_16(const unsigned char* in, std::size_t len) noexcept
+{
+    if (len > 8)
+    {
+        auto lo = read64(in) ^ (read64(secret + 24) ^ read64(secret + 32));
+        auto hi = read64(in + len - 8) ^ (read64(secret + 40) ^ read64(secret + 48));
+        return avalanche(len + bswap64(lo) + hi + fold_mul(lo, hi));
+    }
+    if (len >= 4)
+    {
+        auto combined = read32(in + len - 4) + (static_cast<uint64_t>(read32(in)) << 32);
+        return rrmxmx(combined ^ (read64(secret + 8) ^ read64(secret + 16)), len);
+    }
+    if (len > 0)
+    {
+        auto combined = (static_cast<uint32_t>(in[0]) << 16) | (static_cast<uint32_t>(in[len >> 1]) << 24)
+            | static_cast<uint32_t>(in[len - 1]) | (static_cast<uint32_t>(len) << 8);
+        return xxh64_avalanche(combined ^ static_cast<uint64_t>(read32(secret) ^ read32(secret + 4)));
+    }
+    return xxh64_avalanche(read64(secret + 56) ^ read64(secret + 64));
+}
+
+inline uint64_t hash_17_128(const unsigned char* in, std::size_t len) noexcept
+{
+    uint64_t acc = len * p64_1;
+    if (len > 32)
+    {
+        if (len > 64)
+        {
+            if (len > 96)
+            {
+                acc += mix16(in + 48, secret + 96);
+                acc += mix16(in + len - 64, secret + 112);
+            }
+            acc += mix16(in + 32, secret + 64);
+            acc += mix16(in + len - 48, secret + 80);
+        }
+        acc += mix16(in + 16, secret + 32);
+        acc += mix16(in + len - 32, secret + 48);
+    }
+    acc += mix16(in, secret);
+    acc += mix16(in + len - 16, secret + 16);
+    return avalanche(acc);
+}
+
+inline uint64_t hash_129_240(const unsigned char* in, std::size_t len) noexcept
+{
+    uint64_t acc = len * p64_1;
+    for (std::size_t i = 0; i < 8; ++i)
+        acc += mix16(in + 16 * i, secret + 16 * i);
+    acc = avalanche(acc);
+    uint64_t tail = mix16(in + len - 16, secret + 136 - 17);
+    for (std::size_t i = 8; i < len / 16; ++i)
+        tail += mix16(in + 16 * i, secret + 16 * (i - 8) + 3);
+    return avalanche(acc + tail);
+}
+
+// One 64-byte stripe into the eight 64-bit lanes. The lanes go through
+// load/store intrinsics: plain vector dereferences of the uint64_t array are
+// reordered under strict aliasing at -O2.
+inline void accumulate_stripe(uint64_t* acc, const unsigned char* in, const unsigned char* sec) noexcept
+{
+#if defined(__AVX2__)
+    auto* lanes = reinterpret_cast<__m256i*>(acc);
+    for (int i = 0; i < 2; ++i)
+    {
+        auto data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in) + i);
+        auto key = _mm256_xor_si256(data, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sec) + i));
+        auto product = _mm256_mul_epu32(key, _mm256_srli_epi64(key, 32));
+        auto swapped = _mm256_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+        auto lane = _mm256_load_si256(lanes + i);
+        _mm256_store_si256(lanes + i, _mm256_add_epi64(product, _mm256_add_epi64(lane, swapped)));
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    auto* lanes = reinterpret_cast<__m128i*>(acc);
+    for (int i = 0; i < 4; ++i)
+    {
+        auto data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in) + i);
+        auto key = _mm_xor_si128(data, _mm_loadu_si128(reinterpret_cast<const __m128i*>(sec) + i));
+        auto product = _mm_mul_epu32(key, _mm_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)));
+        auto swapped = _mm_shuffle_epi32(data, _MM_SHUFFLE(1, 0, 3, 2));
+        auto lane = _mm_load_si128(lanes + i);
+        _mm_store_si128(lanes + i, _mm_add_epi64(product, _mm_add_epi64(lane, swapped)));
+    }
+#else
+    for (std::size_t i = 0; i < 8; ++i)
+    {
+        auto data = read64(in + 8 * i);
+        auto key = data ^ read64(sec + 8 * i);
+        acc[i ^ 1] += data;
+        acc[i] += (key & 0xFFFFFFFFU) * (key >> 32);
+    }
+#endif
+}
+
+inline void scramble(uint64_t* acc, const unsigned char* sec) noexcept
+{
+#if defined(__AVX2__)
+    auto* lanes = reinterpret_cast<__m256i*>(acc);
+    const auto prime = _mm256_set1_epi32(static_cast<int>(p32_1));
+    for (int i = 0; i < 2; ++i)
+    {
+        auto lane = _mm256_load_si256(lanes + i);
+        auto a = _mm256_xor_si256(lane, _mm256_srli_epi64(lane, 47));
+        auto key = _mm256_xor_si256(a, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sec) + i));
+        auto lo = _mm256_mul_epu32(key, prime);
+        auto hi = _mm256_mul_epu32(_mm256_srli_epi64(key, 32), prime);
+        _mm256_store_si256(lanes + i, _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32)));
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    auto* lanes = reinterpret_cast<__m128i*>(acc);
+    const auto prime = _mm_set1_epi32(static_cast<int>(p32_1));
+    for (int i = 0; i < 4; ++i)
+    {
+        auto lane = _mm_load_si128(lanes + i);
+        auto a = _mm_xor_si128(lane, _mm_srli_epi64(lane, 47));
+        auto key = _mm_xor_si128(a, _mm_loadu_si128(reinterpret_cast<const __m128i*>(sec) + i));
+        auto lo = _mm_mul_epu32(key, prime);
+        auto hi = _mm_mul_epu32(_mm_shuffle_epi32(key, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+        _mm_store_si128(lanes + i, _mm_add_epi64(lo, _mm_slli_epi64(hi, 32)));
+    }
+#else
+    for (std::size_t i = 0; i < 8; ++i)
+    {
+        auto a = acc[i] ^ (acc[i] >> 47) ^ read64(sec + 8 * i);
+        acc[i] = a * p32_1;
+    }
+#endif
+}
+
+inline uint64_t hash_long(const unsigned char* in, std::size_t len) noexcept
+{
+    alignas(32) uint64_t acc[8] = { p32_3, p64_1, p64_2, p64_3, p64_4, p32_2, p64_5, p32_1 };
+    const std::size_t blocks = (len - 1) / block_len;
+    for (std::size_t b = 0; b < blocks; ++b)
+    {
+        for (std::size_t s = 0; s < stripes_per_block; ++s)
+            accumulate_stripe(acc, in + b * block_len + s * stripe_len, secret + s * 8);
+        scramble(acc, secret + secret_size - stripe_len);
+    }
+    const std::size_t stripes = ((len - 1) - blocks * block_len) / stripe_len;
+    for (std::size_t s = 0; s < stripes; ++s)
+        accumulate_stripe(acc, in + blocks * block_len + s * stripe_len, secret + s * 8);
+    accumulate_stripe(acc, in + len - stripe_len, secret + secret_size - stripe_len - 7);
+
+    uint64_t result = len * p64_1;
+    for (std::size_t i = 0; i < 4; ++i)
+        result += fold_mul(acc[2 * i] ^ read64(secret + 11 + 16 * i),
+                           acc[2 * i + 1] ^ read64(secret + 11 + 16 * i + 8));
+    return avalanche(result);
+}
+}
+
+[[nodiscard]] inline uint64_t xxh3_64(std::span<const char> data) noexcept
+{
+    using namespace xxh3_detail;
+    const auto* in = reinterpret_cast<const unsigned char*>(data.data());
+    const auto len = data.size();
+    if (len <= 16)
+        return hash_0_16(in, len);
+    if (len <= 128)
+        return hash_17_128(in, len);
+    if (len <= 240)
+        return hash_129_240(in, len);
+    return hash_long(in, len);
+}
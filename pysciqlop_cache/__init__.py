@@ -1,4 +1,4 @@
-from ._pysciqlop_cache import Cache as _Cache, Index as _Index, FanoutCache as _FanoutCache, FanoutIndex as _FanoutIndex
+from ._pysciqlop_cache import Cache as _Cache, Index as _Index, FanoutCache as _FanoutCache, FanoutIndex as _FanoutIndex, Durability, VerifyMode, available_codecs, StoreOptions, CheckpointPolicy, ThresholdTuning
 import functools
 import hashlib
 import time
@@ -17,7 +17,7 @@ _META_SERIALIZER = "serializer"
 _META_MAX_SIZE = "max_size"
 _SENTINEL = object()
 
-__all__ = ["Cache", "Index", "FanoutCache", "FanoutIndex", "Lock", "Serializer", "PickleSerializer", "MsgspecSerializer"]
+__all__ = ["Cache", "Index", "FanoutCache", "FanoutIndex", "Durability", "VerifyMode", "available_codecs", "StoreOptions", "CheckpointPolicy", "ThresholdTuning", "Lock", "Serializer", "PickleSerializer", "MsgspecSerializer"]
 
 
 class Lock:
@@ -96,8 +96,9 @@ class Cache(_Cache):
         cache_path: str = ".cache/",
         max_size: int | object = _SENTINEL,
         serializer: Serializer | None = None,
+        options: StoreOptions | None = None,
     ):
-        super().__init__(cache_path=cache_path, max_size=0)
+        super().__init__(cache_path=cache_path, max_size=0, options=options or StoreOptions())
         self._serializer = self._resolve_meta(
             _META_SERIALIZER, serializer,
             default=PickleSerializer,
@@ -170,6 +171,28 @@ class Cache(_Cache):
             return self._serializer.loads(value.memoryview())
         return default
 
+    def set_many(self, items) -> bool:
+        """Store several values in one transaction: all of them or none.
+
+        Parameters:
+        items: A mapping, or an iterable of (key, value) pairs.
+        """
+        pairs = items.items() if hasattr(items, "items") else items
+        return super().set_many([(k, self._serializer.dumps(v)) for k, v in pairs])
+
+    def get_many(self, keys, default=None) -> list:
+        """Get several values at once, in the order of `keys`; missing keys
+        yield `default`."""
+        return [self._serializer.loads(v.memoryview()) if v is not None else default
+                for v in super().get_many(list(keys))]
+
+    def items(self, prefix: str = ""):
+        """Iterate over (key, value) pairs, of the keys starting with `prefix`
+        if given. Keys are read a page at a time, so memory stays constant
+        whatever the number of entries."""
+        for key, value in super().items(prefix):
+            yield key, self._serializer.loads(value.memoryview())
+
     def pop(self, key: AnyStr, default=None) -> Any:
         """Remove a value from the cache and return it.
 
@@ -317,8 +340,9 @@ class Index(_Index):
         self,
         path: str = ".index/",
         serializer: Serializer | None = None,
+        options: StoreOptions | None = None,
     ):
-        super().__init__(path=path)
+        super().__init__(path=path, options=options or StoreOptions())
         stored = super().get_meta(_META_SERIALIZER)
         if serializer is not None:
             if stored is not None and serializer.name != stored:
@@ -347,6 +371,28 @@ class Index(_Index):
             return self._serializer.loads(value.memoryview())
         return default
 
+    def set_many(self, items) -> bool:
+        """Store several values in one transaction: all of them or none.
+
+        Parameters:
+        items: A mapping, or an iterable of (key, value) pairs.
+        """
+        pairs = items.items() if hasattr(items, "items") else items
+        return super().set_many([(k, self._serializer.dumps(v)) for k, v in pairs])
+
+    def get_many(self, keys, default=None) -> list:
+        """Get several values at once, in the order of `keys`; missing keys
+        yield `default`."""
+        return [self._serializer.loads(v.memoryview()) if v is not None else default
+                for v in super().get_many(list(keys))]
+
+    def items(self, prefix: str = ""):
+        """Iterate over (key, value) pairs, of the keys starting with `prefix`
+        if given. Keys are read a page at a time, so memory stays constant
+        whatever the number of entries."""
+        for key, value in super().items(prefix):
+            yield key, self._serializer.loads(value.memoryview())
+
     def pop(self, key: AnyStr, default=None) -> Any:
         value = super().pop(key)
         if value is not None:
@@ -402,8 +448,10 @@ class FanoutCache(_FanoutCache):
         shard_count: int = 8,
         max_size: int = 0,
         serializer: Serializer | None = None,
+        options: StoreOptions | None = None,
     ):
-        super().__init__(cache_path=cache_path, shard_count=shard_count, max_size=max_size)
+        super().__init__(cache_path=cache_path, shard_count=shard_count, max_size=max_size,
+                         options=options or StoreOptions())
         self._serializer = serializer or PickleSerializer()
 
     @property
@@ -427,6 +475,28 @@ class FanoutCache(_FanoutCache):
             return self._serializer.loads(value.memoryview())
         return default
 
+    def set_many(self, items) -> bool:
+        """Store several values, in one transaction per shard.
+
+        Parameters:
+        items: A mapping, or an iterable of (key, value) pairs.
+        """
+        pairs = items.items() if hasattr(items, "items") else items
+        return super().set_many([(k, self._serializer.dumps(v)) for k, v in pairs])
+
+    def get_many(self, keys, default=None) -> list:
+        """Get several values at once, in the order of `keys`; missing keys
+        yield `default`."""
+        return [self._serializer.loads(v.memoryview()) if v is not None else default
+                for v in super().get_many(list(keys))]
+
+    def items(self, prefix: str = ""):
+        """Iterate over (key, value) pairs, of the keys starting with `prefix`
+        if given. Keys are read a page at a time, so memory stays constant
+        whatever the number of entries."""
+        for key, value in super().items(prefix):
+            yield key, self._serializer.loads(value.memoryview())
+
     def pop(self, key: AnyStr, default=None) -> Any:
         value = super().pop(key)
         if value is not None:
@@ -534,8 +604,9 @@ class FanoutIndex(_FanoutIndex):
         path: str = ".index/",
         shard_count: int = 8,
         serializer: Serializer | None = None,
+        options: StoreOptions | None = None,
     ):
-        super().__init__(path=path, shard_count=shard_count)
+        super().__init__(path=path, shard_count=shard_count, options=options or StoreOptions())
         self._serializer = serializer or PickleSerializer()
 
     @property
@@ -551,6 +622,28 @@ class FanoutIndex(_FanoutIndex):
             return self._serializer.loads(value.memoryview())
         return default
 
+    def set_many(self, items) -> bool:
+        """Store several values, in one transaction per shard.
+
+        Parameters:
+        items: A mapping, or an iterable of (key, value) pairs.
+        """
+        pairs = items.items() if hasattr(items, "items") else items
+        return super().set_many([(k, self._serializer.dumps(v)) for k, v in pairs])
+
+    def get_many(self, keys, default=None) -> list:
+        """Get several values at once, in the order of `keys`; missing keys
+        yield `default`."""
+        return [self._serializer.loads(v.memoryview()) if v is not None else default
+                for v in super().get_many(list(keys))]
+
+    def items(self, prefix: str = ""):
+        """Iterate over (key, value) pairs, of the keys starting with `prefix`
+        if given. Keys are read a page at a time, so memory stays constant
+        whatever the number of entries."""
+        for key, value in super().items(prefix):
+            yield key, self._serializer.loads(value.memoryview())
+
     def pop(self, key: AnyStr, default=None) -> Any:
         value = super().pop(key)
         if value is not None:
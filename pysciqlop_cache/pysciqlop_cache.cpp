@@ -2,8 +2,10 @@
 
 #include <nanobind/nanobind.h>
 #include <nanobind/ndarray.h>
+#include <nanobind/operators.h>
 #include <nanobind/stl/chrono.h>
 #include <nanobind/stl/optional.h>
+#include <nanobind/stl/pair.h>
 #include <nanobind/stl/string.h>
 #include <nanobind/stl/vector.h>
 
@@ -72,6 +74,150 @@ inline bool _simple_add_item(T& s, const std::string& key, nb::bytes& buffer)
     return s.add(key, data);
 }
 
+template <typename T>
+inline bool _set_many(T& s, const std::vector<std::pair<std::string, nb::bytes>>& items)
+{
+    std::vector<std::pair<std::string, std::span<const char>>> spans;
+    spans.reserve(items.size());
+    for (const auto& [key, buffer] : items)
+        spans.emplace_back(key, std::span<const char>(static_cast<const char*>(buffer.data()),
+                                                      buffer.size()));
+    nb::gil_scoped_release release;
+    return s.set_many(spans);
+}
+
+template <typename T>
+inline nb::dict _wal_stats(T& s)
+{
+    WalStats w;
+    {
+        nb::gil_scoped_release release;
+        w = s.wal_stats();
+    }
+    nb::dict d;
+    d["wal_pages"] = w.wal_pages;
+    d["wal_bytes"] = w.wal_bytes;
+    d["checkpoints"] = w.checkpoints;
+    d["truncating_checkpoints"] = w.truncating_checkpoints;
+    d["last_checkpoint_us"] = w.last_checkpoint_us;
+    d["max_checkpoint_us"] = w.max_checkpoint_us;
+    d["total_checkpoint_us"] = w.total_checkpoint_us;
+    return d;
+}
+
+template <typename T>
+inline nb::dict _mmap_cache_stats(T& s)
+{
+    auto st = s.mmap_cache_stats();
+    nb::dict d;
+    d["hits"] = st.hits;
+    d["misses"] = st.misses;
+    d["entries"] = st.entries;
+    d["mapped_bytes"] = st.mapped_bytes;
+    d["capacity_bytes"] = st.capacity_bytes;
+    return d;
+}
+
+template <typename T>
+inline nb::dict _storage_layout(T& s)
+{
+    auto layout = s.storage_layout();
+    nb::dict d;
+    d["depth"] = layout.depth;
+    d["width"] = layout.width;
+    return d;
+}
+
+template <typename T>
+inline void _set_storage_layout(T& s, std::size_t depth, std::size_t width)
+{
+    nb::gil_scoped_release release;
+    s.set_storage_layout(StorageLayout { depth, width });
+}
+
+template <typename T>
+inline nb::dict _chunk_policy(T& s)
+{
+    auto policy = s.chunk_policy();
+    nb::dict d;
+    d["threshold"] = policy.threshold;
+    d["chunk_size"] = policy.chunk_size;
+    d["workers"] = policy.workers;
+    return d;
+}
+
+template <typename T>
+inline void _set_chunk_policy(T& s, std::size_t threshold, std::size_t chunk_size,
+                              std::size_t workers)
+{
+    s.set_chunk_policy(ChunkPolicy { threshold, chunk_size, workers });
+}
+
+template <typename T>
+inline nb::dict _compression(T& s)
+{
+    auto policy = s.compression();
+    auto* codec = CodecRegistry::instance().find(policy.codec);
+    nb::dict d;
+    d["codec"] = codec ? std::string(codec->name()) : std::string("none");
+    d["min_size"] = policy.min_size;
+    d["max_ratio"] = policy.max_ratio;
+    return d;
+}
+
+template <typename T>
+inline void _set_compression(T& s, const std::string& codec, std::size_t min_size,
+                             double max_ratio)
+{
+    uint8_t id = 0;
+    if (codec != "none")
+    {
+        auto* c = CodecRegistry::instance().find(codec);
+        if (!c)
+            throw nb::value_error(("unknown codec: " + codec).c_str());
+        id = c->id();
+    }
+    nb::gil_scoped_release release;
+    s.set_compression(CompressionPolicy { id, min_size, max_ratio });
+}
+
+template <typename T>
+inline nb::dict _verify_policy(T& s)
+{
+    auto policy = s.verify_policy();
+    nb::dict d;
+    d["mode"] = policy.mode;
+    d["sample_percent"] = policy.sample_percent;
+    d["scrub_rows"] = policy.scrub_rows;
+    return d;
+}
+
+template <typename T>
+inline void _set_verify_policy(T& s, VerifyMode mode, double sample_percent,
+                               std::size_t scrub_rows)
+{
+    s.set_verify_policy(VerifyPolicy { mode, sample_percent, scrub_rows });
+}
+
+template <typename T>
+inline nb::dict _tier_policy(T& s)
+{
+    auto policy = s.tier_policy();
+    nb::dict d;
+    d["cold_path"] = policy.cold_path.string();
+    d["hot_bytes"] = policy.hot_bytes;
+    d["promote_on_read"] = policy.promote_on_read;
+    return d;
+}
+
+template <typename T>
+inline void _set_tier_policy(T& s, const std::string& cold_path, std::size_t hot_bytes,
+                             bool promote_on_read)
+{
+    nb::gil_scoped_release release;
+    s.set_tier_policy(TierPolicy { cold_path, hot_bytes, promote_on_read });
+}
+
 template <typename CursorType>
 void bind_key_cursor(nb::module_& m, const char* name)
 {
@@ -91,6 +237,22 @@ void bind_key_cursor(nb::module_& m, const char* name)
         });
 }
 
+template <typename CursorType>
+void bind_item_cursor(nb::module_& m, const char* name)
+{
+    nb::class_<CursorType>(m, name)
+        .def("__iter__", [](nb::handle self) { return self; })
+        .def("__next__", [](CursorType& c) -> std::pair<std::string, Buffer> {
+            std::optional<std::pair<std::string, Buffer>> item;
+            {
+                nb::gil_scoped_release release;
+                item = c.next();
+            }
+            if (!item) throw nb::stop_iteration();
+            return std::move(*item);
+        });
+}
+
 NB_MODULE(_pysciqlop_cache, m)
 {
     m.doc() = R"pbdoc(
@@ -103,6 +265,56 @@ NB_MODULE(_pysciqlop_cache, m)
     bind_key_cursor<Index::KeyCursor>(m, "IndexKeyCursor");
     bind_key_cursor<FanoutCache::KeyCursor>(m, "FanoutCacheKeyCursor");
     bind_key_cursor<FanoutIndex::KeyCursor>(m, "FanoutIndexKeyCursor");
+    bind_item_cursor<Cache::ItemCursor>(m, "CacheItemCursor");
+    bind_item_cursor<Index::ItemCursor>(m, "IndexItemCursor");
+    bind_item_cursor<FanoutCache::ItemCursor>(m, "FanoutCacheItemCursor");
+    bind_item_cursor<FanoutIndex::ItemCursor>(m, "FanoutIndexItemCursor");
+
+    nb::enum_<Durability>(m, "Durability")
+        .value("none", Durability::none)
+        .value("sync", Durability::sync)
+        .value("group", Durability::group);
+
+    nb::enum_<VerifyMode>(m, "VerifyMode")
+        .value("off", VerifyMode::off)
+        .value("sample", VerifyMode::sample)
+        .value("always", VerifyMode::always);
+
+    m.def("available_codecs", [] { return CodecRegistry::instance().names(); });
+
+    nb::class_<CheckpointPolicy>(m, "CheckpointPolicy")
+        .def(nb::init<>())
+        .def_rw("passive_pages", &CheckpointPolicy::passive_pages)
+        .def_rw("truncate_pages", &CheckpointPolicy::truncate_pages)
+        .def_rw("housekeeping_interval", &CheckpointPolicy::housekeeping_interval)
+        .def(nb::self == nb::self);
+
+    nb::class_<ThresholdTuning>(m, "ThresholdTuning")
+        .def(nb::init<>())
+        .def_rw("enabled", &ThresholdTuning::enabled)
+        .def_rw("min_bytes", &ThresholdTuning::min_bytes)
+        .def_rw("max_bytes", &ThresholdTuning::max_bytes)
+        .def_rw("probe_every", &ThresholdTuning::probe_every)
+        .def_rw("min_samples", &ThresholdTuning::min_samples)
+        .def(nb::self == nb::self);
+
+    nb::class_<StoreOptions>(m, "StoreOptions")
+        .def(nb::init<>())
+        .def_rw("page_cache_bytes", &StoreOptions::page_cache_bytes)
+        .def_rw("mmap_size", &StoreOptions::mmap_size)
+        .def_rw("busy_timeout", &StoreOptions::busy_timeout)
+        .def_rw("page_size", &StoreOptions::page_size)
+        .def_rw("file_size_threshold", &StoreOptions::file_size_threshold)
+        .def_rw("mmap_cache_bytes", &StoreOptions::mmap_cache_bytes)
+        .def_rw("checkpoint", &StoreOptions::checkpoint)
+        .def_rw("threshold_tuning", &StoreOptions::threshold_tuning)
+        .def_rw("separate_values", &StoreOptions::separate_values)
+        .def_rw("hashed_keys", &StoreOptions::hashed_keys)
+        .def_static("laptop", &StoreOptions::laptop)
+        .def_static("server", &StoreOptions::server)
+        .def_static("read_mostly", &StoreOptions::read_mostly)
+        .def_static("write_heavy", &StoreOptions::write_heavy)
+        .def(nb::self == nb::self);
 
     nb::class_<Buffer>(m, "Buffer")
         .def("memoryview",
@@ -149,18 +361,28 @@ NB_MODULE(_pysciqlop_cache, m)
     nb::class_<Cache::CheckResult>(m, "CacheCheckResult")
         .def_ro("ok", &Cache::CheckResult::ok)
         .def_ro("orphaned_files", &Cache::CheckResult::orphaned_files)
+        .def_ro("orphaned_values", &Cache::CheckResult::orphaned_values)
         .def_ro("dangling_rows", &Cache::CheckResult::dangling_rows)
         .def_ro("size_mismatches", &Cache::CheckResult::size_mismatches)
+        .def_ro("checksum_mismatches", &Cache::CheckResult::checksum_mismatches)
         .def_ro("counters_consistent", &Cache::CheckResult::counters_consistent)
-        .def_ro("sqlite_integrity_ok", &Cache::CheckResult::sqlite_integrity_ok);
+        .def_ro("sqlite_integrity_ok", &Cache::CheckResult::sqlite_integrity_ok)
+        .def_ro("volume_consistent", &Cache::CheckResult::volume_consistent)
+        .def_ro("rows_checked", &Cache::CheckResult::rows_checked)
+        .def_ro("pass_complete", &Cache::CheckResult::pass_complete);
 
     nb::class_<Index::CheckResult>(m, "IndexCheckResult")
         .def_ro("ok", &Index::CheckResult::ok)
         .def_ro("orphaned_files", &Index::CheckResult::orphaned_files)
+        .def_ro("orphaned_values", &Index::CheckResult::orphaned_values)
         .def_ro("dangling_rows", &Index::CheckResult::dangling_rows)
         .def_ro("size_mismatches", &Index::CheckResult::size_mismatches)
+        .def_ro("checksum_mismatches", &Index::CheckResult::checksum_mismatches)
         .def_ro("counters_consistent", &Index::CheckResult::counters_consistent)
-        .def_ro("sqlite_integrity_ok", &Index::CheckResult::sqlite_integrity_ok);
+        .def_ro("sqlite_integrity_ok", &Index::CheckResult::sqlite_integrity_ok)
+        .def_ro("volume_consistent", &Index::CheckResult::volume_consistent)
+        .def_ro("rows_checked", &Index::CheckResult::rows_checked)
+        .def_ro("pass_complete", &Index::CheckResult::pass_complete);
 
     nb::class_<Cache::TransactionGuard>(m, "CacheTransactionGuard")
         .def("commit", &Cache::TransactionGuard::commit,
@@ -175,8 +397,8 @@ NB_MODULE(_pysciqlop_cache, m)
              nb::call_guard<nb::gil_scoped_release>());
 
     nb::class_<Cache>(m, "Cache")
-        .def(nb::init<const std::string&, size_t>(), "cache_path"_a = ".cache/",
-             "max_size"_a = 0)
+        .def(nb::init<const std::string&, size_t, const StoreOptions&>(),
+             "cache_path"_a = ".cache/", "max_size"_a = 0, "options"_a = StoreOptions {})
         .def("count", &Cache::count, nb::call_guard<nb::gil_scoped_release>())
         .def("__len__", &Cache::count, nb::call_guard<nb::gil_scoped_release>())
         .def("set", _set_item_impl<Cache>, nb::arg("key"), nb::arg("value"),
@@ -189,7 +411,22 @@ NB_MODULE(_pysciqlop_cache, m)
         .def("__getitem__", &Cache::get, nb::arg("key"),
              nb::call_guard<nb::gil_scoped_release>())
         .def("keys", &Cache::keys, nb::call_guard<nb::gil_scoped_release>())
-        .def("iterkeys", &Cache::iterkeys)
+        .def("get_many", &Cache::get_many, nb::arg("keys"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("set_many", _set_many<Cache>, nb::arg("items"))
+        .def("prefetch", &Cache::prefetch, nb::arg("keys"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("prefetched", &Cache::prefetched)
+        .def("iterkeys", &Cache::iterkeys, nb::arg("prefix") = "",
+             nb::arg("page_size") = Cache::KeyCursor::default_page_size,
+             nb::keep_alive<0, 1>())
+        .def("items", &Cache::items, nb::arg("prefix") = "",
+             nb::arg("page_size") = Cache::KeyCursor::default_page_size,
+             nb::keep_alive<0, 1>())
+        .def("del_prefix", &Cache::del_prefix, nb::arg("prefix"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("del_glob", &Cache::del_glob, nb::arg("pattern"),
+             nb::call_guard<nb::gil_scoped_release>())
         .def("exists", &Cache::exists, nb::arg("key"),
              nb::call_guard<nb::gil_scoped_release>())
         .def("add", _add_item_impl<Cache>, nb::arg("key"), nb::arg("value"),
@@ -211,10 +448,56 @@ NB_MODULE(_pysciqlop_cache, m)
              nb::arg("default_value") = 0)
         .def("clear", &Cache::clear)
         .def("check", &Cache::check, nb::arg("fix") = false)
+        .def("check_incremental", &Cache::check_incremental, nb::arg("max_rows") = 4096,
+             nb::arg("fix") = false, nb::call_guard<nb::gil_scoped_release>())
         .def("set_meta", &Cache::set_meta, nb::arg("key"), nb::arg("value"))
         .def("get_meta", &Cache::get_meta, nb::arg("key"))
         .def("size", &Cache::size)
         .def("volume", &Cache::volume)
+        .def("logical_size", &Cache::logical_size)
+        .def("wal_stats", _wal_stats<Cache>)
+        .def("mmap_cache_stats", _mmap_cache_stats<Cache>)
+        .def("reset_mmap_cache_stats", &Cache::reset_mmap_cache_stats)
+        .def("options", &Cache::options)
+        .def("set_options", &Cache::set_options, nb::arg("options"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("file_size_threshold", &Cache::file_size_threshold)
+        .def("set_file_size_threshold", &Cache::set_file_size_threshold, nb::arg("bytes"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("threshold_tuning", &Cache::threshold_tuning)
+        .def("set_threshold_tuning", &Cache::set_threshold_tuning, nb::arg("tuning"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("pread_cutoff", &Cache::pread_cutoff)
+        .def("set_pread_cutoff", &Cache::set_pread_cutoff, nb::arg("value"))
+        .def("set_io_uring_enabled", &Cache::set_io_uring_enabled, nb::arg("enabled"))
+        .def("uses_io_uring", &Cache::uses_io_uring)
+        .def("storage_layout", _storage_layout<Cache>)
+        .def("set_storage_layout", _set_storage_layout<Cache>, nb::arg("depth") = 1,
+             nb::arg("width") = 256)
+        .def("dedup_threshold", &Cache::dedup_threshold)
+        .def("set_dedup_threshold", &Cache::set_dedup_threshold, nb::arg("bytes"))
+        .def("chunk_policy", _chunk_policy<Cache>)
+        .def("set_chunk_policy", _set_chunk_policy<Cache>, nb::arg("threshold"),
+             nb::arg("chunk_size") = ChunkPolicy {}.chunk_size,
+             nb::arg("workers") = ChunkPolicy {}.workers)
+        .def("verify_policy", _verify_policy<Cache>)
+        .def("set_verify_policy", _set_verify_policy<Cache>, nb::arg("mode"),
+             nb::arg("sample_percent") = VerifyPolicy {}.sample_percent,
+             nb::arg("scrub_rows") = VerifyPolicy {}.scrub_rows)
+        .def("corrupt_values", &Cache::corrupt_values)
+        .def("tier_policy", _tier_policy<Cache>)
+        .def("set_tier_policy", _set_tier_policy<Cache>, nb::arg("cold_path") = "",
+             nb::arg("hot_bytes") = TierPolicy {}.hot_bytes,
+             nb::arg("promote_on_read") = TierPolicy {}.promote_on_read)
+        .def("migrate_tiers", &Cache::migrate_tiers, nb::call_guard<nb::gil_scoped_release>())
+        .def("durability", &Cache::durability)
+        .def("set_durability", &Cache::set_durability, nb::arg("mode"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("sync", &Cache::sync, nb::call_guard<nb::gil_scoped_release>())
+        .def("compression", _compression<Cache>)
+        .def("set_compression", _set_compression<Cache>, nb::arg("codec"),
+             nb::arg("min_size") = CompressionPolicy {}.min_size,
+             nb::arg("max_ratio") = CompressionPolicy {}.max_ratio)
         .def("set_max_cache_size", &Cache::set_max_cache_size, nb::arg("value"))
         .def("path", [](Cache& c) { return c.path().string(); })
         .def("stats", [](Cache& c) {
@@ -229,7 +512,10 @@ NB_MODULE(_pysciqlop_cache, m)
              nb::call_guard<nb::gil_scoped_release>());
 
     nb::class_<Index>(m, "Index")
-        .def(nb::init<const std::string&>(), "path"_a = ".index/")
+        .def("__init__",
+             [](Index* self, const std::string& path, const StoreOptions& options)
+             { new (self) Index(path, 0, options); },
+             "path"_a = ".index/", "options"_a = StoreOptions {})
         .def("count", &Index::count, nb::call_guard<nb::gil_scoped_release>())
         .def("__len__", &Index::count, nb::call_guard<nb::gil_scoped_release>())
         .def("set", _simple_set_item<Index>, nb::arg("key"), nb::arg("value"))
@@ -239,7 +525,22 @@ NB_MODULE(_pysciqlop_cache, m)
         .def("__getitem__", &Index::get, nb::arg("key"),
              nb::call_guard<nb::gil_scoped_release>())
         .def("keys", &Index::keys, nb::call_guard<nb::gil_scoped_release>())
-        .def("iterkeys", &Index::iterkeys)
+        .def("get_many", &Index::get_many, nb::arg("keys"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("set_many", _set_many<Index>, nb::arg("items"))
+        .def("prefetch", &Index::prefetch, nb::arg("keys"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("prefetched", &Index::prefetched)
+        .def("iterkeys", &Index::iterkeys, nb::arg("prefix") = "",
+             nb::arg("page_size") = Index::KeyCursor::default_page_size,
+             nb::keep_alive<0, 1>())
+        .def("items", &Index::items, nb::arg("prefix") = "",
+             nb::arg("page_size") = Index::KeyCursor::default_page_size,
+             nb::keep_alive<0, 1>())
+        .def("del_prefix", &Index::del_prefix, nb::arg("prefix"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("del_glob", &Index::del_glob, nb::arg("pattern"),
+             nb::call_guard<nb::gil_scoped_release>())
         .def("exists", &Index::exists, nb::arg("key"),
              nb::call_guard<nb::gil_scoped_release>())
         .def("add", _simple_add_item<Index>, nb::arg("key"), nb::arg("value"))
@@ -253,8 +554,45 @@ NB_MODULE(_pysciqlop_cache, m)
              nb::arg("default_value") = 0)
         .def("clear", &Index::clear)
         .def("check", &Index::check, nb::arg("fix") = false)
+        .def("check_incremental", &Index::check_incremental, nb::arg("max_rows") = 4096,
+             nb::arg("fix") = false, nb::call_guard<nb::gil_scoped_release>())
         .def("size", &Index::size)
         .def("volume", &Index::volume)
+        .def("logical_size", &Index::logical_size)
+        .def("wal_stats", _wal_stats<Index>)
+        .def("mmap_cache_stats", _mmap_cache_stats<Index>)
+        .def("reset_mmap_cache_stats", &Index::reset_mmap_cache_stats)
+        .def("options", &Index::options)
+        .def("set_options", &Index::set_options, nb::arg("options"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("file_size_threshold", &Index::file_size_threshold)
+        .def("set_file_size_threshold", &Index::set_file_size_threshold, nb::arg("bytes"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("threshold_tuning", &Index::threshold_tuning)
+        .def("set_threshold_tuning", &Index::set_threshold_tuning, nb::arg("tuning"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("pread_cutoff", &Index::pread_cutoff)
+        .def("set_pread_cutoff", &Index::set_pread_cutoff, nb::arg("value"))
+        .def("set_io_uring_enabled", &Index::set_io_uring_enabled, nb::arg("enabled"))
+        .def("uses_io_uring", &Index::uses_io_uring)
+        .def("storage_layout", _storage_layout<Index>)
+        .def("set_storage_layout", _set_storage_layout<Index>, nb::arg("depth") = 1,
+             nb::arg("width") = 256)
+        .def("dedup_threshold", &Index::dedup_threshold)
+        .def("set_dedup_threshold", &Index::set_dedup_threshold, nb::arg("bytes"))
+        .def("chunk_policy", _chunk_policy<Index>)
+        .def("set_chunk_policy", _set_chunk_policy<Index>, nb::arg("threshold"),
+             nb::arg("chunk_size") = ChunkPolicy {}.chunk_size,
+             nb::arg("workers") = ChunkPolicy {}.workers)
+        .def("verify_policy", _verify_policy<Index>)
+        .def("set_verify_policy", _set_verify_policy<Index>, nb::arg("mode"),
+             nb::arg("sample_percent") = VerifyPolicy {}.sample_percent,
+             nb::arg("scrub_rows") = VerifyPolicy {}.scrub_rows)
+        .def("corrupt_values", &Index::corrupt_values)
+        .def("durability", &Index::durability)
+        .def("set_durability", &Index::set_durability, nb::arg("mode"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("sync", &Index::sync, nb::call_guard<nb::gil_scoped_release>())
         .def("set_meta", &Index::set_meta, nb::arg("key"), nb::arg("value"))
         .def("get_meta", &Index::get_meta, nb::arg("key"))
         .def("path", [](Index& idx) { return idx.path().string(); })
@@ -262,8 +600,9 @@ NB_MODULE(_pysciqlop_cache, m)
              nb::call_guard<nb::gil_scoped_release>());
 
     nb::class_<FanoutCache>(m, "FanoutCache")
-        .def(nb::init<const std::string&, std::size_t, std::size_t>(),
-             "cache_path"_a = ".cache/", "shard_count"_a = 8, "max_size"_a = 0)
+        .def(nb::init<const std::string&, std::size_t, std::size_t, const StoreOptions&>(),
+             "cache_path"_a = ".cache/", "shard_count"_a = 8, "max_size"_a = 0,
+             "options"_a = StoreOptions {})
         .def("count", &FanoutCache::count, nb::call_guard<nb::gil_scoped_release>())
         .def("__len__", &FanoutCache::count, nb::call_guard<nb::gil_scoped_release>())
         .def("set", _set_item_impl<FanoutCache>, nb::arg("key"), nb::arg("value"),
@@ -276,7 +615,22 @@ NB_MODULE(_pysciqlop_cache, m)
         .def("__getitem__", &FanoutCache::get, nb::arg("key"),
              nb::call_guard<nb::gil_scoped_release>())
         .def("keys", &FanoutCache::keys, nb::call_guard<nb::gil_scoped_release>())
-        .def("iterkeys", &FanoutCache::iterkeys)
+        .def("get_many", &FanoutCache::get_many, nb::arg("keys"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("set_many", _set_many<FanoutCache>, nb::arg("items"))
+        .def("prefetch", &FanoutCache::prefetch, nb::arg("keys"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("prefetched", &FanoutCache::prefetched)
+        .def("iterkeys", &FanoutCache::iterkeys, nb::arg("prefix") = "",
+             nb::arg("page_size") = FanoutCache::KeyCursor::default_page_size,
+             nb::keep_alive<0, 1>())
+        .def("items", &FanoutCache::items, nb::arg("prefix") = "",
+             nb::arg("page_size") = FanoutCache::KeyCursor::default_page_size,
+             nb::keep_alive<0, 1>())
+        .def("del_prefix", &FanoutCache::del_prefix, nb::arg("prefix"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("del_glob", &FanoutCache::del_glob, nb::arg("pattern"),
+             nb::call_guard<nb::gil_scoped_release>())
         .def("exists", &FanoutCache::exists, nb::arg("key"),
              nb::call_guard<nb::gil_scoped_release>())
         .def("add", _add_item_impl<FanoutCache>, nb::arg("key"), nb::arg("value"),
@@ -298,10 +652,56 @@ NB_MODULE(_pysciqlop_cache, m)
              nb::arg("default_value") = 0)
         .def("clear", &FanoutCache::clear)
         .def("check", &FanoutCache::check, nb::arg("fix") = false)
+        .def("check_incremental", &FanoutCache::check_incremental, nb::arg("max_rows") = 4096,
+             nb::arg("fix") = false, nb::call_guard<nb::gil_scoped_release>())
         .def("set_meta", &FanoutCache::set_meta, nb::arg("key"), nb::arg("value"))
         .def("get_meta", &FanoutCache::get_meta, nb::arg("key"))
         .def("size", &FanoutCache::size)
         .def("volume", &FanoutCache::volume)
+        .def("logical_size", &FanoutCache::logical_size)
+        .def("wal_stats", _wal_stats<FanoutCache>)
+        .def("mmap_cache_stats", _mmap_cache_stats<FanoutCache>)
+        .def("reset_mmap_cache_stats", &FanoutCache::reset_mmap_cache_stats)
+        .def("options", &FanoutCache::options)
+        .def("set_options", &FanoutCache::set_options, nb::arg("options"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("file_size_threshold", &FanoutCache::file_size_threshold)
+        .def("set_file_size_threshold", &FanoutCache::set_file_size_threshold, nb::arg("bytes"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("threshold_tuning", &FanoutCache::threshold_tuning)
+        .def("set_threshold_tuning", &FanoutCache::set_threshold_tuning, nb::arg("tuning"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("pread_cutoff", &FanoutCache::pread_cutoff)
+        .def("set_pread_cutoff", &FanoutCache::set_pread_cutoff, nb::arg("value"))
+        .def("set_io_uring_enabled", &FanoutCache::set_io_uring_enabled, nb::arg("enabled"))
+        .def("uses_io_uring", &FanoutCache::uses_io_uring)
+        .def("storage_layout", _storage_layout<FanoutCache>)
+        .def("set_storage_layout", _set_storage_layout<FanoutCache>, nb::arg("depth") = 1,
+             nb::arg("width") = 256)
+        .def("dedup_threshold", &FanoutCache::dedup_threshold)
+        .def("set_dedup_threshold", &FanoutCache::set_dedup_threshold, nb::arg("bytes"))
+        .def("chunk_policy", _chunk_policy<FanoutCache>)
+        .def("set_chunk_policy", _set_chunk_policy<FanoutCache>, nb::arg("threshold"),
+             nb::arg("chunk_size") = ChunkPolicy {}.chunk_size,
+             nb::arg("workers") = ChunkPolicy {}.workers)
+        .def("verify_policy", _verify_policy<FanoutCache>)
+        .def("set_verify_policy", _set_verify_policy<FanoutCache>, nb::arg("mode"),
+             nb::arg("sample_percent") = VerifyPolicy {}.sample_percent,
+             nb::arg("scrub_rows") = VerifyPolicy {}.scrub_rows)
+        .def("corrupt_values", &FanoutCache::corrupt_values)
+        .def("tier_policy", _tier_policy<FanoutCache>)
+        .def("set_tier_policy", _set_tier_policy<FanoutCache>, nb::arg("cold_path") = "",
+             nb::arg("hot_bytes") = TierPolicy {}.hot_bytes,
+             nb::arg("promote_on_read") = TierPolicy {}.promote_on_read)
+        .def("migrate_tiers", &FanoutCache::migrate_tiers, nb::call_guard<nb::gil_scoped_release>())
+        .def("durability", &FanoutCache::durability)
+        .def("set_durability", &FanoutCache::set_durability, nb::arg("mode"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("sync", &FanoutCache::sync, nb::call_guard<nb::gil_scoped_release>())
+        .def("compression", _compression<FanoutCache>)
+        .def("set_compression", _set_compression<FanoutCache>, nb::arg("codec"),
+             nb::arg("min_size") = CompressionPolicy {}.min_size,
+             nb::arg("max_ratio") = CompressionPolicy {}.max_ratio)
         .def("shard_count", &FanoutCache::shard_count)
         .def("set_max_cache_size", &FanoutCache::set_max_cache_size, nb::arg("value"))
         .def("path", [](FanoutCache& c) { return c.path().string(); })
@@ -317,8 +717,11 @@ NB_MODULE(_pysciqlop_cache, m)
              nb::call_guard<nb::gil_scoped_release>());
 
     nb::class_<FanoutIndex>(m, "FanoutIndex")
-        .def(nb::init<const std::string&, std::size_t>(),
-             "path"_a = ".index/", "shard_count"_a = 8)
+        .def("__init__",
+             [](FanoutIndex* self, const std::string& path, std::size_t shard_count,
+                const StoreOptions& options)
+             { new (self) FanoutIndex(path, shard_count, 0, options); },
+             "path"_a = ".index/", "shard_count"_a = 8, "options"_a = StoreOptions {})
         .def("count", &FanoutIndex::count, nb::call_guard<nb::gil_scoped_release>())
         .def("__len__", &FanoutIndex::count, nb::call_guard<nb::gil_scoped_release>())
         .def("set", _simple_set_item<FanoutIndex>, nb::arg("key"), nb::arg("value"))
@@ -328,7 +731,22 @@ NB_MODULE(_pysciqlop_cache, m)
         .def("__getitem__", &FanoutIndex::get, nb::arg("key"),
              nb::call_guard<nb::gil_scoped_release>())
         .def("keys", &FanoutIndex::keys, nb::call_guard<nb::gil_scoped_release>())
-        .def("iterkeys", &FanoutIndex::iterkeys)
+        .def("get_many", &FanoutIndex::get_many, nb::arg("keys"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("set_many", _set_many<FanoutIndex>, nb::arg("items"))
+        .def("prefetch", &FanoutIndex::prefetch, nb::arg("keys"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("prefetched", &FanoutIndex::prefetched)
+        .def("iterkeys", &FanoutIndex::iterkeys, nb::arg("prefix") = "",
+             nb::arg("page_size") = FanoutIndex::KeyCursor::default_page_size,
+             nb::keep_alive<0, 1>())
+        .def("items", &FanoutIndex::items, nb::arg("prefix") = "",
+             nb::arg("page_size") = FanoutIndex::KeyCursor::default_page_size,
+             nb::keep_alive<0, 1>())
+        .def("del_prefix", &FanoutIndex::del_prefix, nb::arg("prefix"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("del_glob", &FanoutIndex::del_glob, nb::arg("pattern"),
+             nb::call_guard<nb::gil_scoped_release>())
         .def("exists", &FanoutIndex::exists, nb::arg("key"),
              nb::call_guard<nb::gil_scoped_release>())
         .def("add", _simple_add_item<FanoutIndex>, nb::arg("key"), nb::arg("value"))
@@ -342,8 +760,45 @@ NB_MODULE(_pysciqlop_cache, m)
              nb::arg("default_value") = 0)
         .def("clear", &FanoutIndex::clear)
         .def("check", &FanoutIndex::check, nb::arg("fix") = false)
+        .def("check_incremental", &FanoutIndex::check_incremental, nb::arg("max_rows") = 4096,
+             nb::arg("fix") = false, nb::call_guard<nb::gil_scoped_release>())
         .def("size", &FanoutIndex::size)
         .def("volume", &FanoutIndex::volume)
+        .def("logical_size", &FanoutIndex::logical_size)
+        .def("wal_stats", _wal_stats<FanoutIndex>)
+        .def("mmap_cache_stats", _mmap_cache_stats<FanoutIndex>)
+        .def("reset_mmap_cache_stats", &FanoutIndex::reset_mmap_cache_stats)
+        .def("options", &FanoutIndex::options)
+        .def("set_options", &FanoutIndex::set_options, nb::arg("options"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("file_size_threshold", &FanoutIndex::file_size_threshold)
+        .def("set_file_size_threshold", &FanoutIndex::set_file_size_threshold, nb::arg("bytes"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("threshold_tuning", &FanoutIndex::threshold_tuning)
+        .def("set_threshold_tuning", &FanoutIndex::set_threshold_tuning, nb::arg("tuning"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("pread_cutoff", &FanoutIndex::pread_cutoff)
+        .def("set_pread_cutoff", &FanoutIndex::set_pread_cutoff, nb::arg("value"))
+        .def("set_io_uring_enabled", &FanoutIndex::set_io_uring_enabled, nb::arg("enabled"))
+        .def("uses_io_uring", &FanoutIndex::uses_io_uring)
+        .def("storage_layout", _storage_layout<FanoutIndex>)
+        .def("set_storage_layout", _set_storage_layout<FanoutIndex>, nb::arg("depth") = 1,
+             nb::arg("width") = 256)
+        .def("dedup_threshold", &FanoutIndex::dedup_threshold)
+        .def("set_dedup_threshold", &FanoutIndex::set_dedup_threshold, nb::arg("bytes"))
+        .def("chunk_policy", _chunk_policy<FanoutIndex>)
+        .def("set_chunk_policy", _set_chunk_policy<FanoutIndex>, nb::arg("threshold"),
+             nb::arg("chunk_size") = ChunkPolicy {}.chunk_size,
+             nb::arg("workers") = ChunkPolicy {}.workers)
+        .def("verify_policy", _verify_policy<FanoutIndex>)
+        .def("set_verify_policy", _set_verify_policy<FanoutIndex>, nb::arg("mode"),
+             nb::arg("sample_percent") = VerifyPolicy {}.sample_percent,
+             nb::arg("scrub_rows") = VerifyPolicy {}.scrub_rows)
+        .def("corrupt_values", &FanoutIndex::corrupt_values)
+        .def("durability", &FanoutIndex::durability)
+        .def("set_durability", &FanoutIndex::set_durability, nb::arg("mode"),
+             nb::call_guard<nb::gil_scoped_release>())
+        .def("sync", &FanoutIndex::sync, nb::call_guard<nb::gil_scoped_release>())
         .def("shard_count", &FanoutIndex::shard_count)
         .def("set_meta", &FanoutIndex::set_meta, nb::arg("key"), nb::arg("value"))
         .def("get_meta", &FanoutIndex::get_meta, nb::arg("key"))
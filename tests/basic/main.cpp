@@ -4,6 +4,7 @@
 #include <filesystem>
 #include <optional>
 #include <random>
+#include <set>
 #include <string>
 #include <thread>
 #include <vector>
@@ -100,6 +101,337 @@ SCENARIO("Testing file I/O with Bytes concept", "[bytes][fileio]")
     }
 }
 
+SCENARIO("DiskStorage defers removals through its trash directory", "[fileio][trash]")
+{
+    AutoCleanDirectory dir { "TrashTest" };
+    std::vector<char> data(4096, 'x');
+
+    GIVEN("a stored file handed to the deletion queue")
+    {
+        DiskStorage storage(dir.path());
+        auto stored = storage.store(data);
+        REQUIRE(stored);
+        auto file = storage.abs_path(*stored);
+        REQUIRE(storage.defer_remove(*stored) == 1);
+
+        THEN("it leaves its value directory at once but is only unlinked on drain")
+        {
+            REQUIRE_FALSE(std::filesystem::exists(file));
+            auto trashed = storage.trash_path() / file.filename();
+            REQUIRE(std::filesystem::exists(trashed));
+            REQUIRE(storage.drain_removals(1) == 1);
+            REQUIRE_FALSE(std::filesystem::exists(trashed));
+            REQUIRE(storage.pending_removals() == 0);
+        }
+
+        WHEN("the storage is reopened before the queue is drained")
+        {
+            DiskStorage reopened(dir.path());
+
+            THEN("the leftover trash is queued again")
+            {
+                REQUIRE(reopened.pending_removals() == 1);
+                REQUIRE(reopened.drain_removals() == 1);
+                REQUIRE(std::filesystem::is_empty(reopened.trash_path()));
+            }
+        }
+    }
+}
+
+SCENARIO("DiskStorage caches mapped files within a byte budget", "[fileio][mmap]")
+{
+    AutoCleanDirectory dir { "MmapCacheTest" };
+    // 64 KiB per shard: four 16 KiB files fit in a shard, a 128 KiB one does not.
+    constexpr std::size_t budget = MmapHandleCache::shard_count * 64 * 1024;
+    DiskStorage storage(dir.path(), budget);
+    storage.set_pread_cutoff(0);
+    std::vector<char> data(16 * 1024, 'x');
+
+    GIVEN("many more mapped files than the budget can hold")
+    {
+        std::vector<std::filesystem::path> files;
+        for (int i = 0; i < 256; ++i)
+            files.push_back(*storage.store(data));
+        for (const auto& f : files)
+        {
+            REQUIRE(storage.load(f));
+            REQUIRE(storage.load(f));
+        }
+
+        THEN("every first read misses, every immediate re-read hits")
+        {
+            auto st = storage.mmap_cache_stats();
+            REQUIRE(st.misses == 256);
+            REQUIRE(st.hits == 256);
+        }
+        THEN("the mapped bytes stay within the budget")
+        {
+            auto st = storage.mmap_cache_stats();
+            REQUIRE(st.capacity_bytes == budget);
+            REQUIRE(st.entries > 0);
+            REQUIRE(st.entries < 256);
+            REQUIRE(st.mapped_bytes <= budget);
+            REQUIRE(st.mapped_bytes == st.entries * data.size());
+        }
+        THEN("removing a file drops its mapping")
+        {
+            auto before = storage.mmap_cache_stats().entries;
+            storage.remove(files.back());
+            REQUIRE(storage.mmap_cache_stats().entries == before - 1);
+            REQUIRE_FALSE(storage.load(files.back()));
+        }
+    }
+
+    GIVEN("a file larger than a shard's budget")
+    {
+        std::vector<char> big(128 * 1024, 'y');
+        auto f = *storage.store(big);
+        auto first = storage.load(f);
+        auto second = storage.load(f);
+
+        THEN("it is served but never cached")
+        {
+            REQUIRE(first);
+            REQUIRE(second);
+            REQUIRE(second->size() == big.size());
+            auto st = storage.mmap_cache_stats();
+            REQUIRE(st.entries == 0);
+            REQUIRE(st.misses == 2);
+        }
+    }
+}
+
+SCENARIO("DiskStorage reads files below the pread cutoff without mapping them", "[fileio][mmap]")
+{
+    AutoCleanDirectory dir { "PreadTest" };
+    DiskStorage storage(dir.path());
+    REQUIRE(storage.pread_cutoff() == DiskStorage::default_pread_cutoff);
+
+    GIVEN("a file just below the cutoff and one above it")
+    {
+        std::vector<char> medium(DiskStorage::default_pread_cutoff - 1);
+        std::vector<char> large(DiskStorage::default_pread_cutoff);
+        for (std::size_t i = 0; i < large.size(); ++i)
+            large[i] = static_cast<char>(i * 7);
+        std::copy_n(large.begin(), medium.size(), medium.begin());
+        auto medium_file = *storage.store(medium);
+        auto large_file = *storage.store(large);
+
+        THEN("both read back intact, and only the large one is cached")
+        {
+            for (int round = 0; round < 3; ++round)
+            {
+                auto m = storage.load(medium_file);
+                auto l = storage.load(large_file);
+                REQUIRE(m);
+                REQUIRE(l);
+                REQUIRE(m->to_vector() == medium);
+                REQUIRE(l->to_vector() == large);
+            }
+            auto st = storage.mmap_cache_stats();
+            REQUIRE(st.entries == 1);
+            REQUIRE(st.mapped_bytes == large.size());
+            REQUIRE(st.hits == 2);
+        }
+        THEN("a buffer outlives the storage it was read from")
+        {
+            std::optional<Buffer> m;
+            {
+                DiskStorage other(dir.path());
+                m = other.load(medium_file);
+            }
+            REQUIRE(m);
+            REQUIRE(m->to_vector() == medium);
+        }
+        THEN("a missing file reads as nothing")
+        {
+            storage.remove(medium_file);
+            REQUIRE_FALSE(storage.load(medium_file));
+        }
+    }
+}
+
+SCENARIO("DiskStorage batches file I/O, with or without io_uring", "[fileio][batch]")
+{
+    AutoCleanDirectory dir { "BatchIoTest" };
+    const bool use_ring = GENERATE(true, false);
+    DiskStorage storage(dir.path());
+    storage.set_io_uring_enabled(use_ring);
+    if (!use_ring)
+        REQUIRE_FALSE(storage.uses_io_uring());
+
+    GIVEN("a batch of values of assorted sizes written with store_many()")
+    {
+        std::vector<std::vector<char>> values;
+        for (std::size_t i = 0; i < 300; ++i)
+            values.emplace_back(1 + (i * 4099) % (3 * DiskStorage::default_pread_cutoff),
+                                static_cast<char>(i));
+        std::vector<std::span<const char>> spans(values.begin(), values.end());
+        auto stored = storage.store_many(spans);
+        REQUIRE(stored.size() == values.size());
+        std::vector<std::filesystem::path> paths;
+        for (const auto& p : stored)
+        {
+            REQUIRE(p);
+            paths.push_back(*p);
+        }
+
+        THEN("load_many() reads every one back in order")
+        {
+            paths.push_back("no/such/file");
+            auto loaded = storage.load_many(paths);
+            REQUIRE(loaded.size() == paths.size());
+            for (std::size_t i = 0; i < values.size(); ++i)
+            {
+                REQUIRE(loaded[i]);
+                REQUIRE(loaded[i]->to_vector() == values[i]);
+            }
+            REQUIRE_FALSE(loaded.back());
+        }
+        THEN("a drained deletion queue unlinks them all and releases their bytes")
+        {
+            auto before = storage.bytes_delta();
+            REQUIRE(before > 0);
+            for (const auto& p : paths)
+                storage.defer_remove(p);
+            REQUIRE(storage.drain_removals(1024) == paths.size());
+            REQUIRE(storage.bytes_delta() == 0);
+            for (const auto& p : paths)
+                REQUIRE_FALSE(std::filesystem::exists(storage.abs_path(p)));
+        }
+    }
+}
+
+SCENARIO("DiskStorage writes into a precreated fan-out", "[fileio][layout]")
+{
+    namespace fs = std::filesystem;
+    AutoCleanDirectory dir { "LayoutTest" };
+    DiskStorage storage(dir.path());
+    std::vector<char> value(100, 'v');
+
+    GIVEN("the default layout")
+    {
+        REQUIRE(storage.layout() == StorageLayout {});
+        THEN("its directories exist before anything is written")
+        {
+            REQUIRE(fs::is_directory(dir.path() / "00"));
+            REQUIRE(fs::is_directory(dir.path() / "ff"));
+        }
+        THEN("consecutive files share a directory and never share a name")
+        {
+            std::set<fs::path> names;
+            std::set<fs::path> parents;
+            for (int i = 0; i < 10; ++i)
+            {
+                auto p = storage.store(value);
+                REQUIRE(p);
+                REQUIRE(std::distance(p->begin(), p->end()) == 2);
+                names.insert(p->filename());
+                parents.insert(p->parent_path());
+            }
+            REQUIRE(names.size() == 10);
+            REQUIRE(parents.size() <= 2);
+        }
+        THEN("a write whose directory vanished recreates it")
+        {
+            auto first = storage.store(value);
+            REQUIRE(first);
+            fs::remove_all(storage.abs_path(first->parent_path()));
+            auto second = storage.store(value);
+            REQUIRE(second);
+            REQUIRE(storage.load(*second)->to_vector() == value);
+            std::vector<std::span<const char>> spans { value, value };
+            for (const auto& p : storage.store_many(spans))
+                REQUIRE(p);
+        }
+    }
+
+    GIVEN("a deeper, narrower layout")
+    {
+        storage.set_layout({ 2, 16 });
+        REQUIRE(storage.layout() == StorageLayout { 2, 16 });
+        THEN("files go two levels down")
+        {
+            REQUIRE(fs::is_directory(dir.path() / "f" / "f"));
+            auto p = storage.store(value);
+            REQUIRE(p);
+            REQUIRE(std::distance(p->begin(), p->end()) == 3);
+            REQUIRE(storage.load(*p)->to_vector() == value);
+        }
+    }
+
+    GIVEN("out of range layouts")
+    {
+        THEN("they are clamped")
+        {
+            storage.set_layout({ 5, 8 });
+            REQUIRE(storage.layout() == StorageLayout { 3, 8 });
+            storage.set_layout({ 1, 100000 });
+            REQUIRE(storage.layout() == StorageLayout { 1, 4096 });
+            storage.set_layout({ 0, 16 });
+            REQUIRE(storage.layout() == StorageLayout { 1, 16 });
+        }
+    }
+}
+
+SCENARIO("DiskStorage honours each durability mode", "[fileio][durability]")
+{
+    AutoCleanDirectory dir { "DurabilityTest" };
+    const auto mode = GENERATE(Durability::none, Durability::sync, Durability::group);
+    DiskStorage storage(dir.path());
+    storage.set_durability(mode);
+    REQUIRE(storage.durability() == mode);
+
+    GIVEN("values written one by one and in a batch")
+    {
+        std::vector<std::vector<char>> values;
+        for (std::size_t i = 0; i < 20; ++i)
+            values.emplace_back(1000 + i * 997, static_cast<char>(i));
+        std::vector<std::filesystem::path> paths;
+        for (std::size_t i = 0; i < 10; ++i)
+        {
+            auto p = storage.store(values[i]);
+            REQUIRE(p);
+            paths.push_back(*p);
+        }
+        std::vector<std::span<const char>> spans(values.begin() + 10, values.end());
+        for (const auto& p : storage.store_many(spans))
+        {
+            REQUIRE(p);
+            paths.push_back(*p);
+        }
+
+        THEN("they read back and no temporary file is left behind")
+        {
+            for (std::size_t i = 0; i < values.size(); ++i)
+                REQUIRE(storage.load(paths[i])->to_vector() == values[i]);
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(dir.path()))
+                REQUIRE(entry.path().extension() != ".tmp");
+        }
+        THEN("only group mode leaves them for a sync wave, which clears the backlog")
+        {
+            const auto expected = mode == Durability::group ? values.size() : 0;
+            REQUIRE(storage.unsynced_files() == expected);
+            REQUIRE(storage.sync_pending() == expected);
+            REQUIRE(storage.unsynced_files() == 0);
+            REQUIRE(storage.sync_pending() == 0);
+        }
+        THEN("copies to another tier are on the device before their rows can point at them")
+        {
+            AutoCleanDirectory cold { "DurabilityTestCold" };
+            storage.set_cold_path(cold.path());
+            (void)storage.sync_pending();
+            auto demoted = storage.copy_to_tier(paths[0], true);
+            REQUIRE(demoted);
+            REQUIRE(storage.unsynced_files() == 0);
+            auto promoted = storage.copy_to_tier(*demoted, false);
+            REQUIRE(promoted);
+            REQUIRE(storage.unsynced_files() == 0);
+            REQUIRE(storage.load(*demoted)->to_vector() == values[0]);
+        }
+    }
+}
+
 SCENARIO("Testing sciqlop_cache basic operations", "[cache]")
 {
     AutoCleanDirectory db_path { "BasicTest01" , false};
@@ -475,6 +807,16 @@ SCENARIO("Testing sciqlop_cache tag operations", "[cache][tags]")
                 REQUIRE(cache.count() == 4);
             }
         }
+
+        WHEN("a tag generation is written through set_meta")
+        {
+            THEN("it is rejected and the tagged entries stay visible")
+            {
+                REQUIRE_THROWS_AS(cache.set_meta("gen:groupA", "x"), std::invalid_argument);
+                REQUIRE(cache.get("k1").has_value());
+                REQUIRE(cache.count() == 4);
+            }
+        }
     }
 
     GIVEN("a cache with tagged entries using add()")
@@ -514,6 +856,52 @@ SCENARIO("Testing sciqlop_cache tag operations", "[cache][tags]")
             }
         }
     }
+
+    GIVEN("a tag invalidated before its rows are collected")
+    {
+        Cache cache(db_path.path());
+        cache.set_checkpoint_policy({ .housekeeping_interval = std::chrono::hours(1) });
+        std::vector<char> big(16000, 'x');
+        cache.set("old_big", big, "gen");
+        cache.set("old_small", v1, "gen");
+        cache.set("counter", v1, "gen");
+        REQUIRE(cache.evict_tag("gen") == 3);
+
+        THEN("the hidden rows still occupy the counters but not the keyspace")
+        {
+            REQUIRE(cache.count() == 0);
+            REQUIRE(cache.size() == big.size() + 2 * v1.size());
+            REQUIRE(cache.keys().empty());
+            REQUIRE_FALSE(cache.exists("old_big"));
+        }
+        THEN("the same tag can be reused right away")
+        {
+            cache.set("new", v2, "gen");
+            REQUIRE(cache.get("new").has_value());
+            REQUIRE(cache.evict_tag("gen") == 1);
+        }
+        THEN("add() and incr() treat the hidden keys as absent")
+        {
+            REQUIRE(cache.add("old_small", v2, "gen"));
+            REQUIRE(cache.get("old_small")->size() == v2.size());
+            REQUIRE(cache.incr("counter", 5) == 5);
+        }
+        WHEN("the background thread runs")
+        {
+            cache.set_checkpoint_policy({ .housekeeping_interval = 20ms });
+            auto deadline = std::chrono::steady_clock::now() + 10s;
+            while (cache.size() != 0 && std::chrono::steady_clock::now() < deadline)
+                std::this_thread::sleep_for(20ms);
+
+            THEN("the hidden rows and their files are gone")
+            {
+                REQUIRE(cache.size() == 0);
+                auto result = cache.check();
+                REQUIRE(result.ok);
+                REQUIRE(std::filesystem::is_empty(db_path.path() / std::string(DiskStorage::trash_dirname)));
+            }
+        }
+    }
 }
 
 SCENARIO("Testing sciqlop_cache incr/decr operations", "[cache][incr]")
@@ -756,13 +1144,22 @@ SCENARIO("Testing sciqlop_cache clear with big values", "[cache]")
             {
                 namespace fs = std::filesystem;
                 int file_count = 0;
-                for (const auto& entry : fs::recursive_directory_iterator(db_path.path()))
+                // Files moved to the trash are only waiting for the
+                // background thread to unlink them.
+                for (auto it = fs::recursive_directory_iterator(db_path.path());
+                     it != fs::recursive_directory_iterator(); ++it)
                 {
+                    const auto& entry = *it;
+                    if (entry.path().filename() == DiskStorage::trash_dirname)
+                    {
+                        it.disable_recursion_pending();
+                        continue;
+                    }
                     if (entry.is_regular_file())
                     {
                         auto fname = entry.path().filename().string();
-                        bool is_db_file = fname == "sciqlop-cache.db"
-                            || fname.ends_with("-wal") || fname.ends_with("-shm");
+                        // The database and its sidecars (WAL, SHM, intent logs).
+                        bool is_db_file = fname.starts_with(std::string(Cache::db_fname));
                         if (!is_db_file)
                             ++file_count;
                     }
@@ -773,138 +1170,912 @@ SCENARIO("Testing sciqlop_cache clear with big values", "[cache]")
     }
 }
 
-SCENARIO("Cache statistics track hits and misses", "[stats]")
+SCENARIO("clear() swaps the table out and purges the old rows in the background", "[clear]")
 {
-    AutoCleanDirectory db_path { "StatsTest" };
-    std::vector<char> value(64, 'x');
-
-    GIVEN("a fresh cache")
+    AutoCleanDirectory db_path { "ClearPurge" };
+    auto count_tables = [&](const char* where) -> int
+    {
+        sqlite3* raw = nullptr;
+        sqlite3_open((db_path.path() / "sciqlop-cache.db").string().c_str(), &raw);
+        sqlite3_stmt* stmt = nullptr;
+        auto sql = std::string("SELECT count(*) FROM sqlite_master WHERE ") + where + ";";
+        sqlite3_prepare_v2(raw, sql.c_str(), -1, &stmt, nullptr);
+        int n = -1;
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+            n = sqlite3_column_int(stmt, 0);
+        sqlite3_finalize(stmt);
+        sqlite3_close(raw);
+        return n;
+    };
+
+    GIVEN("a cache with many small and a few file-backed entries")
     {
-        Cache cache(db_path.path());
-        auto s = cache.stats();
-        REQUIRE(s.hits == 0);
-        REQUIRE(s.misses == 0);
-
-        WHEN("getting an existing key")
         {
-            cache.set("k1", value);
-            cache.get("k1");
-
-            THEN("hits increments")
+            Cache cache(db_path.path());
+            cache.set_checkpoint_policy({ .housekeeping_interval = 20ms });
             {
-                auto s = cache.stats();
-                REQUIRE(s.hits == 1);
-                REQUIRE(s.misses == 0);
+                auto txn = cache.begin_user_transaction();
+                for (int i = 0; i < 5000; ++i)
+                    cache.set("small" + std::to_string(i), std::vector<char>(64, 'x'));
+                for (int i = 0; i < 4; ++i)
+                    cache.set("big" + std::to_string(i), std::vector<char>(16000, 'y'));
+                txn.commit();
             }
-        }
 
-        WHEN("getting a missing key")
-        {
-            cache.get("nonexistent");
+            WHEN("clear() is called")
+            {
+                cache.clear();
 
-            THEN("misses increments")
+                THEN("the cache is immediately empty and usable")
+                {
+                    REQUIRE(cache.count() == 0);
+                    REQUIRE(cache.size() == 0);
+                    REQUIRE_FALSE(cache.get("small1"));
+                    REQUIRE(cache.set("small1", std::vector<char>(64, 'z')));
+                    REQUIRE(cache.count() == 1);
+                }
+                THEN("the background thread eventually drops the old table")
+                {
+                    auto deadline = std::chrono::steady_clock::now() + 10s;
+                    while (count_tables("type = 'table' AND name LIKE 'cache_purge_%'") != 0
+                           && std::chrono::steady_clock::now() < deadline)
+                        std::this_thread::sleep_for(20ms);
+                    REQUIRE(count_tables("type = 'table' AND name LIKE 'cache_purge_%'") == 0);
+                }
+            }
+            WHEN("clear() is called on a table with an index of its own")
             {
-                auto s = cache.stats();
-                REQUIRE(s.hits == 0);
-                REQUIRE(s.misses == 1);
+                cache.set_checkpoint_policy({ .housekeeping_interval = std::chrono::hours(1) });
+                sqlite3* raw = nullptr;
+                sqlite3_open((db_path.path() / "sciqlop-cache.db").string().c_str(), &raw);
+                REQUIRE(sqlite3_exec(raw, "CREATE INDEX idx_cache_extra ON cache(size);",
+                                     nullptr, nullptr, nullptr)
+                        == SQLITE_OK);
+                sqlite3_close(raw);
+                cache.clear();
+                THEN("no index or trigger is left on the renamed tables")
+                {
+                    REQUIRE(count_tables("type IN ('index', 'trigger') AND sql IS NOT NULL"
+                                         " AND tbl_name LIKE '%_purge_%'")
+                            == 0);
+                    REQUIRE(cache.set("small1", std::vector<char>(64, 'z')));
+                    REQUIRE(cache.check().ok);
+                }
             }
         }
-
-        WHEN("getting an expired key")
+        THEN("the fresh table keeps its indexes")
         {
-            cache.set("k2", value, 1s);
-            std::this_thread::sleep_for(2s);
-            cache.get("k2");
-
-            THEN("it counts as a miss")
-            {
-                auto s = cache.stats();
-                REQUIRE(s.hits == 0);
-                REQUIRE(s.misses == 1);
-            }
+            REQUIRE(count_tables("type = 'index' AND name = 'idx_cache_tag_gen' AND tbl_name = 'cache'") == 1);
         }
+    }
+}
 
-        WHEN("performing a mix of hits and misses")
+SCENARIO("set_many() and get_many() batch several entries", "[cache][batch]")
+{
+    GIVEN("a cache and a batch of inline and file-backed values")
+    {
+        AutoCleanDirectory db_path { "Batch" };
+        Cache cache(db_path.path());
+        std::vector<std::vector<char>> values;
+        std::vector<std::pair<std::string, std::span<const char>>> items;
+        std::vector<std::string> keys;
+        std::size_t total = 0;
+        for (int i = 0; i < 100; ++i)
         {
-            cache.set("a", value);
-            cache.set("b", value);
-            cache.get("a");
-            cache.get("b");
-            cache.get("c");
-            cache.get("d");
+            values.emplace_back(i % 2 ? 200 : 20000, static_cast<char>(i));
+            total += values.back().size();
+        }
+        for (int i = 0; i < 100; ++i)
+        {
+            keys.push_back("k" + std::to_string(i));
+            items.emplace_back(keys.back(), values[i]);
+        }
+        REQUIRE(cache.set_many(items));
 
-            THEN("counts are accurate")
+        THEN("every entry is stored and accounted for")
+        {
+            REQUIRE(cache.count() == 100);
+            REQUIRE(cache.size() == total);
+            auto with_missing = keys;
+            with_missing.push_back("missing");
+            auto got = cache.get_many(with_missing);
+            REQUIRE(got.size() == 101);
+            for (int i = 0; i < 100; ++i)
             {
-                auto s = cache.stats();
-                REQUIRE(s.hits == 2);
-                REQUIRE(s.misses == 2);
+                REQUIRE(got[i]);
+                REQUIRE(got[i]->to_vector() == values[i]);
             }
+            REQUIRE_FALSE(got.back());
+            REQUIRE(cache.stats().misses == 1);
         }
-
-        WHEN("reset_stats is called")
+        WHEN("the batch is written again with swapped sizes")
         {
-            cache.set("k", value);
-            cache.get("k");
-            cache.get("missing");
-            cache.reset_stats();
+            for (auto& v : values)
+                v.resize(v.size() == 200 ? 20000 : 200, 'z');
+            for (int i = 0; i < 100; ++i)
+                items[i].second = values[i];
+            REQUIRE(cache.set_many(items));
 
-            THEN("counters return to zero")
+            THEN("the new values replace the old ones and the old files go away")
             {
-                auto s = cache.stats();
-                REQUIRE(s.hits == 0);
-                REQUIRE(s.misses == 0);
+                auto got = cache.get_many(keys);
+                for (int i = 0; i < 100; ++i)
+                    REQUIRE(got[i]->to_vector() == values[i]);
+                REQUIRE(cache.count() == 100);
+                auto result = cache.check();
+                REQUIRE(result.ok);
+                REQUIRE(result.orphaned_files == 0);
             }
         }
     }
 }
 
-SCENARIO("expire() correctly updates size and count counters", "[cache][expire]")
+SCENARIO("prefetch() warms up keys from the background thread", "[prefetch]")
 {
-    AutoCleanDirectory db_path { "ExpireCounters01" };
-    std::vector<char> v100(100, 'a');
-    std::vector<char> v200(200, 'b');
-
-    GIVEN("a cache with expiring and non-expiring entries")
+    GIVEN("a cache holding inline and file-backed values")
     {
+        AutoCleanDirectory db_path { "Prefetch" };
         Cache cache(db_path.path());
-        cache.set("permanent1", v100);
-        cache.set("permanent2", v200);
-        cache.set("expiring1", v100, 1s);
-        cache.set("expiring2", v200, 1s);
-
-        REQUIRE(cache.size() == 600);
-
-        WHEN("entries expire and expire() is called")
+        std::vector<char> small(200, 's');
+        std::vector<char> big(DiskStorage::default_pread_cutoff * 2, 'b');
+        std::vector<std::string> keys;
+        for (int i = 0; i < 600; ++i)
         {
-            std::this_thread::sleep_for(2s);
-            cache.expire();
-
-            THEN("size reflects only the remaining entries")
-            {
-                REQUIRE(cache.size() == 300);
-                REQUIRE(cache.count() == 2);
-            }
+            keys.push_back("k" + std::to_string(i));
+            REQUIRE(cache.set(keys.back(), i % 3 == 0 ? big : small));
         }
+        keys.push_back("missing");
 
-        WHEN("we add more entries between expiration check and expire()")
+        WHEN("the keys are prefetched")
         {
-            std::this_thread::sleep_for(2s);
-            cache.set("late_arrival", v100);
-            cache.expire();
+            cache.prefetch(keys);
+            auto deadline = std::chrono::steady_clock::now() + 5s;
+            while (cache.prefetched() < keys.size() && std::chrono::steady_clock::now() < deadline)
+                std::this_thread::sleep_for(10ms);
 
-            THEN("late arrival is preserved and counters are correct")
+            THEN("the background thread goes through all of them, unknown ones included")
             {
-                REQUIRE(cache.get("late_arrival").has_value());
-                REQUIRE(cache.size() == 400);
-                REQUIRE(cache.count() == 3);
+                REQUIRE(cache.prefetched() == keys.size());
+            }
+            THEN("the values read back unchanged")
+            {
+                for (int i = 0; i < 600; ++i)
+                    REQUIRE(cache.get(keys[i])->to_vector() == (i % 3 == 0 ? big : small));
+                REQUIRE_FALSE(cache.get("missing"));
             }
         }
     }
+}
 
-    GIVEN("a cache where all entries expire")
+SCENARIO("Entries survive a reopen in every durability mode", "[durability]")
+{
+    AutoCleanDirectory db_path { "CacheDurability" };
+    const auto mode = GENERATE(Durability::none, Durability::sync, Durability::group);
+    std::vector<char> small(200, 's');
+    std::vector<char> big(64 * 1024, 'b');
+    std::vector<std::pair<std::string, std::span<const char>>> batch {
+        { "batch-small", small }, { "batch-big", big }
+    };
+
+    GIVEN("entries written in that mode, then flushed with sync()")
     {
-        Cache cache(db_path.path());
-        cache.set("e1", v100, 1s);
+        {
+            Cache cache(db_path.path());
+            cache.set_durability(mode);
+            REQUIRE(cache.durability() == mode);
+            REQUIRE(cache.set("small", small));
+            REQUIRE(cache.set("big", big));
+            REQUIRE(cache.set_many(batch));
+            cache.sync();
+        }
+
+        THEN("a reopened cache reads them back")
+        {
+            Cache cache(db_path.path());
+            REQUIRE(cache.get("small")->to_vector() == small);
+            REQUIRE(cache.get("big")->to_vector() == big);
+            REQUIRE(cache.get("batch-small")->to_vector() == small);
+            REQUIRE(cache.get("batch-big")->to_vector() == big);
+            REQUIRE(cache.check().ok);
+        }
+    }
+}
+
+// Run-length encoding as (count, byte) pairs: enough to exercise the codec
+// plumbing without an external library.
+class RleTestCodec final : public Codec
+{
+public:
+    uint8_t id() const noexcept override { return static_cast<uint8_t>(CodecId::first_user); }
+    std::string_view name() const noexcept override { return "rle-test"; }
+    std::size_t max_compressed_size(std::size_t size) const noexcept override { return 2 * size; }
+    std::size_t compress(std::span<const char> in, std::span<char> out) const noexcept override
+    {
+        std::size_t n = 0;
+        for (std::size_t i = 0; i < in.size();)
+        {
+            std::size_t run = 1;
+            while (i + run < in.size() && run < 255 && in[i + run] == in[i])
+                ++run;
+            out[n++] = static_cast<char>(run);
+            out[n++] = in[i];
+            i += run;
+        }
+        return n;
+    }
+    bool decompress(std::span<const char> in, std::span<char> out) const noexcept override
+    {
+        std::size_t n = 0;
+        for (std::size_t i = 0; i + 1 < in.size(); i += 2)
+        {
+            auto run = static_cast<unsigned char>(in[i]);
+            if (n + run > out.size())
+                return false;
+            std::fill_n(out.begin() + static_cast<std::ptrdiff_t>(n), run, in[i + 1]);
+            n += run;
+        }
+        return n == out.size();
+    }
+};
+
+SCENARIO("Values are compressed per entry with a pluggable codec", "[cache][compression]")
+{
+    AutoCleanDirectory db_path { "CacheCompression" };
+    register_codec(std::make_unique<RleTestCodec>());
+    const auto rle = static_cast<uint8_t>(CodecId::first_user);
+
+    std::vector<char> tiny(32, 't');
+    std::vector<char> inline_run(4 * 1024, 'i');
+    std::vector<char> file_run(256 * 1024, 'f');
+    std::vector<char> noise(64 * 1024);
+    std::mt19937 rng { 42 };
+    std::generate(noise.begin(), noise.end(), [&] { return static_cast<char>(rng()); });
+
+    GIVEN("a cache with a value written before compression was enabled")
+    {
+        Cache cache(db_path.path());
+        REQUIRE(cache.compression().codec == 0);
+        REQUIRE(cache.set("before", inline_run));
+        REQUIRE_FALSE(cache.set_compression({ 200, 64, 0.9 }));
+        REQUIRE(cache.set_compression({ rle, 64, 0.9 }));
+
+        WHEN("values of every kind are written")
+        {
+            REQUIRE(cache.set("tiny", tiny));
+            REQUIRE(cache.set("inline", inline_run));
+            REQUIRE(cache.add("file", file_run));
+            REQUIRE(cache.set("noise", noise));
+            std::vector<std::pair<std::string, std::span<const char>>> batch {
+                { "batch-inline", inline_run }, { "batch-file", file_run }
+            };
+            REQUIRE(cache.set_many(batch));
+
+            THEN("they read back unchanged, through get() and get_many()")
+            {
+                REQUIRE(cache.get("before")->to_vector() == inline_run);
+                REQUIRE(cache.get("tiny")->to_vector() == tiny);
+                REQUIRE(cache.get("inline")->to_vector() == inline_run);
+                REQUIRE(cache.get("file")->to_vector() == file_run);
+                REQUIRE(cache.get("noise")->to_vector() == noise);
+                auto values = cache.get_many({ "batch-inline", "batch-file", "missing" });
+                REQUIRE(values[0]->to_vector() == inline_run);
+                REQUIRE(values[1]->to_vector() == file_run);
+                REQUIRE_FALSE(values[2]);
+                REQUIRE(cache.pop("inline")->to_vector() == inline_run);
+            }
+
+            THEN("size() counts stored bytes and logical_size() decoded ones")
+            {
+                auto logical = 2 * inline_run.size() + tiny.size() + 2 * file_run.size()
+                    + noise.size() + inline_run.size();
+                REQUIRE(cache.logical_size() == logical);
+                // Runs shrink 255:2; tiny and noise are kept as they are.
+                REQUIRE(cache.size() < inline_run.size() + tiny.size() + noise.size() + 8 * 1024);
+                REQUIRE(cache.check().ok);
+
+                AND_THEN("deleting entries and reopening keeps both counters exact")
+                {
+                    REQUIRE(cache.del("file"));
+                    REQUIRE(cache.del("noise"));
+                    auto size = cache.size();
+                    logical -= file_run.size() + noise.size();
+                    REQUIRE(cache.logical_size() == logical);
+                    cache.close();
+                    Cache reopened(db_path.path());
+                    REQUIRE(reopened.size() == size);
+                    REQUIRE(reopened.logical_size() == logical);
+                    REQUIRE(reopened.get("batch-file")->to_vector() == file_run);
+                }
+            }
+        }
+    }
+}
+
+#ifdef SCIQLOP_CACHE_WITH_ZLIB
+SCENARIO("The zlib codec round-trips file-backed values", "[cache][compression]")
+{
+    AutoCleanDirectory db_path { "CacheZlib" };
+    Cache cache(db_path.path());
+    REQUIRE(cache.set_compression({ static_cast<uint8_t>(CodecId::zlib) }));
+    std::vector<char> value(512 * 1024);
+    for (std::size_t i = 0; i < value.size(); ++i)
+        value[i] = static_cast<char>((i / 64) % 17);
+    REQUIRE(cache.set("key", value));
+    REQUIRE(cache.get("key")->to_vector() == value);
+    REQUIRE(cache.size() < value.size() / 10);
+    REQUIRE(cache.logical_size() == value.size());
+}
+#endif
+
+// Value files outside the trash, i.e. not yet released.
+static std::size_t live_value_files(const std::filesystem::path& root)
+{
+    std::size_t count = 0;
+    for (auto it = std::filesystem::recursive_directory_iterator(root);
+         it != std::filesystem::recursive_directory_iterator(); ++it)
+    {
+        if (it->path().filename() == DiskStorage::trash_dirname)
+        {
+            it.disable_recursion_pending();
+            continue;
+        }
+        if (it->is_regular_file()
+            && !it->path().filename().string().starts_with(std::string(Cache::db_fname)))
+            ++count;
+    }
+    return count;
+}
+
+SCENARIO("Identical file-backed values are stored once", "[cache][dedup]")
+{
+    AutoCleanDirectory db_path { "CacheDedup" };
+    std::vector<char> shared(256 * 1024, 's');
+    shared[1000] = 'x';
+    std::vector<char> other(shared);
+    other[2000] = 'y';
+
+    GIVEN("a cache deduplicating values of 16 KiB and more")
+    {
+        Cache cache(db_path.path());
+        REQUIRE(cache.dedup_threshold() == 0);
+        cache.set_dedup_threshold(16 * 1024);
+
+        WHEN("the same value is written under several keys, by every write path")
+        {
+            REQUIRE(cache.set("a", shared));
+            REQUIRE(cache.set("b", shared));
+            REQUIRE(cache.add("c", shared));
+            REQUIRE(cache.set("a", shared));
+            std::vector<std::pair<std::string, std::span<const char>>> batch {
+                { "d", shared }, { "e", other }, { "f", other }
+            };
+            REQUIRE(cache.set_many(batch));
+
+            THEN("one file per distinct content holds them all")
+            {
+                REQUIRE(live_value_files(db_path.path()) == 2);
+                for (const auto* key : { "a", "b", "c", "d" })
+                    REQUIRE(cache.get(key)->to_vector() == shared);
+                REQUIRE(cache.get("e")->to_vector() == other);
+                REQUIRE(cache.get("f")->to_vector() == other);
+                REQUIRE(cache.size() == 6 * shared.size());
+                REQUIRE(cache.check().ok);
+            }
+
+            THEN("a file goes with the last row pointing at it, even across a reopen")
+            {
+                REQUIRE(cache.del("a"));
+                REQUIRE(cache.pop("b"));
+                REQUIRE(cache.set("e", std::string("now inline")));
+                REQUIRE(live_value_files(db_path.path()) == 2);
+                cache.close();
+                Cache reopened(db_path.path());
+                REQUIRE(reopened.del("c"));
+                REQUIRE(reopened.get("d")->to_vector() == shared);
+                REQUIRE(live_value_files(db_path.path()) == 2);
+                REQUIRE(reopened.del("d"));
+                REQUIRE(live_value_files(db_path.path()) == 1);
+                REQUIRE(reopened.del("f"));
+                REQUIRE(live_value_files(db_path.path()) == 0);
+                REQUIRE(reopened.check().ok);
+            }
+
+            THEN("clear() forgets them and later values are stored afresh")
+            {
+                cache.clear();
+                REQUIRE(cache.set("g", shared));
+                REQUIRE(cache.set("h", shared));
+                REQUIRE(live_value_files(db_path.path()) == 1);
+                REQUIRE(cache.get("h")->to_vector() == shared);
+            }
+        }
+
+        WHEN("dedup is off")
+        {
+            cache.set_dedup_threshold(0);
+            REQUIRE(cache.set("a", shared));
+            REQUIRE(cache.set("b", shared));
+
+            THEN("each value gets its own file")
+            {
+                REQUIRE(live_value_files(db_path.path()) == 2);
+            }
+        }
+    }
+}
+
+SCENARIO("File-backed values move between a hot and a cold tier", "[cache][tiers]")
+{
+    AutoCleanDirectory hot_path { "CacheTierHot" };
+    AutoCleanDirectory cold_path { "CacheTierCold" };
+    constexpr std::size_t value_size = 64 * 1024;
+    auto value_of = [](int i) { return std::vector<char>(value_size, static_cast<char>('a' + i)); };
+
+    GIVEN("a cache keeping three values' worth of files hot")
+    {
+        Cache cache(hot_path.path());
+        cache.set_tier_policy({ cold_path.path(), 3 * value_size, false });
+        REQUIRE(cache.tier_policy().cold_path == cold_path.path());
+        for (int i = 0; i < 6; ++i)
+            REQUIRE(cache.set("k" + std::to_string(i), value_of(i)));
+        REQUIRE(cache.set("inline", std::string("stays in the database")));
+        REQUIRE(cache.get("k0"));
+
+        WHEN("a transaction is open")
+        {
+            THEN("the tiers cannot be rebalanced from inside it")
+            {
+                auto txn = cache.begin_user_transaction();
+                REQUIRE_THROWS_AS(cache.migrate_tiers(), std::runtime_error);
+            }
+        }
+
+        WHEN("the tiers are rebalanced")
+        {
+            REQUIRE(cache.migrate_tiers() == 4);
+
+            THEN("the least recently used files went cold and every value still reads")
+            {
+                REQUIRE(live_value_files(hot_path.path()) == 2);
+                REQUIRE(live_value_files(cold_path.path()) == 4);
+                for (int i = 0; i < 6; ++i)
+                    REQUIRE(cache.get("k" + std::to_string(i))->to_vector() == value_of(i));
+                REQUIRE(cache.get("inline"));
+                REQUIRE(cache.migrate_tiers() == 0);
+                auto result = cache.check();
+                REQUIRE(result.ok);
+                REQUIRE(result.orphaned_files == 0);
+                REQUIRE(result.volume_consistent);
+            }
+
+            THEN("cold reads can promote their value back to the hot tier")
+            {
+                cache.set_tier_policy({ {}, 3 * value_size, true });
+                REQUIRE(cache.tier_policy().cold_path == cold_path.path());
+                REQUIRE(cache.get("k5"));
+                REQUIRE(cache.get("k0"));
+                REQUIRE(cache.migrate_tiers() == 0);
+                REQUIRE(cache.get("k2")->to_vector() == value_of(2));
+                REQUIRE(cache.migrate_tiers() == 1);
+                REQUIRE(live_value_files(hot_path.path()) == 3);
+                REQUIRE(live_value_files(cold_path.path()) == 3);
+                REQUIRE(cache.get("k2")->to_vector() == value_of(2));
+                REQUIRE(cache.check().ok);
+            }
+
+            THEN("cold files go with their rows, and the cold root survives a reopen")
+            {
+                REQUIRE(cache.del("k1"));
+                REQUIRE(live_value_files(cold_path.path()) == 3);
+                cache.close();
+                Cache reopened(hot_path.path());
+                REQUIRE(reopened.tier_policy().cold_path == cold_path.path());
+                REQUIRE(reopened.get("k3")->to_vector() == value_of(3));
+                reopened.clear();
+                REQUIRE(live_value_files(cold_path.path()) == 0);
+                REQUIRE(reopened.check().ok);
+            }
+        }
+    }
+}
+
+SCENARIO("Very large values are written and read in chunks", "[cache][chunks]")
+{
+    AutoCleanDirectory db_path { "CacheChunks" };
+    AutoCleanDirectory cold_path { "CacheChunksCold" };
+    constexpr std::size_t chunk_size = 16 * 1024;
+    // Six whole chunks and a partial one.
+    auto value_of = [](int seed)
+    {
+        std::vector<char> value(6 * chunk_size + 4219);
+        for (std::size_t i = 0; i < value.size(); ++i)
+            value[i] = static_cast<char>((i * 31 + seed) % 251);
+        return value;
+    };
+    auto range_of = [](const std::vector<char>& value, std::size_t offset, std::size_t size)
+    { return std::vector<char>(value.begin() + offset, value.begin() + offset + size); };
+    const auto big = value_of(0);
+    const std::vector<char> small(20 * 1024, 's');
+
+    GIVEN("a cache chunking values of 64 KiB and more")
+    {
+        Cache cache(db_path.path());
+        cache.set_chunk_policy({ 64 * 1024, chunk_size, 3 });
+        REQUIRE(cache.chunk_policy() == ChunkPolicy { 64 * 1024, chunk_size, 3 });
+        REQUIRE(cache.set("big", big));
+        REQUIRE(cache.set("small", small));
+        REQUIRE(cache.set("inline", std::string("stays in the database")));
+        REQUIRE(live_value_files(db_path.path()) == 8);
+
+        THEN("values read back whole and in ranges, across chunks and clipped to the end")
+        {
+            REQUIRE(cache.get("big")->to_vector() == big);
+            REQUIRE(cache.get_range("big", chunk_size - 10, 40)->to_vector()
+                    == range_of(big, chunk_size - 10, 40));
+            REQUIRE(cache.get_range("big", 2 * chunk_size + 1, 3 * chunk_size)->to_vector()
+                    == range_of(big, 2 * chunk_size + 1, 3 * chunk_size));
+            REQUIRE(cache.get_range("big", big.size() - 5, 100)->size() == 5);
+            REQUIRE(cache.get_range("big", big.size() + 10, 1)->size() == 0);
+            REQUIRE(cache.get_range("small", 100, 50)->to_vector() == range_of(small, 100, 50));
+            REQUIRE(cache.get_range("inline", 6, 2)->to_vector() == std::vector<char> { 'i', 'n' });
+            REQUIRE_FALSE(cache.get_range("missing", 0, 1));
+            auto result = cache.check();
+            REQUIRE(result.ok);
+            REQUIRE(result.orphaned_files == 0);
+            REQUIRE(result.volume_consistent);
+        }
+
+        THEN("a range read only opens the chunks it covers, whatever the current policy")
+        {
+            std::filesystem::path chunks;
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(db_path.path()))
+                if (entry.path().extension() == ".chunks")
+                    chunks = entry.path();
+            REQUIRE_FALSE(chunks.empty());
+            // A damaged chunk outside the range goes unnoticed.
+            std::filesystem::resize_file(chunks / "000005", chunk_size - 1);
+            cache.set_chunk_policy({ 64 * 1024, 4 * chunk_size, 3 });
+            REQUIRE(cache.get_range("big", chunk_size, chunk_size)->to_vector()
+                    == range_of(big, chunk_size, chunk_size));
+            REQUIRE(cache.get_range("big", 3 * chunk_size - 3, chunk_size + 6)->to_vector()
+                    == range_of(big, 3 * chunk_size - 3, chunk_size + 6));
+            REQUIRE(cache.get_range("big", big.size() - 5, 5)->to_vector()
+                    == range_of(big, big.size() - 5, 5));
+            REQUIRE(cache.get_range("big", big.size(), 5)->size() == 0);
+        }
+
+        WHEN("chunked values are batched, rewritten synchronously and deleted")
+        {
+            const auto b1 = value_of(1);
+            const auto b2 = value_of(2);
+            std::vector<std::pair<std::string, std::span<const char>>> items {
+                { "b1", b1 }, { "b2", b2 }, { "s1", small }
+            };
+            REQUIRE(cache.set_many(items));
+            cache.set_durability(Durability::sync);
+            REQUIRE(cache.set("big", value_of(3)));
+            REQUIRE(cache.del("b1"));
+
+            THEN("the remaining values and the cache stay consistent")
+            {
+                REQUIRE(cache.get("big")->to_vector() == value_of(3));
+                REQUIRE(cache.get("b2")->to_vector() == value_of(2));
+                REQUIRE(cache.get("s1")->to_vector() == small);
+                REQUIRE_FALSE(cache.get("b1"));
+                REQUIRE(live_value_files(db_path.path()) == 7 + 7 + 2);
+                auto result = cache.check();
+                REQUIRE(result.ok);
+                REQUIRE(result.orphaned_files == 0);
+                REQUIRE(result.volume_consistent);
+            }
+        }
+
+        WHEN("the chunked value goes to the cold tier")
+        {
+            cache.set_tier_policy({ cold_path.path(), 1, false });
+            REQUIRE(cache.migrate_tiers() == 2);
+
+            THEN("it moves as a whole and still reads")
+            {
+                REQUIRE(live_value_files(cold_path.path()) == 8);
+                REQUIRE(cache.get("big")->to_vector() == big);
+                REQUIRE(cache.get_range("big", chunk_size, 8)->to_vector()
+                        == range_of(big, chunk_size, 8));
+                REQUIRE(cache.check().ok);
+            }
+        }
+    }
+}
+
+SCENARIO("Ephemeral stores keep everything in memory", "[cache][ephemeral]")
+{
+    AutoCleanDirectory snapshot_dir { "EphemeralSnapshot" };
+    const auto scratch = snapshot_dir.path() / "scratch";
+    const std::vector<char> big(64 * 1024, 'b');
+    const std::vector<char> other(32 * 1024, 'o');
+
+    GIVEN("an ephemeral cache holding inline and large values")
+    {
+        EphemeralCache cache(scratch);
+        REQUIRE(cache.set("inline", std::string("small value")));
+        REQUIRE(cache.set("big", big));
+        REQUIRE(cache.set("other", other, 3600s));
+
+        THEN("values read back and nothing is written to disk")
+        {
+            REQUIRE(cache.get("big")->to_vector() == big);
+            REQUIRE(cache.get_range("big", 10, 5)->size() == 5);
+            REQUIRE(cache.count() == 3);
+            REQUIRE_FALSE(std::filesystem::exists(scratch));
+            auto result = cache.check();
+            REQUIRE(result.ok);
+            REQUIRE(result.volume_consistent);
+        }
+
+        WHEN("values are deleted, overwritten and written in a rolled back transaction")
+        {
+            auto held = cache.get("big");
+            REQUIRE(cache.del("big"));
+            REQUIRE(cache.set("other", big));
+            {
+                auto txn = cache.begin_user_transaction();
+                REQUIRE(cache.set("discarded", big));
+            }
+
+            THEN("a buffer read earlier survives and no value is left unreferenced")
+            {
+                REQUIRE(held->to_vector() == big);
+                REQUIRE_FALSE(cache.get("discarded"));
+                REQUIRE(cache.get("other")->to_vector() == big);
+                auto result = cache.check();
+                REQUIRE(result.dangling_rows == 0);
+                REQUIRE(result.orphaned_files == 0);
+                REQUIRE(result.volume_consistent);
+            }
+        }
+
+        WHEN("the cache grows past its maximum size")
+        {
+            cache.set_max_cache_size(256 * 1024);
+            for (int i = 0; i < 16; ++i)
+                REQUIRE(cache.set("fill" + std::to_string(i), big));
+
+            THEN("writers evict the least recently used entries themselves")
+            {
+                REQUIRE(cache.size() <= 256 * 1024 + big.size());
+                REQUIRE(cache.get("fill15"));
+                REQUIRE(cache.check().ok);
+            }
+        }
+
+        WHEN("a snapshot is saved")
+        {
+            REQUIRE(cache.save_snapshot(snapshot_dir.path()));
+            REQUIRE(cache.set("inline", std::string("changed after the snapshot")));
+
+            THEN("a regular cache opens it")
+            {
+                Cache on_disk(snapshot_dir.path());
+                REQUIRE(on_disk.get("big")->to_vector() == big);
+                REQUIRE(on_disk.get("inline")->to_vector()
+                        == std::vector<char> { 's', 'm', 'a', 'l', 'l', ' ', 'v', 'a', 'l', 'u', 'e' });
+                REQUIRE(on_disk.check().ok);
+            }
+
+            THEN("an ephemeral cache loads it back, and a later snapshot replaces it")
+            {
+                EphemeralCache restored(scratch);
+                REQUIRE(restored.load_snapshot(snapshot_dir.path()));
+                REQUIRE(restored.count() == 3);
+                REQUIRE(restored.get("other")->to_vector() == other);
+                REQUIRE(restored.check().ok);
+                REQUIRE(cache.save_snapshot(snapshot_dir.path()));
+                REQUIRE(live_value_files(snapshot_dir.path()) == 2);
+                REQUIRE(restored.load_snapshot(snapshot_dir.path()));
+                REQUIRE(restored.get("inline")->size() == 26);
+            }
+        }
+    }
+
+    GIVEN("an ephemeral index saving a snapshot on close")
+    {
+        {
+            EphemeralIndex index(snapshot_dir.path());
+            index.set_snapshot_on_close(true);
+            REQUIRE(index.set("big", big));
+        }
+
+        THEN("the next one finds its entries there")
+        {
+            EphemeralIndex index(snapshot_dir.path());
+            REQUIRE_FALSE(index.get("big"));
+            REQUIRE(index.load_snapshot());
+            REQUIRE(index.get("big")->to_vector() == big);
+        }
+    }
+}
+
+SCENARIO("Cache statistics track hits and misses", "[stats]")
+{
+    AutoCleanDirectory db_path { "StatsTest" };
+    std::vector<char> value(64, 'x');
+
+    GIVEN("a fresh cache")
+    {
+        Cache cache(db_path.path());
+        auto s = cache.stats();
+        REQUIRE(s.hits == 0);
+        REQUIRE(s.misses == 0);
+
+        WHEN("getting an existing key")
+        {
+            cache.set("k1", value);
+            cache.get("k1");
+
+            THEN("hits increments")
+            {
+                auto s = cache.stats();
+                REQUIRE(s.hits == 1);
+                REQUIRE(s.misses == 0);
+            }
+        }
+
+        WHEN("getting a missing key")
+        {
+            cache.get("nonexistent");
+
+            THEN("misses increments")
+            {
+                auto s = cache.stats();
+                REQUIRE(s.hits == 0);
+                REQUIRE(s.misses == 1);
+            }
+        }
+
+        WHEN("getting an expired key")
+        {
+            cache.set("k2", value, 1s);
+            std::this_thread::sleep_for(2s);
+            cache.get("k2");
+
+            THEN("it counts as a miss")
+            {
+                auto s = cache.stats();
+                REQUIRE(s.hits == 0);
+                REQUIRE(s.misses == 1);
+            }
+        }
+
+        WHEN("performing a mix of hits and misses")
+        {
+            cache.set("a", value);
+            cache.set("b", value);
+            cache.get("a");
+            cache.get("b");
+            cache.get("c");
+            cache.get("d");
+
+            THEN("counts are accurate")
+            {
+                auto s = cache.stats();
+                REQUIRE(s.hits == 2);
+                REQUIRE(s.misses == 2);
+            }
+        }
+
+        WHEN("reset_stats is called")
+        {
+            cache.set("k", value);
+            cache.get("k");
+            cache.get("missing");
+            cache.reset_stats();
+
+            THEN("counters return to zero")
+            {
+                auto s = cache.stats();
+                REQUIRE(s.hits == 0);
+                REQUIRE(s.misses == 0);
+            }
+        }
+    }
+}
+
+SCENARIO("WAL checkpoints are driven by WAL size", "[wal]")
+{
+    AutoCleanDirectory db_path { "WalCheckpoint" };
+    std::vector<char> value(2048, 'x');
+
+    GIVEN("a cache with a low checkpoint threshold and a long housekeeping interval")
+    {
+        Cache cache(db_path.path());
+        cache.set_checkpoint_policy({ .passive_pages = 16,
+                                      .truncate_pages = 64,
+                                      .housekeeping_interval = std::chrono::hours(1) });
+        REQUIRE(cache.checkpoint_policy().passive_pages == 16);
+
+        WHEN("nothing is written")
+        {
+            std::this_thread::sleep_for(200ms);
+
+            THEN("no checkpoint runs")
+            {
+                REQUIRE(cache.wal_stats().checkpoints == 0);
+            }
+        }
+
+        WHEN("a single commit grows the WAL past the truncate threshold")
+        {
+            {
+                auto txn = cache.begin_user_transaction();
+                for (int i = 0; i < 200; ++i)
+                    cache.set("k" + std::to_string(i), value);
+                txn.commit();
+            }
+
+            THEN("checkpoints run without waiting for the housekeeping tick")
+            {
+                auto deadline = std::chrono::steady_clock::now() + 5s;
+                while (cache.wal_stats().truncating_checkpoints == 0
+                       && std::chrono::steady_clock::now() < deadline)
+                    std::this_thread::sleep_for(10ms);
+                auto stats = cache.wal_stats();
+                REQUIRE(stats.checkpoints > 0);
+                REQUIRE(stats.truncating_checkpoints > 0);
+                REQUIRE(stats.wal_bytes == 0);
+                REQUIRE(stats.total_checkpoint_us >= stats.last_checkpoint_us);
+                REQUIRE(cache.count() == 200);
+            }
+        }
+    }
+}
+
+SCENARIO("expire() correctly updates size and count counters", "[cache][expire]")
+{
+    AutoCleanDirectory db_path { "ExpireCounters01" };
+    std::vector<char> v100(100, 'a');
+    std::vector<char> v200(200, 'b');
+
+    GIVEN("a cache with expiring and non-expiring entries")
+    {
+        Cache cache(db_path.path());
+        cache.set("permanent1", v100);
+        cache.set("permanent2", v200);
+        cache.set("expiring1", v100, 1s);
+        cache.set("expiring2", v200, 1s);
+
+        REQUIRE(cache.size() == 600);
+
+        WHEN("entries expire and expire() is called")
+        {
+            std::this_thread::sleep_for(2s);
+            cache.expire();
+
+            THEN("size reflects only the remaining entries")
+            {
+                REQUIRE(cache.size() == 300);
+                REQUIRE(cache.count() == 2);
+            }
+        }
+
+        WHEN("we add more entries between expiration check and expire()")
+        {
+            std::this_thread::sleep_for(2s);
+            cache.set("late_arrival", v100);
+            cache.expire();
+
+            THEN("late arrival is preserved and counters are correct")
+            {
+                REQUIRE(cache.get("late_arrival").has_value());
+                REQUIRE(cache.size() == 400);
+                REQUIRE(cache.count() == 3);
+            }
+        }
+    }
+
+    GIVEN("a cache where all entries expire")
+    {
+        Cache cache(db_path.path());
+        cache.set("e1", v100, 1s);
         cache.set("e2", v100, 1s);
         cache.set("e3", v100, 1s);
 
@@ -968,9 +2139,15 @@ SCENARIO("clear() removes file-backed values cleanly even after they were mmap'd
             THEN("no per-key files remain in the cache directory")
             {
                 std::size_t leftover = 0;
-                for (auto& entry :
-                     std::filesystem::recursive_directory_iterator(db_path.path()))
+                for (auto it = std::filesystem::recursive_directory_iterator(db_path.path());
+                     it != std::filesystem::recursive_directory_iterator(); ++it)
                 {
+                    const auto& entry = *it;
+                    if (entry.path().filename() == DiskStorage::trash_dirname)
+                    {
+                        it.disable_recursion_pending();
+                        continue;
+                    }
                     if (!entry.is_regular_file()) continue;
                     auto fname = entry.path().filename().string();
                     if (fname == Cache::db_fname
@@ -980,6 +2157,11 @@ SCENARIO("clear() removes file-backed values cleanly even after they were mmap'd
                 }
                 REQUIRE(leftover == 0);
             }
+            THEN("the trashed files are gone once the deletion queue is drained")
+            {
+                REQUIRE(cache.check().ok);
+                REQUIRE(std::filesystem::is_empty(db_path.path() / std::string(DiskStorage::trash_dirname)));
+            }
             THEN("subsequent set() of the same keys works")
             {
                 std::vector<char> updated(16000, 'y');
@@ -1018,3 +2200,552 @@ SCENARIO("Buffer is safe to inspect after being moved from", "[buffer]")
         }
     }
 }
+
+SCENARIO("Store options size SQLite and the storage", "[cache][options]")
+{
+    AutoCleanDirectory db_path { "StoreOptionsTest" };
+    const std::vector<char> medium(12 * 1024, 'm');
+    const std::vector<char> small(2 * 1024, 's');
+
+    GIVEN("a cache opened with the server preset")
+    {
+        {
+            Cache cache(db_path.path(), 0, StoreOptions::server());
+            THEN("the preset is in effect")
+            {
+                REQUIRE(cache.options() == StoreOptions::server());
+                REQUIRE(cache.options().page_size == 8192);
+            }
+            WHEN("a value below the preset's threshold is stored")
+            {
+                REQUIRE(cache.set("medium", medium));
+                THEN("it stays inline")
+                {
+                    REQUIRE(live_value_files(db_path.path()) == 0);
+                    REQUIRE(cache.get("medium")->to_vector() == medium);
+                }
+            }
+            WHEN("options are changed at runtime")
+            {
+                cache.set_options(StoreOptions::laptop());
+                THEN("everything but the page size and value layout follows")
+                {
+                    auto expected = StoreOptions::laptop();
+                    expected.page_size = 8192;
+                    expected.separate_values = true;
+                    REQUIRE(cache.options() == expected);
+                }
+                AND_WHEN("the threshold alone is lowered")
+                {
+                    cache.set_file_size_threshold(1024);
+                    REQUIRE(cache.set("small", small));
+                    THEN("smaller values go to files")
+                    {
+                        REQUIRE(live_value_files(db_path.path()) == 1);
+                        REQUIRE(cache.get("small")->to_vector() == small);
+                        REQUIRE(cache.check().ok);
+                    }
+                }
+            }
+        }
+        WHEN("the database is reopened with default options")
+        {
+            Cache cache(db_path.path());
+            THEN("it keeps the page size it was created with")
+            {
+                REQUIRE(cache.options().page_size == 8192);
+                REQUIRE(cache.file_size_threshold() == StoreOptions {}.file_size_threshold);
+            }
+        }
+    }
+}
+
+SCENARIO("The file size threshold can tune itself", "[cache][options][tuning]")
+{
+    AutoCleanDirectory db_path { "ThresholdTuningTest" };
+    ThresholdTuning tuning { .enabled = true, .min_bytes = 2048, .max_bytes = 64 * 1024,
+                             .probe_every = 2, .min_samples = 8 };
+
+    GIVEN("a cache tuning its threshold")
+    {
+        StoreOptions options;
+        options.threshold_tuning = tuning;
+        options.checkpoint.housekeeping_interval = std::chrono::hours(1);
+        Cache cache(db_path.path(), 0, options);
+        REQUIRE(cache.threshold_tuning() == tuning);
+        REQUIRE(cache.file_size_threshold() == 8 * 1024);
+
+        WHEN("values just below the threshold are written")
+        {
+            const std::vector<char> value(6 * 1024, 'v');
+            for (int i = 0; i < 10; ++i)
+                REQUIRE(cache.set("k" + std::to_string(i), value));
+            THEN("every other one is a probe stored in a file")
+            {
+                REQUIRE(live_value_files(db_path.path()) == 5);
+                for (int i = 0; i < 10; ++i)
+                    REQUIRE(cache.get("k" + std::to_string(i))->to_vector() == value);
+                REQUIRE(cache.check().ok);
+            }
+        }
+        WHEN("the threshold is set by hand")
+        {
+            cache.set_file_size_threshold(4096);
+            THEN("it is recorded for the other processes")
+            {
+                REQUIRE(cache.get_meta("file_size_threshold") == "4096");
+                StoreOptions other = options;
+                other.file_size_threshold = 32 * 1024;
+                Cache second(db_path.path(), 0, other);
+                REQUIRE(second.file_size_threshold() == 4096);
+            }
+        }
+        WHEN("meta holds a threshold that is not a valid tuned one")
+        {
+            THEN("it is ignored, whether text or out of the tuning range")
+            {
+                for (auto bogus : { "4096", "0", "abc" })
+                {
+                    cache.set_meta("file_size_threshold", bogus);
+                    cache.set_threshold_tuning(tuning);
+                    REQUIRE(cache.file_size_threshold() == 8 * 1024);
+                }
+                cache.set_file_size_threshold(1024);
+                StoreOptions other = options;
+                other.file_size_threshold = 32 * 1024;
+                Cache second(db_path.path(), 0, other);
+                REQUIRE(second.file_size_threshold() == 32 * 1024);
+            }
+        }
+        WHEN("tuning runs under a mixed workload")
+        {
+            using namespace std::chrono_literals;
+            cache.set_checkpoint_policy({ .housekeeping_interval = 20ms });
+            std::mt19937 rng(42);
+            std::uniform_int_distribution<std::size_t> size(4 * 1024, 16 * 1024);
+            for (int round = 0; round < 20; ++round)
+            {
+                for (int i = 0; i < 20; ++i)
+                {
+                    auto key = "k" + std::to_string(i);
+                    REQUIRE(cache.set(key, std::vector<char>(size(rng), 'x')));
+                    REQUIRE(cache.get(key).has_value());
+                }
+                std::this_thread::sleep_for(20ms);
+            }
+            THEN("the threshold stays within bounds and in meta once moved")
+            {
+                auto threshold = cache.file_size_threshold();
+                REQUIRE(threshold >= tuning.min_bytes);
+                REQUIRE(threshold <= tuning.max_bytes);
+                if (threshold != 8 * 1024)
+                    REQUIRE(cache.get_meta("file_size_threshold")
+                            == std::to_string(threshold));
+                REQUIRE(cache.check().ok);
+            }
+        }
+        WHEN("tuning is turned off")
+        {
+            cache.set_threshold_tuning({});
+            const std::vector<char> value(6 * 1024, 'v');
+            for (int i = 0; i < 10; ++i)
+                REQUIRE(cache.set("k" + std::to_string(i), value));
+            THEN("no value is probed")
+            {
+                REQUIRE(live_value_files(db_path.path()) == 0);
+            }
+        }
+    }
+}
+
+SCENARIO("Inline values can live in a table of their own", "[cache][options][values]")
+{
+    AutoCleanDirectory db_path { "SeparateValuesTest" };
+    StoreOptions separate;
+    separate.separate_values = true;
+    const std::vector<char> small(100, 's');
+    const std::vector<char> medium(6 * 1024, 'm');
+
+    GIVEN("a cache opened with separate_values")
+    {
+        Cache cache(db_path.path(), 0, separate);
+        REQUIRE(cache.options().separate_values);
+        REQUIRE(cache.set("small", small));
+        REQUIRE(cache.set("medium", medium));
+        REQUIRE(cache.incr("counter", 5) == 5);
+
+        THEN("values, counts and counters read back")
+        {
+            REQUIRE(cache.get("small")->to_vector() == small);
+            REQUIRE(cache.get("medium")->to_vector() == medium);
+            REQUIRE(cache.incr("counter") == 6);
+            REQUIRE(cache.count() == 3);
+            REQUIRE(cache.size() == small.size() + medium.size() + sizeof(int64_t));
+            REQUIRE(cache.check().ok);
+        }
+        WHEN("entries are overwritten, added over and deleted")
+        {
+            REQUIRE(cache.set("small", medium));
+            REQUIRE_FALSE(cache.add("medium", small));
+            REQUIRE(cache.del("counter"));
+            THEN("no value row is left behind")
+            {
+                REQUIRE(cache.get("small")->to_vector() == medium);
+                REQUIRE(cache.get("medium")->to_vector() == medium);
+                auto result = cache.check();
+                REQUIRE(result.orphaned_values == 0);
+                REQUIRE(result.dangling_rows == 0);
+                REQUIRE(result.ok);
+            }
+        }
+        WHEN("the cache is cleared")
+        {
+            cache.clear();
+            REQUIRE(cache.set("small", small));
+            THEN("only the new value remains")
+            {
+                REQUIRE(cache.count() == 1);
+                REQUIRE(cache.get("small")->to_vector() == small);
+                REQUIRE_FALSE(cache.get("medium").has_value());
+                REQUIRE(cache.check().ok);
+            }
+        }
+    }
+
+    GIVEN("a cache written without separate_values")
+    {
+        {
+            Cache cache(db_path.path());
+            REQUIRE(cache.set("small", small));
+            REQUIRE(cache.set("medium", medium));
+        }
+        WHEN("it is reopened with separate_values")
+        {
+            Cache cache(db_path.path(), 0, separate);
+            THEN("its inline values were moved and read back")
+            {
+                REQUIRE(cache.get_meta("separate_values") == "1");
+                REQUIRE(cache.get("small")->to_vector() == small);
+                REQUIRE(cache.get("medium")->to_vector() == medium);
+                REQUIRE(cache.check().ok);
+            }
+            AND_WHEN("it is written to and reopened without the option")
+            {
+                REQUIRE(cache.set("other", small));
+                REQUIRE(cache.set("small", medium));
+                Cache plain(db_path.path());
+                REQUIRE(plain.set("plain", small));
+                THEN("values of both layouts read back")
+                {
+                    REQUIRE_FALSE(plain.get_meta("separate_values").has_value());
+                    REQUIRE(plain.get("small")->to_vector() == medium);
+                    REQUIRE(plain.get("medium")->to_vector() == medium);
+                    REQUIRE(plain.get("other")->to_vector() == small);
+                    REQUIRE(plain.get("plain")->to_vector() == small);
+                    REQUIRE(plain.check().ok);
+                }
+            }
+        }
+        WHEN("moving the values fails part way")
+        {
+            auto raw_exec = [&](const char* sql)
+            {
+                sqlite3* raw = nullptr;
+                sqlite3_open((db_path.path() / "sciqlop-cache.db").string().c_str(), &raw);
+                REQUIRE(sqlite3_exec(raw, sql, nullptr, nullptr, nullptr) == SQLITE_OK);
+                sqlite3_close(raw);
+            };
+            raw_exec("CREATE TRIGGER fail_move BEFORE UPDATE ON cache"
+                     " BEGIN SELECT RAISE(ABORT, 'injected failure'); END;");
+            REQUIRE_THROWS_AS(Cache(db_path.path(), 0, separate), std::runtime_error);
+            raw_exec("DROP TRIGGER fail_move;");
+            THEN("nothing was moved and the database is still writable")
+            {
+                Cache plain(db_path.path());
+                REQUIRE_FALSE(plain.get_meta("separate_values").has_value());
+                REQUIRE(plain.set("other", small));
+                REQUIRE(plain.get("small")->to_vector() == small);
+                REQUIRE(plain.get("medium")->to_vector() == medium);
+                auto result = plain.check();
+                REQUIRE(result.orphaned_values == 0);
+                REQUIRE(result.ok);
+            }
+        }
+    }
+}
+
+SCENARIO("Keys can be stored as fixed-width hashes", "[cache][options][keys]")
+{
+    AutoCleanDirectory db_path { "HashedKeysTest" };
+    StoreOptions hashed;
+    hashed.hashed_keys = true;
+    const std::string prefix = "amda/" + std::string(200, 'p') + "/";
+    const std::vector<char> small(100, 's');
+    const std::vector<char> large(64 * 1024, 'l');
+    auto stored_key_types = [&]
+    {
+        std::set<std::string> types;
+        sqlite3* raw = nullptr;
+        sqlite3_open((db_path.path() / "sciqlop-cache.db").string().c_str(), &raw);
+        sqlite3_stmt* stmt = nullptr;
+        sqlite3_prepare_v2(raw, "SELECT DISTINCT typeof(key) FROM cache;", -1, &stmt, nullptr);
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+            types.insert(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
+        sqlite3_finalize(stmt);
+        sqlite3_close(raw);
+        return types;
+    };
+
+    GIVEN("a cache created with hashed_keys and long keys")
+    {
+        Cache cache(db_path.path(), 0, hashed);
+        REQUIRE(cache.options().hashed_keys);
+        REQUIRE(cache.set(prefix + "small", small));
+        REQUIRE(cache.set(prefix + "large", large));
+        REQUIRE(cache.incr(prefix + "counter", 5) == 5);
+
+        THEN("entries read back under their keys, stored as integers")
+        {
+            REQUIRE(cache.get(prefix + "small")->to_vector() == small);
+            REQUIRE(cache.get(prefix + "large")->to_vector() == large);
+            REQUIRE(cache.incr(prefix + "counter") == 6);
+            REQUIRE(cache.exists(prefix + "small"));
+            REQUIRE_FALSE(cache.exists(prefix + "other"));
+            auto keys = cache.keys();
+            REQUIRE(std::set<std::string>(keys.begin(), keys.end())
+                    == std::set<std::string> { prefix + "small", prefix + "large",
+                                               prefix + "counter" });
+            auto cursor = cache.iterkeys();
+            std::size_t iterated = 0;
+            while (auto key = cursor.next())
+                iterated += key->starts_with(prefix);
+            REQUIRE(iterated == 3);
+            REQUIRE(stored_key_types() == std::set<std::string> { "integer" });
+            REQUIRE(cache.check().ok);
+        }
+        WHEN("entries are overwritten, added over, expired and deleted")
+        {
+            REQUIRE(cache.set(prefix + "small", large));
+            REQUIRE_FALSE(cache.add(prefix + "large", small));
+            REQUIRE(cache.del(prefix + "counter"));
+            REQUIRE_FALSE(cache.del(prefix + "counter"));
+            REQUIRE(cache.touch(prefix + "large", -1s));
+            cache.expire();
+            THEN("the counters and the files follow")
+            {
+                REQUIRE(cache.count() == 1);
+                REQUIRE(cache.size() == large.size());
+                REQUIRE(cache.get(prefix + "small")->to_vector() == large);
+                REQUIRE_FALSE(cache.get(prefix + "large").has_value());
+                REQUIRE(cache.check().ok);
+            }
+        }
+        WHEN("it is reopened without the option")
+        {
+            Cache reopened(db_path.path());
+            THEN("it keeps the layout it was created with")
+            {
+                REQUIRE(reopened.options().hashed_keys);
+                REQUIRE(reopened.get(prefix + "small")->to_vector() == small);
+                REQUIRE(reopened.set("short", small));
+                REQUIRE(reopened.get("short")->to_vector() == small);
+            }
+        }
+    }
+
+    GIVEN("a cache holding more than its maximum size")
+    {
+        Cache cache(db_path.path(), 4 * large.size(), hashed);
+        for (int i = 0; i < 8; ++i)
+            REQUIRE(cache.set(prefix + std::to_string(i), large));
+        WHEN("it is evicted")
+        {
+            cache.evict();
+            THEN("the least recently used entries went")
+            {
+                REQUIRE(cache.size() <= 4 * large.size());
+                REQUIRE_FALSE(cache.exists(prefix + "0"));
+                REQUIRE(cache.exists(prefix + "7"));
+                REQUIRE(cache.check().ok);
+            }
+        }
+    }
+
+    GIVEN("a cache created without hashed_keys")
+    {
+        {
+            Cache cache(db_path.path());
+            REQUIRE(cache.set(prefix + "small", small));
+        }
+        WHEN("it is reopened with the option")
+        {
+            Cache cache(db_path.path(), 0, hashed);
+            THEN("its keys stay as they were")
+            {
+                REQUIRE_FALSE(cache.options().hashed_keys);
+                REQUIRE(cache.get(prefix + "small")->to_vector() == small);
+                REQUIRE(stored_key_types() == std::set<std::string> { "text" });
+            }
+        }
+    }
+}
+
+SCENARIO("Key cursors page through the keys and filter them by prefix", "[cache][keys]")
+{
+    AutoCleanDirectory db_path { "KeyCursorTest" };
+    auto drain = [](auto cursor)
+    {
+        std::vector<std::string> keys;
+        while (auto key = cursor.next())
+            keys.push_back(std::move(*key));
+        return keys;
+    };
+    auto sorted = [](std::vector<std::string> keys)
+    {
+        std::sort(keys.begin(), keys.end());
+        return keys;
+    };
+    const std::vector<std::string> solo { "amda/solo/a", "amda/solo/b", "amda/solo/c" };
+
+    for (bool hashed : { false, true })
+    {
+        GIVEN(std::string("a cache with keys under several prefixes")
+              + (hashed ? ", hashed" : ""))
+        {
+            StoreOptions options;
+            options.hashed_keys = hashed;
+            Cache cache(db_path.path(), 0, options);
+            for (const auto& key : solo)
+                REQUIRE(cache.set(key, std::vector<char>(key.begin(), key.end())));
+            REQUIRE(cache.set("amda/solar", std::vector<char>(10, 'x')));
+            REQUIRE(cache.set("amda/wind/a", std::vector<char>(10, 'x')));
+            REQUIRE(cache.set("cdaweb/a", std::vector<char>(64 * 1024, 'x')));
+            REQUIRE(cache.set("gone", std::vector<char>(10, 'x'), -1s));
+
+            THEN("a cursor of one-key pages lists every live key once")
+            {
+                auto keys = drain(cache.iterkeys("", 1));
+                REQUIRE(keys.size() == 6);
+                REQUIRE(sorted(keys) == sorted(cache.keys()));
+            }
+            THEN("a prefix lists only the keys starting with it")
+            {
+                REQUIRE(sorted(drain(cache.iterkeys("amda/solo/", 2))) == solo);
+                REQUIRE(drain(cache.iterkeys("amda/sol")).size() == 4);
+                REQUIRE(drain(cache.iterkeys("nothing/")).empty());
+                REQUIRE(drain(cache.iterkeys("\xff")).empty());
+            }
+            THEN("items() reads the entries under a prefix")
+            {
+                auto cursor = cache.items("amda/solo/", 2);
+                std::vector<std::string> keys;
+                while (auto item = cursor.next())
+                {
+                    REQUIRE(item->second.to_vector()
+                            == std::vector<char>(item->first.begin(), item->first.end()));
+                    keys.push_back(item->first);
+                }
+                REQUIRE(sorted(keys) == solo);
+            }
+            WHEN("keys are written and deleted while a cursor runs")
+            {
+                auto cursor = cache.iterkeys("amda/", 1);
+                auto first = cursor.next();
+                REQUIRE(first);
+                REQUIRE(cache.set("amda/zzz", std::vector<char>(10, 'x')));
+                for (const auto& key : solo)
+                    if (key != *first)
+                        cache.del(key);
+                THEN("the cursor carries on from where it was")
+                {
+                    auto rest = drain(std::move(cursor));
+                    for (const auto& key : solo)
+                        if (key != *first)
+                            REQUIRE(std::find(rest.begin(), rest.end(), key) == rest.end());
+                    REQUIRE(std::find(rest.begin(), rest.end(), *first) == rest.end());
+                    if (!hashed)
+                        REQUIRE(rest.back() == "amda/zzz");
+                }
+            }
+        }
+    }
+}
+
+SCENARIO("Entries can be deleted by key prefix or pattern", "[cache][keys]")
+{
+    AutoCleanDirectory db_path { "DelPrefixTest" };
+    const std::vector<char> small(100, 's');
+    const std::vector<char> large(64 * 1024, 'l');
+
+    for (bool hashed : { false, true })
+    {
+        GIVEN(std::string("a cache with the entries of several products")
+              + (hashed ? ", hashed" : ""))
+        {
+            StoreOptions options;
+            options.hashed_keys = hashed;
+            Cache cache(db_path.path(), 0, options);
+            for (int i = 0; i < 3000; ++i)
+                REQUIRE(cache.set("amda/solo/" + std::to_string(i), small));
+            for (int i = 0; i < 5; ++i)
+                REQUIRE(cache.set("amda/solo/file" + std::to_string(i), large));
+            REQUIRE(cache.set("amda/wind/0", small));
+            REQUIRE(cache.set("amda/solar", large));
+            REQUIRE(cache.set("cdaweb/solo/0", small));
+
+            WHEN("one prefix is deleted")
+            {
+                REQUIRE(cache.del_prefix("amda/solo/") == 3005);
+                THEN("only the entries under it went, with their files")
+                {
+                    REQUIRE(cache.count() == 3);
+                    REQUIRE(cache.size() == 2 * small.size() + large.size());
+                    REQUIRE(cache.exists("amda/solar"));
+                    REQUIRE(cache.exists("amda/wind/0"));
+                    REQUIRE(cache.exists("cdaweb/solo/0"));
+                    REQUIRE(cache.del_prefix("amda/solo/") == 0);
+                    REQUIRE(live_value_files(db_path.path()) == 1);
+                    REQUIRE(cache.check().ok);
+                }
+            }
+            WHEN("a pattern is deleted")
+            {
+                REQUIRE(cache.del_glob("amda/solo/file[0-2]") == 3);
+                REQUIRE(cache.del_glob("*/solo/1?") == 10);
+                THEN("only the matching entries went")
+                {
+                    REQUIRE(cache.count() == 3008 - 13);
+                    REQUIRE_FALSE(cache.exists("amda/solo/file1"));
+                    REQUIRE(cache.exists("amda/solo/file3"));
+                    REQUIRE_FALSE(cache.exists("amda/solo/15"));
+                    REQUIRE(cache.exists("amda/solo/150"));
+                    REQUIRE(cache.check().ok);
+                }
+            }
+            WHEN("expired entries are deleted with live ones")
+            {
+                REQUIRE(cache.set("amda/wind/1", small, 0s));
+                REQUIRE(cache.set("amda/wind/2", large, 0s));
+                REQUIRE(cache.del_prefix("amda/wind/") == 1);
+                THEN("only the live ones are counted, but all of them went")
+                {
+                    REQUIRE(cache.count() == 3007);
+                    REQUIRE(cache.size() == 3001 * small.size() + 6 * large.size());
+                    REQUIRE(live_value_files(db_path.path()) == 6);
+                    REQUIRE(cache.check().ok);
+                }
+            }
+            WHEN("everything is asked for")
+            {
+                THEN("it is refused, leaving clear() as the one way to empty the cache")
+                {
+                    REQUIRE_THROWS_AS(cache.del_prefix(""), std::invalid_argument);
+                    REQUIRE_THROWS_AS(cache.del_glob("*"), std::invalid_argument);
+                    REQUIRE_THROWS_AS(cache.del_glob("**"), std::invalid_argument);
+                    REQUIRE(cache.del_glob("*/wind/*") == 1);
+                    REQUIRE(cache.count() == 3007);
+                }
+            }
+        }
+    }
+}
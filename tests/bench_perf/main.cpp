@@ -1,3 +1,5 @@
+#include <filesystem>
+#include <limits>
 #include <string>
 #include <vector>
 
@@ -172,4 +174,146 @@ static void BM_GetLargeValueRepeat(benchmark::State& state)
 }
 BENCHMARK(BM_GetLargeValueRepeat)->Arg(256 * 1024)->Arg(1024 * 1024)->Arg(4 * 1024 * 1024);
 
+// pread-into-pooled-block vs mmap for a first read of a file-backed value,
+// swept over value sizes. Reads rotate over many files and the mmap handle
+// cache is disabled, so every iteration pays the full cost of its strategy;
+// the whole value is touched, as a consumer would. The size at which the
+// two curves cross is what DiskStorage::default_pread_cutoff is set from.
+static void BM_LoadStrategy(benchmark::State& state)
+{
+    auto value_size = static_cast<std::size_t>(state.range(0));
+    bool use_mmap = state.range(1) != 0;
+    AutoCleanDirectory dir { "BenchLoadStrategy" };
+    DiskStorage storage(dir.path(), /*mmap_cache_bytes=*/0);
+    storage.set_pread_cutoff(use_mmap ? 0 : std::numeric_limits<std::size_t>::max());
+    std::vector<char> value(value_size, 'x');
+    std::vector<std::filesystem::path> files;
+    for (int i = 0; i < 64; ++i)
+        files.push_back(*storage.store(value));
+
+    int64_t ops = 0;
+    for (auto _ : state)
+    {
+        auto buffer = storage.load(files[ops % files.size()]);
+        uint64_t sum = 0;
+        for (std::size_t i = 0; i < buffer->size(); i += 64)
+            sum += static_cast<unsigned char>(buffer->data()[i]);
+        benchmark::DoNotOptimize(sum);
+        ++ops;
+    }
+    state.SetLabel(use_mmap ? "mmap" : "pread");
+    state.SetItemsProcessed(ops);
+    state.SetBytesProcessed(ops * static_cast<int64_t>(value_size));
+}
+BENCHMARK(BM_LoadStrategy)
+    ->ArgsProduct({ benchmark::CreateRange(8 * 1024, 4 * 1024 * 1024, 2), { 0, 1 } });
+
+// One batch of 256 medium file-backed reads through load_many(), with the
+// batch going through io_uring (1) or one plain syscall per operation (0).
+static void BM_LoadMany(benchmark::State& state)
+{
+    AutoCleanDirectory dir { "BenchLoadMany" };
+    DiskStorage storage(dir.path());
+    storage.set_io_uring_enabled(state.range(0) != 0);
+    std::vector<char> value(32 * 1024, 'x');
+    std::vector<std::filesystem::path> files;
+    for (int i = 0; i < 256; ++i)
+        files.push_back(*storage.store(value));
+
+    int64_t ops = 0;
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(storage.load_many(files));
+        ops += static_cast<int64_t>(files.size());
+    }
+    state.SetLabel(storage.uses_io_uring() ? "io_uring" : "syscalls");
+    state.SetItemsProcessed(ops);
+}
+BENCHMARK(BM_LoadMany)->Arg(0)->Arg(1);
+
+// set() of a file-backed (64 KiB) or inline (1 KiB) value in each
+// durability mode: none (0), sync (1) and group (2). Group mode runs a
+// sync() wave every 256 sets so its flushes are part of the measured cost.
+static void BM_SetDurability(benchmark::State& state)
+{
+    AutoCleanDirectory dir { "BenchDurability" };
+    Cache cache(dir.path());
+    const auto mode = static_cast<Durability>(state.range(0));
+    cache.set_durability(mode);
+    std::vector<char> value(static_cast<std::size_t>(state.range(1)), 'x');
+    int64_t i = 0;
+    for (auto _ : state)
+    {
+        cache.set("k" + std::to_string(i++), value);
+        if (mode == Durability::group && i % 256 == 0)
+            cache.sync();
+    }
+    cache.sync();
+    state.SetLabel(mode == Durability::none ? "none" : mode == Durability::sync ? "sync" : "group");
+    state.SetItemsProcessed(i);
+}
+BENCHMARK(BM_SetDurability)->ArgsProduct({ { 0, 1, 2 }, { 1024, 64 * 1024 } });
+
+// Scans of the keys and metadata of 10k entries with 4 KiB inline values,
+// kept in the key B-tree (0) or in cache_values (1, see
+// StoreOptions::separate_values); and, for the price of the split, get().
+static void BM_ValueLayout(benchmark::State& state)
+{
+    AutoCleanDirectory dir { "BenchValueLayout" };
+    const bool separate = state.range(0) != 0;
+    StoreOptions options;
+    options.separate_values = separate;
+    Cache cache(dir.path(), 0, options);
+    std::vector<char> value(4 * 1024, 'x');
+    for (int i = 0; i < 10'000; ++i)
+        cache.set("k" + std::to_string(i), value);
+
+    const auto op = state.range(1);
+    int64_t i = 0;
+    for (auto _ : state)
+    {
+        switch (op)
+        {
+            case 0: benchmark::DoNotOptimize(cache.keys()); break;
+            case 1: benchmark::DoNotOptimize(cache.count()); break;
+            case 2: cache.expire(); break;
+            default: benchmark::DoNotOptimize(cache.get("k" + std::to_string(i++ % 10'000)));
+        }
+    }
+    static constexpr const char* ops[] = { "keys", "count", "expire", "get" };
+    state.SetLabel(std::string(separate ? "separate " : "inline ") + ops[op]);
+}
+BENCHMARK(BM_ValueLayout)->ArgsProduct({ { 0, 1 }, { 0, 1, 2, 3 } });
+
+// get(), exists() and set() over 100k entries with 250-byte keys, stored as
+// they are (0) or as 64-bit hashes (1, see StoreOptions::hashed_keys).
+static void BM_KeyLayout(benchmark::State& state)
+{
+    AutoCleanDirectory dir { "BenchKeyLayout" };
+    const bool hashed = state.range(0) != 0;
+    StoreOptions options;
+    options.hashed_keys = hashed;
+    Cache cache(dir.path(), 0, options);
+    const std::string prefix = "amda/" + std::string(230, 'p') + "/";
+    std::vector<char> value(64, 'x');
+    for (int i = 0; i < 100'000; ++i)
+        cache.set(prefix + std::to_string(i), value);
+
+    const auto op = state.range(1);
+    int64_t i = 0;
+    for (auto _ : state)
+    {
+        auto key = prefix + std::to_string((i++ * 7919) % 100'000);
+        switch (op)
+        {
+            case 0: benchmark::DoNotOptimize(cache.get(key)); break;
+            case 1: benchmark::DoNotOptimize(cache.exists(key)); break;
+            default: cache.set(key, value);
+        }
+    }
+    static constexpr const char* ops[] = { "get", "exists", "set" };
+    state.SetLabel(std::string(hashed ? "hashed " : "text ") + ops[op]);
+}
+BENCHMARK(BM_KeyLayout)->ArgsProduct({ { 0, 1 }, { 0, 1, 2 } });
+
 BENCHMARK_MAIN();
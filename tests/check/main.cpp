@@ -1,14 +1,21 @@
 // tests/check/main.cpp
+#include <chrono>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include <catch2/catch_all.hpp>
 #include <catch2/catch_test_macros.hpp>
 #include <sqlite3.h>
 
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
 #include "../common.hpp"
 #include "sciqlop_cache/sciqlop_cache.hpp"
 
@@ -189,6 +196,113 @@ SCENARIO("check() detects size mismatches", "[check]")
     }
 }
 
+SCENARIO("Checksums catch value files whose bytes changed", "[check][checksum]")
+{
+    AutoCleanDirectory dir("check_checksum");
+    Cache cache(dir.path().string());
+    std::vector<char> large(16 * 1024, 'x');
+    cache.set("flipped", std::span(large.data(), large.size()));
+    cache.set("intact", std::span(large.data(), large.size()));
+    cache.set("inline", std::string("small"));
+
+    GIVEN("A value file with one byte overwritten in place")
+    {
+        std::filesystem::path file_path;
+        {
+            sqlite3* raw_db = nullptr;
+            auto db_path = dir.path() / "sciqlop-cache.db";
+            sqlite3_open(db_path.string().c_str(), &raw_db);
+            sqlite3_stmt* stmt = nullptr;
+            sqlite3_prepare_v2(raw_db,
+                "SELECT path FROM cache WHERE key = 'flipped';", -1, &stmt, nullptr);
+            if (sqlite3_step(stmt) == SQLITE_ROW)
+                file_path = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            sqlite3_finalize(stmt);
+            sqlite3_close(raw_db);
+        }
+        REQUIRE(!file_path.empty());
+        if (file_path.is_relative())
+            file_path = dir.path() / file_path;
+        {
+            std::fstream fs(file_path, std::ios::binary | std::ios::in | std::ios::out);
+            fs.seekp(1234);
+            fs.put('y');
+        }
+
+        WHEN("Reads do not verify")
+        {
+            REQUIRE(cache.verify_policy().mode == VerifyMode::off);
+
+            THEN("The changed bytes are returned")
+            {
+                auto v = cache.get("flipped");
+                REQUIRE(v.has_value());
+                REQUIRE(v->size() == large.size());
+                REQUIRE(v->data()[1234] == 'y');
+            }
+
+            AND_THEN("check() finds the mismatch and check(fix=true) drops the entry")
+            {
+                auto result = cache.check();
+                REQUIRE_FALSE(result.ok);
+                REQUIRE(result.checksum_mismatches == 1);
+                REQUIRE(result.size_mismatches == 0);
+                result = cache.check(true);
+                REQUIRE(result.checksum_mismatches == 1);
+                REQUIRE_FALSE(cache.exists("flipped"));
+                REQUIRE(cache.corrupt_values() == 1);
+                REQUIRE(cache.check().ok);
+            }
+        }
+
+        WHEN("Every read verifies")
+        {
+            cache.set_verify_policy({ VerifyMode::always });
+
+            THEN("The corrupt value reads as a miss and its entry is gone")
+            {
+                REQUIRE_FALSE(cache.get("flipped").has_value());
+                REQUIRE_FALSE(cache.exists("flipped"));
+                REQUIRE(cache.corrupt_values() == 1);
+                REQUIRE(cache.get("intact")->to_vector() == large);
+                auto batch = cache.get_many({ "intact", "inline" });
+                REQUIRE(batch[0].has_value());
+                REQUIRE(batch[1].has_value());
+                REQUIRE(cache.check().ok);
+            }
+        }
+
+        WHEN("Half of the reads verify")
+        {
+            cache.set_verify_policy({ VerifyMode::sample, 50.0 });
+            REQUIRE(cache.verify_policy().sample_percent == 50.0);
+
+            THEN("The corrupt value is caught within two reads")
+            {
+                auto first = cache.get("flipped");
+                auto second = cache.get("flipped");
+                REQUIRE((!first || !second));
+                REQUIRE_FALSE(cache.exists("flipped"));
+            }
+        }
+
+        WHEN("The background thread scrubs the value files")
+        {
+            cache.set_checkpoint_policy({ 1000, 16000, std::chrono::milliseconds(20) });
+            cache.set_verify_policy({ VerifyMode::off, 1.0, 1 });
+
+            THEN("The corrupt entry is dropped without being read")
+            {
+                for (int i = 0; i < 250 && cache.exists("flipped"); ++i)
+                    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                REQUIRE_FALSE(cache.exists("flipped"));
+                REQUIRE(cache.exists("intact"));
+                REQUIRE(cache.corrupt_values() == 1);
+            }
+        }
+    }
+}
+
 SCENARIO("check() detects counter drift", "[check]")
 {
     AutoCleanDirectory dir("check_counters");
@@ -288,7 +402,265 @@ SCENARIO("check() on a clean cache reports no issues", "[check]")
                 REQUIRE(result.size_mismatches == 0);
                 REQUIRE(result.counters_consistent);
                 REQUIRE(result.sqlite_integrity_ok);
+                REQUIRE(result.volume_consistent);
+            }
+        }
+    }
+}
+
+SCENARIO("check() does not report files waiting in the deletion queue", "[check][trash]")
+{
+    AutoCleanDirectory dir("check_trash");
+    Cache cache(dir.path().string());
+
+    GIVEN("A file left in the trash directory by a process that died before unlinking it")
+    {
+        auto trash = dir.path() / std::string(DiskStorage::trash_dirname);
+        std::filesystem::create_directories(trash);
+        {
+            std::ofstream ofs(trash / "dead-process-leftover", std::ios::binary);
+            ofs << "stale";
+        }
+
+        WHEN("check() is called")
+        {
+            auto result = cache.check();
+
+            THEN("It is not counted as an orphan")
+            {
+                REQUIRE(result.ok);
+                REQUIRE(result.orphaned_files == 0);
+            }
+        }
+    }
+
+    GIVEN("A file-backed entry that was deleted")
+    {
+        std::vector<char> large(16 * 1024, 'x');
+        cache.set("large", std::span(large.data(), large.size()));
+        REQUIRE(cache.del("large"));
+
+        WHEN("check() is called")
+        {
+            auto result = cache.check();
+
+            THEN("The queued file has been unlinked and the cache is clean")
+            {
+                REQUIRE(result.ok);
+                REQUIRE(std::filesystem::is_empty(dir.path() / std::string(DiskStorage::trash_dirname)));
+            }
+        }
+    }
+}
+
+SCENARIO("volume() is tracked incrementally and reconciled by check()", "[check][volume]")
+{
+    AutoCleanDirectory dir("check_volume");
+    std::vector<char> large(16 * 1024 + 1, 'x');
+
+    GIVEN("A cache whose value files are written, overwritten and deleted")
+    {
+        std::size_t volume_before = 0;
+        {
+            Cache cache(dir.path().string());
+            volume_before = cache.volume();
+            for (int i = 0; i < 8; ++i)
+                cache.set("k" + std::to_string(i), std::span(large.data(), large.size()));
+            cache.set("k0", std::span(large.data(), large.size()));
+            REQUIRE(cache.del("k1"));
+
+            THEN("volume() accounts for the block-rounded files without a walk")
+            {
+                REQUIRE(cache.volume() >= volume_before + 7 * large.size());
+                REQUIRE(cache.check().volume_consistent);
+            }
+        }
+
+        WHEN("the cache is reopened")
+        {
+            Cache cache(dir.path().string());
+
+            THEN("the persisted total still matches the directory")
+            {
+                REQUIRE(cache.check().volume_consistent);
+            }
+        }
+
+        WHEN("a value file disappears behind the cache's back")
+        {
+            Cache cache(dir.path().string());
+            std::filesystem::path victim;
+            for (auto& entry : std::filesystem::recursive_directory_iterator(dir.path()))
+                if (entry.is_regular_file()
+                    && !entry.path().filename().string().starts_with(std::string(Cache::db_fname)))
+                    victim = entry.path();
+            REQUIRE_FALSE(victim.empty());
+            std::filesystem::remove(victim);
+
+            THEN("check() reports the drift and check(fix=true) reconciles it")
+            {
+                REQUIRE_FALSE(cache.check().volume_consistent);
+                REQUIRE_FALSE(cache.check(true).volume_consistent);
+                REQUIRE(cache.check().volume_consistent);
+            }
+        }
+    }
+}
+
+SCENARIO("check_incremental() sweeps the cache in bounded slices", "[check][incremental]")
+{
+    AutoCleanDirectory dir("check_incremental");
+    std::vector<char> large(9000, 'x');
+    auto file_of = [&](Cache& cache, const std::string& key)
+    {
+        (void)cache.get(key);
+        for (auto& entry : std::filesystem::recursive_directory_iterator(dir.path()))
+        {
+            if (!entry.is_regular_file()
+                || entry.path().filename().string().starts_with(std::string(Cache::db_fname)))
+                continue;
+            if (auto v = cache.get(key); v && entry.file_size() == v->size())
+            {
+                std::ifstream ifs(entry.path(), std::ios::binary);
+                char first = 0;
+                ifs.read(&first, 1);
+                if (first == key.back())
+                    return entry.path();
+            }
+        }
+        return std::filesystem::path {};
+    };
+
+    GIVEN("A cache with many file-backed entries, one missing and one truncated file")
+    {
+        {
+            Cache cache(dir.path().string());
+            for (int i = 0; i < 600; ++i)
+                cache.set("k" + std::to_string(i), std::span(large.data(), large.size()));
+            std::vector<char> marked(large);
+            marked[0] = 'a';
+            cache.set("missing_a", std::span(marked.data(), marked.size()));
+            marked[0] = 'b';
+            cache.set("truncated_b", std::span(marked.data(), marked.size()));
+            auto missing = file_of(cache, "missing_a");
+            auto truncated = file_of(cache, "truncated_b");
+            REQUIRE_FALSE(missing.empty());
+            REQUIRE_FALSE(truncated.empty());
+            std::filesystem::remove(missing);
+            std::filesystem::resize_file(truncated, 100);
+        }
+
+        WHEN("check() runs the full pass")
+        {
+            Cache cache(dir.path().string());
+            auto result = cache.check();
+
+            THEN("Both problems are found in one pass over the rows")
+            {
+                REQUIRE(result.rows_checked == 602);
+                REQUIRE(result.dangling_rows == 1);
+                REQUIRE(result.size_mismatches == 1);
+            }
+        }
+
+        WHEN("check_incremental() is called until the pass completes, across a reopen")
+        {
+            std::size_t rows = 0, dangling = 0, mismatches = 0, calls = 0;
+            auto step = [&](Cache& cache)
+            {
+                auto r = cache.check_incremental(250, true);
+                rows += r.rows_checked;
+                dangling += r.dangling_rows;
+                mismatches += r.size_mismatches;
+                ++calls;
+                return r.pass_complete;
+            };
+            {
+                Cache cache(dir.path().string());
+                REQUIRE_FALSE(step(cache));
+            }
+            Cache cache(dir.path().string());
+            while (!step(cache) && calls < 10) { }
+
+            THEN("Every row was visited exactly once and the problems were fixed")
+            {
+                REQUIRE(calls == 3);
+                REQUIRE(rows == 602);
+                REQUIRE(dangling == 1);
+                REQUIRE(mismatches == 1);
+                auto result = cache.check();
+                REQUIRE(result.ok);
+                REQUIRE(cache.count() == 601);
+            }
+        }
+    }
+}
+
+SCENARIO("Value files of uncommitted writes are cleaned up through the intent log", "[check][intents]")
+{
+    AutoCleanDirectory dir("check_intents");
+    std::vector<char> large(16 * 1024, 'x');
+    auto value_files = [&]
+    {
+        std::size_t n = 0;
+        for (auto& entry : std::filesystem::recursive_directory_iterator(dir.path()))
+            if (entry.is_regular_file()
+                && !entry.path().filename().string().starts_with(std::string(Cache::db_fname)))
+                ++n;
+        return n;
+    };
+
+    GIVEN("A user transaction that writes a file-backed value and rolls back")
+    {
+        Cache cache(dir.path().string());
+        {
+            auto txn = cache.begin_user_transaction();
+            cache.set("big", std::span(large.data(), large.size()));
+            REQUIRE(value_files() == 1);
+            txn.rollback();
+        }
+
+        THEN("The file is removed with the transaction")
+        {
+            REQUIRE_FALSE(cache.get("big"));
+            REQUIRE(value_files() == 0);
+            REQUIRE(cache.check().orphaned_files == 0);
+        }
+    }
+
+#ifndef _WIN32
+    GIVEN("A process that dies between writing a value file and committing its row")
+    {
+        {
+            Cache committed(dir.path().string());
+            committed.set("kept", std::span(large.data(), large.size()));
+        }
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            Cache cache(dir.path().string());
+            auto txn = cache.begin_user_transaction();
+            cache.set("lost", std::span(large.data(), large.size()));
+            _exit(0); // no commit, no destructors
+        }
+        int status = 0;
+        waitpid(pid, &status, 0);
+        REQUIRE(value_files() == 2);
+
+        WHEN("The cache is opened again")
+        {
+            Cache cache(dir.path().string());
+
+            THEN("Only the interrupted write's file is removed, without a check() sweep")
+            {
+                REQUIRE(value_files() == 1);
+                REQUIRE(cache.get("kept"));
+                REQUIRE_FALSE(cache.get("lost"));
+                auto result = cache.check();
+                REQUIRE(result.ok);
+                REQUIRE(result.orphaned_files == 0);
             }
         }
     }
+#endif
 }
@@ -123,6 +123,34 @@ SCENARIO("FanoutCache aggregated operations", "[fanout][aggregate]")
             REQUIRE(k.size() == 20);
         }
 
+        THEN("cursors stream the keys and entries of every shard, by prefix")
+        {
+            std::size_t all = 0, under_key1 = 0, items = 0;
+            auto keys = fc.iterkeys("", 3);
+            while (keys.next())
+                ++all;
+            auto prefixed = fc.iterkeys("key1", 3);
+            while (auto key = prefixed.next())
+                under_key1 += key->starts_with("key1");
+            auto entries = fc.items("key1");
+            while (auto item = entries.next())
+                items += item->second.to_vector() == v1;
+            REQUIRE(all == 20);
+            REQUIRE(under_key1 == 11);
+            REQUIRE(items == 11);
+        }
+
+        WHEN("entries are deleted by prefix and by pattern")
+        {
+            REQUIRE(fc.del_prefix("key1") == 11);
+            REQUIRE(fc.del_glob("key?") == 9);
+            THEN("every shard lost its matching entries")
+            {
+                REQUIRE(fc.count() == 0);
+                REQUIRE(fc.size() == 0);
+            }
+        }
+
         WHEN("we clear")
         {
             fc.clear();
@@ -377,6 +377,14 @@ class TestCache(unittest.TestCase):
         self.cache.set("bool", True)
         self.assertEqual(self.cache.get("bool"), True)
 
+    def test_wal_stats(self):
+        self.cache.set("k", b"x" * 1024)
+        stats = self.cache.wal_stats()
+        for field in ("wal_pages", "wal_bytes", "checkpoints", "truncating_checkpoints",
+                      "last_checkpoint_us", "max_checkpoint_us", "total_checkpoint_us"):
+            self.assertIn(field, stats)
+            self.assertGreaterEqual(stats[field], 0)
+
     def test_set_overwrite(self):
         self.cache.set("key", "first")
         self.cache.set("key", "second")
@@ -741,6 +749,7 @@ class TestCheckResult(unittest.TestCase):
             self.assertEqual(result.size_mismatches, 0)
             self.assertTrue(result.counters_consistent)
             self.assertTrue(result.sqlite_integrity_ok)
+            self.assertTrue(result.volume_consistent)
 
     def test_check_fix(self):
         with tempfile.TemporaryDirectory(ignore_cleanup_errors=True) as d:
@@ -749,6 +758,19 @@ class TestCheckResult(unittest.TestCase):
             result = c.check(fix=True)
             self.assertTrue(result.ok)
 
+    def test_check_incremental_sweeps_in_slices(self):
+        with tempfile.TemporaryDirectory(ignore_cleanup_errors=True) as d:
+            c = Cache(os.path.join(d, "check_incremental"))
+            for i in range(5):
+                c[f"key{i}"] = b"x" * 16000
+            checked = 0
+            for _ in range(3):
+                result = c.check_incremental(max_rows=2)
+                self.assertTrue(result.ok)
+                checked += result.rows_checked
+            self.assertTrue(result.pass_complete)
+            self.assertEqual(checked, 5)
+
     def test_fanout_check_returns_result_object(self):
         from pysciqlop_cache import FanoutCache
         with tempfile.TemporaryDirectory(ignore_cleanup_errors=True) as d:
@@ -822,7 +844,7 @@ class TestMmapCache(unittest.TestCase):
         self.assertIsNone(self.cache.get("key"))
 
     def test_eviction_beyond_capacity(self):
-        # Default capacity is 128; write 200 large values to force LRU eviction
+        # Write 200 large values; the handle cache may drop any of them
         for i in range(200):
             self.cache.set(f"k{i}", bytes([i % 256]) * (16 * 1024))
         # All values should still be readable (eviction only drops the mmap
@@ -831,6 +853,233 @@ class TestMmapCache(unittest.TestCase):
             val = self.cache.get(f"k{i}")
             self.assertEqual(val, bytes([i % 256]) * (16 * 1024))
 
+    def test_mmap_cache_stats(self):
+        self.cache.set_pread_cutoff(0)  # map every file-backed value
+        self.cache.set("big", self.large_value)
+        self.cache.reset_mmap_cache_stats()
+        self.cache.get("big")
+        self.cache.get("big")
+        stats = self.cache.mmap_cache_stats()
+        self.assertEqual(stats["misses"], 1)
+        self.assertEqual(stats["hits"], 1)
+        self.assertEqual(stats["entries"], 1)
+        self.assertEqual(stats["mapped_bytes"], len(self.large_value))
+        self.assertGreaterEqual(stats["capacity_bytes"], stats["mapped_bytes"])
+
+    def test_pread_cutoff(self):
+        cutoff = self.cache.pread_cutoff()
+        medium = bytes(range(256)) * ((cutoff - 1) // 256)
+        large = bytes(range(256)) * (cutoff // 256 + 1)
+        self.cache.set("medium", medium)
+        self.cache.set("large", large)
+        self.cache.reset_mmap_cache_stats()
+        for _ in range(2):
+            self.assertEqual(self.cache.get("medium"), medium)
+            self.assertEqual(self.cache.get("large"), large)
+        stats = self.cache.mmap_cache_stats()
+        self.assertEqual(stats["entries"], 1)
+        self.assertEqual(stats["mapped_bytes"], len(large))
+
+    def test_storage_layout(self):
+        self.assertEqual(self.cache.storage_layout(), {"depth": 1, "width": 256})
+        self.cache.set("before", self.large_value)
+        self.cache.set_storage_layout(depth=2, width=16)
+        self.assertEqual(self.cache.storage_layout(), {"depth": 2, "width": 16})
+        self.cache.set("after", self.large_value)
+        self.assertEqual(self.cache.get("before"), self.large_value)
+        self.assertEqual(self.cache.get("after"), self.large_value)
+        self.assertTrue(os.path.isdir(os.path.join(self.tmp_dir, "f", "f")))
+
+    def test_durability(self):
+        from pysciqlop_cache import Durability
+        self.assertEqual(self.cache.durability(), Durability.none)
+        for mode in (Durability.sync, Durability.group, Durability.none):
+            self.cache.set_durability(mode)
+            self.assertEqual(self.cache.durability(), mode)
+            self.cache.set(f"small-{mode.name}", "small")
+            self.cache.set(f"large-{mode.name}", self.large_value)
+            self.cache.sync()
+            self.assertEqual(self.cache.get(f"small-{mode.name}"), "small")
+            self.assertEqual(self.cache.get(f"large-{mode.name}"), self.large_value)
+
+    def test_compression(self):
+        from pysciqlop_cache import available_codecs
+        self.assertEqual(self.cache.compression()["codec"], "none")
+        with self.assertRaises(ValueError):
+            self.cache.set_compression("no-such-codec")
+        if "zlib" not in available_codecs():
+            self.skipTest("built without zlib")
+        value = "x" * 100000
+        self.cache.set("plain", value)
+        self.cache.set_compression("zlib", min_size=1024)
+        self.assertEqual(self.cache.compression()["codec"], "zlib")
+        self.cache.set("packed", value)
+        self.assertEqual(self.cache.get("plain"), value)
+        self.assertEqual(self.cache.get("packed"), value)
+        self.assertLess(self.cache.size(), self.cache.logical_size())
+
+    def test_dedup(self):
+        self.assertEqual(self.cache.dedup_threshold(), 0)
+        self.cache.set_dedup_threshold(1024)
+        self.assertEqual(self.cache.dedup_threshold(), 1024)
+        self.cache.set("a", self.large_value)
+        self.cache.set("b", self.large_value)
+        self.assertTrue(self.cache.delete("a"))
+        self.assertEqual(self.cache.get("b"), self.large_value)
+        self.assertTrue(self.cache.check().ok)
+
+    def test_chunk_policy(self):
+        self.assertEqual(self.cache.chunk_policy()["threshold"], 0)
+        self.cache.set_chunk_policy(threshold=64 * 1024, chunk_size=16 * 1024, workers=3)
+        policy = self.cache.chunk_policy()
+        self.assertEqual(policy["threshold"], 64 * 1024)
+        self.assertEqual(policy["chunk_size"] % 4096, 0)
+        self.assertEqual(policy["workers"], 3)
+        value = bytes(range(256)) * 1024
+        self.cache.set("chunked", value)
+        self.assertEqual(self.cache.get("chunked"), value)
+        self.assertTrue(self.cache.check().ok)
+        self.assertTrue(self.cache.delete("chunked"))
+
+    def test_store_options(self):
+        from pysciqlop_cache import StoreOptions
+        self.assertEqual(self.cache.options().page_size, 4096)
+        self.assertEqual(self.cache.file_size_threshold(), StoreOptions().file_size_threshold)
+        laptop = StoreOptions.laptop()
+        self.cache.set_options(laptop)
+        options = self.cache.options()
+        self.assertEqual(options.page_cache_bytes, laptop.page_cache_bytes)
+        self.assertEqual(options.checkpoint, laptop.checkpoint)
+        self.cache.set_file_size_threshold(1024)
+        self.cache.set("small", b"x" * 2048)
+        self.assertEqual(self.cache.get("small"), b"x" * 2048)
+        self.assertTrue(self.cache.check().ok)
+
+        path = tempfile.mkdtemp()
+        try:
+            server = Cache(cache_path=path, options=StoreOptions.server())
+            self.assertEqual(server.options().page_size, 8192)
+            self.assertEqual(server.file_size_threshold(), StoreOptions.server().file_size_threshold)
+            del server
+        finally:
+            shutil.rmtree(path, ignore_errors=True)
+
+    def test_separate_values(self):
+        from pysciqlop_cache import StoreOptions
+        path = tempfile.mkdtemp()
+        try:
+            options = StoreOptions()
+            options.separate_values = True
+            cache = Cache(cache_path=path, options=options)
+            self.assertTrue(cache.options().separate_values)
+            cache.set("small", b"s" * 100)
+            cache.set("small", b"t" * 200)
+            self.assertEqual(cache.get("small"), b"t" * 200)
+            self.assertEqual(cache.incr("counter", 2), 2)
+            self.assertEqual(cache.count(), 2)
+            result = cache.check()
+            self.assertEqual(result.orphaned_values, 0)
+            self.assertTrue(result.ok)
+            del cache
+            plain = Cache(cache_path=path)
+            self.assertEqual(plain.get("small"), b"t" * 200)
+            self.assertTrue(plain.check().ok)
+            del plain
+        finally:
+            shutil.rmtree(path, ignore_errors=True)
+
+    def test_hashed_keys(self):
+        from pysciqlop_cache import StoreOptions
+        path = tempfile.mkdtemp()
+        try:
+            options = StoreOptions()
+            options.hashed_keys = True
+            cache = Cache(cache_path=path, options=options)
+            self.assertTrue(cache.options().hashed_keys)
+            long_key = "amda/" + "p" * 250
+            cache.set(long_key, b"v" * 100)
+            cache.set(long_key + "/big", b"b" * 100_000)
+            self.assertEqual(cache.get(long_key), b"v" * 100)
+            self.assertEqual(sorted(cache.keys()), [long_key, long_key + "/big"])
+            self.assertTrue(cache.delete(long_key + "/big"))
+            self.assertTrue(cache.check().ok)
+            del cache
+            reopened = Cache(cache_path=path)
+            self.assertTrue(reopened.options().hashed_keys)
+            self.assertEqual(reopened.get(long_key), b"v" * 100)
+            del reopened
+        finally:
+            shutil.rmtree(path, ignore_errors=True)
+
+    def test_threshold_tuning(self):
+        from pysciqlop_cache import ThresholdTuning
+        self.assertFalse(self.cache.threshold_tuning().enabled)
+        tuning = ThresholdTuning()
+        tuning.enabled = True
+        tuning.probe_every = 2
+        self.cache.set_threshold_tuning(tuning)
+        self.assertEqual(self.cache.threshold_tuning(), tuning)
+        self.cache.set_file_size_threshold(4096)
+        self.assertEqual(self.cache.get_meta("file_size_threshold"), "4096")
+        value = b"t" * 3000
+        for i in range(10):
+            self.cache.set(f"tuned-{i}", value)
+        for i in range(10):
+            self.assertEqual(self.cache.get(f"tuned-{i}"), value)
+        self.assertTrue(self.cache.check().ok)
+
+    def test_verify_policy(self):
+        from pysciqlop_cache import VerifyMode
+        self.assertEqual(self.cache.verify_policy()["mode"], VerifyMode.off)
+        self.cache.set_verify_policy(VerifyMode.sample, sample_percent=5.0, scrub_rows=100)
+        policy = self.cache.verify_policy()
+        self.assertEqual(policy["mode"], VerifyMode.sample)
+        self.assertEqual(policy["sample_percent"], 5.0)
+        self.assertEqual(policy["scrub_rows"], 100)
+        self.cache.set_verify_policy(VerifyMode.always)
+        self.cache.set("big", self.large_value)
+        self.assertEqual(self.cache.get("big"), self.large_value)
+        self.assertEqual(self.cache.corrupt_values(), 0)
+        self.assertEqual(self.cache.check().checksum_mismatches, 0)
+
+    def test_tier_policy(self):
+        cold_dir = tempfile.mkdtemp()
+        try:
+            self.cache.set_tier_policy(cold_dir, hot_bytes=2 * len(self.large_value))
+            policy = self.cache.tier_policy()
+            self.assertEqual(policy["cold_path"], cold_dir)
+            self.assertFalse(policy["promote_on_read"])
+            for i in range(4):
+                self.cache.set(f"k{i}", self.large_value)
+            self.assertGreater(self.cache.migrate_tiers(), 0)
+            cold_files = [f for _, _, files in os.walk(cold_dir) for f in files]
+            self.assertGreater(len(cold_files), 0)
+            for i in range(4):
+                self.assertEqual(self.cache.get(f"k{i}"), self.large_value)
+            self.assertTrue(self.cache.check().ok)
+        finally:
+            shutil.rmtree(cold_dir, ignore_errors=True)
+
+    def test_prefetch(self):
+        keys = [f"k{i}" for i in range(50)]
+        for i, k in enumerate(keys):
+            self.cache.set(k, self.large_value if i % 2 else "small")
+        self.cache.prefetch(keys + ["missing"])
+        deadline = time.monotonic() + 5
+        while self.cache.prefetched() < len(keys) + 1 and time.monotonic() < deadline:
+            time.sleep(0.01)
+        self.assertEqual(self.cache.prefetched(), len(keys) + 1)
+        for i, k in enumerate(keys):
+            self.assertEqual(self.cache.get(k), self.large_value if i % 2 else "small")
+
+    def test_set_many_get_many(self):
+        for enabled in (False, True):
+            self.cache.set_io_uring_enabled(enabled)
+            items = {f"k{i}": (self.large_value if i % 2 else i) for i in range(40)}
+            self.assertTrue(self.cache.set_many(items))
+            self.assertEqual(self.cache.get_many(list(items) + ["missing"], default="none"),
+                             list(items.values()) + ["none"])
+
     def test_mixed_small_and_large(self):
         self.cache.set("small", "hello")
         self.cache.set("large", self.large_value)
@@ -855,6 +1104,17 @@ class TestIterkeys(unittest.TestCase):
     def test_iterkeys_empty(self):
         self.assertEqual(list(self.cache.iterkeys()), [])
 
+    def test_cursors_keep_their_store_alive(self):
+        import gc
+        for i in range(10):
+            self.cache.set(f"k{i}", i)
+        del self.cache
+        keys = Cache(self.tmp_dir).iterkeys(page_size=3)
+        items = Cache(self.tmp_dir).items()
+        gc.collect()
+        self.assertEqual(sorted(keys), [f"k{i}" for i in range(10)])
+        self.assertEqual(sorted(items), [(f"k{i}", i) for i in range(10)])
+
     def test_iterkeys_matches_keys(self):
         for i in range(20):
             self.cache.set(f"k{i}", f"v{i}")
@@ -889,6 +1149,35 @@ class TestIterkeys(unittest.TestCase):
                 fc.set(f"k{i}", f"v{i}")
             self.assertEqual(sorted(fc.iterkeys()), sorted(fc.keys()))
 
+    def test_del_prefix_and_glob(self):
+        for i in range(20):
+            self.cache.set(f"amda/solo/{i}", b"v" * (100_000 if i % 5 == 0 else 10))
+        self.cache.set("amda/wind/0", "w")
+        self.cache.set("cdaweb/solo/0", "c")
+        self.assertEqual(self.cache.del_glob("*/solo/1?"), 10)
+        self.assertEqual(self.cache.del_prefix("amda/solo/"), 10)
+        self.assertEqual(sorted(self.cache.keys()), ["amda/wind/0", "cdaweb/solo/0"])
+        self.assertEqual(self.cache.del_prefix("amda/solo/"), 0)
+        with self.assertRaises(ValueError):
+            self.cache.del_prefix("")
+        with self.assertRaises(ValueError):
+            self.cache.del_glob("*")
+        self.assertEqual(len(self.cache), 2)
+        self.assertTrue(self.cache.check().ok)
+
+    def test_iterkeys_and_items_by_prefix(self):
+        for i in range(5):
+            self.cache.set(f"amda/solo/{i}", i)
+        self.cache.set("amda/wind/0", "w")
+        self.cache.set("cdaweb/0", "c")
+        self.assertEqual(sorted(self.cache.iterkeys("amda/solo/", page_size=2)),
+                         [f"amda/solo/{i}" for i in range(5)])
+        self.assertEqual(len(list(self.cache.iterkeys("amda/"))), 6)
+        self.assertEqual(sorted(self.cache.items("amda/solo/")),
+                         [(f"amda/solo/{i}", i) for i in range(5)])
+        self.assertEqual(dict(self.cache.items()), {
+            **{f"amda/solo/{i}": i for i in range(5)}, "amda/wind/0": "w", "cdaweb/0": "c"})
+
 
 class TestErrorHandling(unittest.TestCase):
 